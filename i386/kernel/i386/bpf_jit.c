@@ -0,0 +1,542 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	Compile BPF packet filters to i386 code.
+ *
+ *	net_set_filter hands us a program that bpf_validate has
+ *	already accepted.  We translate it one instruction at a time
+ *	into straight-line code with A in %eax, X in %ebx, the packet
+ *	in %esi, the link-level header in %edi and the scratch memory
+ *	on the stack.  Anything we do not handle (MATCH and KEY
+ *	instructions, backward jumps, unchecked memory indices) makes
+ *	us give up, and the filter is left to bpf_do_filter.
+ *
+ *	The generated code must behave exactly as bpf_do_filter does,
+ *	down to the sign extension of byte loads and the fallback of
+ *	out-of-range absolute loads to the link-level header.
+ *
+ *	All jumps are emitted with 32-bit displacements so that the
+ *	size of each instruction is known before its targets are;
+ *	a first pass finds the code offset of every instruction, and
+ *	the second pass writes the code.
+ */
+
+#include <mach/boolean.h>
+#include <mach/vm_param.h>
+#include <kern/kalloc.h>
+#include <kern/macro_help.h>
+#include <device/net_status.h>
+#include <device/bpf.h>
+#include <i386/bpf_jit.h>
+
+/*
+ *	Clear to make net_set_filter leave new filters to the
+ *	interpreter.
+ */
+boolean_t	bpf_jit_enable = TRUE;
+
+struct bpf_jit_state {
+	unsigned char	*buf;		/* 0 while sizing */
+	int		pos;		/* current code offset */
+	int		reject;		/* code offset of "return 0" */
+	int		ret;		/* code offset of "return min(A, wirelen)" */
+	int		addr[NET_MAX_BPF + 1];
+					/* code offset of each instruction */
+};
+
+#define	EMIT1(s, b)						\
+MACRO_BEGIN							\
+	if ((s)->buf)						\
+		(s)->buf[(s)->pos] = (b);			\
+	(s)->pos++;						\
+MACRO_END
+
+#define	EMIT2(s, b1, b2)					\
+MACRO_BEGIN							\
+	EMIT1(s, b1);						\
+	EMIT1(s, b2);						\
+MACRO_END
+
+#define	EMIT3(s, b1, b2, b3)					\
+MACRO_BEGIN							\
+	EMIT1(s, b1);						\
+	EMIT1(s, b2);						\
+	EMIT1(s, b3);						\
+MACRO_END
+
+#define	EMIT4(s, w)						\
+MACRO_BEGIN							\
+	register unsigned int _w = (w);				\
+	EMIT1(s, _w);						\
+	EMIT1(s, _w >> 8);					\
+	EMIT1(s, _w >> 16);					\
+	EMIT1(s, _w >> 24);					\
+MACRO_END
+
+/* 32-bit displacement to a code offset, after the opcode */
+#define	EMITREL(s, target)	EMIT4(s, (target) - ((s)->pos + 4))
+
+#define	JMP(s, target)							\
+MACRO_BEGIN								\
+	EMIT1(s, 0xe9);							\
+	EMITREL(s, target);						\
+MACRO_END
+
+#define	JCC(s, cc, target)						\
+MACRO_BEGIN								\
+	EMIT2(s, 0x0f, (cc));						\
+	EMITREL(s, target);						\
+MACRO_END
+
+/* condition codes for JCC */
+#define	CC_B	0x82
+#define	CC_AE	0x83
+#define	CC_E	0x84
+#define	CC_NE	0x85
+#define	CC_BE	0x86
+#define	CC_A	0x87
+
+/* network to host order of %eax and %ax, on any i386 */
+#define	SWAP32(s)							\
+MACRO_BEGIN								\
+	EMIT4(s, 0x08c0c166);		/* rolw	$8,%ax */		\
+	EMIT3(s, 0xc1, 0xc0, 0x10);	/* roll	$16,%eax */		\
+	EMIT4(s, 0x08c0c166);		/* rolw	$8,%ax */		\
+MACRO_END
+
+#define	SWAP16(s)	EMIT4(s, 0x08c0c166)	/* rolw	$8,%ax */
+
+/* offsets from %ebp */
+#define	ARG_P		8
+#define	ARG_WIRELEN	12
+#define	ARG_HEADER	16
+#define	MEM(k)		(-12 - 4 * BPF_MEMWORDS + 4 * (k))
+
+/*
+ *	Emit code for a conditional jump, given the opcode of the
+ *	comparison (already emitted) and the inverse condition.
+ */
+static void
+bpf_jit_branch(s, p, i, cc, ncc)
+	struct bpf_jit_state *s;
+	bpf_insn_t p;
+	int i;
+	int cc, ncc;
+{
+	int jt = s->addr[i + 1 + p->jt];
+	int jf = s->addr[i + 1 + p->jf];
+
+	if (p->jt == p->jf)
+		JMP(s, jt);
+	else if (p->jt == 0)
+		JCC(s, ncc, jf);
+	else {
+		JCC(s, cc, jt);
+		if (p->jf != 0)
+			JMP(s, jf);
+	}
+}
+
+/*
+ *	Translate a validated program.  Return FALSE if it uses
+ *	something we do not compile.
+ */
+static boolean_t
+bpf_jit_emit(s, f, len)
+	register struct bpf_jit_state *s;
+	bpf_insn_t f;
+	int len;
+{
+	register bpf_insn_t p;
+	register int i;
+	int k;
+
+	s->pos = 0;
+
+	/*
+	 *	Prologue.
+	 */
+	EMIT1(s, 0x55);			/* pushl %ebp */
+	EMIT2(s, 0x89, 0xe5);		/* movl	%esp,%ebp */
+	EMIT1(s, 0x53);			/* pushl %ebx */
+	EMIT1(s, 0x56);			/* pushl %esi */
+	EMIT1(s, 0x57);			/* pushl %edi */
+	EMIT3(s, 0x83, 0xec, 4 * BPF_MEMWORDS);
+					/* subl	$mem,%esp */
+	EMIT3(s, 0x8b, 0x75, ARG_P);	/* movl	p,%esi */
+	EMIT3(s, 0x8b, 0x7d, ARG_HEADER);
+					/* movl	header,%edi */
+	EMIT2(s, 0x31, 0xc0);		/* xorl	%eax,%eax */
+	EMIT2(s, 0x31, 0xdb);		/* xorl	%ebx,%ebx */
+
+	/* f[0] is BPF_BEGIN */
+	for (i = 1, p = &f[1]; i < len; i++, p++) {
+		s->addr[i] = s->pos;
+		k = p->k;
+
+		switch (p->code) {
+
+		case BPF_RET|BPF_K:
+			EMIT1(s, 0xb8);		/* movl	$k,%eax */
+			EMIT4(s, k);
+			/* fall through */
+
+		case BPF_RET|BPF_A:
+			JMP(s, s->ret);
+			break;
+
+		case BPF_LD|BPF_W|BPF_ABS:
+		case BPF_LD|BPF_H|BPF_ABS:
+		case BPF_LD|BPF_B|BPF_ABS:
+		    {
+			unsigned int size, base;
+
+			size = (BPF_SIZE(p->code) == BPF_W) ? 4 :
+			       (BPF_SIZE(p->code) == BPF_H) ? 2 : 1;
+			if ((unsigned int)k + size <= NET_RCV_MAX)
+				base = 0x86;		/* k(%esi) */
+			else {
+				k -= BPF_DLBASE;
+				if ((unsigned int)k + size > NET_HDW_HDR_MAX) {
+					JMP(s, s->reject);
+					break;
+				}
+				base = 0x87;		/* k(%edi) */
+			}
+			if (size == 4) {
+				EMIT2(s, 0x8b, base);	/* movl */
+				EMIT4(s, k);
+				SWAP32(s);
+			} else if (size == 2) {
+				EMIT3(s, 0x0f, 0xb7, base);
+						/* movzwl */
+				EMIT4(s, k);
+				SWAP16(s);
+			} else {
+				/* bpf_do_filter loads a (signed) char */
+				EMIT3(s, 0x0f, 0xbe, base);
+						/* movsbl */
+				EMIT4(s, k);
+			}
+			break;
+		    }
+
+		case BPF_LD|BPF_W|BPF_IND:
+		case BPF_LD|BPF_H|BPF_IND:
+		case BPF_LD|BPF_B|BPF_IND:
+		    {
+			unsigned int size;
+
+			size = (BPF_SIZE(p->code) == BPF_W) ? 4 :
+			       (BPF_SIZE(p->code) == BPF_H) ? 2 : 1;
+			EMIT2(s, 0x8d, 0x8b);	/* leal	k(%ebx),%ecx */
+			EMIT4(s, k);
+			EMIT2(s, 0x81, 0xf9);	/* cmpl	$max,%ecx */
+			EMIT4(s, NET_RCV_MAX - size);
+			JCC(s, CC_A, s->reject);
+			if (size == 4) {
+				EMIT3(s, 0x8b, 0x04, 0x0e);
+						/* movl	(%esi,%ecx),%eax */
+				SWAP32(s);
+			} else if (size == 2) {
+				EMIT4(s, 0x0e04b70f);
+						/* movzwl (%esi,%ecx),%eax */
+				SWAP16(s);
+			} else
+				EMIT4(s, 0x0e04be0f);
+						/* movsbl (%esi,%ecx),%eax */
+			break;
+		    }
+
+		case BPF_LDX|BPF_MSH|BPF_B:
+			if ((unsigned int)k >= NET_RCV_MAX) {
+				JMP(s, s->reject);
+				break;
+			}
+			EMIT3(s, 0x0f, 0xb6, 0x9e);
+					/* movzbl k(%esi),%ebx */
+			EMIT4(s, k);
+			EMIT3(s, 0x83, 0xe3, 0x0f);
+					/* andl	$0xf,%ebx */
+			EMIT3(s, 0xc1, 0xe3, 0x02);
+					/* shll	$2,%ebx */
+			break;
+
+		case BPF_LD|BPF_W|BPF_LEN:
+			EMIT3(s, 0x8b, 0x45, ARG_WIRELEN);
+					/* movl	wirelen,%eax */
+			break;
+
+		case BPF_LDX|BPF_W|BPF_LEN:
+			EMIT3(s, 0x8b, 0x5d, ARG_WIRELEN);
+					/* movl	wirelen,%ebx */
+			break;
+
+		case BPF_LD|BPF_IMM:
+			EMIT1(s, 0xb8);		/* movl	$k,%eax */
+			EMIT4(s, k);
+			break;
+
+		case BPF_LDX|BPF_IMM:
+			EMIT1(s, 0xbb);		/* movl	$k,%ebx */
+			EMIT4(s, k);
+			break;
+
+		case BPF_LD|BPF_MEM:
+		case BPF_LDX|BPF_MEM:
+		case BPF_ST:
+		case BPF_STX:
+			/* bpf_validate does not check LDX and STX */
+			if (k < 0 || k >= BPF_MEMWORDS)
+				return FALSE;
+			EMIT1(s, (BPF_CLASS(p->code) == BPF_LD ||
+				  BPF_CLASS(p->code) == BPF_LDX) ? 0x8b : 0x89);
+			EMIT1(s, (BPF_CLASS(p->code) == BPF_LD ||
+				  BPF_CLASS(p->code) == BPF_ST) ? 0x45 : 0x5d);
+			EMIT1(s, MEM(k));
+					/* movl	between %eax/%ebx and mem[k] */
+			break;
+
+		case BPF_JMP|BPF_JA:
+			if (k < 0)
+				return FALSE;
+			JMP(s, s->addr[i + 1 + k]);
+			break;
+
+		case BPF_JMP|BPF_JGT|BPF_K:
+		case BPF_JMP|BPF_JGE|BPF_K:
+		case BPF_JMP|BPF_JEQ|BPF_K:
+			EMIT1(s, 0x3d);		/* cmpl	$k,%eax */
+			EMIT4(s, k);
+			goto branch;
+
+		case BPF_JMP|BPF_JSET|BPF_K:
+			EMIT1(s, 0xa9);		/* testl $k,%eax */
+			EMIT4(s, k);
+			goto branch;
+
+		case BPF_JMP|BPF_JGT|BPF_X:
+		case BPF_JMP|BPF_JGE|BPF_X:
+		case BPF_JMP|BPF_JEQ|BPF_X:
+			EMIT2(s, 0x39, 0xd8);	/* cmpl	%ebx,%eax */
+			goto branch;
+
+		case BPF_JMP|BPF_JSET|BPF_X:
+			EMIT2(s, 0x85, 0xd8);	/* testl %ebx,%eax */
+		branch:
+			switch (BPF_OP(p->code)) {
+			case BPF_JGT:
+				bpf_jit_branch(s, p, i, CC_A, CC_BE);
+				break;
+			case BPF_JGE:
+				bpf_jit_branch(s, p, i, CC_AE, CC_B);
+				break;
+			case BPF_JEQ:
+				bpf_jit_branch(s, p, i, CC_E, CC_NE);
+				break;
+			case BPF_JSET:
+				bpf_jit_branch(s, p, i, CC_NE, CC_E);
+				break;
+			}
+			break;
+
+		case BPF_ALU|BPF_ADD|BPF_K:
+			EMIT1(s, 0x05);		/* addl	$k,%eax */
+			EMIT4(s, k);
+			break;
+
+		case BPF_ALU|BPF_SUB|BPF_K:
+			EMIT1(s, 0x2d);		/* subl	$k,%eax */
+			EMIT4(s, k);
+			break;
+
+		case BPF_ALU|BPF_MUL|BPF_K:
+			EMIT2(s, 0x69, 0xc0);	/* imull $k,%eax,%eax */
+			EMIT4(s, k);
+			break;
+
+		case BPF_ALU|BPF_DIV|BPF_K:
+			EMIT1(s, 0xb9);		/* movl	$k,%ecx */
+			EMIT4(s, k);
+			EMIT2(s, 0x31, 0xd2);	/* xorl	%edx,%edx */
+			EMIT2(s, 0xf7, 0xf1);	/* divl	%ecx */
+			break;
+
+		case BPF_ALU|BPF_AND|BPF_K:
+			EMIT1(s, 0x25);		/* andl	$k,%eax */
+			EMIT4(s, k);
+			break;
+
+		case BPF_ALU|BPF_OR|BPF_K:
+			EMIT1(s, 0x0d);		/* orl	$k,%eax */
+			EMIT4(s, k);
+			break;
+
+		case BPF_ALU|BPF_LSH|BPF_K:
+			/* the count is taken mod 32, as in shll %cl */
+			EMIT3(s, 0xc1, 0xe0, k & 0x1f);
+					/* shll	$k,%eax */
+			break;
+
+		case BPF_ALU|BPF_RSH|BPF_K:
+			EMIT3(s, 0xc1, 0xe8, k & 0x1f);
+					/* shrl	$k,%eax */
+			break;
+
+		case BPF_ALU|BPF_ADD|BPF_X:
+			EMIT2(s, 0x01, 0xd8);	/* addl	%ebx,%eax */
+			break;
+
+		case BPF_ALU|BPF_SUB|BPF_X:
+			EMIT2(s, 0x29, 0xd8);	/* subl	%ebx,%eax */
+			break;
+
+		case BPF_ALU|BPF_MUL|BPF_X:
+			EMIT3(s, 0x0f, 0xaf, 0xc3);
+					/* imull %ebx,%eax */
+			break;
+
+		case BPF_ALU|BPF_DIV|BPF_X:
+			EMIT2(s, 0x85, 0xdb);	/* testl %ebx,%ebx */
+			JCC(s, CC_E, s->reject);
+			EMIT2(s, 0x31, 0xd2);	/* xorl	%edx,%edx */
+			EMIT2(s, 0xf7, 0xf3);	/* divl	%ebx */
+			break;
+
+		case BPF_ALU|BPF_AND|BPF_X:
+			EMIT2(s, 0x21, 0xd8);	/* andl	%ebx,%eax */
+			break;
+
+		case BPF_ALU|BPF_OR|BPF_X:
+			EMIT2(s, 0x09, 0xd8);	/* orl	%ebx,%eax */
+			break;
+
+		case BPF_ALU|BPF_LSH|BPF_X:
+			EMIT2(s, 0x89, 0xd9);	/* movl	%ebx,%ecx */
+			EMIT2(s, 0xd3, 0xe0);	/* shll	%cl,%eax */
+			break;
+
+		case BPF_ALU|BPF_RSH|BPF_X:
+			EMIT2(s, 0x89, 0xd9);	/* movl	%ebx,%ecx */
+			EMIT2(s, 0xd3, 0xe8);	/* shrl	%cl,%eax */
+			break;
+
+		case BPF_ALU|BPF_NEG:
+			EMIT2(s, 0xf7, 0xd8);	/* negl	%eax */
+			break;
+
+		case BPF_MISC|BPF_TAX:
+			EMIT2(s, 0x89, 0xc3);	/* movl	%eax,%ebx */
+			break;
+
+		case BPF_MISC|BPF_TXA:
+			EMIT2(s, 0x89, 0xd8);	/* movl	%ebx,%eax */
+			break;
+
+		default:
+			/* BPF_RET|BPF_MATCH_IMM, BPF_KEY, or unknown */
+			return FALSE;
+		}
+	}
+
+	/*
+	 *	Running off the end rejects the packet (bpf_validate
+	 *	makes sure it cannot happen).  Returns clamp the count
+	 *	to the length of the packet.
+	 */
+	s->addr[len] = s->reject = s->pos;
+	EMIT2(s, 0x31, 0xc0);		/* xorl	%eax,%eax */
+	s->ret = s->pos;
+	EMIT3(s, 0x3b, 0x45, ARG_WIRELEN);
+					/* cmpl	wirelen,%eax */
+	EMIT2(s, 0x76, 0x03);		/* jbe	1f */
+	EMIT3(s, 0x8b, 0x45, ARG_WIRELEN);
+					/* movl	wirelen,%eax */
+					/* 1: */
+	EMIT3(s, 0x8d, 0x65, 0xf4);	/* leal	-12(%ebp),%esp */
+	EMIT1(s, 0x5f);			/* popl	%edi */
+	EMIT1(s, 0x5e);			/* popl	%esi */
+	EMIT1(s, 0x5b);			/* popl	%ebx */
+	EMIT1(s, 0x5d);			/* popl	%ebp */
+	EMIT1(s, 0xc3);			/* ret */
+
+	return TRUE;
+}
+
+/*
+ *	Routine:	bpf_jit_compile
+ *	Purpose:
+ *		Compile a validated BPF program of the given size
+ *		in bytes.  Returns BPF_JIT_NULL if the program is
+ *		better left to bpf_do_filter.
+ *	Conditions:
+ *		Nothing locked; may block allocating memory.
+ */
+bpf_jit_t
+bpf_jit_compile(f, bytes)
+	bpf_insn_t f;
+	int bytes;
+{
+	struct bpf_jit_state state;
+	vm_size_t size;
+	vm_offset_t code;
+	int len;
+
+	if (!bpf_jit_enable)
+		return BPF_JIT_NULL;
+
+	len = BPF_BYTES2LEN(bytes);
+	if (len < 2 || len > NET_MAX_BPF)
+		return BPF_JIT_NULL;
+
+	/*
+	 *	The sizing pass finds every code offset; the second
+	 *	pass, which emits the same sizes, fills in the code.
+	 */
+	bzero((char *) &state, sizeof state);
+	if (!bpf_jit_emit(&state, f, len))
+		return BPF_JIT_NULL;
+
+	/* remember the size in front of the code, for bpf_jit_free */
+	size = sizeof(vm_size_t) + state.pos;
+	code = kalloc(size);
+	if (code == 0)
+		return BPF_JIT_NULL;
+	*(vm_size_t *) code = size;
+
+	state.buf = (unsigned char *) (code + sizeof(vm_size_t));
+	(void) bpf_jit_emit(&state, f, len);
+
+	return (bpf_jit_t) state.buf;
+}
+
+/*
+ *	Routine:	bpf_jit_free
+ *	Purpose:
+ *		Release code from bpf_jit_compile.
+ */
+void
+bpf_jit_free(code)
+	bpf_jit_t code;
+{
+	vm_offset_t addr = (vm_offset_t) code - sizeof(vm_size_t);
+
+	kfree(addr, *(vm_size_t *) addr);
+}
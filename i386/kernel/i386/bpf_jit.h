@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	Compiler from BPF packet filter programs to i386 code.
+ */
+
+#ifndef	_I386_BPF_JIT_H_
+#define	_I386_BPF_JIT_H_
+
+#include <device/bpf.h>
+
+#define	MACHINE_BPF_JIT	1
+
+/*
+ *	A compiled filter is called with the packet data, its length
+ *	and the link-level header, and returns what bpf_do_filter
+ *	would: the number of bytes to accept, or 0.
+ */
+typedef unsigned int	(*bpf_jit_t)(char *p, unsigned int wirelen,
+				     char *header);
+
+#define	BPF_JIT_NULL	((bpf_jit_t) 0)
+
+extern bpf_jit_t	bpf_jit_compile(bpf_insn_t f, int bytes);
+extern void		bpf_jit_free(bpf_jit_t code);
+
+#endif	/* _I386_BPF_JIT_H_ */
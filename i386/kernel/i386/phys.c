@@ -34,6 +34,7 @@
 #include <vm/vm_page.h>
 
 #include <i386/pmap.h>
+#include <i386/proc_reg.h>
 #include <mach/machine/vm_param.h>
 
 /*
@@ -46,6 +47,37 @@ pmap_zero_page(p)
 	bzero(phystokv(p), PAGE_SIZE);
 }
 
+/*
+ *	pmap_zero_page_nocache zeros the specified page without
+ *	pulling it into the cache, for pages that are zeroed ahead
+ *	of time and won't be touched again soon.  Falls back
+ *	on pmap_zero_page if the processor lacks movnti.
+ */
+void
+pmap_zero_page_nocache(p)
+	vm_offset_t p;
+{
+	register int	*va, *end;
+
+	assert(p != vm_page_fictitious_addr);
+
+	if ((cpu_features & CPUID_FEAT_SSE2) == 0) {
+		bzero(phystokv(p), PAGE_SIZE);
+		return;
+	}
+
+	va = (int *) phystokv(p);
+	end = va + PAGE_SIZE / sizeof(int);
+	for (; va < end; va += 4)
+		asm volatile("movnti %1, 0(%0)\n\t"
+			     "movnti %1, 4(%0)\n\t"
+			     "movnti %1, 8(%0)\n\t"
+			     "movnti %1, 12(%0)"
+			     : : "r" (va), "r" (0) : "memory");
+	/* Non-temporal stores are weakly ordered.  */
+	asm volatile("sfence" : : : "memory");
+}
+
 /*
  *	pmap_copy_page copies the specified (machine independent) pages.
  */
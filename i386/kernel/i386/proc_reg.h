@@ -45,6 +45,21 @@
 #define	CR0_MP	0x00000002		/*	 monitor coprocessor */
 #define	CR0_PE	0x00000001		/*	 enable protected mode */
 
+/*
+ * CR4
+ */
+#define	CR4_PSE	0x00000010		/* Pentium: 4MB pages */
+
+/*
+ * CPUID function 1 feature flags (%edx)
+ */
+#define	CPUID_FEAT_FPU	0x00000001		/* on-chip floating point */
+#define	CPUID_FEAT_PSE	0x00000008		/* 4MB page size extension */
+#define	CPUID_FEAT_TSC	0x00000010		/* time stamp counter */
+#define	CPUID_FEAT_PGE	0x00002000		/* global pages */
+#define	CPUID_FEAT_SSE	0x02000000		/* SSE, incl. sfence */
+#define	CPUID_FEAT_SSE2	0x04000000		/* SSE2, incl. movnti */
+
 #ifndef	ASSEMBLER
 #ifdef	__GNUC__
 
@@ -109,6 +124,19 @@ set_eflags(unsigned eflags)
 	asm volatile("mov %0, %%cr3" : : "r" (_temp__)); \
      })
 
+#define	get_cr4() \
+    ({ \
+	register unsigned int _temp__; \
+	asm("mov %%cr4, %0" : "=r" (_temp__)); \
+	_temp__; \
+    })
+
+#define	set_cr4(value) \
+    ({ \
+	register unsigned int _temp__ = (value); \
+	asm volatile("mov %0, %%cr4" : : "r" (_temp__)); \
+     })
+
 #define	set_ts() \
 	set_cr0(get_cr0() | CR0_TS)
 
@@ -135,6 +163,14 @@ set_eflags(unsigned eflags)
 #define	set_ldt(seg) \
 	asm volatile("lldt %0" : : "rm" ((unsigned short)(seg)) )
 
+#define	cpuid(func, eax, ebx, ecx, edx) \
+	asm volatile("cpuid"					\
+		     : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)	\
+		     : "a" (func))
+
+#define	rdtsc(low, high) \
+	asm volatile("rdtsc" : "=a" (low), "=d" (high))
+
 /* This doesn't set a processor register,
    but it's often used immediately after setting one,
    to flush the instruction queue.  */
@@ -145,6 +181,13 @@ set_eflags(unsigned eflags)
 	)
 
 #endif	/* __GNUC__ */
+
+/*
+ * CPUID feature flags of the boot processor,
+ * or zero if it doesn't implement CPUID.
+ */
+extern unsigned int cpu_features;
+
 #endif	/* ASSEMBLER */
 
 #endif	/* _I386_PROC_REG_H_ */
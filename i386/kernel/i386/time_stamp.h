@@ -23,8 +23,37 @@
  * any improvements or extensions that they make and grant Carnegie Mellon
  * the rights to redistribute these changes.
  */
+#ifndef	_I386_TIME_STAMP_H_
+#define	_I386_TIME_STAMP_H_
+
 /*
  *	The i386 timestamp implementation uses the default, so we don't
  *	need to do anything here.
  */
 
+/*
+ *	For timing short kernel paths, cycle_count returns the low
+ *	word of the time stamp counter, or 0 if the processor has none.
+ */
+
+#ifndef	ASSEMBLER
+#ifdef	__GNUC__
+
+#include <i386/proc_reg.h>
+
+static inline unsigned
+cycle_count()
+{
+	unsigned low, high;
+
+	if ((cpu_features & CPUID_FEAT_TSC) == 0)
+		return 0;
+	rdtsc(low, high);
+	return low;
+}
+#define	cycle_count	cycle_count
+
+#endif	/* __GNUC__ */
+#endif	/* ASSEMBLER */
+
+#endif	/* _I386_TIME_STAMP_H_ */
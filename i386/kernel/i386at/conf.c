@@ -84,6 +84,7 @@ extern int	pc586open(), pc586output(), pc586getstat(), pc586setstat(),
 #include <ne.h>
 #if     NNE > 0
 extern int      neopen(), neoutput(), negetstat(), nesetstat(), nesetinput();
+extern vm_offset_t	nemmap();
 #ifdef FIPC
 extern int      nefoutput();
 #endif /* FIPC */
@@ -95,6 +96,8 @@ extern int      nefoutput();
 extern int	wd8003open(), eliiopen();
 extern int	ns8390output(), ns8390getstat(), ns8390setstat(), 
 		ns8390setinput();
+extern vm_offset_t	ns8390mmap();
+extern int	ns8390devinfo();
 #define	ns8390wdname		"wd"
 #define	ns8390elname		"el"
 #endif NNS8390 > 0
@@ -264,7 +267,7 @@ struct dev_ops	dev_name_list[] =
 
 #if     NNE > 0
         { nename,       neopen,         nulldev,        nulldev,
-          neoutput,     negetstat,      nesetstat,      nulldev,
+          neoutput,     negetstat,      nesetstat,      nemmap,
 #ifdef FIPC
           nesetinput,   nulldev,        nefoutput,      0,
 #else
@@ -282,14 +285,14 @@ struct dev_ops	dev_name_list[] =
 
 #if	NNS8390 > 0
 	{ ns8390wdname,	wd8003open,	nulldev,	nulldev,
-	  ns8390output, ns8390getstat,	ns8390setstat,	nomap,
+	  ns8390output, ns8390getstat,	ns8390setstat,	ns8390mmap,
 	  ns8390setinput, nulldev,	nulldev,	0,
-	  nodev },
+	  ns8390devinfo },
 
 	{ ns8390elname,	eliiopen,	nulldev,	nulldev,
-	  ns8390output, ns8390getstat,	ns8390setstat,	nomap,
+	  ns8390output, ns8390getstat,	ns8390setstat,	ns8390mmap,
 	  ns8390setinput, nulldev,	nulldev,	0,
-	  nodev },
+	  ns8390devinfo },
 #endif
 
 #if   	NUL > 0
@@ -289,6 +289,7 @@ alloc_contig_mem(unsigned size, unsigned limit,
 	 * Walk the page free list and set a bit for every usable page.
 	 */
 	simple_lock(&vm_page_queue_free_lock);
+	vm_page_zeroed_drain();
 	p = vm_page_queue_free;
 	while (p) {
 		if (p->phys_addr < limit)
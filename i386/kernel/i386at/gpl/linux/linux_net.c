@@ -243,7 +243,7 @@ void
 dev_kfree_skb (struct sk_buff *skb, int mode)
 {
   unsigned flags;
-  extern void *io_done_list;
+  extern void io_done_wakeup ();
 
   /* Queue sk_buff on done list if there is a
      page list attached or we need to send a reply.
@@ -252,7 +252,7 @@ dev_kfree_skb (struct sk_buff *skb, int mode)
     {
       skb_queue_tail (&skb_done_list, skb);
       save_flags (flags);
-      thread_wakeup ((event_t) &io_done_list);
+      io_done_wakeup ();
       restore_flags (flags);
       return;
     }
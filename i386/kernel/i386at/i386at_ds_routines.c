@@ -31,6 +31,7 @@
 
 #include <device/device_types.h>
 #include <device/device_port.h>
+#include <device/io_cq.h>
 #include "device_interface.h"
 
 #include <i386at/dev_hdr.h>
@@ -104,11 +105,14 @@ ds_device_write (device_t dev, ipc_port_t reply_port,
 		 int *bytes_written)
 {
   if (dev == DEVICE_NULL)
-    return D_NO_SUCH_DEVICE;
+    return io_cq_error (reply_port, reply_port_type, IO_CQ_WRITE, recnum,
+			D_NO_SUCH_DEVICE, (vm_map_copy_t) data);
   if (! data)
-    return D_INVALID_SIZE;
+    return io_cq_error (reply_port, reply_port_type, IO_CQ_WRITE, recnum,
+			D_INVALID_SIZE, VM_MAP_COPY_NULL);
   if (! dev->emul_ops->write)
-    return D_INVALID_OPERATION;
+    return io_cq_error (reply_port, reply_port_type, IO_CQ_WRITE, recnum,
+			D_INVALID_OPERATION, (vm_map_copy_t) data);
   return (*dev->emul_ops->write) (dev->emul_data, reply_port,
 				  reply_port_type, mode, recnum,
 				  data, count, bytes_written);
@@ -122,11 +126,14 @@ ds_device_write_inband (device_t dev, ipc_port_t reply_port,
 			int *bytes_written)
 {
   if (dev == DEVICE_NULL)
-    return D_NO_SUCH_DEVICE;
+    return io_cq_error (reply_port, reply_port_type, IO_CQ_WRITE, recnum,
+			D_NO_SUCH_DEVICE, VM_MAP_COPY_NULL);
   if (! data)
-    return D_INVALID_SIZE;
+    return io_cq_error (reply_port, reply_port_type, IO_CQ_WRITE, recnum,
+			D_INVALID_SIZE, VM_MAP_COPY_NULL);
   if (! dev->emul_ops->write_inband)
-    return D_INVALID_OPERATION;
+    return io_cq_error (reply_port, reply_port_type, IO_CQ_WRITE, recnum,
+			D_INVALID_OPERATION, VM_MAP_COPY_NULL);
   return (*dev->emul_ops->write_inband) (dev->emul_data, reply_port,
 					 reply_port_type, mode, recnum,
 					 data, count, bytes_written);
@@ -139,9 +146,11 @@ ds_device_read (device_t dev, ipc_port_t reply_port,
 		unsigned *bytes_read)
 {
   if (dev == DEVICE_NULL)
-    return D_NO_SUCH_DEVICE;
+    return io_cq_error (reply_port, reply_port_type, IO_CQ_READ, recnum,
+			D_NO_SUCH_DEVICE, VM_MAP_COPY_NULL);
   if (! dev->emul_ops->read)
-    return D_INVALID_OPERATION;
+    return io_cq_error (reply_port, reply_port_type, IO_CQ_READ, recnum,
+			D_INVALID_OPERATION, VM_MAP_COPY_NULL);
   return (*dev->emul_ops->read) (dev->emul_data, reply_port,
 				 reply_port_type, mode, recnum,
 				 count, data, bytes_read);
@@ -154,9 +163,11 @@ ds_device_read_inband (device_t dev, ipc_port_t reply_port,
 		       unsigned *bytes_read)
 {
   if (dev == DEVICE_NULL)
-    return D_NO_SUCH_DEVICE;
+    return io_cq_error (reply_port, reply_port_type, IO_CQ_READ, recnum,
+			D_NO_SUCH_DEVICE, VM_MAP_COPY_NULL);
   if (! dev->emul_ops->read_inband)
-    return D_INVALID_OPERATION;
+    return io_cq_error (reply_port, reply_port_type, IO_CQ_READ, recnum,
+			D_INVALID_OPERATION, VM_MAP_COPY_NULL);
   return (*dev->emul_ops->read_inband) (dev->emul_data, reply_port,
 					reply_port_type, mode, recnum,
 					count, data, bytes_read);
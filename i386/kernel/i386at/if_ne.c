@@ -879,7 +879,7 @@ int   flag;
 {
 	register int unit = minor(dev);
 
-	if (!ne_softc[unit].card_present || unit < 0 || unit >= NNE)
+	if (unit < 0 || unit >= NNE || !ne_softc[unit].card_present)
 		return (ENXIO);
 
 	ne_softc[unit].ds_if.if_flags |= IFF_UP;
@@ -894,7 +894,7 @@ io_req_t ior;
 {
 	register int unit = minor(dev);
 
-	if (!ne_softc[unit].card_present || unit < 0 || unit >= NNE)
+	if (unit < 0 || unit >= NNE || !ne_softc[unit].card_present)
 		return (ENXIO);
 
 	return (net_fwrite(&ne_softc[unit].ds_if, nestart, ior));
@@ -907,7 +907,7 @@ io_req_t ior;
 {
 	register int unit = minor(dev);
 
-	if (!ne_softc[unit].card_present || unit < 0 || unit >= NNE)
+	if (unit < 0 || unit >= NNE || !ne_softc[unit].card_present)
 		return (ENXIO);
 
 	return (net_write(&ne_softc[unit].ds_if, nestart, ior));
@@ -922,7 +922,7 @@ unsigned int	filter_count;
 {
 	register int unit = minor(dev);
 
-	if (!ne_softc[unit].card_present || unit < 0 || unit >= NNE)
+	if (unit < 0 || unit >= NNE || !ne_softc[unit].card_present)
 		return (ENXIO);
 
 	return (net_set_filter(&ne_softc[unit].ds_if,
@@ -938,7 +938,7 @@ unsigned int	*count;
 {
 	register int unit = minor(dev);
 
-	if (!ne_softc[unit].card_present || unit < 0 || unit >= NNE)
+	if (unit < 0 || unit >= NNE || !ne_softc[unit].card_present)
 		return (ENXIO);
 
 	return (net_getstat(&ne_softc[unit].ds_if,
@@ -947,6 +947,20 @@ unsigned int	*count;
 			    count));
 }
 
+vm_offset_t
+nemmap(dev, off, prot)
+dev_t		dev;
+vm_offset_t	off;
+vm_prot_t	prot;
+{
+	register int unit = minor(dev);
+
+	if (unit < 0 || unit >= NNE || !ne_softc[unit].card_present)
+		return (-1);
+
+	return (net_ring_mmap(&ne_softc[unit].ds_if, off, prot));
+}
+
 nesetstat(dev, flavor, status, count)
 dev_t		dev;
 int		flavor;
@@ -956,7 +970,7 @@ unsigned int	count;
 	register int unit = minor(dev);
 	register ne_softc_t *ns;
 
-	if (!ne_softc[unit].card_present || unit < 0 || unit >= NNE)
+	if (unit < 0 || unit >= NNE || !ne_softc[unit].card_present)
 		return (ENXIO);
 
 	ns = &ne_softc[unit];
@@ -82,6 +82,7 @@ WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include	<kern/time_out.h>
 #include	<device/device_types.h>
 #include	<device/errno.h>
+#include	<device/conf.h>
 #include	<device/io_req.h>
 #include	<device/if_hdr.h>
 #include	<device/if_ether.h>
@@ -782,6 +783,45 @@ ns8390getstat(dev, flavor, status, count)
 			    status,
 			    count));
 }
+
+/*ARGSUSED*/
+vm_offset_t
+ns8390mmap(dev, off, prot)
+	dev_t		dev;
+	vm_offset_t	off;
+	vm_prot_t	prot;
+{
+	register int	unit = minor(dev);
+
+	if (unit < 0 || unit >= NNS8390 ||
+		ns8390_softc[unit].nic == 0)
+	    return (-1);
+
+	return (net_ring_mmap(&ns8390_softc[unit].ds_if, off, prot));
+}
+
+/*
+ * The card's transmit buffer is plain memory, so a write
+ * can be gathered from any number of pages.
+ */
+#define	NS8390_SG_MAX	32
+
+/*ARGSUSED*/
+int
+ns8390devinfo(dev, flavor, info)
+	dev_t		dev;
+	int		flavor;
+	char		*info;
+{
+	switch (flavor) {
+	case D_INFO_SG_MAX:
+		*((int *) info) = NS8390_SG_MAX;
+		return (D_SUCCESS);
+	default:
+		return (D_INVALID_OPERATION);
+	}
+}
+
 ns8390setstat(dev, flavor, status, count)
 	dev_t		dev;
 	int		flavor;
@@ -1825,15 +1865,39 @@ struct	mbuf	*m;
 	sram_write_pkt = is->sram + is->tpsr * 0x100; 
 
 #ifdef	MACH_KERNEL
-	count = m->io_count;
-	if (board_id & IFWD_SLOT_16BIT) {
-		s = splhi();
-		en_16bit_access(hdwbase, board_id);
-		bcopy16 (m->io_data, sram_write_pkt,  count);
-		dis_16bit_access (hdwbase, board_id);
-		splx(s);
+	if (m->io_op & IO_GATHER) {
+		register struct io_sg_entry *sg = m->io_sgp;
+
+		if (board_id & IFWD_SLOT_16BIT) {
+			s = splhi();
+			en_16bit_access(hdwbase, board_id);
+		}
+		for (i = 0; i < m->io_sgcount; i++, sg++) {
+			if (board_id & IFWD_SLOT_16BIT)
+				bcopy16 ((char *) phystokv(sg->phys_addr),
+					 sram_write_pkt + count,
+					 sg->length);
+			else
+				bcopy ((char *) phystokv(sg->phys_addr),
+				       sram_write_pkt + count,
+				       sg->length);
+			count += sg->length;
+		}
+		if (board_id & IFWD_SLOT_16BIT) {
+			dis_16bit_access (hdwbase, board_id);
+			splx(s);
+		}
 	} else {
-		bcopy (m->io_data, sram_write_pkt,  count);
+		count = m->io_count;
+		if (board_id & IFWD_SLOT_16BIT) {
+			s = splhi();
+			en_16bit_access(hdwbase, board_id);
+			bcopy16 (m->io_data, sram_write_pkt,  count);
+			dis_16bit_access (hdwbase, board_id);
+			splx(s);
+		} else {
+			bcopy (m->io_data, sram_write_pkt,  count);
+		}
 	}
 #else	MACH_KERNEL
 	for(tm_p = m; tm_p != (struct mbuf *)0; tm_p = tm_p->m_next)  {
@@ -32,6 +32,7 @@
  *	Basic initialization for I386 - ISA bus machines.
  */
 
+#include <cpus.h>
 #include <platforms.h>
 #include <mach_kdb.h>
 
@@ -39,6 +40,7 @@
 #include <mach/vm_prot.h>
 #include <mach/machine.h>
 #include <mach/machine/multiboot.h>
+#include <mach/machine/eflags.h>
 
 #include "vm_param.h"
 #include <kern/time_out.h>
@@ -65,6 +67,9 @@ vm_offset_t phys_last_addr;
 /* Virtual address of physical memory, for the kvtophys/phystokv macros.  */
 vm_offset_t phys_mem_va;
 
+/* CPUID feature flags of the boot processor; see proc_reg.h.  */
+unsigned int cpu_features;
+
 struct multiboot_info *boot_info;
 
 /* Command line supplied to kernel.  */
@@ -217,6 +222,28 @@ mem_size_init()
 	phys_last_addr = trunc_page(phys_last_addr);
 }
 
+/*
+ * Find out what optional features the processor has.
+ * Processors that can't toggle the ID flag don't have CPUID.
+ */
+static unsigned int
+cpu_features_probe()
+{
+	unsigned int eflags, eax, ebx, ecx, edx;
+
+	eflags = get_eflags();
+	set_eflags(eflags ^ EFL_ID);
+	if (((get_eflags() ^ eflags) & EFL_ID) == 0)
+		return 0;
+	set_eflags(eflags);
+
+	cpuid(0, eax, ebx, ecx, edx);
+	if (eax < 1)
+		return 0;
+	cpuid(1, eax, ebx, ecx, edx);
+	return edx;
+}
+
 /*
  * Basic PC VM initialization.
  * Turns on paging and changes the kernel segments to use high linear addresses.
@@ -231,6 +258,8 @@ i386at_init()
 	 */
 	picinit();
 
+	cpu_features = cpu_features_probe();
+
 	/*
 	 * Find memory size parameters.
 	 */
@@ -259,6 +288,18 @@ i386at_init()
 	set_cr0(get_cr0() | CR0_PG | CR0_WP);
 	flush_instr_queue();
 
+#if	NCPUS == 1
+	/*
+	 * Let the pmap map fully populated, contiguous user
+	 * page tables with single 4MB pages.  Only the boot
+	 * processor is set up here, so this is uniprocessor only.
+	 */
+	if (cpu_features & CPUID_FEAT_PSE) {
+		set_cr4(get_cr4() | CR4_PSE);
+		pmap_superpages_enabled = TRUE;
+	}
+#endif	NCPUS == 1
+
 	/*
 	 * Initialize and activate the real i386 protected-mode structures.
 	 */
@@ -588,6 +629,7 @@ alloc_dma_mem(size, align)
 	 * every usable page in bit array.
 	 */
 	simple_lock(&vm_page_queue_free_lock);
+	vm_page_zeroed_drain();
 	for (p = vm_page_queue_free; p; p = (vm_page_t)p->pageq.next) {
 		if (p->phys_addr < DMA_MAX) {
 			i = p->phys_addr / PAGE_SIZE;
@@ -57,6 +57,7 @@
 #include <device/errno.h>
 #include <device/device_types.h>
 #include <device/disk_status.h>
+#include <device/io_sched.h>
 #include <chips/busses.h>
 #include <i386/machspl.h>
 #include <i386/pio.h>
@@ -94,6 +95,9 @@ static char *drive_name[4]={"wd0: ","wd1: ","xxx ","yyy "};
 #define hdpart(dev)	((dev) & 0x3ff)
 
 #define MAX_RETRIES	12	/* maximum number of retries */
+#define MAX_SECTORS	256	/* most sectors one command moves */
+#define MAX_XFER	(1024 * 1024)	/* largest request; longer ones
+					   take several commands */
 #define OP_TIMEOUT	7	/* time to wait (secs) for an operation */
 
 /*
@@ -173,6 +177,7 @@ struct hdsoftc {
 
 struct	buf hdtab[NHDC];	/* controller queues */
 struct	buf hdutab[NHD];	/* drive queues */
+struct	io_sched hdsched[NHD];	/* requests waiting for each drive */
 struct	disklabel hdlabel[NHD];	/* disklabels -- incorrect info! */
 struct  diskpart array[NHD*MAX_IDE_PARTS]; /* partition info */
 
@@ -270,6 +275,8 @@ hdattach(ui)
 	bg->bg_nsect = *(unsigned char *)(tbl + 14);
 	fudge_bsd_label(lp, DTYPE_ESDI, bg->bg_ncyl*bg->bg_ntrk*bg->bg_nsect,
 			bg->bg_ntrk, bg->bg_nsect, SECSIZE, 3);  
+	io_sched_init(&hdsched[ui->unit], SECSIZE);
+	io_sched_chain(&hdsched[ui->unit], MAX_SECTORS * SECSIZE);
 
 	/* FORCE sector size to 512... */
 
@@ -467,7 +474,7 @@ hdgetstat(dev, flavor, data, count)
 		break;
 	}
 	default:
-		return (D_INVALID_OPERATION);
+		return (io_sched_getstat(&hdsched[unit], flavor, data, count));
 	}
 	return (0);
 }
@@ -552,7 +559,7 @@ hdsetstat(dev, flavor, data, count)
 		break;
 
 	default:
-		return (D_INVALID_OPERATION);
+		return (io_sched_setstat(&hdsched[unit], flavor, data, count));
 	}
 	return (error);
 }
@@ -569,6 +576,10 @@ hddevinfo(dev, flavor, info)
 		*((int *)info) = SECSIZE;  /* #defined to 512 */
 		break;
 
+	case D_INFO_MAX_XFER:
+		*((int *)info) = MAX_XFER;
+		break;
+
 	default:
 		return (D_INVALID_OPERATION);
 	}
@@ -790,6 +801,7 @@ hdstrategy(bp)
 
 	if (bp->b_flags & B_IDENTIFY) {
 		bp->b_cylin = 0;
+		bp->b_physblock = 0;
 		goto q;
 	}
 	bn = bp->b_blkno;
@@ -823,10 +835,11 @@ hdstrategy(bp)
 
  q1:
 	bp->b_cylin = (sc->sc_flags & HDF_LBA) ? bn : bn / lp->d_secpercyl;
+	bp->b_physblock = bn;
  q:
 	dp = &hdutab[unit];
 	s = splbio();
-	disksort(dp, bp);
+	io_sched_add(&hdsched[unit], bp);
 	if (!dp->b_active) {
 		hdustart(ui);
 		if (!hdtab[ui->mi->unit].b_active)
@@ -841,7 +854,8 @@ hdstrategy(bp)
 
 /*
  * Unit start routine.
- * Move request from drive to controller queue.
+ * Take the next request from the scheduler and
+ * move the drive to the controller queue.
  */
 int
 hdustart(ui)
@@ -851,6 +865,8 @@ hdustart(ui)
 	struct buf *dp;
 
 	bp = &hdutab[ui->unit];
+	if (bp->b_actf == 0)
+		bp->b_actf = io_sched_next(&hdsched[ui->unit]);
 	if (bp->b_actf == 0)
 		return(0);
 	dp = &hdtab[ui->mi->unit];
@@ -871,7 +887,7 @@ hdstart(um)
 	struct bus_ctlr *um;
 {
 	long bn;
-	struct buf *bp;
+	struct buf *bp, *nbp;
 	struct buf *dp;
 	struct hdsoftc *sc;
 	struct hdcsoftc *hdc;
@@ -921,10 +937,13 @@ hdstart(um)
 	}
 
 	/*
-	 * Set up for multi-sector transfer.
+	 * Set up for multi-sector transfer.  Requests the
+	 * scheduler merged behind this one are part of it.
 	 */
 	hdc->sc_addr = bp->b_un.b_addr;
-	hdc->sc_resid = bp->b_bcount;
+	hdc->sc_resid = 0;
+	for (nbp = bp; nbp != 0; nbp = nbp->io_merge)
+		hdc->sc_resid += nbp->b_bcount;
 	hdc->sc_wticks = 0;
 	hdc->sc_recalerr = 0;
 	hdc->sc_ioerr = 0;
@@ -990,6 +1009,69 @@ hdintr(ctlr)
 	hdstate(um);
 }
 
+/*
+ * Move n bytes between the data port and the current request,
+ * starting at sc_addr and running on into the requests merged
+ * behind it.
+ */
+static void
+hdpio(um, bp, n)
+	struct bus_ctlr *um;
+	struct buf *bp;
+	int n;
+{
+	struct hdcsoftc *hdc = &hdcsoftc[um->unit];
+	caddr_t addr = hdc->sc_addr;
+	int m;
+
+	for (;;) {
+		m = bp->b_un.b_addr + bp->b_bcount - addr;
+		if (m > n)
+			m = n;
+		if (bp->b_flags & B_READ)
+			linw(HD_DATA(um->address), addr, m / 2);
+		else
+			loutw(HD_DATA(um->address), addr, m / 2);
+		n -= m;
+		if (n == 0 || bp->io_merge == 0)
+			return;
+		bp = bp->io_merge;
+		addr = bp->b_un.b_addr;
+	}
+}
+
+/*
+ * Step sc_addr past n bytes that have reached the disk or
+ * memory, finishing each merged request as it is used up.
+ * Returns the request that is current afterwards.
+ */
+static struct buf *
+hdadvance(ui, bp, n)
+	struct bus_device *ui;
+	struct buf *bp;
+	int n;
+{
+	struct hdcsoftc *hdc = &hdcsoftc[ui->mi->unit];
+	struct buf *next;
+	int left;
+
+	for (;;) {
+		left = bp->b_un.b_addr + bp->b_bcount - hdc->sc_addr;
+		if (n < left || bp->io_merge == 0) {
+			hdc->sc_addr += n;
+			return (bp);
+		}
+		n -= left;
+		next = bp->io_merge;
+		bp->io_merge = 0;
+		bp->b_resid = 0;
+		hdutab[ui->unit].b_actf = next;
+		biodone(bp);
+		bp = next;
+		hdc->sc_addr = bp->b_un.b_addr;
+	}
+}
+
 /*
  * Transfer finite state machine driver.
  */
@@ -1121,11 +1203,15 @@ hdstate(um)
 				bzero(buf + hdc->sc_resid,
 				      lp->d_secsize - hdc->sc_resid);
 			} else
-				buf = hdc->sc_addr;
+				buf = 0;
 			for (i = 0; i < 1000000; i++)
 				if (inb(HD_STATUS(um->address)) & ST_DREQ) {
-					loutw(HD_DATA(um->address), buf,
-					      hdc->sc_cnt * lp->d_secsize / 2);
+					if (buf)
+						loutw(HD_DATA(um->address), buf,
+						      lp->d_secsize / 2);
+					else
+						hdpio(um, bp, hdc->sc_cnt *
+							      lp->d_secsize);
 					return(0);
 				}
 			goto ctlr_err;
@@ -1158,9 +1244,9 @@ hdstate(um)
 				bcopy(hdc->sc_buf, hdc->sc_addr,
 				      hdc->sc_resid);
 			} else
-				linw(HD_DATA(um->address), hdc->sc_addr,
-				     hdc->sc_cnt * lp->d_secsize / 2);
+				hdpio(um, bp, hdc->sc_cnt * lp->d_secsize);
 		}
+		bp = hdadvance(ui, bp, hdc->sc_cnt * lp->d_secsize);
 		hdc->sc_resid -= hdc->sc_cnt * lp->d_secsize;
 		if (hdc->sc_resid <= 0) {
 			bp->b_resid = 0;
@@ -1180,7 +1266,6 @@ hdstate(um)
 			}
 		}
 		hdc->sc_ioerr = 0;
-		hdc->sc_addr += hdc->sc_cnt * lp->d_secsize;
 		hdc->sc_amt -= hdc->sc_cnt;
 		if (hdc->sc_amt == 0) {
 			hdc->sc_state = TRANSFER;
@@ -1191,9 +1276,8 @@ hdstate(um)
 
 			for (i = 0; i < 1000000; i++)
 				if (inb(HD_STATUS(um->address)) & ST_DREQ) {
-					loutw(HD_DATA(um->address),
-					      hdc->sc_addr,
-					      hdc->sc_cnt * lp->d_secsize / 2);
+					hdpio(um, bp, hdc->sc_cnt *
+						      lp->d_secsize);
 					return(0);
 				}
 			goto ctlr_err;
@@ -1271,9 +1355,22 @@ hddone(ui, bp)
 	struct hdsoftc *sc = &hdsoftc[ui->unit];
 	struct hdcsoftc *hdc = &hdcsoftc[um->unit];
 	struct buf *dp = &hdtab[um->unit];
+	struct buf *next;
 
 	sc->sc_flags &= ~HDF_UNALIGNED;
 
+	/*
+	 * Requests merged behind a failed one fail with it.
+	 */
+	while ((next = bp->io_merge) != 0) {
+		bp->io_merge = 0;
+		hdutab[ui->unit].b_actf = next;
+		biodone(bp);
+		next->b_flags |= B_ERROR;
+		next->b_error = bp->b_error;
+		bp = next;
+	}
+
 	/*
 	 * Remove this request from queue.
 	 */
@@ -439,6 +439,47 @@ int		ptes_per_vm_page;	/* number of hardware ptes needed
 
 unsigned int	inuse_ptepages_count = 0;	/* debugging */
 
+/*
+ *	Superpages.  Set by machine-dependent startup code once
+ *	the processor has been found to support 4MB pages and
+ *	CR4.PSE has been turned on.
+ */
+boolean_t	pmap_superpages_enabled = FALSE;
+
+unsigned int	pmap_superpage_promotions = 0;	/* debugging */
+unsigned int	pmap_superpage_demotions = 0;	/* debugging */
+
+/*
+ *	Lazy write protection.  When pmap_protect removes write
+ *	access from a whole page table's worth of a user map (as
+ *	copy-on-write setup in vm_map_fork does), it only clears
+ *	the write bit in the page directory entry; the processor
+ *	honors the more restrictive of the two.  The ptes are
+ *	write-protected later, by the first pmap_enter in that
+ *	page table (pmap_pde_unprotect).  A user page table pde
+ *	is otherwise always writable, so a valid, non-superpage
+ *	pde without INTEL_PTE_WRITE marks deferred work.
+ */
+boolean_t	pmap_lazy_protect = TRUE;
+
+unsigned int	pmap_lazy_protects = 0;		/* debugging */
+unsigned int	pmap_lazy_unprotects = 0;	/* debugging */
+
+#define	pde_lazy_protected(pde)	\
+	(((pde) & (INTEL_PTE_VALID|INTEL_PTE_WRITE|INTEL_PTE_PS)) \
+		== INTEL_PTE_VALID)
+
+/*
+ *	Bits that must agree (after adjusting the frame number)
+ *	in every pte of a page table before it can be replaced
+ *	by a superpage pde.  The reference and modify bits are
+ *	left behind in the saved page table.
+ */
+#define	PTE_SUPERPAGE_BITS	(INTEL_PTE_PFN | INTEL_PTE_VALID | \
+				 INTEL_PTE_WRITE | INTEL_PTE_USER | \
+				 INTEL_PTE_WTHRU | INTEL_PTE_NCACHE | \
+				 INTEL_PTE_WIRED)
+
 extern char end;
 
 /*
@@ -485,10 +526,189 @@ pmap_pte(pmap_t pmap, vm_offset_t addr)
 	pte = *pmap_pde(pmap, addr);
 	if ((pte & INTEL_PTE_VALID) == 0)
 		return(PT_ENTRY_NULL);
+	if (pte & INTEL_PTE_PS) {
+		/*
+		 *	The page table set aside under a superpage
+		 *	still holds the right frame numbers, but not
+		 *	the current reference and modify bits.
+		 *	Callers that change ptes use pmap_pte_demote.
+		 */
+		ptp = (pt_entry_t *) phystokv(pmap->superpage_ptp[
+					pmap_pde(pmap, addr) - pmap->dirbase]);
+		return(&ptp[ptenum(addr)]);
+	}
 	ptp = (pt_entry_t *)ptetokv(pte);
 	return(&ptp[ptenum(addr)]);
 }
 
+/*
+ *	Break the superpage mapped by the given pde back into
+ *	its page table.  The reference and modify bits that the
+ *	hardware kept in the pde are handed down to every pte.
+ *
+ *	The pmap must be locked.
+ */
+static void
+pmap_demote(pmap, pdp, va)
+	pmap_t			pmap;
+	register pt_entry_t	*pdp;
+	vm_offset_t		va;
+{
+	register pt_entry_t	*pte, *epte;
+	register pt_entry_t	bits;
+	vm_offset_t		ptp;
+
+	va &= ~(PDE_MAPPED_SIZE-1);
+	PMAP_UPDATE_TLBS(pmap, va, va + PDE_MAPPED_SIZE);
+
+	ptp = pmap->superpage_ptp[pdp - pmap->dirbase];
+	pmap->superpage_ptp[pdp - pmap->dirbase] = 0;
+
+	bits = *pdp & (INTEL_PTE_REF|INTEL_PTE_MOD);
+	if (bits != 0) {
+	    pte = (pt_entry_t *) phystokv(ptp);
+	    for (epte = pte + NPTES; pte < epte; pte++)
+		*pte |= bits;
+	}
+
+	*pdp = pa_to_pte(ptp) | INTEL_PTE_VALID
+			      | INTEL_PTE_USER
+			      | INTEL_PTE_WRITE;
+	pmap_superpage_demotions++;
+}
+
+/*
+ *	Clear reference or modify bits kept in a superpage pde
+ *	without breaking up the superpage.  The bits are first
+ *	handed down to the saved ptes, so that the other pages
+ *	keep them; the caller then clears the pte it wants.
+ *	The TLBs must be flushed, or the processor would not set
+ *	the bits in the pde again.
+ *
+ *	The pmap must be locked.
+ */
+static void
+pmap_superpage_clear(pmap, pdp, va, bits)
+	pmap_t			pmap;
+	register pt_entry_t	*pdp;
+	vm_offset_t		va;
+	register pt_entry_t	bits;
+{
+	register pt_entry_t	*pte, *epte;
+
+	bits &= *pdp;
+	if (bits == 0)
+		return;
+
+	pte = (pt_entry_t *)
+		phystokv(pmap->superpage_ptp[pdp - pmap->dirbase]);
+	for (epte = pte + NPTES; pte < epte; pte++)
+		*pte |= bits;
+
+	*pdp &= ~bits;
+	va &= ~(PDE_MAPPED_SIZE-1);
+	PMAP_UPDATE_TLBS(pmap, va, va + PDE_MAPPED_SIZE);
+}
+
+/*
+ *	Finish a lazy write protection: write-protect every pte
+ *	in the page table, then make the pde writable again.
+ *	Raising the pde's permission needs no TLB flush; a stale
+ *	entry can only cause a spurious fault.
+ *
+ *	The pmap must be locked.
+ */
+static void
+pmap_pde_unprotect(pmap, pdp)
+	pmap_t			pmap;
+	register pt_entry_t	*pdp;
+{
+	register pt_entry_t	*pte, *epte;
+
+	pte = (pt_entry_t *) ptetokv(*pdp);
+	for (epte = pte + NPTES; pte < epte; pte++)
+	    if (*pte & INTEL_PTE_VALID)
+		*pte &= ~INTEL_PTE_WRITE;
+
+	*pdp |= INTEL_PTE_WRITE;
+	pmap_lazy_unprotects++;
+}
+
+/*
+ *	Like pmap_pte, but first demotes a superpage covering
+ *	the address, so that the caller may change the pte.
+ *
+ *	The pmap must be locked.
+ */
+static pt_entry_t *
+pmap_pte_demote(pmap, addr)
+	register pmap_t		pmap;
+	vm_offset_t		addr;
+{
+	register pt_entry_t	*pdp;
+
+	if (pmap->dirbase == 0)
+		return(PT_ENTRY_NULL);
+	pdp = pmap_pde(pmap, addr);
+	if (*pdp & INTEL_PTE_PS)
+		pmap_demote(pmap, pdp, addr);
+	return(pmap_pte(pmap, addr));
+}
+
+/*
+ *	Replace the page table covering the given (user) address
+ *	with a single superpage pde, if every pte in it is valid,
+ *	maps the next frame of one aligned 4MB physical run, and
+ *	carries the same protection, wiring and cache bits.
+ *
+ *	The page table page is set aside rather than freed, so
+ *	that demotion never has to allocate memory.
+ *
+ *	The pmap must be locked.
+ */
+static void
+pmap_promote(pmap, va)
+	register pmap_t		pmap;
+	vm_offset_t		va;
+{
+	register pt_entry_t	*pte, *epte;
+	register pt_entry_t	template;
+	pt_entry_t		*pdp;
+
+	pdp = pmap_pde(pmap, va);
+	if ((*pdp & INTEL_PTE_VALID) == 0 || (*pdp & INTEL_PTE_PS) ||
+	    pde_lazy_protected(*pdp))
+	    return;
+
+	pte = (pt_entry_t *) ptetokv(*pdp);
+	epte = pte + NPTES;
+
+	/*
+	 *	Cheap checks on the ends first: most page tables
+	 *	are not full.
+	 */
+	template = *pte & PTE_SUPERPAGE_BITS;
+	if ((template & INTEL_PTE_VALID) == 0 ||
+	    (pte_to_pa(template) & (PDE_MAPPED_SIZE-1)) != 0)
+	    return;
+	if ((epte[-1] & PTE_SUPERPAGE_BITS) !=
+	    template + (NPTES-1) * INTEL_PGBYTES)
+	    return;
+
+	for (; pte < epte; pte++, template += INTEL_PGBYTES)
+	    if ((*pte & PTE_SUPERPAGE_BITS) != template)
+		return;
+
+	va &= ~(PDE_MAPPED_SIZE-1);
+	PMAP_UPDATE_TLBS(pmap, va, va + PDE_MAPPED_SIZE);
+
+	template = *(pt_entry_t *) ptetokv(*pdp);
+	pmap->superpage_ptp[pdp - pmap->dirbase] = pte_to_pa(*pdp);
+	*pdp = (template & (PTE_SUPERPAGE_BITS & ~INTEL_PTE_WIRED))
+		| INTEL_PTE_PS;
+	pmap_superpage_promotions++;
+}
+
 #define DEBUG_PTE_PAGE	0
 
 #if	DEBUG_PTE_PAGE
@@ -619,6 +839,7 @@ void pmap_bootstrap()
 	simple_lock_init(&kernel_pmap->lock);
 
 	kernel_pmap->ref_count = 1;
+	kernel_pmap->superpage_ptp = 0;
 
 	/*
 	 * Determine the kernel virtual address range.
@@ -1017,6 +1238,15 @@ pmap_t pmap_create(size)
 	bcopy(kernel_page_dir, p->dirbase, INTEL_PGBYTES);
 	p->ref_count = 1;
 
+	p->superpage_ptp = 0;
+	if (pmap_superpages_enabled) {
+	    if (kmem_alloc_wired(kernel_map,
+				 (vm_offset_t *)&p->superpage_ptp,
+				 INTEL_PGBYTES) != KERN_SUCCESS)
+		panic("pmap_create");
+	    bzero((char *) p->superpage_ptp, INTEL_PGBYTES);
+	}
+
 	simple_lock_init(&p->lock);
 	p->cpus_using = 0;
 
@@ -1066,7 +1296,10 @@ void pmap_destroy(p)
 	     pdep < &p->dirbase[lin2pdenum(LINEAR_MIN_KERNEL_ADDRESS)];
 	     pdep += ptes_per_vm_page) {
 	    if (*pdep & INTEL_PTE_VALID) {
-		pa = pte_to_pa(*pdep);
+		if (*pdep & INTEL_PTE_PS)
+		    pa = p->superpage_ptp[pdep - p->dirbase];
+		else
+		    pa = pte_to_pa(*pdep);
 		vm_object_lock(pmap_object);
 		m = vm_page_lookup(pmap_object, pa);
 		if (m == VM_PAGE_NULL)
@@ -1079,6 +1312,9 @@ void pmap_destroy(p)
 	    }
 	}
 	kmem_free(kernel_map, p->dirbase, INTEL_PGBYTES);
+	if (p->superpage_ptp != 0)
+	    kmem_free(kernel_map, (vm_offset_t) p->superpage_ptp,
+		      INTEL_PGBYTES);
 	zfree(pmap_zone, (vm_offset_t) p);
 }
 
@@ -1256,6 +1492,8 @@ void pmap_remove(map, s, e)
 	    l = (s + PDE_MAPPED_SIZE) & ~(PDE_MAPPED_SIZE-1);
 	    if (l > e)
 		l = e;
+	    if (*pde & INTEL_PTE_PS)
+		pmap_demote(map, pde, s);
 	    if (*pde & INTEL_PTE_VALID) {
 		spte = (pt_entry_t *)ptetokv(*pde);
 		spte = &spte[ptenum(s)];
@@ -1340,7 +1578,7 @@ void pmap_page_protect(phys, prot)
 		    register vm_offset_t va;
 
 		    va = pv_e->va;
-		    pte = pmap_pte(pmap, va);
+		    pte = pmap_pte_demote(pmap, va);
 
 		    /*
 		     * Consistency checks.
@@ -1488,6 +1726,37 @@ void pmap_protect(map, s, e, prot)
 	    l = (s + PDE_MAPPED_SIZE) & ~(PDE_MAPPED_SIZE-1);
 	    if (l > e)
 		l = e;
+	    if ((*pde & INTEL_PTE_PS) && l - s == PDE_MAPPED_SIZE) {
+		/*
+		 *	Write-protecting the whole superpage:
+		 *	keep it, and the page table set aside
+		 *	under it, intact.
+		 */
+		*pde &= ~INTEL_PTE_WRITE;
+		spte = (pt_entry_t *)
+			phystokv(map->superpage_ptp[pde - map->dirbase]);
+		epte = &spte[NPTES];
+		while (spte < epte)
+		    *spte++ &= ~INTEL_PTE_WRITE;
+		s = l;
+		pde++;
+		continue;
+	    }
+	    if (*pde & INTEL_PTE_PS)
+		pmap_demote(map, pde, s);
+	    if ((*pde & INTEL_PTE_VALID) && l - s == PDE_MAPPED_SIZE &&
+		pmap_lazy_protect) {
+		/*
+		 *	The whole page table: defer the ptes.
+		 */
+		if (*pde & INTEL_PTE_WRITE) {
+		    *pde &= ~INTEL_PTE_WRITE;
+		    pmap_lazy_protects++;
+		}
+		s = l;
+		pde++;
+		continue;
+	    }
 	    if (*pde & INTEL_PTE_VALID) {
 		spte = (pt_entry_t *)ptetokv(*pde);
 		spte = &spte[ptenum(s)];
@@ -1581,7 +1850,7 @@ Retry:
 	 *	pages to map one VM page.
 	 */
 
-	while ((pte = pmap_pte(pmap, v)) == PT_ENTRY_NULL) {
+	while ((pte = pmap_pte_demote(pmap, v)) == PT_ENTRY_NULL) {
 	    /*
 	     * Need to allocate a new page-table page.
 	     */
@@ -1648,6 +1917,13 @@ Retry:
 	    continue;
 	}
 
+	/*
+	 *	The new pte's own bits must be honored, so finish
+	 *	any lazy write protection of its page table.
+	 */
+	if (pde_lazy_protected(*pmap_pde(pmap, v)))
+	    pmap_pde_unprotect(pmap, pmap_pde(pmap, v));
+
 	/*
 	 *	Special case if the physical page is already mapped
 	 *	at this address.
@@ -1787,6 +2063,14 @@ Retry:
 	    } while (--i > 0);
 	}
 
+	/*
+	 *	If this filled in the last page of an aligned,
+	 *	physically contiguous run, try for a superpage.
+	 */
+	if (pmap->superpage_ptp != 0 &&
+	    ((v ^ pa) & (PDE_MAPPED_SIZE-1)) == 0)
+	    pmap_promote(pmap, v);
+
 	if (pv_e != PV_ENTRY_NULL) {
 	    PV_FREE(pv_e);
 	}
@@ -1816,7 +2100,7 @@ void pmap_change_wiring(map, v, wired)
 	 */
 	PMAP_READ_LOCK(map, spl);
 
-	if ((pte = pmap_pte(map, v)) == PT_ENTRY_NULL)
+	if ((pte = pmap_pte_demote(map, v)) == PT_ENTRY_NULL)
 		panic("pmap_change_wiring: pte missing");
 
 	if (wired && !(*pte & INTEL_PTE_WIRED)) {
@@ -1927,6 +2211,8 @@ void pmap_collect(p)
 	     pdp < &p->dirbase[lin2pdenum(LINEAR_MIN_KERNEL_ADDRESS)];
 	     pdp += ptes_per_vm_page)
 	{
+	    if (*pdp & INTEL_PTE_PS)
+		pmap_demote(p, pdp, pdenum2lin(pdp - p->dirbase));
 	    if (*pdp & INTEL_PTE_VALID) {
 
 		pa = pte_to_pa(*pdp);
@@ -2166,8 +2452,17 @@ phys_attribute_clear(phys, bits)
 
 		{
 		    register vm_offset_t va;
+		    register pt_entry_t *pdp;
 
 		    va = pv_e->va;
+
+		    /*
+		     * Pageout clears these bits all the time; keep
+		     * a superpage unless the page is actually taken.
+		     */
+		    pdp = pmap_pde(pmap, va);
+		    if (*pdp & INTEL_PTE_PS)
+			pmap_superpage_clear(pmap, pdp, va, bits);
 		    pte = pmap_pte(pmap, va);
 
 #if	0
@@ -2270,6 +2565,17 @@ phys_attribute_test(phys, bits)
 		    assert(*pte & INTEL_PTE_VALID);
 		    /* assert(pte_to_phys(*pte) == phys); */
 #endif
+
+		    /*
+		     * Under a superpage, the hardware keeps the
+		     * bits in the pde.
+		     */
+		    if ((*pmap_pde(pmap, va) & INTEL_PTE_PS) &&
+			(*pmap_pde(pmap, va) & bits)) {
+			simple_unlock(&pmap->lock);
+			PMAP_WRITE_UNLOCK(spl);
+			return (TRUE);
+		    }
 		}
 
 		/*
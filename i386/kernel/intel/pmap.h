@@ -119,6 +119,7 @@ typedef unsigned int	pt_entry_t;
 #define INTEL_PTE_NCACHE 	0x00000010
 #define INTEL_PTE_REF		0x00000020
 #define INTEL_PTE_MOD		0x00000040
+#define INTEL_PTE_PS		0x00000080	/* pde maps a 4MB page */
 #define INTEL_PTE_WIRED		0x00000200
 #define INTEL_PTE_PFN		0xfffff000
 
@@ -158,6 +159,9 @@ struct pmap {
 					/* lock on map */
 	struct pmap_statistics	stats;	/* map statistics */
 	cpu_set		cpus_using;	/* bitmap of cpus using pmap */
+	vm_offset_t	*superpage_ptp;	/* page-table pages set aside
+					   under superpage pdes, by
+					   pde index (or 0) */
 };
 
 typedef struct pmap	*pmap_t;
@@ -207,6 +211,15 @@ extern	pmap_t	kernel_pmap;
 
 pt_entry_t *pmap_pte(pmap_t pmap, vm_offset_t addr);
 
+/*
+ *	Superpages: a fully populated, physically contiguous and
+ *	uniformly protected page table is replaced by a single 4MB
+ *	page directory entry, on processors with PSE.
+ */
+extern boolean_t	pmap_superpages_enabled;
+#define	pmap_superpage_size()	\
+	(pmap_superpages_enabled ? pdenum2lin(1) : (vm_size_t) 0)
+
 /*
  *	Macros for speed.
  */
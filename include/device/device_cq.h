@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	File:	device/device_cq.h
+ *
+ *	User-level layout of a device I/O completion queue.
+ *
+ *	io_cq_create maps a ring of cqh_nentries completion entries,
+ *	preceded by an io_cq_header, into a task, and returns a send
+ *	right for the queue and the id of its eventcount.  Reads and
+ *	writes are sent with the queue as their reply port, using the
+ *	simpleroutines in <device/device_cq.defs>.  When one finishes,
+ *	the kernel fills the entry at cqh_head (modulo cqh_nentries),
+ *	advances cqh_head, and signals the eventcount; no reply
+ *	message is sent.
+ *
+ *	The task consumes entries from cqh_tail up to cqh_head, then
+ *	stores the new cqh_tail.  To block until more arrive it calls
+ *	evc_wait on the eventcount; a signal sent before the task waits
+ *	is counted, not lost.  Only one thread may wait at a time.
+ *
+ *	The data of a read is mapped into the task at cqe_data, like
+ *	out-of-line data in a message; the task must vm_deallocate it.
+ *	If the ring is full when a request finishes, its completion is
+ *	counted in cqh_dropped and its data discarded, so a task should
+ *	not have more requests outstanding than the ring has entries.
+ *
+ *	Entries are told apart by operation and record number.  A
+ *	request is only answered through the ring if it reaches the
+ *	device server; a malformed request message, or one sent to a
+ *	port that is not a device, gets no completion.
+ */
+
+#ifndef	_DEVICE_DEVICE_CQ_H_
+#define	_DEVICE_DEVICE_CQ_H_
+
+#include <mach/machine/vm_types.h>
+#include <device/device_types.h>
+
+#define	IO_CQ_MAGIC		0x696f6371	/* "iocq" */
+
+#define	IO_CQ_READ		1
+#define	IO_CQ_WRITE		2
+
+struct io_cq_header {
+	natural_t		cqh_magic;
+	natural_t		cqh_nentries;
+	volatile natural_t	cqh_head;	/* written by the kernel */
+	volatile natural_t	cqh_tail;	/* written by the task */
+	volatile natural_t	cqh_dropped;	/* completions lost, ring full */
+	natural_t		cqh_pad[3];
+};
+
+struct io_cq_entry {
+	natural_t		cqe_op;		/* IO_CQ_READ or IO_CQ_WRITE */
+	recnum_t		cqe_recnum;	/* first record of the request */
+	io_return_t		cqe_result;
+	natural_t		cqe_count;	/* bytes read or written */
+	vm_address_t		cqe_data;	/* read: where the data is */
+	natural_t		cqe_pad[3];
+};
+
+#define	io_cq_entry(h, i)	\
+	((struct io_cq_entry *) ((struct io_cq_header *) (h) + 1) + (i))
+
+#endif	/* _DEVICE_DEVICE_CQ_H_ */
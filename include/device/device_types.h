@@ -111,6 +111,28 @@ typedef int		dev_status_data_t[DEV_STATUS_MAX];
 #	define	DEV_GET_SIZE_RECORD_SIZE	1	/* 1 if sequential */
 #define	DEV_GET_SIZE_COUNT		2
 
+/*
+ * Optional get/set status operations, handled by the device
+ * service itself rather than the driver.
+ */
+
+/* block cache: set the mode with status[0]; get returns a dev_cache_status */
+#define	DEV_CACHE			(('c'<<16) + 1)
+#	define	DEV_CACHE_OFF			0
+#	define	DEV_CACHE_WRITETHROUGH		1
+#	define	DEV_CACHE_WRITEBACK		2
+/* block cache: write back the device's dirty data (set only) */
+#define	DEV_CACHE_SYNC			(('c'<<16) + 2)
+
+struct dev_cache_status {
+	int	dcs_mode;		/* DEV_CACHE_* */
+	int	dcs_blocks;		/* cache pages holding the device's data */
+	int	dcs_dirty;		/* ... with data not yet written */
+	int	dcs_hits;		/* reads answered by the cache, all devices */
+	int	dcs_misses;		/* reads sent to a driver, all devices */
+};
+#define	DEV_CACHE_STATUS_COUNT	(sizeof(struct dev_cache_status)/sizeof(int))
+
 /*
  * Device error codes
  */
@@ -301,6 +301,28 @@ struct format_op {
 
 #define DIOCSBAD	_IOW('d', 110, struct dkbad)	/* set kernel dkbad */
 
+/*
+ * Block I/O scheduler, for drivers that have one.
+ */
+#define	IO_SCHED_ELEVATOR	0	/* one-way sweep, like disksort */
+#define	IO_SCHED_DEADLINE	1	/* sweep, but bound queueing time */
+#define	IO_SCHED_FAIR		2	/* round-robin between tasks */
+#define	IO_SCHED_NPOLICIES	3
+
+struct io_sched_stats {
+	int		policy;		/* IO_SCHED_* */
+	unsigned int	queued;		/* requests waiting now */
+	unsigned int	added;		/* requests queued, ever */
+	unsigned int	merged;		/* of which merged with another */
+	unsigned int	unmerged;	/* dispatched with none merged */
+	unsigned int	dispatched;
+	unsigned int	expired;	/* dispatched early by deadline */
+};
+
+#define DIOCSSCHED	_IOW('d', 111, int)	/* set scheduling policy */
+#define DIOCGSCHED	_IOR('d', 112, struct io_sched_stats)
+						/* get policy and counters */
+
 #endif LOCORE
 
 #endif	/* _DISK_STATUS_H_ */
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	File:	device/net_ring.h
+ *
+ *	Layout of the packet ring a network interface maps into
+ *	user space.
+ *
+ *	device_get_status(NET_RING_STATUS) sets up the ring, if the
+ *	interface does not have one yet, and returns its size;
+ *	device_map then maps it.  The ring starts with a
+ *	net_ring_header, followed by nr_rx_slots receive slots and
+ *	nr_tx_slots transmit slots of nr_slot_size bytes each.
+ *
+ *	Indices are free-running counters; slot i is at i modulo
+ *	the number of slots.  The kernel copies every packet the
+ *	interface receives into receive slot nr_rx_head, if it is
+ *	free, and advances nr_rx_head; the reader advances
+ *	nr_rx_tail when done with a slot.  The writer fills transmit
+ *	slots up to nr_tx_head and, if nr_tx_active is clear, does a
+ *	zero-length device_write to start the interface; the kernel
+ *	keeps going as long as nr_tx_head moves, and advances
+ *	nr_tx_tail as slots may be reused.  nr_rx_evc is signalled
+ *	when the receive ring stops being empty and nr_tx_evc when
+ *	transmit slots are freed, for evc_wait.
+ *
+ *	Packets received still go through the filters as well.
+ */
+
+#ifndef	_DEVICE_NET_RING_H_
+#define	_DEVICE_NET_RING_H_
+
+#define	NET_RING_STATUS		(('n'<<16) + 4)
+#define	NET_RING_STATUS_COUNT	1	/* size of the ring in bytes */
+
+#define	NET_RING_MAGIC		0x6e72696e	/* "nrin" */
+
+struct net_ring_header {
+	unsigned int		nr_magic;
+	unsigned int		nr_slot_size;	/* bytes per slot */
+	unsigned int		nr_rx_slots;
+	unsigned int		nr_tx_slots;
+	unsigned int		nr_rx_offset;	/* of slot 0, from the header */
+	unsigned int		nr_tx_offset;
+	unsigned int		nr_rx_evc;	/* eventcount ids */
+	unsigned int		nr_tx_evc;
+
+	volatile unsigned int	nr_rx_head;	/* kernel: next to fill */
+	volatile unsigned int	nr_rx_tail;	/* user: next to read */
+	volatile unsigned int	nr_rx_drops;	/* kernel: ring was full */
+	volatile unsigned int	nr_tx_head;	/* user: next to fill */
+	volatile unsigned int	nr_tx_tail;	/* kernel: next to free */
+	volatile unsigned int	nr_tx_active;	/* kernel: draining */
+};
+
+struct net_ring_slot {
+	unsigned short		ns_header_size;	/* receive only */
+	unsigned short		ns_packet_size;	/* on transmit, the frame */
+	unsigned int		ns_pad;
+	/* on receive, header then packet; on transmit, the frame */
+};
+
+#define	net_ring_slot_data(ns)	((char *) ((ns) + 1))
+
+#ifndef	MACH_KERNEL
+/*
+ *	For the user.  The kernel keeps its own copy of the
+ *	geometry and never trusts these fields of the header.
+ */
+#define	net_ring_rx_slot(h, i)						\
+	((struct net_ring_slot *) ((char *) (h) + (h)->nr_rx_offset +	\
+				   ((i) % (h)->nr_rx_slots) * (h)->nr_slot_size))
+#define	net_ring_tx_slot(h, i)						\
+	((struct net_ring_slot *) ((char *) (h) + (h)->nr_tx_offset +	\
+				   ((i) % (h)->nr_tx_slots) * (h)->nr_slot_size))
+#endif	/* MACH_KERNEL */
+
+#endif	/* _DEVICE_NET_RING_H_ */
@@ -182,6 +182,47 @@ struct net_rcv_msg {
 typedef struct net_rcv_msg 	*net_rcv_msg_t;
 #define	net_rcv_msg_packet_count packet_type.msgt_number
 
+/*
+ * Batched receive.
+ *
+ * A filter whose priority has NET_RCV_BATCH or'd in gets its
+ * packets packed several to a message.  A batch is sent when
+ * the next packet would not fit, or when the kernel has no
+ * more packets queued, so it adds little latency.  Each frame
+ * holds the hardware header and the packet, and starts on a
+ * long-word boundary; net_rcv_batch_next walks them.  The
+ * frames are counted in a long-form type descriptor, since a
+ * batch can hold more bytes than msgt_number can.
+ */
+#define	NET_RCV_BATCH		0x40000000
+
+#define	NET_RCV_BATCH_MSG_ID	2998	/* in device.defs reply range */
+#define	NET_RCV_BATCH_MAX	8000
+
+struct net_rcv_frame {
+	unsigned short	nf_size;	/* of the whole frame */
+	unsigned short	nf_header_size;
+	unsigned short	nf_packet_size;
+	unsigned short	nf_pad;
+	/* header, then packet */
+};
+
+#define	net_rcv_frame_header(nf)	((char *) ((nf) + 1))
+#define	net_rcv_frame_packet(nf)	\
+		(net_rcv_frame_header(nf) + (nf)->nf_header_size)
+
+struct net_rcv_batch_msg {
+	mach_msg_header_t msg_hdr;
+	mach_msg_type_long_t frames_type; /* bytes of frames */
+	char		frames[NET_RCV_BATCH_MAX];
+};
+typedef struct net_rcv_batch_msg *net_rcv_batch_msg_t;
+
+#ifndef	MACH_KERNEL
+extern struct net_rcv_frame *net_rcv_batch_next(net_rcv_batch_msg_t msg,
+						struct net_rcv_frame *frame);
+#endif	/* MACH_KERNEL */
+
 
 
 #endif	_DEVICE_NET_STATUS_H_
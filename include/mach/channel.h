@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	File:	mach/channel.h
+ *
+ *	User-level layout of a shared-memory RPC channel.
+ *
+ *	channel_create maps a zero-filled buffer into the client;
+ *	channel_attach maps the same pages into the server.  The
+ *	buffer starts with a channel_header, followed by chh_nslots
+ *	slots of sizeof(struct channel_slot) + chh_slot_size bytes.
+ *	The client fills in the header; the server checks it against
+ *	the size channel_attach returns and keeps its own copy, since
+ *	the client can rewrite the header at any time.  cs_size is
+ *	likewise written by the other side and must not be trusted
+ *	beyond the slot size.
+ *
+ *	A slot goes FREE -> REQUEST (client, then channel_signal on
+ *	the request eventcount) -> BUSY (server) -> REPLY (server,
+ *	then channel_signal on the reply eventcount) -> FREE (client).
+ *	Eventcounts count signals, so a signal sent before the other
+ *	side waits is not lost; but only one thread may wait on an
+ *	eventcount at a time, so the client and server each block
+ *	from a single thread.
+ *
+ *	Only bytes move through a channel.  Port rights and
+ *	out-of-line memory must still be sent with mach_msg.
+ */
+
+#ifndef	_MACH_CHANNEL_H_
+#define _MACH_CHANNEL_H_
+
+#include <mach/kern_return.h>
+#include <mach/port.h>
+
+#define	CHANNEL_MAGIC		0x63686e6c	/* "chnl" */
+
+#define	CHANNEL_SLOT_FREE	0
+#define	CHANNEL_SLOT_REQUEST	1
+#define	CHANNEL_SLOT_BUSY	2
+#define	CHANNEL_SLOT_REPLY	3
+
+struct channel_header {
+	natural_t		chh_magic;
+	natural_t		chh_nslots;
+	natural_t		chh_slot_size;	/* data bytes per slot */
+	natural_t		chh_pad;
+};
+
+struct channel_slot {
+	volatile natural_t	cs_state;
+	natural_t		cs_id;		/* like msgh_id */
+	natural_t		cs_size;	/* data bytes in use */
+	natural_t		cs_pad;
+	/* chh_slot_size bytes of data follow */
+};
+
+#define	channel_slot_data(slot)	((void *) ((slot) + 1))
+
+#ifndef	MACH_KERNEL
+
+/*
+ *	One end of a channel, as seen by libmach.
+ */
+typedef struct mach_channel {
+	mach_port_t		mc_port;	/* send right for the channel */
+	struct channel_header	*mc_header;
+	vm_size_t		mc_size;
+	natural_t		mc_nslots;	/* private copies of the header */
+	natural_t		mc_slot_size;
+	natural_t		mc_request;	/* eventcount ids */
+	natural_t		mc_reply;
+	natural_t		mc_next;	/* next slot to look at */
+} *mach_channel_t;
+
+extern kern_return_t	evc_wait(natural_t _ev_id);
+extern kern_return_t	channel_signal(natural_t _ev_id);
+
+extern kern_return_t	mach_channel_create(mach_channel_t _mc,
+					    vm_size_t _slot_size,
+					    natural_t _nslots);
+extern kern_return_t	mach_channel_attach(mach_channel_t _mc,
+					    mach_port_t _channel);
+extern kern_return_t	mach_channel_call(mach_channel_t _mc,
+					  natural_t _id,
+					  const void *_request,
+					  vm_size_t _request_size,
+					  void *_reply,
+					  vm_size_t *_reply_size);
+extern kern_return_t	mach_channel_receive(mach_channel_t _mc,
+					     struct channel_slot **_slot);
+extern kern_return_t	mach_channel_reply(mach_channel_t _mc,
+					   struct channel_slot *_slot,
+					   vm_size_t _reply_size);
+
+#endif	/* MACH_KERNEL */
+
+#endif	/* _MACH_CHANNEL_H_ */
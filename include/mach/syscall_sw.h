@@ -46,6 +46,7 @@
 
 kernel_trap(evc_wait,-17,1)
 kernel_trap(evc_wait_clear,-18,1)
+kernel_trap(channel_signal,-19,1)
 
 kernel_trap(mach_msg_trap,-25,7)
 kernel_trap(mach_reply_port,-26,0)
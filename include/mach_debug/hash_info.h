@@ -38,4 +38,14 @@ typedef struct hash_info_bucket {
 
 typedef hash_info_bucket_t *hash_info_bucket_array_t;
 
+/*
+ *	Distribution of chain lengths in a hash table.
+ *	Entry i counts the buckets holding i records;
+ *	the last entry also counts all longer chains.
+ */
+
+#define	HASH_INFO_HISTOGRAM_SIZE	32
+
+typedef natural_t hash_info_histogram_t[HASH_INFO_HISTOGRAM_SIZE];
+
 #endif	_MACH_DEBUG_HASH_INFO_H_
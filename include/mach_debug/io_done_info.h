@@ -0,0 +1,55 @@
+/* 
+ * Mach Operating System
+ * Copyright (c) 1991,1990,1989 Carnegie Mellon University
+ * All Rights Reserved.
+ * 
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ * 
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ * 
+ * Carnegie Mellon requests users of this software to return to
+ * 
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ * 
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+
+#ifndef	_MACH_DEBUG_IO_DONE_INFO_H_
+#define _MACH_DEBUG_IO_DONE_INFO_H_
+
+#include <mach/machine/vm_types.h>
+
+/*
+ *	Remember to update the mig type definitions
+ *	in mach_debug_types.defs when adding/removing fields.
+ */
+
+/*
+ *	Statistics for one io_done completion list.  Entry i of the
+ *	histogram counts completions that took between 2^i and
+ *	2^(i+1) - 1 machine cycles from the driver's iodone to the
+ *	end of the completion routine (see kernel_rpc_info_t).
+ */
+
+#define	IO_DONE_HISTOGRAM_SIZE	32
+
+typedef struct io_done_info {
+	natural_t	idi_count;	/* requests completed */
+	natural_t	idi_queued;	/* now waiting on the list */
+	natural_t	idi_max_queued;	/* most ever waiting */
+	natural_t	idi_histogram[IO_DONE_HISTOGRAM_SIZE];
+} io_done_info_t;
+
+typedef io_done_info_t *io_done_info_array_t;
+
+#endif	_MACH_DEBUG_IO_DONE_INFO_H_
@@ -34,6 +34,8 @@
 #include <mach_debug/vm_info.h>
 #include <mach_debug/zone_info.h>
 #include <mach_debug/hash_info.h>
+#include <mach_debug/rpc_info.h>
+#include <mach_debug/io_done_info.h>
 
 typedef	char	symtab_name_t[32];
 
@@ -0,0 +1,62 @@
+/* 
+ * Mach Operating System
+ * Copyright (c) 1991,1990,1989 Carnegie Mellon University
+ * All Rights Reserved.
+ * 
+ * Permission to use, copy, modify and distribute this software and its
+ * documentation is hereby granted, provided that both the copyright
+ * notice and this permission notice appear in all copies of the
+ * software, derivative works or modified versions, and any portions
+ * thereof, and that both notices appear in supporting documentation.
+ * 
+ * CARNEGIE MELLON ALLOWS FREE USE OF THIS SOFTWARE IN ITS "AS IS"
+ * CONDITION.  CARNEGIE MELLON DISCLAIMS ANY LIABILITY OF ANY KIND FOR
+ * ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ * 
+ * Carnegie Mellon requests users of this software to return to
+ * 
+ *  Software Distribution Coordinator  or  Software.Distribution@CS.CMU.EDU
+ *  School of Computer Science
+ *  Carnegie Mellon University
+ *  Pittsburgh PA 15213-3890
+ * 
+ * any improvements or extensions that they make and grant Carnegie Mellon
+ * the rights to redistribute these changes.
+ */
+
+#ifndef	_MACH_DEBUG_RPC_INFO_H_
+#define _MACH_DEBUG_RPC_INFO_H_
+
+#include <mach/kern_return.h>
+#include <mach/machine/vm_types.h>
+#include <mach/port.h>
+
+/*
+ *	Remember to update the mig type definitions
+ *	in mach_debug_types.defs when adding/removing fields.
+ */
+
+/*
+ *	Statistics for one kernel routine, summed over all processors.
+ *	Entry i of the histogram counts calls that took between 2^i
+ *	and 2^(i+1) - 1 machine cycles; entry 0 also counts calls that
+ *	took no measurable time, which is all of them on machines
+ *	without a cycle counter.
+ */
+
+#define	KERNEL_RPC_HISTOGRAM_SIZE	32
+
+typedef struct kernel_rpc_info {
+	natural_t	kri_id;		/* msgh_id of the request */
+	natural_t	kri_count;	/* number of calls */
+	natural_t	kri_histogram[KERNEL_RPC_HISTOGRAM_SIZE];
+} kernel_rpc_info_t;
+
+typedef kernel_rpc_info_t *kernel_rpc_info_array_t;
+
+#ifndef	MACH_KERNEL
+/* libmach: print the top N kernel routines by number of calls */
+extern kern_return_t	kernel_rpc_dump(mach_port_t _host, int _top);
+#endif	MACH_KERNEL
+
+#endif	_MACH_DEBUG_RPC_INFO_H_
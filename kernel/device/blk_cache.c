@@ -0,0 +1,917 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	File:	device/blk_cache.c
+ *
+ *	Block cache for random-access devices.  See device/blk_cache.h.
+ *
+ *	Blocks are found through a hash table, and kept on an LRU
+ *	list for replacement.  All of it is protected by one simple
+ *	lock, which is never held across a call to a driver or a
+ *	memory allocation.  Only threads use the cache, never
+ *	interrupt routines.
+ */
+
+#include <mach/boolean.h>
+#include <mach/message.h>
+#include <mach/vm_param.h>
+
+#include <kern/lock.h>
+#include <kern/queue.h>
+#include <kern/zalloc.h>
+#include <kern/sched.h>
+#include <kern/sched_prim.h>
+
+#include <ipc/ipc_port.h>
+
+#include <vm/vm_kern.h>
+#include <vm/vm_map.h>
+#include <vm/vm_page.h>
+
+#include <device/device_types.h>
+#include <device/dev_hdr.h>
+#include <device/conf.h>
+#include <device/io_req.h>
+#include <device/ds_routines.h>
+#include <device/blk_cache.h>
+
+struct blk_buf {
+	queue_chain_t	bb_hash;	/* hash bucket, or free list */
+	queue_chain_t	bb_lru;		/* most recently used first */
+	mach_device_t	bb_device;	/* not referenced */
+	recnum_t	bb_block;	/* first record / cache_rpb */
+	unsigned int	bb_valid;	/* records holding data */
+	unsigned int	bb_dirty;	/* records not yet written */
+	boolean_t	bb_busy;	/* being written back */
+	boolean_t	bb_wanted;	/* someone waits for !bb_busy */
+	vm_offset_t	bb_data;	/* PAGE_SIZE bytes, wired */
+};
+typedef struct blk_buf	*blk_buf_t;
+#define	BLK_BUF_NULL	((blk_buf_t) 0)
+
+/*
+ * Tunables.  A blk_cache_max of 0 sizes the cache at boot
+ * from the amount of free memory.
+ */
+int		blk_cache_max = 0;		/* blocks */
+int		blk_cache_min = 16;
+int		blk_cache_dirty_max;		/* blocks, max / 4 */
+
+int		blk_cache_count = 0;		/* blocks allocated */
+int		blk_cache_ndirty = 0;		/* blocks with dirty records */
+int		blk_cache_hits = 0;		/* reads from the cache */
+int		blk_cache_misses = 0;		/* reads sent to a driver */
+
+#define	BLK_CACHE_NHASH	64
+
+#define	blk_cache_hash(device, block)	\
+	((((vm_offset_t) (device) >> 6) + (block)) % BLK_CACHE_NHASH)
+
+#define	bb_bit(i)	((unsigned int) 1 << (i))
+
+#define	bb_bsize(device)	(PAGE_SIZE / (device)->cache_rpb)
+
+decl_simple_lock_data(,	blk_cache_lock)
+queue_head_t	blk_cache_hashtab[BLK_CACHE_NHASH];
+queue_head_t	blk_cache_lru;
+queue_head_t	blk_cache_free;		/* allocated, but unused */
+zone_t		blk_buf_zone;
+
+#define	bb_set_dirty(bb, mask)				\
+	MACRO_BEGIN					\
+	if ((bb)->bb_dirty == 0)			\
+	    blk_cache_ndirty++;				\
+	(bb)->bb_dirty |= (mask);			\
+	MACRO_END
+
+#define	bb_clear_dirty(bb, mask)			\
+	MACRO_BEGIN					\
+	if ((bb)->bb_dirty != 0 &&			\
+	    ((bb)->bb_dirty &= ~(mask)) == 0)		\
+	    blk_cache_ndirty--;				\
+	MACRO_END
+
+void
+blk_cache_init()
+{
+	register int	i;
+
+	simple_lock_init(&blk_cache_lock);
+	for (i = 0; i < BLK_CACHE_NHASH; i++)
+	    queue_init(&blk_cache_hashtab[i]);
+	queue_init(&blk_cache_lru);
+	queue_init(&blk_cache_free);
+
+	if (blk_cache_max == 0)
+	    blk_cache_max = vm_page_free_count / 32;
+	if (blk_cache_max < blk_cache_min)
+	    blk_cache_max = blk_cache_min;
+	blk_cache_dirty_max = blk_cache_max / 4;
+
+	blk_buf_zone = zinit(sizeof(struct blk_buf),
+			     blk_cache_max * sizeof(struct blk_buf),
+			     PAGE_SIZE,
+			     FALSE,
+			     "block cache headers");
+}
+
+/*
+ * Find a cached block.  Lock held.
+ */
+static blk_buf_t
+blk_cache_lookup(device, block)
+	mach_device_t	device;
+	recnum_t	block;
+{
+	register blk_buf_t	bb;
+	register queue_t	bucket;
+
+	bucket = &blk_cache_hashtab[blk_cache_hash(device, block)];
+	queue_iterate(bucket, bb, blk_buf_t, bb_hash) {
+	    if (bb->bb_device == device && bb->bb_block == block)
+		return (bb);
+	}
+	return (BLK_BUF_NULL);
+}
+
+#define	blk_cache_touch(bb)					\
+	MACRO_BEGIN						\
+	queue_remove(&blk_cache_lru, (bb), blk_buf_t, bb_lru);	\
+	queue_enter_first(&blk_cache_lru, (bb), blk_buf_t, bb_lru); \
+	MACRO_END
+
+/*
+ * Take a block out of the hash table and LRU list.  Lock held.
+ */
+static void
+blk_cache_unlink(bb)
+	register blk_buf_t	bb;
+{
+	queue_remove(&blk_cache_hashtab[blk_cache_hash(bb->bb_device,
+							bb->bb_block)],
+		     bb, blk_buf_t, bb_hash);
+	queue_remove(&blk_cache_lru, bb, blk_buf_t, bb_lru);
+}
+
+/*
+ *	Routine:	blk_cache_reserve
+ *	Purpose:
+ *		Allocate blocks onto the free list until it holds
+ *		count of them, as long as the cache is below
+ *		blk_cache_max and the free page count is above
+ *		vm_page_free_target.
+ *
+ *		Completions run in the io_done thread, which is
+ *		vm-privileged and may be serving the default pager,
+ *		so they never allocate; the thread making a request
+ *		sets blocks aside for them here instead.
+ *	Conditions:
+ *		Lock held; dropped and retaken around allocations.
+ */
+static void
+blk_cache_reserve(count)
+	int		count;
+{
+	register blk_buf_t	bb;
+	vm_offset_t		data;
+
+	queue_iterate(&blk_cache_free, bb, blk_buf_t, bb_hash) {
+	    if (--count == 0)
+		return;
+	}
+
+	for (; count > 0; count--) {
+	    if (blk_cache_count >= blk_cache_max ||
+		vm_page_free_count <= vm_page_free_target)
+		return;
+	    blk_cache_count++;
+	    simple_unlock(&blk_cache_lock);
+
+	    bb = (blk_buf_t) zalloc(blk_buf_zone);
+	    if (kmem_alloc_wired(kernel_map, &data, PAGE_SIZE)
+			!= KERN_SUCCESS) {
+		zfree(blk_buf_zone, (vm_offset_t) bb);
+		simple_lock(&blk_cache_lock);
+		blk_cache_count--;
+		return;
+	    }
+	    bb->bb_data = data;
+
+	    simple_lock(&blk_cache_lock);
+	    queue_enter(&blk_cache_free, bb, blk_buf_t, bb_hash);
+	}
+}
+
+/*
+ *	Routine:	blk_cache_get
+ *	Purpose:
+ *		Return the block for (device, block), entering an
+ *		empty one if there is none.  A new block is taken
+ *		from the free list, which is first topped up if
+ *		may_alloc is set, or else reclaimed from the least
+ *		recently used clean block.  Returns BLK_BUF_NULL
+ *		if the device's cache is off, or if every block is
+ *		dirty or busy.  Completions must
+ *		pass FALSE; see blk_cache_reserve.
+ *	Conditions:
+ *		Lock held; may be dropped and retaken if may_alloc.
+ */
+static blk_buf_t
+blk_cache_get(device, block, may_alloc)
+	mach_device_t	device;
+	recnum_t	block;
+	boolean_t	may_alloc;
+{
+	register blk_buf_t	bb;
+
+	/*
+	 * Checked under the lock, so that no block is entered
+	 * after blk_cache_set_mode has purged the device.
+	 */
+	if (!blk_cache_enabled(device))
+	    return (BLK_BUF_NULL);
+
+	bb = blk_cache_lookup(device, block);
+	if (bb != BLK_BUF_NULL) {
+	    blk_cache_touch(bb);
+	    return (bb);
+	}
+
+	if (may_alloc && queue_empty(&blk_cache_free)) {
+	    blk_cache_reserve(1);
+
+	    /* the lock may have been dropped */
+	    if (!blk_cache_enabled(device))
+		return (BLK_BUF_NULL);
+	    bb = blk_cache_lookup(device, block);
+	    if (bb != BLK_BUF_NULL) {
+		blk_cache_touch(bb);
+		return (bb);
+	    }
+	}
+
+	if (!queue_empty(&blk_cache_free)) {
+	    queue_remove_first(&blk_cache_free, bb, blk_buf_t, bb_hash);
+	}
+	else {
+	    for (bb = (blk_buf_t) queue_last(&blk_cache_lru);
+		 !queue_end(&blk_cache_lru, (queue_entry_t) bb);
+		 bb = (blk_buf_t) queue_prev(&bb->bb_lru)) {
+		if (!bb->bb_busy && bb->bb_dirty == 0)
+		    break;
+	    }
+	    if (queue_end(&blk_cache_lru, (queue_entry_t) bb))
+		return (BLK_BUF_NULL);
+	    blk_cache_unlink(bb);
+	}
+
+	bb->bb_device = device;
+	bb->bb_block = block;
+	bb->bb_valid = 0;
+	bb->bb_dirty = 0;
+	bb->bb_busy = FALSE;
+	bb->bb_wanted = FALSE;
+	queue_enter(&blk_cache_hashtab[blk_cache_hash(device, block)],
+		    bb, blk_buf_t, bb_hash);
+	queue_enter_first(&blk_cache_lru, bb, blk_buf_t, bb_lru);
+	return (bb);
+}
+
+/*
+ * Completion routine for blk_cache_io.
+ */
+static boolean_t
+blk_cache_io_done(ior)
+	register io_req_t	ior;
+{
+	ior_lock(ior);
+	ior->io_op |= IO_DONE;
+	ior_unlock(ior);
+	thread_wakeup((event_t) ior);
+	return (TRUE);
+}
+
+/*
+ *	Routine:	blk_cache_io
+ *	Purpose:
+ *		Write count bytes at addr, which is wired kernel
+ *		memory, to the device, and wait for it to finish.
+ *	Conditions:
+ *		Nothing locked.
+ */
+static io_return_t
+blk_cache_io(device, recnum, addr, count)
+	mach_device_t	device;
+	recnum_t	recnum;
+	vm_offset_t	addr;
+	vm_size_t	count;
+{
+	register io_req_t	ior;
+	io_return_t		result;
+
+	io_req_alloc(ior, 0);
+
+	ior->io_device		= device;
+	ior->io_unit		= device->dev_number;
+	ior->io_op		= IO_WRITE | IO_LOANED;
+	ior->io_mode		= 0;
+	ior->io_recnum		= recnum;
+	ior->io_data		= (io_buf_ptr_t) addr;
+	ior->io_count		= count;
+	ior->io_total		= count;
+	ior->io_alloc_size	= 0;
+	ior->io_residual	= 0;
+	ior->io_error		= 0;
+	ior->io_done		= blk_cache_io_done;
+	ior->io_reply_port	= IP_NULL;
+	ior->io_reply_port_type	= 0;
+	ior->io_copy		= VM_MAP_COPY_NULL;
+
+	result = (*device->dev_ops->d_write)(device->dev_number, ior);
+	if (result == D_IO_QUEUED) {
+	    iowait(ior);
+	    result = ior->io_error;
+	}
+	if (result == D_SUCCESS && ior->io_residual != 0)
+	    result = D_IO_ERROR;
+
+	io_req_free(ior);
+	return (result);
+}
+
+/*
+ * Write the given dirty records of a busy block to its device.
+ */
+static io_return_t
+blk_cache_flush(bb, dirty)
+	register blk_buf_t	bb;
+	unsigned int		dirty;
+{
+	mach_device_t		device = bb->bb_device;
+	register int		first, last;
+	int			rpb = device->cache_rpb;
+	vm_size_t		bsize = bb_bsize(device);
+	io_return_t		result;
+
+	for (first = 0; first < rpb; first = last) {
+	    last = first + 1;
+	    if ((dirty & bb_bit(first)) == 0)
+		continue;
+	    while (last < rpb && (dirty & bb_bit(last)))
+		last++;
+
+	    result = blk_cache_io(device,
+				  bb->bb_block * rpb + first,
+				  bb->bb_data + first * bsize,
+				  (last - first) * bsize);
+	    if (result != D_SUCCESS)
+		return (result);
+	}
+	return (D_SUCCESS);
+}
+
+/*
+ *	Routine:	blk_cache_sync
+ *	Purpose:
+ *		Write back the dirty records of a device, or of
+ *		all devices if device is MACH_DEVICE_NULL.  Records
+ *		that cannot be written are dropped from the cache,
+ *		and the error is returned.
+ *	Conditions:
+ *		Nothing locked.
+ */
+io_return_t
+blk_cache_sync(device)
+	mach_device_t	device;
+{
+	register blk_buf_t	bb;
+	unsigned int		dirty;
+	io_return_t		result = D_SUCCESS;
+	io_return_t		error;
+
+	simple_lock(&blk_cache_lock);
+    restart:
+	queue_iterate(&blk_cache_lru, bb, blk_buf_t, bb_lru) {
+	    if (device != MACH_DEVICE_NULL && bb->bb_device != device)
+		continue;
+
+	    if (bb->bb_busy) {
+		/*
+		 *	Someone else is writing it; a sync of one
+		 *	device must wait for that to finish.
+		 */
+		if (device == MACH_DEVICE_NULL)
+		    continue;
+		bb->bb_wanted = TRUE;
+		thread_sleep((event_t) bb,
+			     simple_lock_addr(blk_cache_lock),
+			     FALSE);
+		simple_lock(&blk_cache_lock);
+		goto restart;
+	    }
+
+	    if (bb->bb_dirty == 0)
+		continue;
+
+	    dirty = bb->bb_dirty;
+	    bb_clear_dirty(bb, dirty);
+	    bb->bb_busy = TRUE;
+	    simple_unlock(&blk_cache_lock);
+
+	    error = blk_cache_flush(bb, dirty);
+
+	    simple_lock(&blk_cache_lock);
+	    if (error != D_SUCCESS) {
+		printf("blk_cache: error %d writing block %d of device %x\n",
+		       error, bb->bb_block, bb->bb_device->dev_number);
+		/*
+		 *	Keep records that were written again
+		 *	while we were at it.
+		 */
+		bb->bb_valid &= ~(dirty & ~bb->bb_dirty);
+		result = error;
+	    }
+	    bb->bb_busy = FALSE;
+	    if (bb->bb_wanted) {
+		bb->bb_wanted = FALSE;
+		thread_wakeup((event_t) bb);
+	    }
+	    goto restart;
+	}
+	simple_unlock(&blk_cache_lock);
+	return (result);
+}
+
+/*
+ * Drop all of a device's blocks, dirty or not.
+ */
+static void
+blk_cache_purge(device)
+	mach_device_t	device;
+{
+	register blk_buf_t	bb;
+
+	simple_lock(&blk_cache_lock);
+    restart:
+	queue_iterate(&blk_cache_lru, bb, blk_buf_t, bb_lru) {
+	    if (bb->bb_device != device)
+		continue;
+
+	    if (bb->bb_busy) {
+		bb->bb_wanted = TRUE;
+		thread_sleep((event_t) bb,
+			     simple_lock_addr(blk_cache_lock),
+			     FALSE);
+		simple_lock(&blk_cache_lock);
+		goto restart;
+	    }
+
+	    bb_clear_dirty(bb, bb->bb_dirty);
+	    blk_cache_unlink(bb);
+	    queue_enter(&blk_cache_free, bb, blk_buf_t, bb_hash);
+	    goto restart;
+	}
+	simple_unlock(&blk_cache_lock);
+}
+
+/*
+ *	Routine:	blk_cache_set_mode
+ *	Purpose:
+ *		Handle DEV_CACHE.  The cache can only be turned on
+ *		for devices whose record size divides a page.
+ */
+io_return_t
+blk_cache_set_mode(device, mode)
+	register mach_device_t	device;
+	int			mode;
+{
+	int		bsize;
+	int		old_mode;
+	io_return_t	result = D_SUCCESS;
+
+	if (mode != DEV_CACHE_OFF &&
+	    mode != DEV_CACHE_WRITETHROUGH &&
+	    mode != DEV_CACHE_WRITEBACK)
+	    return (D_INVALID_OPERATION);
+
+	old_mode = device->cache_mode;
+	if (old_mode == DEV_CACHE_OFF && mode != DEV_CACHE_OFF) {
+	    if ((*device->dev_ops->d_dev_info)(device->dev_number,
+					       D_INFO_BLOCK_SIZE,
+					       &bsize) != D_SUCCESS ||
+		bsize <= 0 || bsize > PAGE_SIZE ||
+		PAGE_SIZE % bsize != 0 ||
+		PAGE_SIZE / bsize > BLK_CACHE_RPB_MAX)
+		return (D_INVALID_OPERATION);
+	    device->cache_rpb = PAGE_SIZE / bsize;
+	}
+
+	/*
+	 * Change the mode first, so that no new writes are held
+	 * back and no new reads cached while we clean up.
+	 */
+	device->cache_mode = mode;
+	if (old_mode == DEV_CACHE_WRITEBACK && mode != DEV_CACHE_WRITEBACK)
+	    result = blk_cache_sync(device);
+	if (mode == DEV_CACHE_OFF && old_mode != DEV_CACHE_OFF)
+	    blk_cache_purge(device);
+
+	return (result);
+}
+
+/*
+ * Handle DEV_CACHE for get_status.
+ */
+io_return_t
+blk_cache_get_status(device, status, status_count)
+	mach_device_t		device;
+	dev_status_t		status;
+	mach_msg_type_number_t	*status_count;
+{
+	register struct dev_cache_status *dcs;
+	register blk_buf_t	bb;
+
+	if (*status_count < DEV_CACHE_STATUS_COUNT)
+	    return (D_INVALID_OPERATION);
+
+	dcs = (struct dev_cache_status *) status;
+	dcs->dcs_mode = device->cache_mode;
+	dcs->dcs_blocks = 0;
+	dcs->dcs_dirty = 0;
+
+	simple_lock(&blk_cache_lock);
+	queue_iterate(&blk_cache_lru, bb, blk_buf_t, bb_lru) {
+	    if (bb->bb_device != device)
+		continue;
+	    dcs->dcs_blocks++;
+	    if (bb->bb_dirty != 0)
+		dcs->dcs_dirty++;
+	}
+	dcs->dcs_hits = blk_cache_hits;
+	dcs->dcs_misses = blk_cache_misses;
+	simple_unlock(&blk_cache_lock);
+
+	*status_count = DEV_CACHE_STATUS_COUNT;
+	return (D_SUCCESS);
+}
+
+/*
+ * The device is being closed: write back and drop its blocks.
+ */
+void
+blk_cache_close(device)
+	mach_device_t	device;
+{
+	(void) blk_cache_set_mode(device, DEV_CACHE_OFF);
+}
+
+/*
+ *	Routine:	blk_cache_read
+ *	Purpose:
+ *		Copy the data for a read into io_data, if every
+ *		record it covers is cached.  Returns FALSE, with
+ *		io_data possibly scribbled on, if any is missing;
+ *		blocks are then set aside for blk_cache_fill.
+ *	Conditions:
+ *		Nothing locked; called by the requesting thread.
+ */
+boolean_t
+blk_cache_read(ior)
+	register io_req_t	ior;
+{
+	mach_device_t		device = ior->io_device;
+	int			rpb = device->cache_rpb;
+	vm_size_t		bsize = bb_bsize(device);
+	recnum_t		rec = ior->io_recnum;
+	vm_offset_t		addr = (vm_offset_t) ior->io_data;
+	vm_size_t		left = ior->io_count;
+	register vm_size_t	n;
+	register blk_buf_t	bb = BLK_BUF_NULL;
+	int			i;
+
+	simple_lock(&blk_cache_lock);
+	for (; left > 0; rec++, addr += n, left -= n) {
+	    if (bb == BLK_BUF_NULL || bb->bb_block != rec / rpb) {
+		bb = blk_cache_lookup(device, rec / rpb);
+		if (bb == BLK_BUF_NULL)
+		    break;
+		blk_cache_touch(bb);
+	    }
+	    i = rec % rpb;
+	    if ((bb->bb_valid & bb_bit(i)) == 0)
+		break;
+
+	    n = (left < bsize) ? left : bsize;
+	    bcopy((char *) bb->bb_data + i * bsize, (char *) addr, n);
+	}
+
+	if (left > 0) {
+	    blk_cache_misses++;
+	    n = (ior->io_count + bsize - 1) / bsize;
+	    blk_cache_reserve((ior->io_recnum + n - 1) / rpb -
+			      ior->io_recnum / rpb + 1);
+	    simple_unlock(&blk_cache_lock);
+	    return (FALSE);
+	}
+	blk_cache_hits++;
+	simple_unlock(&blk_cache_lock);
+
+	ior->io_residual = 0;
+	ior->io_error = D_SUCCESS;
+	return (TRUE);
+}
+
+/*
+ *	Routine:	blk_cache_fill
+ *	Purpose:
+ *		Merge the data of a read that the driver completed
+ *		with the cache.  Records the cache already has
+ *		replace what was read, since they may have been
+ *		written since; the rest are entered in the cache,
+ *		in blocks that are already allocated.
+ *	Conditions:
+ *		Called from the io_done thread.
+ */
+void
+blk_cache_fill(ior)
+	register io_req_t	ior;
+{
+	mach_device_t		device = ior->io_device;
+	int			rpb;
+	vm_size_t		bsize;
+	recnum_t		rec = ior->io_recnum;
+	vm_offset_t		addr = (vm_offset_t) ior->io_data;
+	vm_size_t		left = ior->io_count - ior->io_residual;
+	register blk_buf_t	bb = BLK_BUF_NULL;
+	unsigned int		bit;
+
+	if (!blk_cache_enabled(device))
+	    return;
+	rpb = device->cache_rpb;
+	bsize = bb_bsize(device);
+
+	simple_lock(&blk_cache_lock);
+	for (; left >= bsize; rec++, addr += bsize, left -= bsize) {
+	    if (bb == BLK_BUF_NULL || bb->bb_block != rec / rpb) {
+		bb = blk_cache_get(device, rec / rpb, FALSE);
+		if (bb == BLK_BUF_NULL)
+		    break;
+	    }
+	    bit = bb_bit(rec % rpb);
+	    if (bb->bb_valid & bit)
+		bcopy((char *) bb->bb_data + (rec % rpb) * bsize,
+		      (char *) addr, bsize);
+	    else {
+		bcopy((char *) addr,
+		      (char *) bb->bb_data + (rec % rpb) * bsize, bsize);
+		bb->bb_valid |= bit;
+	    }
+	}
+	simple_unlock(&blk_cache_lock);
+}
+
+/*
+ *	Routine:	blk_cache_update
+ *	Purpose:
+ *		Copy the data of a write that the driver completed
+ *		into the cache.  Records the write did not cover
+ *		completely, or that failed, are dropped.  Like
+ *		blk_cache_fill, never allocates a block.
+ *	Conditions:
+ *		io_data is mapped; called from device_write_dealloc,
+ *		possibly in the io_done thread.
+ */
+void
+blk_cache_update(ior)
+	register io_req_t	ior;
+{
+	mach_device_t		device = ior->io_device;
+	int			rpb;
+	vm_size_t		bsize;
+	recnum_t		rec = ior->io_recnum;
+	vm_offset_t		addr = (vm_offset_t) ior->io_data;
+	vm_size_t		left = ior->io_count;
+	register vm_size_t	n;
+	register blk_buf_t	bb = BLK_BUF_NULL;
+	unsigned int		bit;
+	boolean_t		ok;
+
+	if (!blk_cache_enabled(device))
+	    return;
+	rpb = device->cache_rpb;
+	bsize = bb_bsize(device);
+	ok = (ior->io_error == 0 && ior->io_residual == 0);
+
+	simple_lock(&blk_cache_lock);
+	for (; left > 0; rec++, addr += n, left -= n) {
+	    n = (left < bsize) ? left : bsize;
+	    if (bb == BLK_BUF_NULL || bb->bb_block != rec / rpb) {
+		bb = (ok && n == bsize)
+			? blk_cache_get(device, rec / rpb, FALSE)
+			: blk_cache_lookup(device, rec / rpb);
+		if (bb == BLK_BUF_NULL)
+		    continue;
+	    }
+	    bit = bb_bit(rec % rpb);
+	    if (ok && n == bsize) {
+		bcopy((char *) addr,
+		      (char *) bb->bb_data + (rec % rpb) * bsize, bsize);
+		bb->bb_valid |= bit;
+		bb_clear_dirty(bb, bit);
+	    }
+	    else if ((bb->bb_dirty & bit) == 0)
+		bb->bb_valid &= ~bit;
+	}
+	simple_unlock(&blk_cache_lock);
+}
+
+/*
+ *	Routine:	blk_cache_absorb
+ *	Purpose:
+ *		Copy whole records at addr into the cache as dirty
+ *		data.  A record for which no block can be had is
+ *		written straight to the device instead.
+ *	Conditions:
+ *		Nothing locked.
+ */
+static io_return_t
+blk_cache_absorb(device, rec, addr, count)
+	mach_device_t	device;
+	recnum_t	rec;
+	vm_offset_t	addr;
+	vm_size_t	count;
+{
+	int			rpb = device->cache_rpb;
+	vm_size_t		bsize = bb_bsize(device);
+	register blk_buf_t	bb = BLK_BUF_NULL;
+	unsigned int		bit;
+	io_return_t		result;
+
+	simple_lock(&blk_cache_lock);
+	for (; count > 0; rec++, addr += bsize, count -= bsize) {
+	    if (bb == BLK_BUF_NULL || bb->bb_block != rec / rpb) {
+		bb = blk_cache_get(device, rec / rpb, TRUE);
+		if (bb == BLK_BUF_NULL) {
+		    simple_unlock(&blk_cache_lock);
+		    result = blk_cache_io(device, rec, addr, bsize);
+		    if (result != D_SUCCESS)
+			return (result);
+		    simple_lock(&blk_cache_lock);
+		    continue;
+		}
+	    }
+	    bit = bb_bit(rec % rpb);
+	    bcopy((char *) addr,
+		  (char *) bb->bb_data + (rec % rpb) * bsize, bsize);
+	    bb->bb_valid |= bit;
+	    bb_set_dirty(bb, bit);
+	}
+	simple_unlock(&blk_cache_lock);
+
+	/*
+	 * Errors from other devices' blocks are not our caller's.
+	 */
+	if (blk_cache_ndirty > blk_cache_dirty_max)
+	    (void) blk_cache_sync(MACH_DEVICE_NULL);
+
+	return (D_SUCCESS);
+}
+
+/*
+ * Write-back mode holds writes of whole records, up to a
+ * quarter of the cache at a time.
+ */
+#define	blk_cache_absorbs(device, count)			\
+	((count) != 0 &&					\
+	 (count) % bb_bsize(device) == 0 &&			\
+	 (count) <= blk_cache_dirty_max * PAGE_SIZE)
+
+/*
+ *	Routine:	blk_cache_write
+ *	Purpose:
+ *		Try to take a device_write in write-back mode.
+ *		If it returns TRUE, the data has been consumed and
+ *		*result is the result of the write.  Otherwise the
+ *		device's dirty data has been written back, and the
+ *		caller must send the write to the driver.
+ */
+boolean_t
+blk_cache_write(device, recnum, copy, count, result)
+	mach_device_t	device;
+	recnum_t	recnum;
+	vm_map_copy_t	copy;
+	vm_size_t	count;
+	io_return_t	*result;
+{
+	vm_offset_t	addr;
+
+	if (!blk_cache_absorbs(device, count) ||
+	    vm_map_copy_has_cont(copy) ||
+	    vm_map_copyout(kernel_map, &addr, copy) != KERN_SUCCESS) {
+	    (void) blk_cache_sync(device);
+	    return (FALSE);
+	}
+
+	*result = blk_cache_absorb(device, recnum, addr, count);
+
+	(void) vm_deallocate(kernel_map, trunc_page(addr),
+			     round_page(addr + count) - trunc_page(addr));
+	return (TRUE);
+}
+
+/*
+ * Same, for device_write_inband.
+ */
+boolean_t
+blk_cache_write_inband(device, recnum, data, count, result)
+	mach_device_t	device;
+	recnum_t	recnum;
+	char		*data;
+	vm_size_t	count;
+	io_return_t	*result;
+{
+	if (!blk_cache_absorbs(device, count)) {
+	    (void) blk_cache_sync(device);
+	    return (FALSE);
+	}
+
+	*result = blk_cache_absorb(device, recnum, (vm_offset_t) data, count);
+	return (TRUE);
+}
+
+/*
+ *	Routine:	blk_cache_collect
+ *	Purpose:
+ *		Give memory back to the system.  Frees unused blocks,
+ *		and the older half of the clean ones.  Called by the
+ *		pageout daemon, which may call it far more often than
+ *		the cache can refill, so it runs at most once every
+ *		blk_cache_collect_max_rate scheduler ticks.
+ */
+unsigned	blk_cache_collect_last_tick = 0;
+unsigned	blk_cache_collect_max_rate = 1;		/* sched ticks */
+
+void
+blk_cache_collect()
+{
+	queue_head_t		doomed;
+	register blk_buf_t	bb, prev;
+	register int		n;
+
+	if (sched_tick <= blk_cache_collect_last_tick +
+			  blk_cache_collect_max_rate)
+	    return;
+	blk_cache_collect_last_tick = sched_tick;
+
+	queue_init(&doomed);
+
+	simple_lock(&blk_cache_lock);
+	while (!queue_empty(&blk_cache_free)) {
+	    queue_remove_first(&blk_cache_free, bb, blk_buf_t, bb_hash);
+	    queue_enter(&doomed, bb, blk_buf_t, bb_hash);
+	    blk_cache_count--;
+	}
+
+	n = 0;
+	queue_iterate(&blk_cache_lru, bb, blk_buf_t, bb_lru) {
+	    if (!bb->bb_busy && bb->bb_dirty == 0)
+		n++;
+	}
+
+	n /= 2;
+	for (bb = (blk_buf_t) queue_last(&blk_cache_lru);
+	     n > 0 && !queue_end(&blk_cache_lru, (queue_entry_t) bb);
+	     bb = prev) {
+	    prev = (blk_buf_t) queue_prev(&bb->bb_lru);
+	    if (bb->bb_busy || bb->bb_dirty != 0)
+		continue;
+	    blk_cache_unlink(bb);
+	    queue_enter(&doomed, bb, blk_buf_t, bb_hash);
+	    blk_cache_count--;
+	    n--;
+	}
+	simple_unlock(&blk_cache_lock);
+
+	while (!queue_empty(&doomed)) {
+	    queue_remove_first(&doomed, bb, blk_buf_t, bb_hash);
+	    kmem_free(kernel_map, bb->bb_data, PAGE_SIZE);
+	    zfree(blk_buf_zone, (vm_offset_t) bb);
+	}
+}
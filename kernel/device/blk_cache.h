@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	File:	device/blk_cache.h
+ *
+ *	Block cache for random-access devices.
+ *
+ *	The cache holds page-sized blocks of device data, named by
+ *	the device and the block number (record number divided by
+ *	the records per page).  It is off until DEV_CACHE turns it on
+ *	for a device, and goes off again when the device is closed.
+ *	Each record of a block is separately valid, and in write-back
+ *	mode separately dirty.
+ *
+ *	With the cache on, a read whose records are all cached is
+ *	answered without calling the driver; the data of every other
+ *	read, and of every write the driver completes, is copied into
+ *	the cache.  In write-back mode a write of whole records is
+ *	copied into the cache and answered at once.  Dirty records go
+ *	to the device on DEV_CACHE_SYNC, on close or mode change, and
+ *	whenever too many blocks are dirty.
+ *
+ *	The cache is limited to blk_cache_max blocks, and gives clean
+ *	blocks back when the pageout daemon runs short of memory.
+ *	Blocks are only allocated by requesting threads, and only
+ *	while free memory is above the pageout target; completions
+ *	use blocks set aside for them, or reuse clean ones.
+ *	The partitions of a disk are separate devices; the cache does
+ *	not keep them coherent with each other.
+ */
+
+#ifndef	_DEVICE_BLK_CACHE_H_
+#define	_DEVICE_BLK_CACHE_H_
+
+#include <mach/boolean.h>
+#include <device/device_types.h>
+#include <device/dev_hdr.h>
+#include <device/io_req.h>
+
+#define	BLK_CACHE_RPB_MAX	32	/* records per block, at most */
+
+#define	blk_cache_enabled(device)	\
+		((device)->cache_mode != DEV_CACHE_OFF)
+
+extern void		blk_cache_init();
+extern io_return_t	blk_cache_set_mode(/* mach_device_t, int */);
+extern io_return_t	blk_cache_get_status(/* mach_device_t, dev_status_t,
+						mach_msg_type_number_t * */);
+extern io_return_t	blk_cache_sync(/* mach_device_t */);
+extern void		blk_cache_close(/* mach_device_t */);
+extern boolean_t	blk_cache_read(/* io_req_t */);
+extern void		blk_cache_fill(/* io_req_t */);
+extern void		blk_cache_update(/* io_req_t */);
+extern boolean_t	blk_cache_write(/* mach_device_t, recnum_t,
+					   vm_map_copy_t, vm_size_t,
+					   io_return_t * */);
+extern boolean_t	blk_cache_write_inband(/* mach_device_t, recnum_t,
+						  char *, vm_size_t,
+						  io_return_t * */);
+extern void		blk_cache_collect();
+
+#endif	/* _DEVICE_BLK_CACHE_H_ */
@@ -31,8 +31,11 @@
  */
 #include <mach/kern_return.h>
 
+#include <kern/thread.h>
+
 #include <device/param.h>
 #include <device/device_types.h>
+#include <device/conf.h>
 #include <device/io_req.h>
 #include <device/ds_routines.h>
 
@@ -53,6 +56,11 @@ io_return_t block_io(strat, max_count, ior)
 	 */
 	(*max_count)(ior);
 
+	/*
+	 * Remember who asked, for I/O schedulers that care.
+	 */
+	ior->io_task = current_task();
+
 	/*
 	 * If reading, allocate memory.  If writing, wire
 	 * down the incoming memory.
@@ -85,17 +93,27 @@ io_return_t block_io(strat, max_count, ior)
  * 'standard' max_count routine.  VM continuations mean that this
  * code can cope with arbitrarily-sized write operations (they won't be
  * atomic, but any caller that cares will do the op synchronously).
+ * Reads are limited to what the driver says it can transfer
+ * (D_INFO_MAX_XFER), or MAX_PHYS if it doesn't say.
  */
 #define MAX_PHYS        (256 * 1024)
 
 void minphys(ior)
 	register io_req_t	ior;
 {
+	int	max;
+
 	if ((ior->io_op & (IO_WRITE | IO_READ | IO_OPEN)) == IO_WRITE)
 	    return;
 
-        if (ior->io_count > MAX_PHYS)
-            ior->io_count = MAX_PHYS;
+	if (ior->io_device == 0 ||
+	    (*ior->io_device->dev_ops->d_dev_info)(ior->io_device->dev_number,
+						   D_INFO_MAX_XFER,
+						   &max) != D_SUCCESS)
+	    max = MAX_PHYS;
+
+        if (ior->io_count > max)
+            ior->io_count = max;
 }
 
 /*
@@ -66,6 +66,10 @@ extern vm_offset_t nomap();		/* no operation - error */
  * Flavor constants for d_dev_info routine
  */
 #define D_INFO_BLOCK_SIZE	1
+#define D_INFO_SG_MAX		2	/* fragments a write can gather
+					   (implies IO_GATHER support) */
+#define D_INFO_MAX_XFER		3	/* largest transfer, if not
+					   MAX_PHYS */
 
 /*
  * Head of list of attached devices
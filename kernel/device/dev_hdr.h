@@ -71,6 +71,8 @@ struct mach_device {
 	queue_chain_t	number_chain;	/* chain for lookup by number */
 	int		dev_number;	/* device number */
 	int		bsize;		/* replacement for DEV_BSIZE */
+	int		cache_mode;	/* block cache mode (DEV_CACHE_*) */
+	int		cache_rpb;	/* records per cache block */
 	struct dev_ops	*dev_ops;	/* and operations vector */
 #ifdef i386
 	struct device	dev;		/* the real device structure */
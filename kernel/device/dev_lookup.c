@@ -166,6 +166,8 @@ device_lookup(name)
 	    new_device->dev_ops = dev_ops;
 	    new_device->dev_number = dev_minor;
 	    new_device->bsize = DEV_BSIZE;	/* change later */
+	    new_device->cache_mode = DEV_CACHE_OFF;
+	    new_device->cache_rpb = 0;
 
 	    simple_lock(&dev_number_lock);
 	}
@@ -35,6 +35,7 @@
 
 #include <device/device_types.h>
 #include <device/device_port.h>
+#include <device/ds_routines.h>
 
 
 
@@ -47,7 +48,6 @@ extern void	chario_init(void);
 extern void 	fipc_init();
 #endif
 
-extern void	io_done_thread();
 extern void	net_thread();
 
 ipc_port_t	master_device_port;
@@ -55,6 +55,8 @@ ipc_port_t	master_device_port;
 void
 device_service_create()
 {
+	int	i;
+
 	master_device_port = ipc_port_alloc_kernel();
 	if (master_device_port == IP_NULL)
 	    panic("can't allocate master device port");
@@ -68,6 +70,7 @@ device_service_create()
 	fipc_init();
 #endif
 
-	(void) kernel_thread(kernel_task, io_done_thread, 0);
+	for (i = 0; i < IO_DONE_LISTS; i++)
+	    (void) kernel_thread(kernel_task, io_done_thread, (char *) i);
 	(void) kernel_thread(kernel_task, net_thread, 0);
 }
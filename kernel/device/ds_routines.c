@@ -28,6 +28,7 @@
  *	Date: 	3/89
  */
 
+#include <mach_debug.h>
 #include <norma_device.h>
 
 #include <mach/boolean.h>
@@ -48,6 +49,8 @@
 #include <kern/thread.h>
 #include <kern/task.h>
 #include <kern/sched_prim.h>
+#include <kern/host.h>
+#include <kern/time_stamp.h>
 
 #include <vm/memory_object.h>
 #include <vm/vm_map.h>
@@ -60,6 +63,9 @@
 #include <device/ds_routines.h>
 #include <device/net_status.h>
 #include <device/device_port.h>
+#include <device/blk_cache.h>
+#include <device/io_cq.h>
+#include <mach_debug/io_done_info.h>
 #include "device_reply.h"
 
 #include <machine/machspl.h>
@@ -389,6 +395,12 @@ ds_device_close(device)
 	dev_port_remove(device);
 	ipc_port_dealloc_kernel(device->port);
 
+	/*
+	 * Write back and drop anything cached for it.
+	 */
+	if (blk_cache_enabled(device))
+	    blk_cache_close(device);
+
 	/*
 	 * Close the device
 	 */
@@ -435,22 +447,25 @@ ds_device_write(device, reply_port, reply_port_type, mode, recnum,
 	register mach_device_t	device = d;
 #endif
 	register io_req_t	ior;
-	register io_return_t	result;
+	io_return_t		result;
 
 #ifndef i386
 	/*
 	 * Refuse if device is dead or not completely open.
 	 */
 	if (device == DEVICE_NULL)
-	    return (D_NO_SUCH_DEVICE);
+	    return (io_cq_error(reply_port, reply_port_type, IO_CQ_WRITE,
+				recnum, D_NO_SUCH_DEVICE, (vm_map_copy_t) data));
 #endif
 
 	if (device->state != DEV_STATE_OPEN)
-	    return (D_NO_SUCH_DEVICE);
+	    return (io_cq_error(reply_port, reply_port_type, IO_CQ_WRITE,
+				recnum, D_NO_SUCH_DEVICE, (vm_map_copy_t) data));
 
 #ifndef i386
 	if (data == 0)
-	   return (D_INVALID_SIZE);
+	   return (io_cq_error(reply_port, reply_port_type, IO_CQ_WRITE,
+				recnum, D_INVALID_SIZE, (vm_map_copy_t) data));
 #endif
 
 	/*
@@ -459,6 +474,23 @@ ds_device_write(device, reply_port, reply_port_type, mode, recnum,
 
 	/* XXX note that a CLOSE may proceed at any point */
 
+	/*
+	 * In write-back mode, the block cache may take the write.
+	 */
+	if (device->cache_mode == DEV_CACHE_WRITEBACK &&
+	    blk_cache_write(device, recnum, (vm_map_copy_t) data,
+			    (vm_size_t) data_count, &result)) {
+	    if (io_cq_port(reply_port)) {
+		io_cq_reply(reply_port, reply_port_type, IO_CQ_WRITE,
+			    recnum, result,
+			    (result == D_SUCCESS) ? (vm_size_t) data_count : 0,
+			    VM_MAP_COPY_NULL);
+		return (MIG_NO_REPLY);
+	    }
+	    *bytes_written = (result == D_SUCCESS) ? data_count : 0;
+	    return (result);
+	}
+
 	/*
 	 * Package the write request for the device driver
 	 */
@@ -509,6 +541,22 @@ ds_device_write(device, reply_port, reply_port_type, mode, recnum,
 
 	} while (!device_write_dealloc(ior));
 
+	/*
+	 * A completion queue takes the result in place of a reply.
+	 * If the driver failed without taking the data, io_data is
+	 * still the copy, which no reply message will now destroy.
+	 */
+	if (io_cq_port(reply_port)) {
+	    if (result != D_SUCCESS) {
+		ior->io_error = result;
+		vm_map_copy_discard((vm_map_copy_t) ior->io_data);
+	    }
+	    io_cq_done(ior, 0, 0);
+	    mach_device_deallocate(device);
+	    io_req_free(ior);
+	    return (MIG_NO_REPLY);
+	}
+
 	/*
 	 * Return the number of bytes actually written.
 	 */
@@ -549,26 +597,46 @@ ds_device_write_inband(device, reply_port, reply_port_type, mode, recnum,
 	register mach_device_t	device = d;
 #endif
 	register io_req_t	ior;
-	register io_return_t	result;
+	io_return_t		result;
 
 #ifndef i386
 	/*
 	 * Refuse if device is dead or not completely open.
 	 */
 	if (device == DEVICE_NULL)
-	    return (D_NO_SUCH_DEVICE);
+	    return (io_cq_error(reply_port, reply_port_type, IO_CQ_WRITE,
+				recnum, D_NO_SUCH_DEVICE, VM_MAP_COPY_NULL));
 #endif
 
 	if (device->state != DEV_STATE_OPEN)
-	    return (D_NO_SUCH_DEVICE);
+	    return (io_cq_error(reply_port, reply_port_type, IO_CQ_WRITE,
+				recnum, D_NO_SUCH_DEVICE, VM_MAP_COPY_NULL));
 
 #ifndef i386
 	if (data == 0)
-	   return (D_INVALID_SIZE);
+	   return (io_cq_error(reply_port, reply_port_type, IO_CQ_WRITE,
+				recnum, D_INVALID_SIZE, VM_MAP_COPY_NULL));
 #endif
 
 	/* XXX note that a CLOSE may proceed at any point */
 
+	/*
+	 * In write-back mode, the block cache may take the write.
+	 */
+	if (device->cache_mode == DEV_CACHE_WRITEBACK &&
+	    blk_cache_write_inband(device, recnum, data,
+				   (vm_size_t) data_count, &result)) {
+	    if (io_cq_port(reply_port)) {
+		io_cq_reply(reply_port, reply_port_type, IO_CQ_WRITE,
+			    recnum, result,
+			    (result == D_SUCCESS) ? (vm_size_t) data_count : 0,
+			    VM_MAP_COPY_NULL);
+		return (MIG_NO_REPLY);
+	    }
+	    *bytes_written = (result == D_SUCCESS) ? data_count : 0;
+	    return (result);
+	}
+
 	/*
 	 * Package the write request for the device driver.
 	 */
@@ -605,6 +673,18 @@ ds_device_write_inband(device, reply_port, reply_port_type, mode, recnum,
 	if (result == D_IO_QUEUED)
 	    return (MIG_NO_REPLY);
 
+	/*
+	 * A completion queue takes the result in place of a reply.
+	 */
+	if (io_cq_port(reply_port)) {
+	    if (result != D_SUCCESS)
+		ior->io_error = result;
+	    io_cq_done(ior, 0, 0);
+	    mach_device_deallocate(device);
+	    io_req_free(ior);
+	    return (MIG_NO_REPLY);
+	}
+
 	/*
 	 * Return the number of bytes actually written.
 	 */
@@ -645,9 +725,9 @@ device_write_get(ior, wait)
 	    return (KERN_SUCCESS);
 
 	/*
-	 * Loaned iors already have valid data.
+	 * Loaned and gathered iors already have valid data.
 	 */
-	if (ior->io_op & IO_LOANED)
+	if (ior->io_op & (IO_LOANED|IO_GATHER))
 	    return (KERN_SUCCESS);
 
 	/*
@@ -735,6 +815,8 @@ device_write_dealloc(ior)
 	 * Inband case.
 	 */
 	if (ior->io_op & IO_INBAND) {
+	    if (blk_cache_enabled(ior->io_device))
+		blk_cache_update(ior);
 	    zfree(io_inband_zone, (vm_offset_t)ior->io_data);
 
 	    return (TRUE);
@@ -743,6 +825,14 @@ device_write_dealloc(ior)
 	if ((io_copy = ior->io_copy) == VM_MAP_COPY_NULL)
 	    return (TRUE);
 
+	/*
+	 *	The data is still mapped; let the block cache see it.
+	 *	blk_cache_update allocates nothing, so this is safe
+	 *	before the release below.
+	 */
+	if (blk_cache_enabled(ior->io_device))
+	    blk_cache_update(ior);
+
 	/*
 	 *	To prevent a possible deadlock with the default pager,
 	 *	we have to release space in the device_io_map before
@@ -848,7 +938,9 @@ ds_write_done(ior)
 	 *	Now the write is really complete.  Send reply.
 	 */
 
-	if (IP_VALID(ior->io_reply_port)) {
+	if (io_cq_port(ior->io_reply_port))
+	    io_cq_done(ior, 0, 0);
+	else if (IP_VALID(ior->io_reply_port)) {
 	    (void) (*((ior->io_op & IO_INBAND) ?
 		      ds_device_write_reply_inband :
 		      ds_device_write_reply))(ior->io_reply_port,
@@ -862,6 +954,19 @@ ds_write_done(ior)
 	return (TRUE);
 }
 
+/*
+ * Completion of a read that went to the driver with the block
+ * cache on: merge the data with the cache, then reply as usual.
+ */
+static boolean_t
+ds_read_cache_done(ior)
+	register io_req_t	ior;
+{
+	if (ior->io_error == 0)
+	    blk_cache_fill(ior);
+	return (ds_read_done(ior));
+}
+
 /*
  * Read from a device.
  */
@@ -900,11 +1005,13 @@ ds_device_read(device, reply_port, reply_port_type, mode, recnum,
 	 * Refuse if device is dead or not completely open.
 	 */
 	if (device == DEVICE_NULL)
-	    return (D_NO_SUCH_DEVICE);
+	    return (io_cq_error(reply_port, reply_port_type, IO_CQ_READ,
+				recnum, D_NO_SUCH_DEVICE, VM_MAP_COPY_NULL));
 #endif
 
 	if (device->state != DEV_STATE_OPEN)
-	    return (D_NO_SUCH_DEVICE);
+	    return (io_cq_error(reply_port, reply_port_type, IO_CQ_READ,
+				recnum, D_NO_SUCH_DEVICE, VM_MAP_COPY_NULL));
 
 	/* XXX note that a CLOSE may proceed at any point */
 
@@ -941,6 +1048,20 @@ ds_device_read(device, reply_port, reply_port_type, mode, recnum,
 	 */
 	mach_device_reference(device);
 
+	/*
+	 * Try the block cache first.
+	 */
+	if (blk_cache_enabled(device) && ior->io_count > 0) {
+	    ior->io_done = ds_read_cache_done;
+	    if (device_read_alloc(ior, (vm_size_t)ior->io_count)
+			== KERN_SUCCESS &&
+		blk_cache_read(ior)) {
+		(void) ds_read_done(ior);
+		io_req_free(ior);
+		return (MIG_NO_REPLY);
+	    }
+	}
+
 	/*
 	 * And do the read.
 	 */
@@ -956,7 +1077,7 @@ ds_device_read(device, reply_port, reply_port_type, mode, recnum,
 	 * Return result via ds_read_done.
 	 */
 	ior->io_error = result;
-	(void) ds_read_done(ior);
+	(void) (*ior->io_done)(ior);
 	io_req_free(ior);
 
 	return (MIG_NO_REPLY);	/* reply has already been sent. */
@@ -1000,11 +1121,13 @@ ds_device_read_inband(device, reply_port, reply_port_type, mode, recnum,
 	 * Refuse if device is dead or not completely open.
 	 */
 	if (device == DEVICE_NULL)
-	    return (D_NO_SUCH_DEVICE);
+	    return (io_cq_error(reply_port, reply_port_type, IO_CQ_READ,
+				recnum, D_NO_SUCH_DEVICE, VM_MAP_COPY_NULL));
 #endif
 
 	if (device->state != DEV_STATE_OPEN)
-	    return (D_NO_SUCH_DEVICE);
+	    return (io_cq_error(reply_port, reply_port_type, IO_CQ_READ,
+				recnum, D_NO_SUCH_DEVICE, VM_MAP_COPY_NULL));
 
 	/* XXX note that a CLOSE may proceed at any point */
 
@@ -1043,6 +1166,20 @@ ds_device_read_inband(device, reply_port, reply_port_type, mode, recnum,
 	 */
 	mach_device_reference(device);
 
+	/*
+	 * Try the block cache first.
+	 */
+	if (blk_cache_enabled(device) && ior->io_count > 0) {
+	    ior->io_done = ds_read_cache_done;
+	    if (device_read_alloc(ior, (vm_size_t)ior->io_count)
+			== KERN_SUCCESS &&
+		blk_cache_read(ior)) {
+		(void) ds_read_done(ior);
+		io_req_free(ior);
+		return (MIG_NO_REPLY);
+	    }
+	}
+
 	/*
 	 * Do the read.
 	 */
@@ -1058,7 +1195,7 @@ ds_device_read_inband(device, reply_port, reply_port_type, mode, recnum,
 	 * Return result, via ds_read_done.
 	 */
 	ior->io_error = result;
-	(void) ds_read_done(ior);
+	(void) (*ior->io_done)(ior);
 	io_req_free(ior);
 
 	return (MIG_NO_REPLY);	/* reply has already been sent. */
@@ -1081,6 +1218,13 @@ kern_return_t device_read_alloc(ior, size)
 	if (ior->io_count == 0)
 	    return (KERN_SUCCESS);
 
+	/*
+	 * Nor if already allocated (by device_read, for the
+	 * block cache).
+	 */
+	if (ior->io_alloc_size != 0)
+	    return (KERN_SUCCESS);
+
 	if (ior->io_op & IO_INBAND) {
 	    ior->io_data = (io_buf_ptr_t) zalloc(io_inband_zone);
 	    ior->io_alloc_size = sizeof(io_buf_ptr_inband_t);
@@ -1143,9 +1287,12 @@ boolean_t ds_read_done(ior)
 
 	/*
 	 * Send the data to the reply port - this
-	 * unwires and deallocates it.
+	 * unwires and deallocates it.  A completion queue maps
+	 * it into its task instead.
 	 */
-	if (ior->io_op & IO_INBAND) {
+	if (io_cq_port(ior->io_reply_port))
+	    io_cq_done(ior, start_data, size_read);
+	else if (ior->io_op & IO_INBAND) {
 	    (void)ds_device_read_reply_inband(ior->io_reply_port,
 					      ior->io_reply_port_type,
 					      ior->io_error,
@@ -1222,6 +1369,16 @@ ds_device_set_status(device, flavor, status, status_count)
 
 	/* XXX note that a CLOSE may proceed at any point */
 
+	switch (flavor) {
+	    case DEV_CACHE:
+		if (status_count < 1)
+		    return (D_INVALID_OPERATION);
+		return (blk_cache_set_mode(device, status[0]));
+
+	    case DEV_CACHE_SYNC:
+		return (blk_cache_sync(device));
+	}
+
 	return ((*device->dev_ops->d_setstat)(device->dev_number,
 					      flavor,
 					      status,
@@ -1258,6 +1415,9 @@ ds_device_get_status(device, flavor, status, status_count)
 
 	/* XXX note that a CLOSE may proceed at any point */
 
+	if (flavor == DEV_CACHE)
+	    return (blk_cache_get_status(device, status, status_count));
+
 	return ((*device->dev_ops->d_getstat)(device->dev_number,
 					      flavor,
 					      status,
@@ -1383,14 +1543,38 @@ ds_notify(msg)
 }
 #endif
 
-queue_head_t		io_done_list;
-decl_simple_lock_data(,	io_done_list_lock)
+/*
+ * Completed requests are handed to IO_DONE_LISTS io_done threads,
+ * each draining its own list.  All requests for one device go to
+ * the same list, so they still complete in the order iodone saw
+ * them; but a completion that blocks (waiting for memory, or for a
+ * full reply queue) no longer holds up every other device.
+ */
+struct io_done_list {
+	queue_head_t		idl_queue;
+	decl_simple_lock_data(,	idl_lock)
+#if	MACH_DEBUG
+	natural_t		idl_count;	/* requests completed */
+	natural_t		idl_queued;	/* now on the list */
+	natural_t		idl_max_queued;
+	natural_t		idl_histogram[IO_DONE_HISTOGRAM_SIZE];
+#endif	MACH_DEBUG
+} io_done_lists[IO_DONE_LISTS];
+
+/*
+ * Devices come from a zone, so consecutive devices are spread
+ * over consecutive lists.
+ */
+#define	io_done_list_for(ior) \
+	(&io_done_lists[((vm_offset_t) (ior)->io_device / \
+			 sizeof(struct mach_device)) % IO_DONE_LISTS])
 
 #define	splio	splsched	/* XXX must block ALL io devices */
 
 void iodone(ior)
 	register io_req_t	ior;
 {
+	register struct io_done_list	*list;
 	register spl_t	s;
 
 	/*
@@ -1414,27 +1598,80 @@ void iodone(ior)
 	    thread_wakeup((event_t)ior);
 	} else {
 	    ior->io_op |= IO_DONE;
-	    simple_lock(&io_done_list_lock);
-	    enqueue_tail(&io_done_list, (queue_entry_t)ior);
-	    thread_wakeup((event_t)&io_done_list);
-	    simple_unlock(&io_done_list_lock);
+	    list = io_done_list_for(ior);
+	    simple_lock(&list->idl_lock);
+#if	MACH_DEBUG
+	    ior->io_dtime = cycle_count();
+	    if (++list->idl_queued > list->idl_max_queued)
+		list->idl_max_queued = list->idl_queued;
+#endif	MACH_DEBUG
+	    enqueue_tail(&list->idl_queue, (queue_entry_t)ior);
+	    thread_wakeup((event_t)list);
+	    simple_unlock(&list->idl_lock);
 	}
 	splx(s);
 }
 
+#if	MACH_DEBUG
+/*
+ * Account for one completion: the time from iodone to the end
+ * of the completion routine, in cycles, into a log2 histogram.
+ * Called at splio with the list locked.
+ */
+static void
+io_done_stat(list, cycles)
+	register struct io_done_list	*list;
+	unsigned			cycles;
+{
+	register int	bucket;
+
+	for (bucket = 0; (cycles >>= 1) != 0; bucket++)
+		continue;
+
+	list->idl_count++;
+	list->idl_histogram[bucket]++;
+}
+#endif	MACH_DEBUG
+
+/*
+ * Wake the io_done thread of the first list, which also
+ * frees the Linux network driver's transmitted buffers.
+ */
+void io_done_wakeup()
+{
+	thread_wakeup((event_t)&io_done_lists[0]);
+}
+
+/*
+ * The list an io_done thread drains is the argument it was
+ * started with by kernel_thread.
+ */
+#define	io_done_thread_list()	\
+	(&io_done_lists[(int) current_thread()->ith_other])
+
 void io_done_thread_continue()
 {
+	register struct io_done_list	*list = io_done_thread_list();
+
 	for (;;) {
 	    register spl_t	s;
 	    register io_req_t	ior;
+#if	MACH_DEBUG
+	    unsigned		start;
+#endif	MACH_DEBUG
 
 #if defined (i386) && defined (LINUX_DEV)
-	    free_skbuffs ();
+	    if (list == &io_done_lists[0])
+		free_skbuffs ();
 #endif
 	    s = splio();
-	    simple_lock(&io_done_list_lock);
-	    while ((ior = (io_req_t)dequeue_head(&io_done_list)) != 0) {
-		simple_unlock(&io_done_list_lock);
+	    simple_lock(&list->idl_lock);
+	    while ((ior = (io_req_t)dequeue_head(&list->idl_queue)) != 0) {
+#if	MACH_DEBUG
+		list->idl_queued--;
+		start = ior->io_dtime;
+#endif	MACH_DEBUG
+		simple_unlock(&list->idl_lock);
 		(void) splx(s);
 
 		if ((*ior->io_done)(ior)) {
@@ -1446,11 +1683,14 @@ void io_done_thread_continue()
 		/* else routine has re-queued it somewhere */
 
 		s = splio();
-		simple_lock(&io_done_list_lock);
+		simple_lock(&list->idl_lock);
+#if	MACH_DEBUG
+		io_done_stat(list, cycle_count() - start);
+#endif	MACH_DEBUG
 	    }
 
-	    assert_wait(&io_done_list, FALSE);
-	    simple_unlock(&io_done_list_lock);
+	    assert_wait((event_t)list, FALSE);
+	    simple_unlock(&list->idl_lock);
 	    (void) splx(s);
 	    counter(c_io_done_thread_block++);
 	    thread_block(io_done_thread_continue);
@@ -1470,6 +1710,85 @@ void io_done_thread()
 	/*NOTREACHED*/
 }
 
+#if	MACH_DEBUG
+/*
+ *	Routine:	host_io_done_info [kernel call]
+ *	Purpose:
+ *		Return completion counts, list depths and
+ *		completion latency histograms for each
+ *		io_done list.
+ *	Conditions:
+ *		Nothing locked.  Obeys CountInOut protocol.
+ *	Returns:
+ *		KERN_SUCCESS		Returned information.
+ *		KERN_INVALID_HOST	The host is null.
+ *		KERN_RESOURCE_SHORTAGE	Couldn't allocate memory.
+ */
+
+kern_return_t
+host_io_done_info(host, infop, infoCntp)
+	host_t			host;
+	io_done_info_array_t	*infop;
+	natural_t		*infoCntp;
+{
+	io_done_info_t *info;
+	vm_offset_t addr;
+	vm_size_t size = 0; /*'=0' to quiet gcc warnings */
+	struct io_done_list *list;
+	spl_t s;
+	int n, i;
+	kern_return_t kr;
+
+	if (host == HOST_NULL)
+		return KERN_INVALID_HOST;
+
+	if (IO_DONE_LISTS <= *infoCntp) {
+		/* use in-line memory */
+
+		info = *infop;
+	} else {
+		size = round_page(IO_DONE_LISTS * sizeof *info);
+		kr = kmem_alloc_pageable(ipc_kernel_map, &addr, size);
+		if (kr != KERN_SUCCESS)
+			return KERN_RESOURCE_SHORTAGE;
+
+		info = (io_done_info_t *) addr;
+	}
+
+	for (n = 0; n < IO_DONE_LISTS; n++) {
+		list = &io_done_lists[n];
+
+		s = splio();
+		simple_lock(&list->idl_lock);
+		info[n].idi_count = list->idl_count;
+		info[n].idi_queued = list->idl_queued;
+		info[n].idi_max_queued = list->idl_max_queued;
+		for (i = 0; i < IO_DONE_HISTOGRAM_SIZE; i++)
+			info[n].idi_histogram[i] = list->idl_histogram[i];
+		simple_unlock(&list->idl_lock);
+		splx(s);
+	}
+
+	if (info != *infop) {
+		vm_map_copy_t copy;
+		vm_size_t used;
+
+		used = IO_DONE_LISTS * sizeof *info;
+		if (used != size)
+			bzero((char *) (addr + used), size - used);
+
+		kr = vm_map_copyin(ipc_kernel_map, addr, size,
+				   TRUE, &copy);
+		assert(kr == KERN_SUCCESS);
+
+		*infop = (io_done_info_t *) copy;
+	}
+	*infoCntp = IO_DONE_LISTS;
+
+	return KERN_SUCCESS;
+}
+#endif	MACH_DEBUG
+
 #define	DEVICE_IO_MAP_SIZE	(2 * 1024 * 1024)
 
 extern void ds_trap_init(void);		/* forward */
@@ -1477,9 +1796,12 @@ extern void ds_trap_init(void);		/* forward */
 void ds_init()
 {
 	vm_offset_t	device_io_min, device_io_max;
+	int		i;
 
-	queue_init(&io_done_list);
-	simple_lock_init(&io_done_list_lock);
+	for (i = 0; i < IO_DONE_LISTS; i++) {
+	    queue_init(&io_done_lists[i].idl_queue);
+	    simple_lock_init(&io_done_lists[i].idl_lock);
+	}
 
 	device_io_map = kmem_suballoc(kernel_map,
 				      &device_io_min,
@@ -1512,6 +1834,8 @@ void ds_init()
 			    "io inband read buffers");
 
 	ds_trap_init();
+	blk_cache_init();
+	io_cq_init();
 }
 
 void iowait(ior)
@@ -1686,6 +2010,175 @@ ds_device_write_trap(device_t		device,
 	return (result);
 }
 
+/*
+ * Writes shorter than this are copied: pinning the user's
+ * pages costs more than copying a small packet.
+ */
+vm_size_t ds_trap_gather_min = 1024;
+
+#define IOTRAP_IOVEC_MAX	16
+
+#define IOTRAP_SG_MAX \
+	((IOTRAP_REQSIZE - sizeof(struct io_req)) / sizeof(struct io_sg_entry))
+
+/*
+ * Release the page lists for the first count vectors.
+ */
+static void
+ds_trap_discard(vm_map_copy_t *copies, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		vm_map_copy_discard(copies[i]);
+}
+
+/*
+ * Write straight from the user's pages, if the driver can
+ * gather them.  Each vector is copied in as a page list without
+ * stealing the pages, as device_write_get's callers get them:
+ * the pages stay busy in their objects, so they cannot be paged
+ * out or moved, and are handed to the driver as physical
+ * fragments in io_sgp.  The caller waits for the write to
+ * finish before the page lists are discarded.
+ *
+ * Returns FALSE if the data should be copied instead.
+ * Otherwise the write is over and *result is its status.
+ */
+static boolean_t
+ds_trap_writev_gather(mach_device_t	device,
+		      dev_mode_t	mode,
+		      recnum_t		recnum,
+		      io_buf_vec_t	*iovec,
+		      int		iocount,
+		      vm_size_t		data_count,
+		      io_return_t	*result)
+{
+	vm_map_t map = current_map();
+	vm_map_copy_t copies[IOTRAP_IOVEC_MAX];
+	vm_map_copy_t copy;
+	io_req_t ior;
+	struct io_sg_entry *sg;
+	vm_offset_t addr, end, phys;
+	vm_size_t len;
+	int sg_max, nsg, ncopies, i, j;
+
+	if (data_count < ds_trap_gather_min)
+		return FALSE;
+	if ((*device->dev_ops->d_dev_info)(device->dev_number,
+					   D_INFO_SG_MAX,
+					   &sg_max) != D_SUCCESS)
+		return FALSE;
+	if (sg_max > IOTRAP_SG_MAX)
+		sg_max = IOTRAP_SG_MAX;
+
+	/*
+	 * A page busied by one page list would deadlock the
+	 * copyin of the next, so vectors sharing a page are
+	 * copied instead.
+	 */
+	for (i = 0; i < iocount; i++) {
+		if (iovec[i].count == 0)
+			continue;
+		for (j = 0; j < i; j++)
+			if (iovec[j].count != 0 &&
+			    trunc_page(iovec[i].data) <
+			    round_page(iovec[j].data + iovec[j].count) &&
+			    trunc_page(iovec[j].data) <
+			    round_page(iovec[i].data + iovec[i].count))
+				return FALSE;
+	}
+
+	ior = ds_trap_req_alloc(device, 0);
+	sg = (struct io_sg_entry *) ((vm_offset_t)ior + sizeof(struct io_req));
+	nsg = 0;
+
+	/*
+	 * Collect the physical fragments of each vector,
+	 * merging pages that happen to be contiguous.
+	 */
+	for (ncopies = 0; ncopies < iocount; ncopies++) {
+		addr = iovec[ncopies].data;
+		end = addr + iovec[ncopies].count;
+		if (vm_map_copyin_page_list(map, addr, end - addr,
+					    FALSE, FALSE, &copy,
+					    FALSE) != KERN_SUCCESS)
+			goto copy;
+		copies[ncopies] = copy;
+		if (copy == VM_MAP_COPY_NULL)
+			continue;
+
+		/* too big for one page list */
+		if (vm_map_copy_has_cont(copy)) {
+			ncopies++;
+			goto copy;
+		}
+
+		for (; addr < end; addr += len) {
+			len = trunc_page(addr) + PAGE_SIZE - addr;
+			if (len > end - addr)
+				len = end - addr;
+			j = atop(trunc_page(addr) - trunc_page(copy->offset));
+			phys = copy->cpy_page_list[j]->phys_addr +
+				(addr - trunc_page(addr));
+
+			if (nsg > 0 &&
+			    sg[nsg-1].phys_addr + sg[nsg-1].length == phys) {
+				sg[nsg-1].length += len;
+				continue;
+			}
+			if (nsg == sg_max) {
+				ncopies++;
+				goto copy;
+			}
+			sg[nsg].phys_addr = phys;
+			sg[nsg].length = len;
+			nsg++;
+		}
+	}
+
+	simple_lock_init(&ior->io_req_lock);
+	ior->io_device          = device;
+	ior->io_unit            = device->dev_number;
+	ior->io_op              = IO_WRITE | IO_GATHER;
+	ior->io_mode            = mode;
+	ior->io_recnum          = recnum;
+	ior->io_data            = 0;
+	ior->io_sgp             = sg;
+	ior->io_sgcount         = nsg;
+	ior->io_count           = data_count;
+	ior->io_total           = data_count;
+	ior->io_alloc_size      = 0;
+	ior->io_residual        = 0;
+	ior->io_error           = 0;
+	ior->io_done            = 0;
+	ior->io_reply_port      = IP_NULL;
+	ior->io_reply_port_type = 0;
+
+	mach_device_reference(device);
+
+	*result = (*device->dev_ops->d_write)(device->dev_number, ior);
+
+	/*
+	 * Without IO_CALL, iodone wakes us up instead of
+	 * queueing the ior for the io_done thread.
+	 */
+	if (*result == D_IO_QUEUED) {
+		iowait(ior);
+		*result = ior->io_error;
+	}
+
+	mach_device_deallocate(device);
+	ds_trap_discard(copies, ncopies);
+	zfree(io_trap_zone, ior);
+	return TRUE;
+
+    copy:
+	ds_trap_discard(copies, ncopies);
+	zfree(io_trap_zone, ior);
+	return FALSE;
+}
+
 #ifdef i386
 static io_return_t
 device_writev_trap (void *d, dev_mode_t mode,
@@ -1704,7 +2197,7 @@ ds_device_writev_trap(device_t		device,
 #endif
 	io_req_t ior;
 	io_return_t result;
-	io_buf_vec_t	stack_iovec[16]; /* XXX */
+	io_buf_vec_t	stack_iovec[IOTRAP_IOVEC_MAX]; /* XXX */
 	vm_size_t data_count;
 	int i;
 
@@ -1724,7 +2217,7 @@ ds_device_writev_trap(device_t		device,
 	/*
 	 * Copyin user addresses.
 	 */
-	if (iocount > 16)
+	if (iocount > IOTRAP_IOVEC_MAX)
 		return KERN_INVALID_VALUE; /* lame */
 	copyin((char *)iovec,
 	       (char *)stack_iovec,
@@ -1732,6 +2225,10 @@ ds_device_writev_trap(device_t		device,
 	for (data_count = 0, i = 0; i < iocount; i++)
 		data_count += stack_iovec[i].count;
 
+	if (ds_trap_writev_gather(device, mode, recnum, stack_iovec, iocount,
+				  data_count, &result))
+		return (result);
+
 	/*
 	 * Get a buffer to hold the ioreq.
 	 */
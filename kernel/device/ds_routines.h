@@ -33,6 +33,7 @@
 #ifndef	DS_ROUTINES_H
 #define	DS_ROUTINES_H
 
+#include <cpus.h>
 #include <vm/vm_map.h>
 #include <device/device_types.h>
 
@@ -49,4 +50,16 @@ boolean_t	ds_open_done();
 boolean_t	ds_read_done();
 boolean_t	ds_write_done();
 
+/*
+ * Number of io_done threads, each with its own completion list.
+ */
+#if	NCPUS > 1
+#define	IO_DONE_LISTS	(2 * NCPUS)
+#else
+#define	IO_DONE_LISTS	2
+#endif
+
+void		io_done_thread();
+void		io_done_wakeup();
+
 #endif	DS_ROUTINES_H
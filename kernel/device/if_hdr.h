@@ -81,6 +81,10 @@ struct ifnet {
 	queue_head_t if_rcv_port_list;	/* input filter list */
 	decl_simple_lock_data(,
 		if_rcv_port_list_lock)	/* lock for filter list */
+	struct net_guard_node *if_guard_tree;
+					/* leading tests of the filters */
+	unsigned int if_guard_gen;	/* packets run through the tree */
+	struct net_ring *if_ring;	/* mapped packet ring, or 0 */
 /* statistics */
 	int	if_ipackets;		/* packets received */
 	int	if_ierrors;		/* input errors */
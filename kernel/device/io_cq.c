@@ -0,0 +1,534 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	File:	device/io_cq.c
+ *
+ *	Device I/O completion queues.  See device/io_cq.h.
+ */
+
+#include <mach/boolean.h>
+#include <mach/kern_return.h>
+#include <mach/message.h>
+#include <mach/mig_errors.h>
+#include <mach/notify.h>
+#include <mach/vm_prot.h>
+#include <mach/vm_inherit.h>
+#include <mach/vm_param.h>
+#include <kern/assert.h>
+#include <kern/zalloc.h>
+#include <ipc/ipc_port.h>
+#include <ipc/ipc_space.h>
+#include <vm/vm_kern.h>
+#include <vm/vm_map.h>
+
+#include <device/device_types.h>
+#include <device/dev_hdr.h>
+#include <device/conf.h>
+#include <device/io_req.h>
+#include <device/io_cq.h>
+
+/*
+ *	Each queue uses one of the eventcounts in the global table.
+ */
+#define	IO_CQ_MAX		16
+#define	IO_CQ_MAX_ENTRIES	4096
+
+/*
+ *	Queues come from a zone, so their memory stays type-stable:
+ *	evc_wait translates an id to an evc without a lock, and may
+ *	still touch the evc of a queue that is being terminated.
+ */
+zone_t		io_cq_zone;
+
+void
+io_cq_init()
+{
+	io_cq_zone = zinit(sizeof(struct io_cq),
+			   IO_CQ_MAX * sizeof(struct io_cq),
+			   sizeof(struct io_cq), ZONE_EXHAUSTIBLE,
+			   "io completion queues");
+}
+
+void
+io_cq_reference(cq)
+	io_cq_t cq;
+{
+	io_cq_lock(cq);
+	cq->cq_ref_count++;
+	io_cq_unlock(cq);
+}
+
+void
+io_cq_deallocate(cq)
+	io_cq_t cq;
+{
+	int refs;
+
+	if (cq == IO_CQ_NULL)
+		return;
+
+	io_cq_lock(cq);
+	refs = --cq->cq_ref_count;
+	io_cq_unlock(cq);
+
+	if (refs == 0)
+		zfree(io_cq_zone, (vm_offset_t) cq);
+}
+
+/*
+ *	Routine:	convert_port_to_io_cq
+ *	Purpose:
+ *		Convert from a port to a completion queue.
+ *		Doesn't consume the port ref; produces a queue ref,
+ *		which may be null.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+io_cq_t
+convert_port_to_io_cq(port)
+	ipc_port_t port;
+{
+	io_cq_t cq = IO_CQ_NULL;
+
+	if (IP_VALID(port)) {
+		ip_lock(port);
+		if (ip_active(port) &&
+		    (ip_kotype(port) == IKOT_IO_CQ)) {
+			cq = (io_cq_t) port->ip_kobject;
+			io_cq_reference(cq);
+		}
+		ip_unlock(port);
+	}
+
+	return cq;
+}
+
+/*
+ *	Routine:	convert_io_cq_to_port
+ *	Purpose:
+ *		Convert from a completion queue to a port.
+ *		Consumes a queue ref; produces a naked send right
+ *		which may be invalid.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+ipc_port_t
+convert_io_cq_to_port(cq)
+	io_cq_t cq;
+{
+	ipc_port_t port = IP_NULL;
+
+	if (cq == IO_CQ_NULL)
+		return IP_NULL;
+
+	io_cq_lock(cq);
+	if (cq->cq_active)
+		port = ipc_port_make_send(cq->cq_self);
+	io_cq_unlock(cq);
+
+	io_cq_deallocate(cq);
+	return port;
+}
+
+/*
+ *	Routine:	io_cq_create [kernel call]
+ *	Purpose:
+ *		Create a completion queue with room for nentries
+ *		completions, mapped into the given task, and return
+ *		the id of the eventcount it signals.
+ *	Conditions:
+ *		Nothing locked.
+ *	Returns:
+ *		KERN_SUCCESS		The queue was created.
+ *		KERN_INVALID_ARGUMENT	Bad task or size.
+ *		KERN_RESOURCE_SHORTAGE	Out of queues or eventcounts.
+ */
+
+kern_return_t
+io_cq_create(task, nentries, cqp, addressp, eventp)
+	task_t task;
+	natural_t nentries;
+	io_cq_t *cqp;
+	vm_offset_t *addressp;
+	natural_t *eventp;
+{
+	io_cq_t cq;
+	struct io_cq_header *h;
+	ipc_port_t port, notify;
+	kern_return_t kr;
+
+	if (task == TASK_NULL || nentries == 0 ||
+	    nentries > IO_CQ_MAX_ENTRIES)
+		return KERN_INVALID_ARGUMENT;
+
+	cq = (io_cq_t) zalloc(io_cq_zone);
+	if (cq == IO_CQ_NULL)
+		return KERN_RESOURCE_SHORTAGE;
+
+	simple_lock_init(&cq->cq_lock);
+	cq->cq_ref_count = 1;
+	cq->cq_active = FALSE;
+	cq->cq_nentries = nentries;
+	cq->cq_head = 0;
+	cq->cq_size = round_page(sizeof(struct io_cq_header) +
+				 nentries * sizeof(struct io_cq_entry));
+
+	evc_init(&cq->cq_event);
+	if (cq->cq_event.sanity != &cq->cq_event) {
+		kr = KERN_RESOURCE_SHORTAGE;
+		goto fail_evc;
+	}
+
+	kr = projected_buffer_allocate(task->map, cq->cq_size, FALSE,
+				       &cq->cq_kaddr, addressp,
+				       VM_PROT_READ | VM_PROT_WRITE,
+				       VM_INHERIT_NONE);
+	if (kr != KERN_SUCCESS)
+		goto fail_evc;
+
+	/*
+	 *	The kernel fills in the ring until the queue is
+	 *	terminated, whatever the task does with its mapping.
+	 */
+	(void) projected_buffer_hold(cq->cq_kaddr);
+
+	h = (struct io_cq_header *) cq->cq_kaddr;
+	h->cqh_magic = IO_CQ_MAGIC;
+	h->cqh_nentries = nentries;
+
+	port = ipc_port_alloc_kernel();
+	if (port == IP_NULL) {
+		(void) projected_buffer_deallocate(task->map, *addressp,
+						   *addressp + cq->cq_size);
+		projected_buffer_release(cq->cq_kaddr);
+		kr = KERN_RESOURCE_SHORTAGE;
+		goto fail_evc;
+	}
+	cq->cq_self = port;
+	ipc_kobject_set(port, (ipc_kobject_t) cq, IKOT_IO_CQ);
+
+	notify = ipc_port_make_sonce(port);
+	ip_lock(port);
+	ipc_port_nsrequest(port, 1, notify, &notify);
+	assert(notify == IP_NULL);
+
+	task_reference(task);
+	cq->cq_task = task;
+	cq->cq_active = TRUE;
+
+	*eventp = cq->cq_event.ev_id;
+
+	/* one reference for the port, one for the caller */
+	cq->cq_ref_count++;
+	*cqp = cq;
+	return KERN_SUCCESS;
+
+    fail_evc:
+	evc_destroy(&cq->cq_event);
+	zfree(io_cq_zone, (vm_offset_t) cq);
+	return kr;
+}
+
+/*
+ *	Routine:	io_cq_terminate
+ *	Purpose:
+ *		Shut a queue down once nobody can name it.  Requests
+ *		still in progress hold send rights for the queue, so
+ *		none can complete after this.  The ring stays mapped
+ *		in the task until it deallocates it or dies.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+void
+io_cq_terminate(cq)
+	io_cq_t cq;
+{
+	task_t task;
+	ipc_port_t port;
+
+	io_cq_lock(cq);
+	if (!cq->cq_active) {
+		io_cq_unlock(cq);
+		return;
+	}
+	cq->cq_active = FALSE;
+	evc_destroy(&cq->cq_event);
+	task = cq->cq_task;
+	cq->cq_task = TASK_NULL;
+	port = cq->cq_self;
+	cq->cq_self = IP_NULL;
+	io_cq_unlock(cq);
+
+	projected_buffer_release(cq->cq_kaddr);
+	task_deallocate(task);
+
+	ipc_kobject_set(port, IKO_NULL, IKOT_NONE);
+	ipc_port_dealloc_kernel(port);
+
+	/* the port's reference */
+	io_cq_deallocate(cq);
+}
+
+/*
+ *	Routine:	io_cq_notify
+ *	Purpose:
+ *		Handle notifications sent to a queue port.
+ *		The only one requested is no-senders.
+ */
+
+boolean_t
+io_cq_notify(msg)
+	mach_msg_header_t *msg;
+{
+	io_cq_t cq;
+
+	if (msg->msgh_id != MACH_NOTIFY_NO_SENDERS)
+		return FALSE;
+
+	cq = convert_port_to_io_cq((ipc_port_t) msg->msgh_remote_port);
+	if (cq == IO_CQ_NULL)
+		return TRUE;
+
+	io_cq_terminate(cq);
+	io_cq_deallocate(cq);
+	return TRUE;
+}
+
+/*
+ *	Routine:	io_cq_post
+ *	Purpose:
+ *		Fill in the next entry of a queue and signal its
+ *		eventcount.  Read data, if any, is consumed: it is
+ *		mapped into the task, or discarded if the ring is
+ *		full or the queue is dead.
+ *	Conditions:
+ *		Nothing locked.  Called from thread context only;
+ *		mapping the data may block.
+ */
+
+static void
+io_cq_post(cq, op, recnum, result, count, copy)
+	io_cq_t cq;
+	int op;
+	recnum_t recnum;
+	io_return_t result;
+	vm_size_t count;
+	vm_map_copy_t copy;
+{
+	struct io_cq_header *h = (struct io_cq_header *) cq->cq_kaddr;
+	struct io_cq_entry *e;
+	vm_offset_t addr = 0;
+	task_t task;
+
+	io_cq_lock(cq);
+	if (!cq->cq_active) {
+		io_cq_unlock(cq);
+		vm_map_copy_discard(copy);
+		return;
+	}
+	task = cq->cq_task;
+	task_reference(task);
+	io_cq_unlock(cq);
+
+	if (copy != VM_MAP_COPY_NULL &&
+	    vm_map_copyout(task->map, &addr, copy) != KERN_SUCCESS) {
+		vm_map_copy_discard(copy);
+		addr = 0;
+		count = 0;
+		result = D_NO_MEMORY;
+	}
+
+	io_cq_lock(cq);
+	if (!cq->cq_active ||
+	    cq->cq_head - h->cqh_tail >= cq->cq_nentries) {
+		if (cq->cq_active)
+			h->cqh_dropped++;
+		io_cq_unlock(cq);
+		if (addr != 0)
+			(void) vm_deallocate(task->map, trunc_page(addr),
+					     round_page(addr + count) -
+					     trunc_page(addr));
+		task_deallocate(task);
+		return;
+	}
+
+	e = io_cq_entry(h, cq->cq_head % cq->cq_nentries);
+	e->cqe_op = op;
+	e->cqe_recnum = recnum;
+	e->cqe_result = result;
+	e->cqe_count = count;
+	e->cqe_data = addr;
+	h->cqh_head = ++cq->cq_head;
+	evc_signal(&cq->cq_event);
+	io_cq_unlock(cq);
+
+	task_deallocate(task);
+}
+
+/*
+ *	Make a page list copy of read data in kernel_map,
+ *	consuming it, or a copy of it if it is not page-owned
+ *	(inband data, which lives in a zone).
+ */
+
+static vm_map_copy_t
+io_cq_copyin(data, size, inband)
+	vm_offset_t data;
+	vm_size_t size;
+	boolean_t inband;
+{
+	vm_map_copy_t copy;
+	vm_offset_t addr;
+
+	if (inband) {
+		if (kmem_alloc(kernel_map, &addr, round_page(size))
+				!= KERN_SUCCESS)
+			return VM_MAP_COPY_NULL;
+		bcopy((char *) data, (char *) addr, size);
+		data = addr;
+	}
+
+	if (vm_map_copyin_page_list(kernel_map, data, size, TRUE, TRUE,
+				    &copy, FALSE) != KERN_SUCCESS)
+		panic("io_cq_copyin: vm_map_copyin_page_list failed");
+
+	return copy;
+}
+
+/*
+ *	Routine:	io_cq_reply
+ *	Purpose:
+ *		Post a completion to the queue named by reply_port,
+ *		instead of sending it a reply message.  Consumes the
+ *		reply right and the read data.
+ *	Conditions:
+ *		Nothing locked.  io_cq_port(reply_port) was TRUE.
+ */
+
+void
+io_cq_reply(reply_port, reply_port_type, op, recnum, result, count, copy)
+	ipc_port_t reply_port;
+	mach_msg_type_name_t reply_port_type;
+	int op;
+	recnum_t recnum;
+	io_return_t result;
+	vm_size_t count;
+	vm_map_copy_t copy;
+{
+	io_cq_t cq;
+
+	cq = convert_port_to_io_cq(reply_port);
+	if (cq != IO_CQ_NULL) {
+		io_cq_post(cq, op, recnum, result, count, copy);
+		io_cq_deallocate(cq);
+	} else
+		vm_map_copy_discard(copy);
+
+	if (reply_port_type == MACH_MSG_TYPE_PORT_SEND_ONCE)
+		ipc_port_release_sonce(reply_port);
+	else
+		ipc_port_release_send(reply_port);
+}
+
+/*
+ *	Routine:	io_cq_done
+ *	Purpose:
+ *		Post the completion of a read or write request whose
+ *		reply port is a queue.  For a read, data and size give
+ *		the data read, which is consumed as ds_read_done would
+ *		have by sending it.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+void
+io_cq_done(ior, data, size)
+	register io_req_t ior;
+	vm_offset_t data;
+	vm_size_t size;
+{
+	recnum_t recnum = ior->io_recnum;
+	io_return_t result = ior->io_error;
+	vm_map_copy_t copy = VM_MAP_COPY_NULL;
+	int bsize;
+
+	if (ior->io_op & IO_READ) {
+		if (size != 0) {
+			copy = io_cq_copyin(data, size,
+					    (ior->io_op & IO_INBAND) != 0);
+			if (copy == VM_MAP_COPY_NULL) {
+				result = D_NO_MEMORY;
+				size = 0;
+			}
+		}
+		io_cq_reply(ior->io_reply_port, ior->io_reply_port_type,
+			    IO_CQ_READ, recnum, result, size, copy);
+		return;
+	}
+
+	/*
+	 *	device_write_dealloc has moved io_recnum past all
+	 *	but the last piece of a write done in pieces.
+	 */
+	if (ior->io_total != ior->io_count &&
+	    (*ior->io_device->dev_ops->d_dev_info)(ior->io_device->dev_number,
+						   D_INFO_BLOCK_SIZE,
+						   &bsize) == D_SUCCESS &&
+	    bsize > 0)
+		recnum -= (ior->io_total - ior->io_count) / bsize;
+
+	io_cq_reply(ior->io_reply_port, ior->io_reply_port_type,
+		    IO_CQ_WRITE, recnum, result,
+		    ior->io_total - ior->io_residual, VM_MAP_COPY_NULL);
+}
+
+/*
+ *	Routine:	io_cq_error
+ *	Purpose:
+ *		Post the failure of a read or write that was refused
+ *		before it reached the driver, if its reply port is a
+ *		queue.  If so, consumes the reply right and copy (the
+ *		write's data, or null) and returns MIG_NO_REPLY;
+ *		otherwise returns result, to be sent in a reply
+ *		message as usual.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+io_return_t
+io_cq_error(reply_port, reply_port_type, op, recnum, result, copy)
+	ipc_port_t reply_port;
+	mach_msg_type_name_t reply_port_type;
+	int op;
+	recnum_t recnum;
+	io_return_t result;
+	vm_map_copy_t copy;
+{
+	if (!io_cq_port(reply_port))
+		return result;
+
+	vm_map_copy_discard(copy);
+	io_cq_reply(reply_port, reply_port_type, op, recnum, result,
+		    0, VM_MAP_COPY_NULL);
+	return MIG_NO_REPLY;
+}
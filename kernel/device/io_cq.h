@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	File:	device/io_cq.h
+ *
+ *	Device I/O completion queues.
+ *
+ *	A completion queue is a ring of completion entries projected
+ *	into a task (see <device/device_cq.h>), plus an eventcount.
+ *	A read or write whose reply port is a completion queue port
+ *	is answered by filling in an entry, instead of by a reply
+ *	message: ds_read_done, ds_write_done and the synchronous
+ *	paths of device_write call io_cq_done, and requests refused
+ *	before they reach the driver are posted by io_cq_error.  The
+ *	kernel accepts no messages at a queue port other than
+ *	notifications.
+ */
+
+#ifndef	_DEVICE_IO_CQ_H_
+#define	_DEVICE_IO_CQ_H_
+
+#include <mach/port.h>
+#include <mach/message.h>
+#include <kern/lock.h>
+#include <kern/task.h>
+#include <kern/eventcount.h>
+#include <kern/ipc_kobject.h>
+#include <ipc/ipc_port.h>
+#include <vm/vm_map.h>
+#include <device/device_cq.h>
+#include <device/io_req.h>
+
+typedef struct io_cq {
+	decl_simple_lock_data(,	cq_lock)
+	int		cq_ref_count;
+	boolean_t	cq_active;	/* not yet terminated */
+	struct ipc_port	*cq_self;	/* kernel port naming the queue */
+	task_t		cq_task;	/* referenced; where the ring is */
+	vm_offset_t	cq_kaddr;	/* kernel address of the ring */
+	vm_size_t	cq_size;
+	natural_t	cq_nentries;
+	natural_t	cq_head;	/* cqh_head, out of the task's reach */
+	struct evc	cq_event;	/* signalled on each completion */
+} *io_cq_t;
+
+#define	IO_CQ_NULL	((io_cq_t) 0)
+
+#define	io_cq_lock(cq)		simple_lock(&(cq)->cq_lock)
+#define	io_cq_unlock(cq)	simple_unlock(&(cq)->cq_lock)
+
+/*
+ * Does the port name a completion queue?  The answer may be
+ * stale; io_cq_done and io_cq_reply cope with dead queues.
+ */
+#define	io_cq_port(port)	\
+		(IP_VALID(port) && ip_kotype(port) == IKOT_IO_CQ)
+
+extern void		io_cq_init();
+extern io_cq_t		convert_port_to_io_cq(/* ipc_port_t */);
+extern ipc_port_t	convert_io_cq_to_port(/* io_cq_t */);
+extern void		io_cq_deallocate(/* io_cq_t */);
+extern boolean_t	io_cq_notify(/* mach_msg_header_t * */);
+extern io_return_t	io_cq_error(/* ipc_port_t, mach_msg_type_name_t,
+				       int, recnum_t, io_return_t,
+				       vm_map_copy_t */);
+extern void		io_cq_reply(/* ipc_port_t, mach_msg_type_name_t,
+				       int, recnum_t, io_return_t,
+				       vm_size_t, vm_map_copy_t */);
+extern void		io_cq_done(/* io_req_t, vm_offset_t, vm_size_t */);
+
+#endif	/* _DEVICE_IO_CQ_H_ */
@@ -43,6 +43,14 @@
 
 #include <kern/macro_help.h>
 
+/*
+ * Physical fragment of a gathered write.
+ */
+struct io_sg_entry {
+	vm_offset_t	phys_addr;
+	vm_size_t	length;
+};
+
 /*
  * IO request element, queued on device for delayed replies.
  */
@@ -83,6 +91,15 @@ struct io_req {
 	long            io_physrec;    /* mapping to the physical block
 					   number */
 	long            io_rectotal;   /* total number of blocks to move */
+	struct io_sg_entry *io_sgp;	/* data fragments, if IO_GATHER */
+	int		io_sgcount;	/* number of fragments */
+	struct task	*io_task;	/* requesting task, set by block_io;
+					   not referenced */
+	struct io_req *	io_merge;	/* io_sched: requests merged
+					   behind this one */
+	unsigned long	io_qtime;	/* io_sched: when queued, in ticks */
+	unsigned	io_dtime;	/* iodone: when done, in cycles
+					   (MACH_DEBUG only) */
 };
 typedef struct io_req *	io_req_t;
 
@@ -106,6 +123,7 @@ typedef struct io_req *	io_req_t;
 #define	IO_WRITE	0x00000000	/* operation is write */
 #define	IO_READ		0x00000001	/* operation is read */
 #define	IO_OPEN		0x00000002	/* operation is open */
+#define	IO_GATHER	0x00000004	/* data is in io_sgp, not io_data */
 #define	IO_DONE		0x00000100	/* operation complete */
 #define	IO_ERROR	0x00000200	/* error on operation */
 #define	IO_BUSY		0x00000400	/* operation in progress */
@@ -0,0 +1,492 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	File:	device/io_sched.c
+ *
+ *	Block I/O scheduling policies.  See device/io_sched.h.
+ */
+
+#include <mach/boolean.h>
+#include <machine/machspl.h>
+#include <sys/ioctl.h>
+
+#include <kern/time_out.h>
+
+#include <device/device_types.h>
+#include <device/io_req.h>
+#include <device/io_sched.h>
+
+/*
+ * Tunables.
+ */
+int		io_sched_default = IO_SCHED_DEADLINE;
+int		io_sched_read_expire = 500;	/* ms a read may wait */
+int		io_sched_write_expire = 5000;	/* ms a write may wait */
+int		io_sched_quantum = 4;		/* requests per turn, fair */
+vm_size_t	io_sched_merge_max = 128 * 1024;
+						/* largest merged cluster,
+						   unless the driver says */
+
+#define	io_sched_ticks(ms)	((ms) * hz / 1000)
+
+#define	io_sched_blocks(q, ior)	\
+	(((ior)->io_count + (q)->is_bsize - 1) / (q)->is_bsize)
+
+/*
+ * Driver-private flags.  Requests that carry any are never
+ * merged, since the driver may treat them specially.
+ */
+#define	IO_PRIVATE	(~(IO_SPARE_START - 1))
+
+static void
+io_sched_enqueue(f, ior)
+	register struct io_sched_flow *f;
+	register io_req_t	ior;
+{
+	ior->io_link = 0;
+	ior->io_rlink = f->sf_tail;
+	if (f->sf_tail)
+	    f->sf_tail->io_link = ior;
+	else
+	    f->sf_head = ior;
+	f->sf_tail = ior;
+	f->sf_count++;
+}
+
+static void
+io_sched_remove(f, ior)
+	register struct io_sched_flow *f;
+	register io_req_t	ior;
+{
+	if (ior->io_rlink)
+	    ior->io_rlink->io_link = ior->io_link;
+	else
+	    f->sf_head = ior->io_link;
+	if (ior->io_link)
+	    ior->io_link->io_rlink = ior->io_rlink;
+	else
+	    f->sf_tail = ior->io_rlink;
+	f->sf_count--;
+}
+
+/*
+ * One-way sweep over flows [first, first + n): the lowest
+ * request at or beyond the last one dispatched, or failing
+ * that the lowest request of all.
+ */
+static io_req_t
+io_sched_sweep(q, first, n, fp)
+	io_sched_t		q;
+	int			first, n;
+	struct io_sched_flow	**fp;
+{
+	register io_req_t	ior, ahead = 0, low = 0;
+	register struct io_sched_flow *f;
+	struct io_sched_flow	*ahead_f, *low_f;
+
+	for (f = &q->is_flows[first]; f < &q->is_flows[first + n]; f++) {
+	    for (ior = f->sf_head; ior != 0; ior = ior->io_link) {
+		if (ior->io_physrec >= q->is_pos) {
+		    if (ahead == 0 || ior->io_physrec < ahead->io_physrec) {
+			ahead = ior;
+			ahead_f = f;
+		    }
+		}
+		else if (low == 0 || ior->io_physrec < low->io_physrec) {
+		    low = ior;
+		    low_f = f;
+		}
+	    }
+	}
+	if (ahead != 0) {
+	    *fp = ahead_f;
+	    return (ahead);
+	}
+	*fp = low_f;
+	return (low);
+}
+
+/*
+ * Elevator: one queue, swept in one direction.  Unlike the
+ * two-way sweep of disksort, a request just behind the head
+ * waits at most one sweep.
+ */
+static struct io_sched_flow *
+elevator_flow(q, ior)
+	io_sched_t	q;
+	io_req_t	ior;
+{
+	return (&q->is_flows[0]);
+}
+
+static io_req_t
+elevator_next(q, fp)
+	io_sched_t		q;
+	struct io_sched_flow	**fp;
+{
+	return (io_sched_sweep(q, 0, 1, fp));
+}
+
+/*
+ * Deadline: sweep over reads and writes together, but once
+ * the oldest read or write has waited past its deadline,
+ * serve it next and carry on sweeping from there.  Reads get
+ * the shorter deadline, since someone is usually waiting.
+ */
+static struct io_sched_flow *
+deadline_flow(q, ior)
+	io_sched_t	q;
+	io_req_t	ior;
+{
+	return (&q->is_flows[(ior->io_op & IO_READ) ? 0 : 1]);
+}
+
+static io_req_t
+deadline_next(q, fp)
+	io_sched_t		q;
+	struct io_sched_flow	**fp;
+{
+	register io_req_t	ior;
+
+	ior = q->is_flows[0].sf_head;
+	if (ior != 0 &&
+	    elapsed_ticks - ior->io_qtime >=
+			io_sched_ticks(io_sched_read_expire)) {
+	    q->is_stats.expired++;
+	    *fp = &q->is_flows[0];
+	    return (ior);
+	}
+	ior = q->is_flows[1].sf_head;
+	if (ior != 0 &&
+	    elapsed_ticks - ior->io_qtime >=
+			io_sched_ticks(io_sched_write_expire)) {
+	    q->is_stats.expired++;
+	    *fp = &q->is_flows[1];
+	    return (ior);
+	}
+	return (io_sched_sweep(q, 0, 2, fp));
+}
+
+/*
+ * Fair queueing: one flow per requesting task, served round
+ * robin io_sched_quantum requests at a time, each flow swept
+ * on its own.  Once there are more tasks than flows, the
+ * extra tasks share flows.
+ */
+static struct io_sched_flow *
+fair_flow(q, ior)
+	io_sched_t	q;
+	io_req_t	ior;
+{
+	register struct io_sched_flow *f, *free = 0;
+
+	for (f = q->is_flows; f < &q->is_flows[IO_SCHED_FLOWS]; f++) {
+	    if (f->sf_count == 0) {
+		if (free == 0)
+		    free = f;
+	    }
+	    else if (f->sf_task == ior->io_task)
+		return (f);
+	}
+	if (free != 0) {
+	    free->sf_task = ior->io_task;
+	    return (free);
+	}
+	return (&q->is_flows[((vm_offset_t) ior->io_task >> 4) %
+			     IO_SCHED_FLOWS]);
+}
+
+static io_req_t
+fair_next(q, fp)
+	io_sched_t		q;
+	struct io_sched_flow	**fp;
+{
+	register struct io_sched_flow *f;
+	register int		i;
+
+	f = &q->is_flows[q->is_turn];
+	if (f->sf_count == 0 || q->is_quantum <= 0) {
+	    for (i = 1; i <= IO_SCHED_FLOWS; i++) {
+		f = &q->is_flows[(q->is_turn + i) % IO_SCHED_FLOWS];
+		if (f->sf_count > 0)
+		    break;
+	    }
+	    q->is_turn = f - q->is_flows;
+	    q->is_quantum = io_sched_quantum;
+	}
+	q->is_quantum--;
+	return (io_sched_sweep(q, q->is_turn, 1, fp));
+}
+
+struct io_sched_policy io_sched_policies[IO_SCHED_NPOLICIES] = {
+	{ "elevator",	elevator_flow,	elevator_next },
+	{ "deadline",	deadline_flow,	deadline_next },
+	{ "fair",	fair_flow,	fair_next },
+};
+
+/*
+ * Try to merge ior behind a queued request that ends where
+ * ior starts.
+ */
+static boolean_t
+io_sched_merge(q, ior)
+	register io_sched_t	q;
+	register io_req_t	ior;
+{
+	register struct io_sched_flow *f;
+	register io_req_t	lead, last;
+	vm_size_t		size;
+
+	if (ior->io_op & IO_PRIVATE)
+	    return (FALSE);
+
+	for (f = q->is_flows; f < &q->is_flows[IO_SCHED_FLOWS]; f++) {
+	    for (lead = f->sf_head; lead != 0; lead = lead->io_link) {
+		if ((lead->io_op ^ ior->io_op) & (IO_READ | IO_PRIVATE))
+		    continue;
+		size = 0;
+		for (last = lead; ; last = last->io_merge) {
+		    size += last->io_count;
+		    if (last->io_merge == 0)
+			break;
+		}
+		if (last->io_count % q->is_bsize != 0 ||
+		    last->io_physrec + last->io_count / q->is_bsize !=
+				ior->io_physrec ||
+		    size + ior->io_count > q->is_merge_max)
+		    continue;
+
+		last->io_merge = ior;
+		ior->io_merge = 0;
+		return (TRUE);
+	    }
+	}
+	return (FALSE);
+}
+
+/*
+ * Switch policies, refiling queued requests in the order
+ * they arrived.  Merged clusters stay together.
+ */
+static void
+io_sched_set_policy(q, policy)
+	register io_sched_t	q;
+	int			policy;
+{
+	register struct io_sched_flow *f, *oldest_f;
+	register io_req_t	ior, oldest;
+	io_req_t		list = 0, tail = 0;
+
+	for (;;) {
+	    oldest = 0;
+	    for (f = q->is_flows; f < &q->is_flows[IO_SCHED_FLOWS]; f++) {
+		ior = f->sf_head;
+		if (ior != 0 &&
+		    (oldest == 0 || ior->io_qtime < oldest->io_qtime)) {
+		    oldest = ior;
+		    oldest_f = f;
+		}
+	    }
+	    if (oldest == 0)
+		break;
+	    io_sched_remove(oldest_f, oldest);
+	    oldest->io_link = 0;
+	    if (tail)
+		tail->io_link = oldest;
+	    else
+		list = oldest;
+	    tail = oldest;
+	}
+
+	q->is_policy = &io_sched_policies[policy];
+	q->is_stats.policy = policy;
+	q->is_turn = 0;
+	q->is_quantum = 0;
+
+	while ((ior = list) != 0) {
+	    list = ior->io_link;
+	    io_sched_enqueue((*q->is_policy->sp_flow)(q, ior), ior);
+	}
+}
+
+/*
+ * Routine:	io_sched_init
+ * Purpose:
+ *	Set up an empty scheduler for a drive whose blocks
+ *	(io_physrec units) are bsize bytes.
+ */
+void
+io_sched_init(q, bsize)
+	register io_sched_t	q;
+	int			bsize;
+{
+	bzero((char *) q, sizeof(struct io_sched));
+	q->is_bsize = bsize;
+	q->is_merge_max = io_sched_merge_max;
+	q->is_policy = &io_sched_policies[io_sched_default];
+	q->is_stats.policy = io_sched_default;
+}
+
+/*
+ * Routine:	io_sched_chain
+ * Purpose:
+ *	Declare that the driver runs a cluster of merged
+ *	requests as one transfer of at most max bytes.
+ */
+void
+io_sched_chain(q, max)
+	register io_sched_t	q;
+	vm_size_t		max;
+{
+	q->is_chain = TRUE;
+	q->is_merge_max = max;
+}
+
+/*
+ * Routine:	io_sched_add
+ * Purpose:
+ *	Queue a request.  io_physrec must be set.
+ * Conditions:
+ *	Called at splbio (or with the driver's interlock).
+ */
+void
+io_sched_add(q, ior)
+	register io_sched_t	q;
+	register io_req_t	ior;
+{
+	ior->io_qtime = elapsed_ticks;
+	q->is_stats.added++;
+	q->is_stats.queued++;
+
+	if (io_sched_merge(q, ior)) {
+	    q->is_stats.merged++;
+	    return;
+	}
+	ior->io_merge = 0;
+	io_sched_enqueue((*q->is_policy->sp_flow)(q, ior), ior);
+}
+
+/*
+ * Routine:	io_sched_next
+ * Purpose:
+ *	Remove and return the request to send to the drive
+ *	next, or 0 if there is none.  Requests merged behind
+ *	the last one returned come first, unless the driver
+ *	takes whole clusters, in which case they come linked
+ *	behind it through io_merge.  io_next is cleared, so
+ *	the request can be linked into the driver's own queue
+ *	as a list of one.
+ * Conditions:
+ *	Called at splbio (or with the driver's interlock).
+ */
+io_req_t
+io_sched_next(q)
+	register io_sched_t	q;
+{
+	register io_req_t	ior, last;
+	struct io_sched_flow	*f;
+
+	if ((ior = q->is_follow) == 0) {
+	    if (q->is_stats.queued == 0)
+		return (0);
+	    ior = (*q->is_policy->sp_next)(q, &f);
+	    io_sched_remove(f, ior);
+	    if (ior->io_merge == 0)
+		q->is_stats.unmerged++;
+	}
+
+	if (q->is_chain) {
+	    for (last = ior; ; last = last->io_merge) {
+		last->io_next = 0;
+		q->is_stats.queued--;
+		q->is_stats.dispatched++;
+		if (last->io_merge == 0)
+		    break;
+	    }
+	}
+	else {
+	    q->is_follow = ior->io_merge;
+	    ior->io_merge = 0;
+	    ior->io_next = 0;
+	    q->is_stats.queued--;
+	    q->is_stats.dispatched++;
+	    last = ior;
+	}
+
+	q->is_pos = last->io_physrec + io_sched_blocks(q, last);
+	return (ior);
+}
+
+/*
+ * Routine:	io_sched_setstat
+ * Purpose:
+ *	Handle the scheduler's device_set_status flavors for
+ *	a driver.  Returns D_INVALID_OPERATION for others.
+ */
+io_return_t
+io_sched_setstat(q, flavor, data, count)
+	io_sched_t		q;
+	dev_flavor_t		flavor;
+	dev_status_t		data;
+	mach_msg_type_number_t	count;
+{
+	spl_t	s;
+
+	switch (flavor) {
+	    case DIOCSSCHED:
+		if (count < 1)
+		    return (D_INVALID_SIZE);
+		if (data[0] < 0 || data[0] >= IO_SCHED_NPOLICIES)
+		    return (D_INVALID_OPERATION);
+		s = splbio();
+		io_sched_set_policy(q, data[0]);
+		splx(s);
+		return (D_SUCCESS);
+
+	    default:
+		return (D_INVALID_OPERATION);
+	}
+}
+
+/*
+ * Routine:	io_sched_getstat
+ * Purpose:
+ *	Handle the scheduler's device_get_status flavors for
+ *	a driver.  Returns D_INVALID_OPERATION for others.
+ */
+io_return_t
+io_sched_getstat(q, flavor, data, count)
+	io_sched_t		q;
+	dev_flavor_t		flavor;
+	dev_status_t		data;
+	mach_msg_type_number_t	*count;
+{
+	switch (flavor) {
+	    case DIOCGSCHED:
+		if (*count < sizeof(struct io_sched_stats) / sizeof(int))
+		    return (D_INVALID_SIZE);
+		*(struct io_sched_stats *) data = q->is_stats;
+		*count = sizeof(struct io_sched_stats) / sizeof(int);
+		return (D_SUCCESS);
+
+	    default:
+		return (D_INVALID_OPERATION);
+	}
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	File:	device/io_sched.h
+ *
+ *	Block I/O scheduling.
+ *
+ *	A disk driver keeps one io_sched per drive.  Its strategy
+ *	routine hands requests to io_sched_add instead of sorting
+ *	them into the drive queue with disksort, and its start
+ *	routine asks io_sched_next for the next request to send to
+ *	the drive.  Which request that is depends on the policy,
+ *	which can be changed at any time with DIOCSSCHED.
+ *
+ *	The driver sets io_physrec to the absolute block number of
+ *	a request before adding it.  A request that starts where a
+ *	queued one of the same kind ends is merged behind it; the
+ *	two are then dispatched back to back, whatever the policy.
+ *	A driver that can run such a cluster as one transfer calls
+ *	io_sched_chain; io_sched_next then returns the whole cluster
+ *	at once, linked through io_merge, and the driver completes
+ *	each request in it separately as its data arrives.
+ *
+ *	While a request is queued the scheduler owns its io_link,
+ *	io_rlink and io_merge fields.  Callers provide their own
+ *	interlock, normally splbio, just as for disksort.
+ */
+
+#ifndef	_DEVICE_IO_SCHED_H_
+#define	_DEVICE_IO_SCHED_H_
+
+#include <mach/boolean.h>
+#include <device/io_req.h>
+#include <device/disk_status.h>
+
+#define	IO_SCHED_FLOWS	8
+
+/*
+ * Queued requests in arrival order.  The elevator uses only
+ * the first flow, deadline one for reads and one for writes,
+ * and fair queueing one per task.
+ */
+struct io_sched_flow {
+	io_req_t	sf_head;	/* linked through io_link/io_rlink */
+	io_req_t	sf_tail;
+	int		sf_count;
+	struct task	*sf_task;	/* fair: owner; not referenced */
+};
+
+typedef struct io_sched	*io_sched_t;
+
+struct io_sched_policy {
+	char		*sp_name;
+	/* flow for a new request */
+	struct io_sched_flow *(*sp_flow)(io_sched_t, io_req_t);
+	/* request to dispatch next, and its flow */
+	io_req_t	(*sp_next)(io_sched_t, struct io_sched_flow **);
+};
+
+struct io_sched {
+	struct io_sched_policy	*is_policy;
+	int			is_bsize;	/* bytes per io_physrec */
+	long			is_pos;		/* block after the last
+						   request dispatched */
+	io_req_t		is_follow;	/* rest of the cluster being
+						   dispatched */
+	boolean_t		is_chain;	/* driver takes whole clusters */
+	vm_size_t		is_merge_max;	/* largest cluster, bytes */
+	int			is_turn;	/* fair: flow being served */
+	int			is_quantum;	/* fair: requests left in turn */
+	struct io_sched_flow	is_flows[IO_SCHED_FLOWS];
+	struct io_sched_stats	is_stats;
+};
+
+extern void		io_sched_init(/* io_sched_t, int bsize */);
+extern void		io_sched_chain(/* io_sched_t, vm_size_t max */);
+extern void		io_sched_add(/* io_sched_t, io_req_t */);
+extern io_req_t		io_sched_next(/* io_sched_t */);
+extern io_return_t	io_sched_setstat(/* io_sched_t, flavor, data, count */);
+extern io_return_t	io_sched_getstat(/* io_sched_t, flavor, data, count */);
+
+#define	io_sched_empty(q)	((q)->is_stats.queued == 0)
+
+#endif	/* _DEVICE_IO_SCHED_H_ */
@@ -45,6 +45,7 @@
 #include <device/net_status.h>
 #include <machine/machspl.h>		/* spl definitions */
 #include <device/net_io.h>
+#include <device/net_ring.h>
 #include <device/if_hdr.h>
 #include <device/io_req.h>
 #include <device/ds_routines.h>
@@ -66,6 +67,10 @@
 #include <norma/ipc_ether.h>
 #endif	/*NORMA_ETHER*/
 
+#ifdef	i386
+#include <i386/bpf_jit.h>
+#endif
+
 #include <machine/machspl.h>
 
 #if	MACH_TTD
@@ -287,6 +292,52 @@ net_kmsg_more(void)
  * should go to that port.
  */
 
+/*
+ * Filter decision tree.
+ *
+ * Most filters start with the same few equality tests on
+ * fixed packet fields (ethertype, IP protocol, port).  The
+ * leading tests of each filter that reject the packet when
+ * they fail are merged into a per-interface tree, one node
+ * per test, so that filters with a common prefix share
+ * nodes.  net_filter walks the tree once per packet, marking
+ * the nodes whose tests pass, and then runs only the filters
+ * whose last test was marked.  The full filter still runs,
+ * so the tree can only save work, never change the result.
+ */
+#define	NET_GUARD_MAX		8	/* tests taken from one filter */
+
+#define	NET_GUARD_BPF_W		0	/* BPF absolute load, 32 bits */
+#define	NET_GUARD_BPF_H		1	/* BPF absolute load, 16 bits */
+#define	NET_GUARD_BPF_B		2	/* BPF absolute load, 8 bits */
+#define	NET_GUARD_CSPF_DATA	3	/* CSPF data word */
+#define	NET_GUARD_CSPF_HDR	4	/* CSPF header word */
+
+struct net_guard {
+	int		type;		/* field to load */
+	int		offset;		/* where, as the filter says */
+	unsigned int	value;		/* what it must equal */
+};
+
+struct net_guard_node {
+	struct net_guard_node	*ng_next;	/* next test at this level */
+	struct net_guard_node	*ng_child;	/* tests that follow this one */
+	struct net_guard_node	*ng_parent;
+	struct net_guard	ng_test;
+	unsigned int		ng_mark;	/* if_guard_gen when passed */
+	int			ng_refs;	/* filters using this test */
+};
+typedef struct net_guard_node *net_guard_node_t;
+
+zone_t		net_guard_zone;		/* zone of net_guard_node structs */
+
+/*
+ * Released nodes are kept here rather than freed, since they
+ * are released with the interface filter list locked.
+ */
+net_guard_node_t	net_guard_free_list;
+decl_simple_lock_data(,net_guard_lock)
+
 /*
  * Receive port for net, with packet filter.
  * This data structure by itself represents a packet
@@ -298,7 +349,12 @@ struct net_rcv_port {
 	int		rcv_qlimit;	/* port's qlimit */
 	int		rcv_count;	/* number of packets received */
 	int		priority;	/* priority for filter */
+	boolean_t	rcv_batch;	/* pack packets (NET_RCV_BATCH) */
 	filter_t	*filter_end;	/* pointer to end of filter */
+#ifdef	MACHINE_BPF_JIT
+	bpf_jit_t	filter_code;	/* compiled BPF filter, or null */
+#endif
+	net_guard_node_t guard_node;	/* last leading test, or null */
 	filter_t	filter[NET_MAX_FILTER];
 					/* filter operations */
 };
@@ -322,6 +378,7 @@ struct net_hash_entry {
 #define he_prev chain.prev
 	ipc_port_t      rcv_port;	/* destination port */
 	int             rcv_qlimit;	/* qlimit for the port */
+	boolean_t	rcv_batch;	/* pack packets (NET_RCV_BATCH) */
 	unsigned int	keys[N_NET_HASH_KEYS];
 };
 typedef struct net_hash_entry *net_hash_entry_t;
@@ -369,6 +426,300 @@ decl_simple_lock_data(,net_hash_header_lock)
 extern boolean_t net_do_filter();	/* CSPF */
 extern int bpf_do_filter();		/* BPF */
 
+/*
+ * net_guard_extract:
+ *
+ * Find the leading tests of a filter that reject the packet
+ * when they fail.  For BPF these are absolute loads followed
+ * by a JEQ whose false branch is "ret #0"; for CSPF, a pushed
+ * word compared with a literal by CAND.  Returns the number
+ * of tests stored in guards.
+ */
+int
+net_guard_extract(filter, filter_count, guards)
+	filter_t		*filter;
+	unsigned int		filter_count;
+	struct net_guard	*guards;
+{
+	register int		n = 0;
+
+	if (filter_count > 0 && filter[0] == NETF_BPF) {
+	    register bpf_insn_t	f = (bpf_insn_t) filter;
+	    register int	i, len, t;
+
+	    len = BPF_BYTES2LEN(CSPF_BYTES(filter_count));
+	    for (i = 1; n < NET_GUARD_MAX && i + 1 < len; i += 2) {
+		if (f[i+1].code != (BPF_JMP|BPF_JEQ|BPF_K) ||
+		    f[i+1].jt != 0 || f[i+1].jf == 0)
+		    break;
+		t = i + 2 + f[i+1].jf;
+		if (t >= len ||
+		    f[t].code != (BPF_RET|BPF_K) || f[t].k != 0)
+		    break;
+
+		switch (f[i].code) {
+		    case BPF_LD|BPF_W|BPF_ABS:
+			guards[n].type = NET_GUARD_BPF_W;
+			break;
+		    case BPF_LD|BPF_H|BPF_ABS:
+			guards[n].type = NET_GUARD_BPF_H;
+			break;
+		    case BPF_LD|BPF_B|BPF_ABS:
+			guards[n].type = NET_GUARD_BPF_B;
+			break;
+		    default:
+			return n;
+		}
+		guards[n].offset = f[i].k;
+		guards[n].value = f[i+1].k;
+		n++;
+	    }
+	} else {
+	    register unsigned int	i, arg;
+
+	    for (i = 0; n < NET_GUARD_MAX && i + 2 < filter_count; i += 3) {
+		if (NETF_OP(filter[i]) != NETF_OP(NETF_NOP) ||
+		    filter[i+1] != (NETF_CAND|NETF_PUSHLIT))
+		    break;
+
+		arg = NETF_ARG(filter[i]);
+		if (arg >= NETF_PUSHSTK)
+		    break;
+		else if (arg >= NETF_PUSHHDR) {
+		    guards[n].type = NET_GUARD_CSPF_HDR;
+		    guards[n].offset = arg - NETF_PUSHHDR;
+		} else if (arg >= NETF_PUSHWORD) {
+		    guards[n].type = NET_GUARD_CSPF_DATA;
+		    guards[n].offset = arg - NETF_PUSHWORD;
+		} else
+		    break;
+		guards[n].value = filter[i+2];
+		n++;
+	    }
+	}
+	return n;
+}
+
+/*
+ * net_guard_load:
+ *
+ * Load the field a test looks at, exactly as the filter
+ * would.  Returns FALSE where the filter would reject the
+ * packet.
+ */
+boolean_t
+net_guard_load(test, p, count, header, valuep)
+	register struct net_guard *test;
+	char		*p;
+	unsigned int	count;
+	char		*header;
+	unsigned int	*valuep;
+{
+	register int	k = test->offset;
+	register unsigned int size;
+
+	switch (test->type) {
+	    case NET_GUARD_CSPF_DATA:
+		if (k >= count / sizeof(unsigned short))
+		    return FALSE;
+		*valuep = ((unsigned short *) p)[k];
+		return TRUE;
+
+	    case NET_GUARD_CSPF_HDR:
+		*valuep = ((unsigned short *) header)[k];
+		return TRUE;
+	}
+
+	/* same bounds as bpf_do_filter */
+	size = (test->type == NET_GUARD_BPF_W) ? sizeof(long) :
+	       (test->type == NET_GUARD_BPF_H) ? sizeof(short) : 1;
+	if ((u_int)k + size > NET_RCV_MAX) {
+	    k -= BPF_DLBASE;
+	    if ((u_int)k + size > NET_HDW_HDR_MAX)
+		return FALSE;
+	    p = header;
+	}
+
+	switch (test->type) {
+	    case NET_GUARD_BPF_W:
+		*valuep = ntohl(*(long *)(p + k));
+		break;
+	    case NET_GUARD_BPF_H:
+		*valuep = (u_short)ntohs(*(u_short *)(p + k));
+		break;
+	    case NET_GUARD_BPF_B:
+		*valuep = p[k];		/* signed, as in bpf_do_filter */
+		break;
+	}
+	return TRUE;
+}
+
+/*
+ * net_guard_walk:
+ *
+ * Mark every node under (and including) the list at node
+ * whose test, and all the tests above it, pass.  Nodes
+ * testing the same field are kept together, so each field
+ * is loaded once per level.
+ */
+void
+net_guard_walk(node, gen, p, count, header)
+	register net_guard_node_t node;
+	unsigned int	gen;
+	char		*p;
+	unsigned int	count;
+	char		*header;
+{
+	register struct net_guard *last = 0;
+	unsigned int	value;
+	boolean_t	loaded;
+
+	for (; node != 0; node = node->ng_next) {
+	    if (last == 0 ||
+		last->type != node->ng_test.type ||
+		last->offset != node->ng_test.offset) {
+		last = &node->ng_test;
+		loaded = net_guard_load(last, p, count, header, &value);
+	    }
+	    if (loaded && value == node->ng_test.value) {
+		node->ng_mark = gen;
+		if (node->ng_child != 0)
+		    net_guard_walk(node->ng_child, gen, p, count, header);
+	    }
+	}
+}
+
+/*
+ * net_guard_reserve:
+ *
+ * Set aside nodes for net_guard_insert, which cannot
+ * allocate them because it runs with the filter list locked.
+ * No locks should be held when called.
+ */
+void
+net_guard_reserve(nodes, n)
+	net_guard_node_t	*nodes;
+	int			n;
+{
+	register int		i;
+
+	for (i = 0; i < n; i++) {
+	    simple_lock(&net_guard_lock);
+	    nodes[i] = net_guard_free_list;
+	    if (nodes[i] != 0)
+		net_guard_free_list = nodes[i]->ng_next;
+	    simple_unlock(&net_guard_lock);
+
+	    if (nodes[i] == 0)
+		nodes[i] = (net_guard_node_t) zalloc(net_guard_zone);
+	}
+}
+
+/*
+ * net_guard_unreserve:
+ *
+ * Put back the nodes that net_guard_insert did not use.
+ */
+void
+net_guard_unreserve(nodes, n)
+	net_guard_node_t	*nodes;
+	int			n;
+{
+	register int		i;
+
+	simple_lock(&net_guard_lock);
+	for (i = 0; i < n; i++) {
+	    nodes[i]->ng_next = net_guard_free_list;
+	    net_guard_free_list = nodes[i];
+	}
+	simple_unlock(&net_guard_lock);
+}
+
+/*
+ * net_guard_insert:
+ *
+ * Add the path for a filter's tests to the interface's tree,
+ * sharing nodes with filters that have the same prefix.
+ * New nodes come from the reserved array; *usedp is set to
+ * the number taken.  Returns the node for the last test.
+ * The filter list must be locked.
+ */
+net_guard_node_t
+net_guard_insert(ifp, guards, n, nodes, usedp)
+	struct ifnet		*ifp;
+	struct net_guard	*guards;
+	int			n;
+	net_guard_node_t	*nodes;
+	int			*usedp;
+{
+	register net_guard_node_t node, parent, *list, *where;
+	register int		i;
+
+	*usedp = 0;
+	parent = 0;
+	list = &ifp->if_guard_tree;
+
+	for (i = 0; i < n; i++) {
+	    where = 0;
+	    for (node = *list; node != 0; node = node->ng_next) {
+		if (node->ng_test.type == guards[i].type &&
+		    node->ng_test.offset == guards[i].offset) {
+		    if (node->ng_test.value == guards[i].value)
+			break;
+		    where = &node->ng_next;	/* keep the field together */
+		}
+	    }
+
+	    if (node == 0) {
+		node = nodes[(*usedp)++];
+		node->ng_test = guards[i];
+		node->ng_child = 0;
+		node->ng_parent = parent;
+		node->ng_mark = ifp->if_guard_gen;
+		node->ng_refs = 0;
+		if (where == 0)
+		    where = list;
+		node->ng_next = *where;
+		*where = node;
+	    }
+
+	    node->ng_refs++;
+	    parent = node;
+	    list = &node->ng_child;
+	}
+	return parent;
+}
+
+/*
+ * net_guard_release:
+ *
+ * Drop a filter's path from the interface's tree.
+ * The filter list must be locked.
+ */
+void
+net_guard_release(ifp, node)
+	struct ifnet		*ifp;
+	register net_guard_node_t node;
+{
+	register net_guard_node_t parent, *list;
+
+	for (; node != 0; node = parent) {
+	    parent = node->ng_parent;
+	    if (--node->ng_refs > 0)
+		continue;
+
+	    list = (parent == 0) ? &ifp->if_guard_tree : &parent->ng_child;
+	    while (*list != node)
+		list = &(*list)->ng_next;
+	    *list = node->ng_next;
+
+	    simple_lock(&net_guard_lock);
+	    node->ng_next = net_guard_free_list;
+	    net_guard_free_list = node;
+	    simple_unlock(&net_guard_lock);
+	}
+}
+
 
 /*
  *	ethernet_priority:
@@ -418,6 +769,208 @@ mach_msg_type_t packet_type = {
 	FALSE			/* deallocate */
 };
 
+mach_msg_type_long_t batch_frames_type = {
+    {
+	0,			/* name */
+	0,			/* size */
+	0,			/* number */
+	TRUE,			/* inline */
+	TRUE,			/* longform */
+	FALSE			/* deallocate */
+    },
+	MACH_MSG_TYPE_BYTE,	/* name */
+	8,			/* size */
+	0			/* number */
+};
+
+/*
+ *	Batched delivery.
+ *
+ *	Packets for NET_RCV_BATCH filters are copied into batch
+ *	messages, one being filled per destination port, taken
+ *	from the same pool of buffers as single packets.  A batch
+ *	goes out when the next packet for its port does not fit,
+ *	when it has waited net_batch_delay packets, or when
+ *	net_deliver runs out of packets.  Lacking a buffer or a
+ *	slot, a packet is delivered by itself.
+ */
+
+#define	NET_BATCH_MAX	16		/* batches being filled */
+
+struct net_batch {
+	ipc_kmsg_t	nb_kmsg;	/* batch, or IKM_NULL */
+	unsigned int	nb_seq;		/* net_batch_seq when started */
+} net_batches[NET_BATCH_MAX];
+
+decl_simple_lock_data(,net_batch_lock)
+int		net_batch_count = 0;	/* batches being filled */
+unsigned int	net_batch_seq = 0;	/* packets batched */
+unsigned int	net_batch_delay = 32;	/* in packets */
+vm_size_t	net_batch_size;		/* bytes of frames per batch */
+
+int		net_kmsg_send_batch_hits = 0;	/* for debugging */
+int		net_kmsg_send_batch_misses = 0;	/* for debugging */
+int		net_batch_unbatched = 0;	/* for debugging */
+
+/*
+ *	net_batch_add:
+ *
+ *	Add a filtered packet to the batch for its destination,
+ *	moving full batches to ready.  Returns FALSE if the packet
+ *	must be sent by itself.  Called at spl0.
+ */
+boolean_t
+net_batch_add(kmsg, header_size, ready)
+	ipc_kmsg_t		kmsg;
+	int			header_size;
+	ipc_kmsg_queue_t	ready;
+{
+	register struct net_batch *nb, *free_nb;
+	register net_rcv_batch_msg_t bm;
+	register struct net_rcv_frame *nf;
+	ipc_kmsg_t		new_kmsg;
+	mach_port_t		dest;
+	int			count;
+	vm_size_t		frame_size;
+
+	dest = kmsg->ikm_header.msgh_remote_port;
+	count = net_kmsg(kmsg)->net_rcv_msg_packet_count;
+	if (header_size < 0 || header_size > NET_HDW_HDR_MAX)
+	    header_size = NET_HDW_HDR_MAX;
+	frame_size = (sizeof(struct net_rcv_frame) + header_size + count + 3)
+			& ~3;
+	if (frame_size > net_batch_size)
+	    return FALSE;
+
+	new_kmsg = IKM_NULL;
+	net_batch_seq++;
+
+    retry:
+	simple_lock(&net_batch_lock);
+	free_nb = 0;
+	for (nb = net_batches; nb < &net_batches[NET_BATCH_MAX]; nb++) {
+	    if (nb->nb_kmsg == IKM_NULL) {
+		if (free_nb == 0)
+		    free_nb = nb;
+	    } else if (nb->nb_kmsg->ikm_header.msgh_remote_port == dest)
+		break;
+	}
+
+	if (nb < &net_batches[NET_BATCH_MAX] &&
+	    net_batch_kmsg(nb->nb_kmsg)->frames_type.msgtl_number + frame_size
+							> net_batch_size) {
+	    /* full: send it, and start another */
+	    ipc_kmsg_enqueue(ready, nb->nb_kmsg);
+	    nb->nb_kmsg = IKM_NULL;
+	    net_batch_count--;
+	    free_nb = nb;
+	}
+
+	if (nb == &net_batches[NET_BATCH_MAX] || nb->nb_kmsg == IKM_NULL) {
+	    if (free_nb != 0 && new_kmsg == IKM_NULL) {
+		/*
+		 *	net_kmsg_get takes locks of its own.
+		 */
+		simple_unlock(&net_batch_lock);
+		new_kmsg = net_kmsg_get();
+		if (new_kmsg != IKM_NULL)
+		    goto retry;
+		simple_lock(&net_batch_lock);
+	    }
+	    if (free_nb == 0 || new_kmsg == IKM_NULL) {
+		simple_unlock(&net_batch_lock);
+		if (new_kmsg != IKM_NULL)
+		    net_kmsg_put(new_kmsg);
+		net_batch_unbatched++;
+		return FALSE;
+	    }
+
+	    /* the batch takes over the packet's send right */
+	    nb = free_nb;
+	    nb->nb_kmsg = new_kmsg;
+	    nb->nb_seq = net_batch_seq;
+	    net_batch_count++;
+	    new_kmsg->ikm_header.msgh_remote_port = dest;
+	    net_batch_kmsg(new_kmsg)->frames_type = batch_frames_type;
+	    new_kmsg = IKM_NULL;
+	} else
+	    dest = MACH_PORT_NULL;	/* release the packet's right */
+
+	bm = net_batch_kmsg(nb->nb_kmsg);
+	nf = (struct net_rcv_frame *)
+		&bm->frames[bm->frames_type.msgtl_number];
+	nf->nf_size = frame_size;
+	nf->nf_header_size = header_size;
+	nf->nf_packet_size = count;
+	nf->nf_pad = 0;
+	bcopy(net_kmsg(kmsg)->header, net_rcv_frame_header(nf), header_size);
+	bcopy(net_kmsg(kmsg)->packet, net_rcv_frame_packet(nf), count);
+	bm->frames_type.msgtl_number += frame_size;
+	simple_unlock(&net_batch_lock);
+
+	if (new_kmsg != IKM_NULL)
+	    net_kmsg_put(new_kmsg);
+	if (dest == MACH_PORT_NULL)
+	    ipc_port_release_send((ipc_port_t)
+				  kmsg->ikm_header.msgh_remote_port);
+	net_kmsg_put(kmsg);
+	return TRUE;
+}
+
+/*
+ *	net_batch_collect:
+ *
+ *	Move batches that are due (all of them, if all is set)
+ *	to ready.  Called at spl0.
+ */
+void
+net_batch_collect(all, ready)
+	boolean_t		all;
+	ipc_kmsg_queue_t	ready;
+{
+	register struct net_batch *nb;
+
+	simple_lock(&net_batch_lock);
+	for (nb = net_batches; nb < &net_batches[NET_BATCH_MAX]; nb++) {
+	    if (nb->nb_kmsg != IKM_NULL &&
+		(all || net_batch_seq - nb->nb_seq >= net_batch_delay)) {
+		ipc_kmsg_enqueue(ready, nb->nb_kmsg);
+		nb->nb_kmsg = IKM_NULL;
+		net_batch_count--;
+	    }
+	}
+	simple_unlock(&net_batch_lock);
+}
+
+/*
+ *	net_batch_send:
+ *
+ *	Finish and send a batch.  Called at spl0.
+ */
+void
+net_batch_send(kmsg)
+	register ipc_kmsg_t	kmsg;
+{
+	ikm_init_special(kmsg, IKM_SIZE_NETWORK);
+
+	kmsg->ikm_header.msgh_bits =
+		MACH_MSGH_BITS(MACH_MSG_TYPE_PORT_SEND, 0);
+	kmsg->ikm_header.msgh_size =
+		(mach_msg_size_t) (sizeof(struct net_rcv_batch_msg)
+				   - NET_RCV_BATCH_MAX
+				   + net_batch_kmsg(kmsg)->frames_type.msgtl_number);
+	kmsg->ikm_header.msgh_local_port = MACH_PORT_NULL;
+	kmsg->ikm_header.msgh_kind = MACH_MSGH_KIND_NORMAL;
+	kmsg->ikm_header.msgh_id = NET_RCV_BATCH_MSG_ID;
+
+	if (ipc_mqueue_send(kmsg, MACH_SEND_TIMEOUT, 0) == MACH_MSG_SUCCESS)
+	    net_kmsg_send_batch_hits++;
+	else {
+	    net_kmsg_send_batch_misses++;
+	    ipc_kmsg_destroy(kmsg);
+	}
+}
+
 /*
  *	net_deliver:
  *
@@ -430,7 +983,8 @@ boolean_t net_deliver(nonblocking)
 {
 	register ipc_kmsg_t kmsg;
 	boolean_t high_priority;
-	struct ipc_kmsg_queue send_list;
+	struct ipc_kmsg_queue send_list, batch_list;
+	struct ifnet *ifp;
 
 	/*
 	 * Pick up a pending network message and deliver it.
@@ -443,6 +997,21 @@ boolean_t net_deliver(nonblocking)
 	} else if ((kmsg = ipc_kmsg_dequeue(&net_queue_low)) != IKM_NULL) {
 	    net_queue_low_size--;
 	    high_priority = FALSE;
+	} else if (net_batch_count != 0) {
+	    /*
+	     * Nothing more is coming for now: send the batches.
+	     */
+	    simple_unlock(&net_queue_lock);
+	    (void) spl0();
+
+	    ipc_kmsg_queue_init(&batch_list);
+	    net_batch_collect(TRUE, &batch_list);
+	    while ((kmsg = ipc_kmsg_dequeue(&batch_list)) != IKM_NULL)
+		net_batch_send(kmsg);
+
+	    (void) splimp();
+	    simple_lock(&net_queue_lock);
+	    return TRUE;
 	} else
 	    return FALSE;
 	simple_unlock(&net_queue_lock);
@@ -452,7 +1021,9 @@ boolean_t net_deliver(nonblocking)
 	 * Run the packet through the filters,
 	 * getting back a queue of packets to send.
 	 */
+	ifp = (struct ifnet *) kmsg->ikm_header.msgh_remote_port;
 	net_filter(kmsg, &send_list);
+	ipc_kmsg_queue_init(&batch_list);
 
 	if (!nonblocking) {
 	    /*
@@ -469,6 +1040,10 @@ boolean_t net_deliver(nonblocking)
 	while ((kmsg = ipc_kmsg_dequeue(&send_list)) != IKM_NULL) {
 	    int count;
 
+	    if (kmsg->ikm_header.msgh_id == NET_RCV_BATCH_MSG_ID &&
+		net_batch_add(kmsg, ifp->if_header_size, &batch_list))
+		continue;
+
 	    /*
 	     * Fill in the rest of the kmsg.
 	     */
@@ -511,6 +1086,11 @@ boolean_t net_deliver(nonblocking)
 	    }
 	}
 
+	if (net_batch_count != 0)
+	    net_batch_collect(FALSE, &batch_list);
+	while ((kmsg = ipc_kmsg_dequeue(&batch_list)) != IKM_NULL)
+	    net_batch_send(kmsg);
+
 	(void) splimp();
 	simple_lock(&net_queue_lock);
 	return TRUE;
@@ -673,6 +1253,18 @@ net_packet(ifp, kmsg, count, priority)
 	}
 #endif	/* MACH_TTD */
 
+	/*
+	 * A mapped ring gets every packet.  Skip the filters
+	 * if there are none.
+	 */
+	if (ifp->if_ring != 0) {
+	    net_ring_input(ifp, kmsg, count);
+	    if (queue_empty(&ifp->if_rcv_port_list)) {
+		net_kmsg_put(kmsg);
+		return;
+	    }
+	}
+
 	kmsg->ikm_header.msgh_remote_port = (mach_port_t) ifp;
 	net_kmsg(kmsg)->net_rcv_msg_packet_count = count;
 
@@ -721,6 +1313,7 @@ net_filter(kmsg, send_list)
  	queue_entry_t		dead_infp = (queue_entry_t) 0;
  	queue_entry_t		dead_entp = (queue_entry_t) 0;
  	unsigned int		ret_count;
+	unsigned int		gen;
 
 	int count = net_kmsg(kmsg)->net_rcv_msg_packet_count;
 	ifp = (struct ifnet *) kmsg->ikm_header.msgh_remote_port;
@@ -732,10 +1325,30 @@ net_filter(kmsg, send_list)
 	 * while examining the filter list.
 	 */
 	simple_lock(&ifp->if_rcv_port_list_lock);
+
+	/*
+	 * Make the leading tests of all filters in one pass.
+	 */
+	gen = ++ifp->if_guard_gen;
+	if (ifp->if_guard_tree != 0)
+	    net_guard_walk(ifp->if_guard_tree, gen,
+			   net_kmsg(kmsg)->packet, count,
+			   net_kmsg(kmsg)->header);
+
  	FILTER_ITERATE(ifp, infp, nextfp)
  	{
+	    if (infp->guard_node != 0 && infp->guard_node->ng_mark != gen)
+		continue;	/* a leading test failed */
+
  	    entp = (net_hash_entry_t) 0;
  	    if (infp->filter[0] == NETF_BPF) {
+#ifdef	MACHINE_BPF_JIT
+		if (infp->filter_code != BPF_JIT_NULL)
+		    ret_count = (*infp->filter_code)(net_kmsg(kmsg)->packet,
+						     count,
+						     net_kmsg(kmsg)->header);
+		else
+#endif
  		ret_count = bpf_do_filter(infp, net_kmsg(kmsg)->packet, count,
  					  net_kmsg(kmsg)->header,
  					  &hash_headp, &entp);
@@ -767,6 +1380,8 @@ net_filter(kmsg, send_list)
  		    if (entp == (net_hash_entry_t) 0) {
  			queue_remove(&ifp->if_rcv_port_list, infp,
  				     net_rcv_port_t, chain);
+			net_guard_release(ifp, infp->guard_node);
+			infp->guard_node = 0;
  			ENQUEUE_DEAD(dead_infp, infp);
  			continue;
  		    } else {
@@ -809,6 +1424,10 @@ net_filter(kmsg, send_list)
 		}
  		net_kmsg(new_kmsg)->net_rcv_msg_packet_count = ret_count;
 		new_kmsg->ikm_header.msgh_remote_port = (mach_port_t) dest;
+		new_kmsg->ikm_header.msgh_id =
+		    ((entp == (net_hash_entry_t) 0) ? infp->rcv_batch
+						    : entp->rcv_batch) ?
+			NET_RCV_BATCH_MSG_ID : NET_RCV_MSG_ID;
 		ipc_kmsg_enqueue(send_list, new_kmsg);
 
 	    {
@@ -1110,6 +1729,16 @@ net_set_filter(ifp, rcv_port, priority, filter, filter_count)
     int				i;
     int				ret, is_new_infp;
     io_return_t			rval;
+#ifdef	MACHINE_BPF_JIT
+    bpf_jit_t			filter_code = BPF_JIT_NULL;
+#endif
+    struct net_guard		guards[NET_GUARD_MAX];
+    net_guard_node_t		guard_nodes[NET_GUARD_MAX];
+    int				n_guards, n_guard_nodes;
+    boolean_t			batch;
+
+    batch = (priority & NET_RCV_BATCH) != 0;
+    priority &= ~NET_RCV_BATCH;
 
     /*
      * Check the filter syntax.
@@ -1122,6 +1751,15 @@ net_set_filter(ifp, rcv_port, priority, filter, filter_count)
 	ret = bpf_validate((bpf_insn_t)filter, filter_bytes, &match);
 	if (!ret)
 	    return (D_INVALID_OPERATION);
+#ifdef	MACHINE_BPF_JIT
+	/*
+	 * Compile it now, while we may still block.  Filters
+	 * with a MATCH instruction stay with the interpreter,
+	 * which knows about the hash table.
+	 */
+	if (match == (bpf_insn_t) 0)
+	    filter_code = bpf_jit_compile((bpf_insn_t)filter, filter_bytes);
+#endif
     } else {
 	if (!parse_net_filter(filter, filter_count))
 	    return (D_INVALID_OPERATION);
@@ -1130,6 +1768,14 @@ net_set_filter(ifp, rcv_port, priority, filter, filter_count)
     rval = D_SUCCESS;			/* default return value */
     dead_infp = dead_entp = 0;
 
+    /*
+     * Find the filter's leading tests, and set aside enough
+     * nodes to add them to the interface's tree.
+     */
+    n_guards = net_guard_extract(filter, filter_count, guards);
+    net_guard_reserve(guard_nodes, n_guards);
+    n_guard_nodes = 0;
+
     if (match == (bpf_insn_t) 0) {
         /*
 	 * If there is no match instruction, we allocate
@@ -1214,6 +1860,8 @@ net_set_filter(ifp, rcv_port, priority, filter, filter_count)
 		       || !ip_active(infp->rcv_port)) {
 		    /* Remove the old filter from list */
 		    remqueue(&ifp->if_rcv_port_list, (queue_entry_t)infp);
+		    net_guard_release(ifp, infp->guard_node);
+		    infp->guard_node = 0;
 		    ENQUEUE_DEAD(dead_infp, infp);
 	    }
     }
@@ -1254,12 +1902,18 @@ net_set_filter(ifp, rcv_port, priority, filter, filter_count)
     if (is_new_infp) {
 	my_infp->priority = priority;
 	my_infp->rcv_count = 0;
+	my_infp->rcv_batch = (match == 0) ? batch : FALSE;
 
 	/* Copy filter program. */
 	bcopy ((vm_offset_t)filter, (vm_offset_t)my_infp->filter,
 	       filter_bytes);
 	my_infp->filter_end =
 	    (filter_t *)((char *)my_infp->filter + filter_bytes);
+#ifdef	MACHINE_BPF_JIT
+	my_infp->filter_code = filter_code;
+#endif
+	my_infp->guard_node = net_guard_insert(ifp, guards, n_guards,
+					       guard_nodes, &n_guard_nodes);
 
 	if (match == 0) {
 	    my_infp->rcv_qlimit = net_add_q_info(rcv_port);
@@ -1280,6 +1934,7 @@ net_set_filter(ifp, rcv_port, priority, filter, filter_count)
 	int j;
 	
 	hash_entp->rcv_port = rcv_port;
+	hash_entp->rcv_batch = batch;
 	for (i = 0; i < match->jt; i++)		/* match->jt is n_keys */
 	    hash_entp->keys[i] = match[i+1].k;
 	p = &((net_hash_header_t)my_infp)->
@@ -1303,6 +1958,9 @@ net_set_filter(ifp, rcv_port, priority, filter, filter_count)
 clean_and_return:
     /* No locks are held at this point. */
 
+    net_guard_unreserve(&guard_nodes[n_guard_nodes],
+			n_guards - n_guard_nodes);
+
     if (dead_infp != 0)
 	    net_free_dead_infp(dead_infp);
     if (dead_entp != 0)
@@ -1335,11 +1993,23 @@ net_getstat(ifp, flavor, status, count)
 		ns->header_size	    = ifp->if_header_size;
 		ns->address_size    = ifp->if_address_size;
 		ns->flags	    = ifp->if_flags;
-		ns->mapped_size	    = 0;
+		ns->mapped_size	    = net_ring_size(ifp);
 
 		*count = NET_STATUS_COUNT;
 		break;
 	    }
+	    case NET_RING_STATUS:
+	    {
+		if (*count < NET_RING_STATUS_COUNT)
+		    return (D_INVALID_OPERATION);
+
+		if (net_ring_create(ifp) != KERN_SUCCESS)
+		    return (D_NO_MEMORY);
+		status[0] = net_ring_size(ifp);
+
+		*count = NET_RING_STATUS_COUNT;
+		break;
+	    }
 	    case NET_ADDRESS:
 	    {
 		register int	addr_byte_count;
@@ -1397,6 +2067,12 @@ net_write(ifp, start, ior)
 	if ((ifp->if_flags & (IFF_UP|IFF_RUNNING)) != (IFF_UP|IFF_RUNNING))
 	    return (D_DEVICE_DOWN);
 
+	/*
+	 * An empty write starts transmission from the mapped ring.
+	 */
+	if (ior->io_count == 0 && ifp->if_ring != 0)
+	    return (net_ring_output(ifp, start));
+
 	/*
 	 * Reject the write if the packet is too large or too small.
 	 */
@@ -1511,9 +2187,28 @@ net_io_init()
  				    FALSE,
  				    "net_hash_entry");
 
+	size = sizeof(struct net_guard_node);
+	net_guard_zone = zinit(size,
+			       size * 1000,
+			       PAGE_SIZE,
+			       FALSE,
+			       "net_guard_node");
+	simple_lock_init(&net_guard_lock);
+
 	size = ikm_plus_overhead(sizeof(struct net_rcv_msg));
 	net_kmsg_size = round_page(size);
 
+	/*
+	 *	Batches are built in the same buffers.
+	 */
+	net_batch_size = ikm_less_overhead(net_kmsg_size) -
+		(sizeof(struct net_rcv_batch_msg) - NET_RCV_BATCH_MAX);
+	if (net_batch_size > NET_RCV_BATCH_MAX)
+	    net_batch_size = NET_RCV_BATCH_MAX;
+	simple_lock_init(&net_batch_lock);
+
+	net_ring_init();
+
 	/*
 	 *	net_kmsg_max caps the number of buffers
 	 *	we are willing to allocate.  By default,
@@ -2073,6 +2768,8 @@ hash_ent_remove (ifp, hp, used, head, entp, dead_p)
 			if (hp->ref_count == 0 && !used) {
 				remqueue((queue_t) &ifp->if_rcv_port_list,
 					 (queue_entry_t)hp);
+				net_guard_release(ifp, hp->rcv.guard_node);
+				hp->rcv.guard_node = 0;
 				hp->n_keys = 0;
 				return TRUE;
 			}
@@ -2140,6 +2837,10 @@ net_free_dead_infp (dead_infp)
 		nextfp = (net_rcv_port_t) queue_next(&infp->chain);
 		ipc_port_release_send(infp->rcv_port);
 		net_del_q_info(infp->rcv_qlimit);
+#ifdef	MACHINE_BPF_JIT
+		if (infp->filter_code != BPF_JIT_NULL)
+		    bpf_jit_free(infp->filter_code);
+#endif
 		zfree(net_rcv_zone, (vm_offset_t) infp);
 	}	    
 }
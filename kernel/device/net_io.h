@@ -50,6 +50,7 @@
  */
 
 #define	net_kmsg(kmsg)	((net_rcv_msg_t)&(kmsg)->ikm_header)
+#define	net_batch_kmsg(kmsg)	((net_rcv_batch_msg_t)&(kmsg)->ikm_header)
 
 /*
  * Interrupt routines may allocate and free net_kmsgs with these
@@ -68,6 +69,17 @@ extern void net_filter();
 extern io_return_t net_getstat();
 extern io_return_t net_write();
 
+/*
+ * Mapped packet rings (device/net_ring.c).
+ */
+
+extern void net_ring_init();
+extern kern_return_t net_ring_create();
+extern vm_size_t net_ring_size();
+extern int net_ring_mmap();
+extern void net_ring_input();
+extern io_return_t net_ring_output();
+
 /*
  * Non-interrupt code may allocate and free net_kmsgs with these functions.
  */
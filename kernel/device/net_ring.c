@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	Mapped packet rings for network interfaces.
+ *	See <device/net_ring.h> for the protocol.
+ *
+ *	The ring is wired kernel memory.  Received packets are copied
+ *	into it from net_packet, at interrupt level.  Transmit slots
+ *	are handed to the driver as loaned io_reqs pointing into the
+ *	ring, so the driver's start routine cannot tell them from
+ *	ordinary writes.  A ring, once set up, lives as long as the
+ *	interface, since user tasks may have it mapped.
+ */
+
+#include <mach/boolean.h>
+#include <mach/kern_return.h>
+#include <mach/vm_param.h>
+
+#include <kern/lock.h>
+#include <kern/thread.h>
+#include <kern/eventcount.h>
+#include <kern/kalloc.h>
+#include <machine/machspl.h>
+
+#include <vm/pmap.h>
+#include <vm/vm_kern.h>
+
+#include <device/device_types.h>
+#include <device/io_req.h>
+#include <device/if_hdr.h>
+#include <device/net_io.h>
+#include <device/net_ring.h>
+
+struct net_ring {
+	decl_simple_lock_data(,	nr_lock)	/* transmit state */
+	vm_offset_t		nr_kaddr;
+	vm_size_t		nr_size;
+	struct net_ring_header	*nr_header;	/* user-writable */
+	vm_offset_t		nr_rx_base;	/* slot 0, in the kernel */
+	vm_offset_t		nr_tx_base;
+	unsigned int		nr_rx_slots;	/* the geometry, kept */
+	unsigned int		nr_tx_slots;	/* here since the header */
+	vm_size_t		nr_slot_size;	/* is the user's too */
+	struct evc		nr_rx_evc;
+	struct evc		nr_tx_evc;
+	unsigned int		nr_rx_head;	/* the real ones; the */
+	unsigned int		nr_tx_queued;	/* header can be written */
+	unsigned int		nr_tx_done;	/* by the user */
+	struct ifnet		*nr_ifp;
+	io_req_t		nr_tx_iors;	/* one per transmit slot */
+	boolean_t		*nr_tx_busy;
+};
+
+/*
+ *	Slot addresses are computed from the ring's own copy of the
+ *	geometry; the header is only written, apart from the
+ *	counters the user advances.
+ */
+#define	ring_rx_slot(ring, i)						\
+	((struct net_ring_slot *) ((ring)->nr_rx_base +			\
+		((i) % (ring)->nr_rx_slots) * (ring)->nr_slot_size))
+#define	ring_tx_slot(ring, i)						\
+	((struct net_ring_slot *) ((ring)->nr_tx_base +			\
+		((i) % (ring)->nr_tx_slots) * (ring)->nr_slot_size))
+
+int	net_ring_rx_slots = 64;
+int	net_ring_tx_slots = 32;
+
+boolean_t	net_ring_tx_done();
+
+decl_simple_lock_data(,net_ring_create_lock)
+
+void
+net_ring_init()
+{
+	simple_lock_init(&net_ring_create_lock);
+}
+
+/*
+ *	Routine:	net_ring_create
+ *	Purpose:
+ *		Give the interface a ring, if it has none.
+ *	Conditions:
+ *		Nothing locked; may block.
+ */
+kern_return_t
+net_ring_create(ifp)
+	register struct ifnet	*ifp;
+{
+	register struct net_ring *ring;
+	register struct net_ring_header *h;
+	vm_size_t		slot_size, header_size;
+	kern_return_t		kr;
+
+	if (ifp->if_ring != 0)
+	    return KERN_SUCCESS;
+
+	ring = (struct net_ring *) kalloc(sizeof(struct net_ring));
+	if (ring == 0)
+	    return KERN_RESOURCE_SHORTAGE;
+
+	slot_size = (sizeof(struct net_ring_slot) + NET_HDW_HDR_MAX +
+		     ifp->if_header_size + ifp->if_mtu + 15) & ~15;
+	header_size = (sizeof(struct net_ring_header) + 15) & ~15;
+	ring->nr_size = round_page(header_size +
+			(net_ring_rx_slots + net_ring_tx_slots) * slot_size);
+
+	kr = kmem_alloc_wired(kernel_map, &ring->nr_kaddr, ring->nr_size);
+	if (kr != KERN_SUCCESS) {
+	    kfree((vm_offset_t) ring, sizeof(struct net_ring));
+	    return kr;
+	}
+	bzero((char *) ring->nr_kaddr, ring->nr_size);
+
+	ring->nr_tx_iors = (io_req_t)
+		kalloc(net_ring_tx_slots * sizeof(struct io_req));
+	ring->nr_tx_busy = (boolean_t *)
+		kalloc(net_ring_tx_slots * sizeof(boolean_t));
+	bzero((char *) ring->nr_tx_iors,
+	      net_ring_tx_slots * sizeof(struct io_req));
+	bzero((char *) ring->nr_tx_busy,
+	      net_ring_tx_slots * sizeof(boolean_t));
+
+	simple_lock_init(&ring->nr_lock);
+	ring->nr_rx_head = 0;
+	ring->nr_tx_queued = 0;
+	ring->nr_tx_done = 0;
+	ring->nr_ifp = ifp;
+	ring->nr_rx_slots = net_ring_rx_slots;
+	ring->nr_tx_slots = net_ring_tx_slots;
+	ring->nr_slot_size = slot_size;
+	ring->nr_rx_base = ring->nr_kaddr + header_size;
+	ring->nr_tx_base = ring->nr_rx_base + net_ring_rx_slots * slot_size;
+	evc_init(&ring->nr_rx_evc);
+	evc_init(&ring->nr_tx_evc);
+
+	h = ring->nr_header = (struct net_ring_header *) ring->nr_kaddr;
+	h->nr_slot_size = slot_size;
+	h->nr_rx_slots = net_ring_rx_slots;
+	h->nr_tx_slots = net_ring_tx_slots;
+	h->nr_rx_offset = header_size;
+	h->nr_tx_offset = header_size + net_ring_rx_slots * slot_size;
+	h->nr_rx_evc = ring->nr_rx_evc.ev_id;
+	h->nr_tx_evc = ring->nr_tx_evc.ev_id;
+	h->nr_magic = NET_RING_MAGIC;
+
+	/*
+	 *	Lost a race with another caller: use theirs.
+	 */
+	simple_lock(&net_ring_create_lock);
+	if (ifp->if_ring == 0) {
+	    ifp->if_ring = ring;
+	    ring = 0;
+	}
+	simple_unlock(&net_ring_create_lock);
+
+	if (ring != 0) {
+	    evc_destroy(&ring->nr_rx_evc);
+	    evc_destroy(&ring->nr_tx_evc);
+	    kfree((vm_offset_t) ring->nr_tx_busy,
+		  ring->nr_tx_slots * sizeof(boolean_t));
+	    kfree((vm_offset_t) ring->nr_tx_iors,
+		  ring->nr_tx_slots * sizeof(struct io_req));
+	    kmem_free(kernel_map, ring->nr_kaddr, ring->nr_size);
+	    kfree((vm_offset_t) ring, sizeof(struct net_ring));
+	}
+	return KERN_SUCCESS;
+}
+
+/*
+ *	Routine:	net_ring_size
+ *	Purpose:
+ *		Bytes to map for the interface's ring, or 0.
+ */
+vm_size_t
+net_ring_size(ifp)
+	struct ifnet	*ifp;
+{
+	return (ifp->if_ring == 0) ? 0 : ifp->if_ring->nr_size;
+}
+
+/*
+ *	Routine:	net_ring_mmap
+ *	Purpose:
+ *		Mapping function for drivers' d_mmap entries.
+ */
+int
+net_ring_mmap(ifp, off, prot)
+	struct ifnet	*ifp;
+	vm_offset_t	off;
+	vm_prot_t	prot;
+{
+	register struct net_ring *ring = ifp->if_ring;
+
+#ifdef	lint
+	prot = prot;
+#endif	lint
+	if (ring == 0 || off >= ring->nr_size)
+	    return (-1);
+	return pmap_phys_to_frame(pmap_extract(kernel_pmap,
+					       ring->nr_kaddr + off));
+}
+
+/*
+ *	Routine:	net_ring_input
+ *	Purpose:
+ *		Copy a received packet into the ring, if there is
+ *		room.
+ *	Conditions:
+ *		Called from net_packet, at splimp.
+ */
+void
+net_ring_input(ifp, kmsg, count)
+	struct ifnet	*ifp;
+	ipc_kmsg_t	kmsg;
+	int		count;
+{
+	register struct net_ring *ring = ifp->if_ring;
+	register struct net_ring_header *h = ring->nr_header;
+	register struct net_ring_slot *ns;
+	register int	header_size;
+	unsigned int	tail;
+	boolean_t	was_empty;
+
+	/* the user may scribble on nr_rx_tail: read it once */
+	tail = h->nr_rx_tail;
+	if (ring->nr_rx_head - tail >= ring->nr_rx_slots) {
+	    h->nr_rx_drops++;
+	    return;
+	}
+	was_empty = (ring->nr_rx_head == tail);
+
+	header_size = ifp->if_header_size;
+	if (header_size < 0 || header_size > NET_HDW_HDR_MAX)
+	    header_size = NET_HDW_HDR_MAX;
+	if (count > ring->nr_slot_size - sizeof(struct net_ring_slot)
+			- header_size)
+	    count = ring->nr_slot_size - sizeof(struct net_ring_slot)
+			- header_size;
+
+	ns = ring_rx_slot(ring, ring->nr_rx_head);
+	ns->ns_header_size = header_size;
+	ns->ns_packet_size = count;
+	bcopy(net_kmsg(kmsg)->header, net_ring_slot_data(ns), header_size);
+	bcopy(net_kmsg(kmsg)->packet, net_ring_slot_data(ns) + header_size,
+	      count);
+
+	h->nr_rx_head = ++ring->nr_rx_head;
+	if (was_empty)
+	    evc_signal(&ring->nr_rx_evc);
+}
+
+/*
+ *	Advance nr_tx_tail over slots that are no longer busy.
+ *	Called with the ring locked, at splimp.
+ */
+void
+net_ring_tx_advance(ring)
+	register struct net_ring *ring;
+{
+	register unsigned int	n = ring->nr_tx_slots;
+
+	while (ring->nr_tx_done != ring->nr_tx_queued &&
+	       !ring->nr_tx_busy[ring->nr_tx_done % n])
+	    ring->nr_tx_done++;
+	ring->nr_header->nr_tx_tail = ring->nr_tx_done;
+}
+
+/*
+ *	Queue the transmit slots the user has filled since last
+ *	time on the interface, skipping frames of a bad size.
+ *	Called with the ring locked, at splimp.
+ */
+void
+net_ring_tx_queue(ring)
+	register struct net_ring *ring;
+{
+	register struct net_ring_header *h = ring->nr_header;
+	register struct ifnet	*ifp = ring->nr_ifp;
+	register struct net_ring_slot *ns;
+	register io_req_t	ior;
+	unsigned int		avail, room, i, size;
+
+	/* the user may have scribbled on nr_tx_head */
+	avail = h->nr_tx_head - ring->nr_tx_queued;
+	room = ring->nr_tx_slots - (ring->nr_tx_queued - ring->nr_tx_done);
+	if (avail > room)
+	    avail = room;
+
+	for (; avail > 0; avail--, ring->nr_tx_queued++) {
+	    i = ring->nr_tx_queued % ring->nr_tx_slots;
+	    ns = ring_tx_slot(ring, ring->nr_tx_queued);
+	    /* and may change the size after we check it */
+	    size = ns->ns_packet_size;
+	    if (size < ifp->if_header_size ||
+		size > ifp->if_header_size + ifp->if_mtu ||
+		size > ring->nr_slot_size - sizeof(struct net_ring_slot))
+		continue;
+
+	    ior = &ring->nr_tx_iors[i];
+	    ior->io_op = IO_WRITE | IO_LOANED;
+	    ior->io_unit = ifp->if_unit;
+	    ior->io_data = net_ring_slot_data(ns);
+	    ior->io_count = size;
+	    ior->io_total = size;
+	    ior->io_residual = 0;
+	    ior->io_error = 0;
+	    ior->io_done = net_ring_tx_done;
+	    ior->io_dev_ptr = (char *) ring;
+	    ior->io_reply_port = IP_NULL;
+	    ior->io_copy = VM_MAP_COPY_NULL;
+	    ring->nr_tx_busy[i] = TRUE;
+	    IF_ENQUEUE(&ifp->if_snd, ior);
+	}
+
+	net_ring_tx_advance(ring);
+	h->nr_tx_active = (ring->nr_tx_done != ring->nr_tx_queued);
+}
+
+/*
+ *	Completion routine for transmit slots; iodone calls it
+ *	directly, since the io_reqs are loaned.  Slots filled in
+ *	the meantime are queued too; drivers run their start
+ *	routine again when a transmission completes.
+ */
+boolean_t
+net_ring_tx_done(ior)
+	register io_req_t	ior;
+{
+	register struct net_ring *ring = (struct net_ring *) ior->io_dev_ptr;
+	spl_t			s;
+
+	s = splimp();
+	simple_lock(&ring->nr_lock);
+	ring->nr_tx_busy[ior - ring->nr_tx_iors] = FALSE;
+	net_ring_tx_queue(ring);
+	simple_unlock(&ring->nr_lock);
+	splx(s);
+
+	evc_signal(&ring->nr_tx_evc);
+	return TRUE;
+}
+
+/*
+ *	Routine:	net_ring_output
+ *	Purpose:
+ *		Queue the filled transmit slots on the interface
+ *		and start it.
+ *	Conditions:
+ *		Called from net_write for a zero-length write.
+ */
+io_return_t
+net_ring_output(ifp, start)
+	register struct ifnet	*ifp;
+	int			(*start)();
+{
+	register struct net_ring *ring = ifp->if_ring;
+	spl_t			s;
+
+	s = splimp();
+	simple_lock(&ring->nr_lock);
+	net_ring_tx_queue(ring);
+	simple_unlock(&ring->nr_lock);
+
+	/* not locked: start may complete a write at once */
+	(*start)(ifp->if_unit);
+	splx(s);
+
+	return (D_SUCCESS);
+}
@@ -83,6 +83,9 @@ void if_init_queues(ifp)
 	IFQ_INIT(&ifp->if_snd);
 	queue_init(&ifp->if_rcv_port_list);
 	simple_lock_init(&ifp->if_rcv_port_list_lock);
+	ifp->if_guard_tree = 0;
+	ifp->if_guard_gen = 0;
+	ifp->if_ring = 0;
 }
 
 
@@ -118,6 +121,7 @@ geteblk(size)
 	ior->io_count = size;
 	ior->io_residual = 0;
 	ior->io_error = 0;
+	ior->io_task = 0;
 
 	size = round_page(size);
 	ior->io_alloc_size = size;
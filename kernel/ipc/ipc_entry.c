@@ -183,6 +183,13 @@ ipc_entry_get(space, namep, entryp)
 	assert(MACH_PORT_VALID(new_name));
 	assert(free_entry->ie_object == IO_NULL);
 
+	/*
+	 *	Drain some of the old reverse hash, so that
+	 *	it is empty by the time the table grows again.
+	 */
+
+	ipc_hash_local_migrate(space, IH_LOCAL_MIGRATE);
+
 	*namep = new_name;
 	*entryp = free_entry;
 	return KERN_SUCCESS;
@@ -252,6 +259,7 @@ ipc_entry_alloc_name(
 	mach_port_index_t index = MACH_PORT_INDEX(name);
 	mach_port_gen_t gen = MACH_PORT_GEN(name);
 	ipc_tree_entry_t tree_entry = ITE_NULL;
+	ipc_entry_num_t count;
 
 	assert(MACH_PORT_VALID(name));
 
@@ -400,10 +408,14 @@ ipc_entry_alloc_name(
 		}
 
 		/*
-		 *	Allocate a tree entry and try again.
+		 *	Allocate a tree entry and try again.  Make
+		 *	room for it in the reverse hash table now,
+		 *	while the space is unlocked.
 		 */
 
+		count = space->is_tree_total + 1;
 		is_write_unlock(space);
+		ipc_hash_tree_reserve(space, count);
 		tree_entry = ite_alloc();
 		if (tree_entry == ITE_NULL)
 			return KERN_RESOURCE_SHORTAGE;
@@ -470,8 +482,8 @@ ipc_entry_dealloc(
 			assert(tentry->ite_space == space);
 
 			if (IE_BITS_TYPE(bits) == MACH_PORT_TYPE_SEND) {
-				ipc_hash_global_delete(space, obj,
-						       tname, tentry);
+				ipc_hash_tree_delete(space, obj,
+						     tname, tentry);
 				ipc_hash_local_insert(space, obj,
 						      index, entry);
 			}
@@ -547,7 +559,10 @@ ipc_entry_grow_table(space)
 	do {
 		ipc_entry_t otable, table;
 		ipc_table_size_t oits, its, nits;
-		mach_port_index_t i, free_index;
+		mach_port_index_t i, free_index, free_last;
+		mach_port_index_t moved_last, moved_prev;
+		mach_port_index_t *hash, *ohash;
+		ipc_entry_num_t hsize, ohsize;
 
 		assert(space->is_active);
 
@@ -579,6 +594,20 @@ ipc_entry_grow_table(space)
 
 		assert((osize < size) && (size <= nsize));
 
+		/*
+		 *	Finish draining the old reverse hash, so that
+		 *	we can free it while unlocked.  Usually the
+		 *	allocations since the last growth have
+		 *	already emptied it.
+		 */
+
+		ipc_hash_local_migrate(space, space->is_hash_old_size);
+		ohash = space->is_hash_old;
+		ohsize = space->is_hash_old_size;
+		space->is_hash_old = (mach_port_index_t *) 0;
+		space->is_hash_old_size = 0;
+		space->is_hash_migrate = 0;
+
 		/*
 		 *	OK, we'll attempt to grow the table.
 		 *	The realloc requires that the old table
@@ -587,10 +616,51 @@ ipc_entry_grow_table(space)
 
 		space->is_growing = TRUE;
 		is_write_unlock(space);
+
+		if (ohash != (mach_port_index_t *) 0)
+			ipc_hash_local_free(ohash, ohsize);
+
 		if (it_entries_reallocable(oits))
 			table = it_entries_realloc(oits, otable, its);
 		else
 			table = it_entries_alloc(its);
+
+		/*
+		 *	The reverse hash must be at least as big as
+		 *	the table.  Only the grower changes is_hash_size,
+		 *	so it is safe to look at it unlocked.
+		 */
+
+		hash = (mach_port_index_t *) 0;
+		if ((table != IE_NULL) && (space->is_hash_size < size)) {
+			hash = ipc_hash_local_alloc(size, &hsize);
+			if (hash == (mach_port_index_t *) 0) {
+				it_entries_free(its, table);
+				table = IE_NULL;
+			}
+		}
+
+		/*
+		 *	Nobody else can see the new part of the table,
+		 *	so initialize it now, before locking the space.
+		 *	Link the entries into a free list in ascending order,
+		 *	and set the generation number to -1, so that
+		 *	early allocations produce "natural" names.
+		 */
+
+		if (table != IE_NULL) {
+			(void) memset((void *) (table + osize), 0,
+			      (size - osize) * sizeof(struct ipc_entry));
+
+			for (i = osize; i < size; i++) {
+				ipc_entry_t entry = &table[i];
+
+				entry->ie_bits = IE_BITS_GEN_MASK;
+				entry->ie_next = i + 1;
+			}
+			table[size - 1].ie_next = 0;
+		}
+
 		is_write_lock(space);
 		space->is_growing = FALSE;
 
@@ -615,6 +685,8 @@ ipc_entry_grow_table(space)
 			is_write_unlock(space);
 			thread_wakeup((event_t) space);
 			it_entries_free(its, table);
+			if (hash != (mach_port_index_t *) 0)
+				ipc_hash_local_free(hash, hsize);
 			is_write_lock(space);
 			return KERN_SUCCESS;
 		}
@@ -629,32 +701,26 @@ ipc_entry_grow_table(space)
 
 		/*
 		 *	If we did a realloc, it remapped the data.
-		 *	Otherwise we copy by hand first.  Then we have
-		 *	to clear the index fields in the old part and
-		 *	zero the new part.
+		 *	Otherwise we copy by hand; the table is
+		 *	less than a page then.
 		 */
 
 		if (!it_entries_reallocable(oits))
 			(void) memcpy((void *) table, (const void *) otable,
 			      osize * sizeof(struct ipc_entry));
 
-		for (i = 0; i < osize; i++)
-			table[i].ie_index = 0;
-
-		(void) memset((void *) (table + osize), 0,
-		      (size - osize) * sizeof(struct ipc_entry));
-
 		/*
-		 *	Put old entries into the reverse hash table.
+		 *	Install the new reverse hash.  The entries
+		 *	in the old one move over a few at a time,
+		 *	as the space is used.
 		 */
 
-		for (i = 0; i < osize; i++) {
-			ipc_entry_t entry = &table[i];
-
-			if (IE_BITS_TYPE(entry->ie_bits) ==
-						MACH_PORT_TYPE_SEND)
-				ipc_hash_local_insert(space, entry->ie_object,
-						      i, entry);
+		if (hash != (mach_port_index_t *) 0) {
+			space->is_hash_old = space->is_hash_table;
+			space->is_hash_old_size = space->is_hash_size;
+			space->is_hash_migrate = 0;
+			space->is_hash_table = hash;
+			space->is_hash_size = hsize;
 		}
 
 		/*
@@ -662,8 +728,19 @@ ipc_entry_grow_table(space)
 		 *	then we have work to do:
 		 *		1) transfer entries to the table
 		 *		2) update is_tree_small
+		 *
+		 *	Entries moved into the table are unlinked from
+		 *	the new free list.  Because the list is in ascending
+		 *	order and the tree is traversed in ascending order,
+		 *	the predecessor of a moved entry is either the entry
+		 *	just before it or, when that one was moved too,
+		 *	the predecessor of the previously moved entry.
+		 *	A predecessor of zero means the head of the list.
 		 */
 
+		free_index = osize;
+		moved_last = moved_prev = 0;
+
 		if (space->is_tree_total > 0) {
 			mach_port_index_t index;
 			boolean_t delete;
@@ -710,6 +787,7 @@ ipc_entry_grow_table(space)
 				ipc_entry_bits_t bits;
 				ipc_object_t obj;
 				ipc_entry_t entry;
+				mach_port_index_t prev;
 
 				name = tentry->ite_name;
 				gen = MACH_PORT_GEN(name);
@@ -723,8 +801,7 @@ ipc_entry_grow_table(space)
 				/* collision with previously moved entry? */
 
 				bits = entry->ie_bits;
-				if (bits != 0) {
-					assert(IE_BITS_TYPE(bits));
+				if (IE_BITS_TYPE(bits) != MACH_PORT_TYPE_NONE) {
 					assert(IE_BITS_GEN(bits) != gen);
 
 					entry->ie_bits =
@@ -733,6 +810,23 @@ ipc_entry_grow_table(space)
 					continue;
 				}
 
+				/* unlink the entry from the free list */
+
+				if ((moved_last != 0) &&
+				    (moved_last == index - 1))
+					prev = moved_prev;
+				else if (index > osize)
+					prev = index - 1;
+				else
+					prev = 0;
+
+				if (prev == 0)
+					free_index = entry->ie_next;
+				else
+					table[prev].ie_next = entry->ie_next;
+				moved_last = index;
+				moved_prev = prev;
+
 				bits = tentry->ite_bits;
 				type = IE_BITS_TYPE(bits);
 				assert(type != MACH_PORT_TYPE_NONE);
@@ -742,8 +836,8 @@ ipc_entry_grow_table(space)
 				entry->ie_request = tentry->ite_request;
 
 				if (type == MACH_PORT_TYPE_SEND) {
-					ipc_hash_global_delete(space, obj,
-							       name, tentry);
+					ipc_hash_tree_delete(space, obj,
+							     name, tentry);
 					ipc_hash_local_insert(space, obj,
 							      index, entry);
 				}
@@ -782,23 +876,15 @@ ipc_entry_grow_table(space)
 		}
 
 		/*
-		 *	Add entries in the new part which still aren't used
-		 *	to the free list.  Add them in reverse order,
-		 *	and set the generation number to -1, so that
-		 *	early allocations produce "natural" names.
+		 *	Put the entries in the new part which still
+		 *	aren't used at the front of the free list.
 		 */
 
-		free_index = table[0].ie_next;
-		for (i = size-1; i >= osize; --i) {
-			ipc_entry_t entry = &table[i];
-
-			if (entry->ie_bits == 0) {
-				entry->ie_bits = IE_BITS_GEN_MASK;
-				entry->ie_next = free_index;
-				free_index = i;
-			}
+		free_last = (moved_last == size - 1) ? moved_prev : size - 1;
+		if (free_last != 0) {
+			table[free_last].ie_next = table[0].ie_next;
+			table[0].ie_next = free_index;
 		}
-		table[0].ie_next = free_index;
 
 		/*
 		 *	Now we need to free the old table.
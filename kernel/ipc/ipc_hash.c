@@ -50,6 +50,8 @@
 #include <vm/vm_map.h>
 #include <vm/vm_kern.h>
 #include <vm/vm_user.h>
+#include <kern/processor.h>
+#include <kern/task.h>
 #endif
 
 
@@ -72,8 +74,8 @@ ipc_hash_lookup(space, obj, namep, entryp)
 {
 	return (ipc_hash_local_lookup(space, obj, namep, entryp) ||
 		((space->is_tree_hash > 0) &&
-		 ipc_hash_global_lookup(space, obj, namep,
-					(ipc_tree_entry_t *) entryp)));
+		 ipc_hash_tree_lookup(space, obj, namep,
+				      (ipc_tree_entry_t *) entryp)));
 }
 
 /*
@@ -99,8 +101,8 @@ ipc_hash_insert(
 	    (entry == &space->is_table[index]))
 		ipc_hash_local_insert(space, obj, index, entry);
 	else
-		ipc_hash_global_insert(space, obj, name,
-				       (ipc_tree_entry_t) entry);
+		ipc_hash_tree_insert(space, obj, name,
+				     (ipc_tree_entry_t) entry);
 }
 
 /*
@@ -125,112 +127,275 @@ ipc_hash_delete(
 	    (entry == &space->is_table[index]))
 		ipc_hash_local_delete(space, obj, index, entry);
 	else
-		ipc_hash_global_delete(space, obj, name,
-				       (ipc_tree_entry_t) entry);
+		ipc_hash_tree_delete(space, obj, name,
+				     (ipc_tree_entry_t) entry);
 }
 
 /*
- *	The global reverse hash table holds splay tree entries.
- *	It is a simple open-chaining hash table with singly-linked buckets.
- *	Each bucket is locked separately, with an exclusive lock.
- *	Within each bucket, move-to-front is used.
+ *	Each space also has a reverse hash table for its splay tree
+ *	entries.  It is a simple open-chaining hash table with
+ *	singly-linked buckets (linked through ite_next), keyed by
+ *	the object alone.  It is protected by the space lock, so
+ *	lookups, which don't reorder the buckets, can run under
+ *	a read lock, and spaces don't contend with each other.
+ *
+ *	The bucket array starts small and doubles when the average
+ *	chain gets longer than IH_TREE_LOAD.  ipc_entry_alloc_name
+ *	calls ipc_hash_tree_reserve before it adds a tree entry,
+ *	while the space is unlocked, so the array can be grown to
+ *	any size with kalloc.  Insertion also grows small arrays
+ *	itself, if kget can find the memory without blocking.
  */
 
 typedef natural_t ipc_hash_index_t;
 
-ipc_hash_index_t ipc_hash_global_size;
-ipc_hash_index_t ipc_hash_global_mask;
+#define	IH_TREE_MIN_SIZE	8
+#define	IH_TREE_GET_SIZE	(PAGE_SIZE / 2 / sizeof(ipc_tree_entry_t))
+#define	IH_TREE_LOAD		2
+
+#define IH_TREE_HASH(obj, size)						\
+	((((ipc_hash_index_t) ((vm_offset_t)obj)) >> 6) & ((size) - 1))
+
+#define	ih_tree_alloc(size)						\
+	((ipc_tree_entry_t *) kalloc((size) * sizeof(ipc_tree_entry_t)))
+#define	ih_tree_get(size)						\
+	((ipc_tree_entry_t *) kget((size) * sizeof(ipc_tree_entry_t)))
+#define	ih_tree_free(size, buckets)					\
+	kfree((vm_offset_t) (buckets), (size) * sizeof(ipc_tree_entry_t))
+
+/*
+ *	Routine:	ipc_hash_tree_init
+ *	Purpose:
+ *		Allocates the tree reverse hash table of a new space.
+ *	Conditions:
+ *		Nothing locked.  Allocates memory.
+ *	Returns:
+ *		KERN_SUCCESS		Allocated the table.
+ *		KERN_RESOURCE_SHORTAGE	Couldn't allocate memory.
+ */
+
+kern_return_t
+ipc_hash_tree_init(
+	ipc_space_t	space)
+{
+	ipc_tree_entry_t *buckets;
+	ipc_hash_index_t i;
+
+	buckets = ih_tree_alloc(IH_TREE_MIN_SIZE);
+	if (buckets == (ipc_tree_entry_t *) 0)
+		return KERN_RESOURCE_SHORTAGE;
+
+	for (i = 0; i < IH_TREE_MIN_SIZE; i++)
+		buckets[i] = ITE_NULL;
+
+	space->is_tree_hash_table = buckets;
+	space->is_tree_hash_size = IH_TREE_MIN_SIZE;
+	return KERN_SUCCESS;
+}
+
+/*
+ *	Routine:	ipc_hash_tree_destroy
+ *	Purpose:
+ *		Frees the tree reverse hash table of a dead space.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+void
+ipc_hash_tree_destroy(
+	ipc_space_t	space)
+{
+	assert(space->is_tree_hash == 0);
+
+	ih_tree_free(space->is_tree_hash_size, space->is_tree_hash_table);
+}
+
+/*
+ *	Routine:	ipc_hash_tree_rehash
+ *	Purpose:
+ *		Moves the entries of the tree reverse hash table
+ *		into a new, larger, empty bucket array.  Returns
+ *		the old array, for the caller to free.
+ *	Conditions:
+ *		The space must be write-locked.
+ */
+
+static ipc_tree_entry_t *
+ipc_hash_tree_rehash(
+	ipc_space_t		space,
+	ipc_tree_entry_t	*buckets,
+	ipc_hash_index_t	size)
+{
+	ipc_tree_entry_t *obuckets;
+	ipc_hash_index_t osize, i;
+
+	osize = space->is_tree_hash_size;
+	obuckets = space->is_tree_hash_table;
+	for (i = 0; i < osize; i++) {
+		ipc_tree_entry_t this, next;
+
+		for (this = obuckets[i]; this != ITE_NULL; this = next) {
+			ipc_tree_entry_t *bucket;
+
+			next = this->ite_next;
+			bucket = &buckets[IH_TREE_HASH(this->ite_object, size)];
+			this->ite_next = *bucket;
+			*bucket = this;
+		}
+	}
+
+	space->is_tree_hash_table = buckets;
+	space->is_tree_hash_size = size;
+
+	return obuckets;
+}
+
+/*
+ *	Routine:	ipc_hash_tree_grow
+ *	Purpose:
+ *		Doubles the number of buckets, if memory
+ *		can be had without blocking.
+ *	Conditions:
+ *		The space must be write-locked.
+ */
+
+static void
+ipc_hash_tree_grow(
+	ipc_space_t	space)
+{
+	ipc_tree_entry_t *buckets;
+	ipc_hash_index_t size, i;
+
+	/*
+	 *	The old array is smaller than the new one, so
+	 *	less than kalloc_max, and kfree won't block.
+	 */
+
+	size = space->is_tree_hash_size << 1;
+
+	buckets = ih_tree_get(size);
+	if (buckets == (ipc_tree_entry_t *) 0)
+		return;
+
+	for (i = 0; i < size; i++)
+		buckets[i] = ITE_NULL;
+
+	ih_tree_free(size >> 1, ipc_hash_tree_rehash(space, buckets, size));
+}
+
+/*
+ *	Routine:	ipc_hash_tree_reserve
+ *	Purpose:
+ *		Grows the tree reverse hash table, if needed,
+ *		so that it can hold count entries with chains
+ *		of IH_TREE_LOAD entries on average.
+ *	Conditions:
+ *		Nothing locked.  Allocates memory.
+ */
+
+void
+ipc_hash_tree_reserve(
+	ipc_space_t	space,
+	ipc_entry_num_t	count)
+{
+	ipc_tree_entry_t *buckets, *obuckets;
+	ipc_hash_index_t size, osize, i;
+
+	/* an unlocked peek, to skip the common case cheaply */
+
+	if (count <= IH_TREE_LOAD * space->is_tree_hash_size)
+		return;
+
+	is_write_lock(space);
+	if (!space->is_active) {
+		is_write_unlock(space);
+		return;
+	}
+	for (size = space->is_tree_hash_size;
+	     count > IH_TREE_LOAD * size;
+	     size <<= 1)
+		continue;
+	is_write_unlock(space);
 
-#define IH_GLOBAL_HASH(space, obj)					\
-	(((((ipc_hash_index_t) ((vm_offset_t)space)) >> 4) +		\
-	  (((ipc_hash_index_t) ((vm_offset_t)obj)) >> 6)) &		\
-	 ipc_hash_global_mask)
+	buckets = ih_tree_alloc(size);
+	if (buckets == (ipc_tree_entry_t *) 0)
+		return;
 
-typedef struct ipc_hash_global_bucket {
-	decl_simple_lock_data(, ihgb_lock_data)
-	ipc_tree_entry_t ihgb_head;
-} *ipc_hash_global_bucket_t;
+	for (i = 0; i < size; i++)
+		buckets[i] = ITE_NULL;
 
-#define	IHGB_NULL	((ipc_hash_global_bucket_t) 0)
+	/*
+	 *	Someone else may have grown the table,
+	 *	or the space may have died, meanwhile.
+	 */
 
-#define	ihgb_lock_init(ihgb)	simple_lock_init(&(ihgb)->ihgb_lock_data)
-#define	ihgb_lock(ihgb)		simple_lock(&(ihgb)->ihgb_lock_data)
-#define	ihgb_unlock(ihgb)	simple_unlock(&(ihgb)->ihgb_lock_data)
+	is_write_lock(space);
+	if (!space->is_active || (space->is_tree_hash_size >= size)) {
+		is_write_unlock(space);
+		ih_tree_free(size, buckets);
+		return;
+	}
+	osize = space->is_tree_hash_size;
+	obuckets = ipc_hash_tree_rehash(space, buckets, size);
+	is_write_unlock(space);
 
-ipc_hash_global_bucket_t ipc_hash_global_table;
+	ih_tree_free(osize, obuckets);
+}
 
 /*
- *	Routine:	ipc_hash_global_lookup
+ *	Routine:	ipc_hash_tree_lookup
  *	Purpose:
  *		Converts (space, obj) -> (name, entry).
- *		Looks in the global table, for splay tree entries.
+ *		Looks in the space's tree table, for splay tree entries.
  *		Returns TRUE if an entry was found.
  *	Conditions:
  *		The space must be locked (read or write) throughout.
  */
 
 boolean_t
-ipc_hash_global_lookup(
+ipc_hash_tree_lookup(
 	ipc_space_t		space,
 	ipc_object_t		obj,
 	mach_port_t		*namep,
 	ipc_tree_entry_t	*entryp)
 {
-	ipc_hash_global_bucket_t bucket;
-	ipc_tree_entry_t this, *last;
+	ipc_tree_entry_t this;
 
 	assert(space != IS_NULL);
 	assert(obj != IO_NULL);
 
-	bucket = &ipc_hash_global_table[IH_GLOBAL_HASH(space, obj)];
-	ihgb_lock(bucket);
-
-	if ((this = bucket->ihgb_head) != ITE_NULL) {
-		if ((this->ite_object == obj) &&
-		    (this->ite_space == space)) {
-			/* found it at front; no need to move */
+	for (this = space->is_tree_hash_table[
+			IH_TREE_HASH(obj, space->is_tree_hash_size)];
+	     this != ITE_NULL;
+	     this = this->ite_next) {
+		if (this->ite_object == obj) {
+			assert(this->ite_space == space);
 
 			*namep = this->ite_name;
 			*entryp = this;
-		} else for (last = &this->ite_next;
-			    (this = *last) != ITE_NULL;
-			    last = &this->ite_next) {
-			if ((this->ite_object == obj) &&
-			    (this->ite_space == space)) {
-				/* found it; move to front */
-
-				*last = this->ite_next;
-				this->ite_next = bucket->ihgb_head;
-				bucket->ihgb_head = this;
-
-				*namep = this->ite_name;
-				*entryp = this;
-				break;
-			}
+			return TRUE;
 		}
 	}
 
-	ihgb_unlock(bucket);
-	return this != ITE_NULL;
+	return FALSE;
 }
 
 /*
- *	Routine:	ipc_hash_global_insert
+ *	Routine:	ipc_hash_tree_insert
  *	Purpose:
- *		Inserts an entry into the global reverse hash table.
+ *		Inserts an entry into the space's tree reverse hash table.
  *	Conditions:
  *		The space must be write-locked.
  */
 
 void
-ipc_hash_global_insert(
+ipc_hash_tree_insert(
 	ipc_space_t		space,
 	ipc_object_t		obj,
 	mach_port_t		name,
 	ipc_tree_entry_t	entry)
 {
-	ipc_hash_global_bucket_t bucket;
-
+	ipc_tree_entry_t *bucket;
 
 	assert(entry->ite_name == name);
 	assert(space != IS_NULL);
@@ -241,33 +406,34 @@ ipc_hash_global_insert(
 	space->is_tree_hash++;
 	assert(space->is_tree_hash <= space->is_tree_total);
 
-	bucket = &ipc_hash_global_table[IH_GLOBAL_HASH(space, obj)];
-	ihgb_lock(bucket);
+	if ((space->is_tree_hash >
+	     IH_TREE_LOAD * space->is_tree_hash_size) &&
+	    (space->is_tree_hash_size < IH_TREE_GET_SIZE))
+		ipc_hash_tree_grow(space);
 
 	/* insert at front of bucket */
 
-	entry->ite_next = bucket->ihgb_head;
-	bucket->ihgb_head = entry;
-
-	ihgb_unlock(bucket);
+	bucket = &space->is_tree_hash_table[
+			IH_TREE_HASH(obj, space->is_tree_hash_size)];
+	entry->ite_next = *bucket;
+	*bucket = entry;
 }
 
 /*
- *	Routine:	ipc_hash_global_delete
+ *	Routine:	ipc_hash_tree_delete
  *	Purpose:
- *		Deletes an entry from the global reverse hash table.
+ *		Deletes an entry from the space's tree reverse hash table.
  *	Conditions:
  *		The space must be write-locked.
  */
 
 void
-ipc_hash_global_delete(
+ipc_hash_tree_delete(
 	ipc_space_t		space,
 	ipc_object_t		obj,
 	mach_port_t		name,
 	ipc_tree_entry_t	entry)
 {
-	ipc_hash_global_bucket_t bucket;
 	ipc_tree_entry_t this, *last;
 
 	assert(entry->ite_name == name);
@@ -279,10 +445,8 @@ ipc_hash_global_delete(
 	assert(space->is_tree_hash > 0);
 	space->is_tree_hash--;
 
-	bucket = &ipc_hash_global_table[IH_GLOBAL_HASH(space, obj)];
-	ihgb_lock(bucket);
-
-	for (last = &bucket->ihgb_head;
+	for (last = &space->is_tree_hash_table[
+			IH_TREE_HASH(obj, space->is_tree_hash_size)];
 	     (this = *last) != ITE_NULL;
 	     last = &this->ite_next) {
 		if (this == entry) {
@@ -293,14 +457,48 @@ ipc_hash_global_delete(
 		}
 	}
 	assert(this != ITE_NULL);
+}
+
+#if	MACH_IPC_DEBUG
+
+/*
+ *	Routine:	ipc_hash_tree_histogram
+ *	Purpose:
+ *		Adds the chain lengths of the space's
+ *		tree reverse hash table to the histogram.
+ *	Conditions:
+ *		The space must be locked (read or write).
+ */
+
+static void
+ipc_hash_tree_histogram(
+	ipc_space_t		space,
+	hash_info_histogram_t	histogram)
+{
+	ipc_hash_index_t i;
+
+	for (i = 0; i < space->is_tree_hash_size; i++) {
+		unsigned int length = 0;
+		ipc_tree_entry_t this;
 
-	ihgb_unlock(bucket);
+		for (this = space->is_tree_hash_table[i];
+		     this != ITE_NULL;
+		     this = this->ite_next)
+			length++;
+
+		if (length >= HASH_INFO_HISTOGRAM_SIZE)
+			length = HASH_INFO_HISTOGRAM_SIZE - 1;
+		histogram[length]++;
+	}
 }
 
+#endif	/* MACH_IPC_DEBUG */
+
 /*
  *	Each space has a local reverse hash table, which holds
- *	entries from the space's table.  In fact, the hash table
- *	just uses a field (ie_index) in the table itself.
+ *	entries from the space's table.  It is an array of table
+ *	indices (is_hash_table), kept apart from the table itself,
+ *	so that growing the table needn't rehash the entries in it.
  *
  *	The local hash table is an open-addressing hash table,
  *	which means that when a collision occurs, instead of
@@ -310,25 +508,180 @@ ipc_hash_global_delete(
  *	This simple rehash makes deletions tractable (they're still a pain),
  *	but it means that collisions tend to build up into clumps.
  *
- *	Because at least one entry in the table (index 0) is always unused,
- *	there will always be room in the reverse hash table.  If a table
- *	with n slots gets completely full, the reverse hash table will
- *	have one giant clump of n-1 slots and one free slot somewhere.
- *	Because entries are only entered into the reverse table if they
- *	are pure send rights (not receive, send-once, port-set,
- *	or dead-name rights), and free entries of course aren't entered,
- *	I expect the reverse hash table won't get unreasonably full.
+ *	The hash size is a power of two, and ipc_entry_grow_table
+ *	keeps it at least as large as the table.  Index 0 of the table
+ *	is never hashed, so there is always a free slot.  Because entries
+ *	are only entered into the reverse table if they are pure send
+ *	rights (not receive, send-once, port-set, or dead-name rights),
+ *	and free entries of course aren't entered, I expect the reverse
+ *	hash table won't get unreasonably full.
  *
- *	Ordered hash tables (Amble & Knuth, Computer Journal, v. 17, no. 2,
- *	pp. 135-142.) may be desirable here.  They can dramatically help
- *	unsuccessful lookups.  But unsuccessful lookups are almost always
- *	followed by insertions, and those slow down somewhat.  They
- *	also can help deletions somewhat.  Successful lookups aren't affected.
- *	So possibly a small win; probably nothing significant.
+ *	When the table grows, ipc_entry_grow_table allocates a larger
+ *	hash while the space is unlocked, and makes the current hash
+ *	the old one (is_hash_old).  New entries go into the new hash.
+ *	The old hash is drained into the new one a few slots at a time
+ *	by later insertions, deletions and allocations, and lookups
+ *	consult both until is_hash_migrate reaches is_hash_old_size.
+ *	Nothing is ever shifted in the old hash: drained and deleted
+ *	slots are marked with IH_LOCAL_TOMBSTONE, which probes skip.
  */
 
 #define	IH_LOCAL_HASH(obj, size)				\
-		((((mach_port_index_t) (obj)) >> 6) % (size))
+		((((mach_port_index_t) (obj)) >> 6) & ((size) - 1))
+
+#define	IH_LOCAL_TOMBSTONE	((mach_port_index_t) ~0)
+
+/*
+ *	Routine:	ipc_hash_local_probe
+ *	Purpose:
+ *		Searches one local hash array for obj.
+ *		Returns the table index, or zero if not found,
+ *		and the hash slot in *hindexp.
+ */
+
+static mach_port_index_t
+ipc_hash_local_probe(
+	mach_port_index_t	*hash,
+	ipc_entry_num_t		hsize,
+	ipc_entry_t		table,
+	ipc_object_t		obj,
+	mach_port_index_t	*hindexp)
+{
+	mach_port_index_t hindex, index;
+
+	hindex = IH_LOCAL_HASH(obj, hsize);
+
+	/*
+	 *	Ideally, hash[hindex] is the index we want.
+	 *	However, must check ie_object to verify this,
+	 *	because collisions can happen.  In case of a collision,
+	 *	search farther along in the clump.
+	 */
+
+	while ((index = hash[hindex]) != 0) {
+		if ((index != IH_LOCAL_TOMBSTONE) &&
+		    (table[index].ie_object == obj)) {
+			*hindexp = hindex;
+			return index;
+		}
+
+		hindex = (hindex + 1) & (hsize - 1);
+	}
+
+	return 0;
+}
+
+/*
+ *	Routine:	ipc_hash_local_enter
+ *	Purpose:
+ *		Puts a table index into the current local hash.
+ *	Conditions:
+ *		The space must be write-locked.
+ */
+
+static void
+ipc_hash_local_enter(
+	ipc_space_t		space,
+	ipc_object_t		obj,
+	mach_port_index_t	index)
+{
+	mach_port_index_t *hash;
+	ipc_entry_num_t hsize;
+	mach_port_index_t hindex;
+
+	hash = space->is_hash_table;
+	hsize = space->is_hash_size;
+	hindex = IH_LOCAL_HASH(obj, hsize);
+
+	/*
+	 *	We want to insert at hindex, but there may be collisions.
+	 *	If a collision occurs, search for the end of the clump
+	 *	and insert there.
+	 */
+
+	while (hash[hindex] != 0)
+		hindex = (hindex + 1) & (hsize - 1);
+
+	hash[hindex] = index;
+}
+
+/*
+ *	Routine:	ipc_hash_local_migrate
+ *	Purpose:
+ *		Drains up to "count" slots of the old local hash
+ *		into the current one.
+ *	Conditions:
+ *		The space must be write-locked.
+ */
+
+void
+ipc_hash_local_migrate(
+	ipc_space_t		space,
+	ipc_entry_num_t		count)
+{
+	mach_port_index_t *ohash = space->is_hash_old;
+	ipc_entry_t table = space->is_table;
+
+	while ((count-- > 0) &&
+	       (space->is_hash_migrate < space->is_hash_old_size)) {
+		mach_port_index_t *slot = &ohash[space->is_hash_migrate++];
+		mach_port_index_t index = *slot;
+
+		if ((index != 0) && (index != IH_LOCAL_TOMBSTONE)) {
+			ipc_hash_local_enter(space, table[index].ie_object,
+					     index);
+			*slot = IH_LOCAL_TOMBSTONE;
+		}
+	}
+}
+
+/*
+ *	Routine:	ipc_hash_local_alloc
+ *	Purpose:
+ *		Allocates an empty local hash with room
+ *		for a table of the given size.
+ *		Returns the number of slots in *hsizep.
+ *	Conditions:
+ *		Nothing locked.  Allocates memory.
+ */
+
+mach_port_index_t *
+ipc_hash_local_alloc(
+	ipc_entry_num_t		size,
+	ipc_entry_num_t		*hsizep)
+{
+	mach_port_index_t *hash;
+	ipc_entry_num_t hsize;
+
+	for (hsize = 1; hsize < size; hsize <<= 1)
+		continue;
+
+	hash = (mach_port_index_t *)
+		ipc_table_alloc(hsize * sizeof(mach_port_index_t));
+	if (hash != 0)
+		(void) memset((void *) hash, 0,
+			      hsize * sizeof(mach_port_index_t));
+
+	*hsizep = hsize;
+	return hash;
+}
+
+/*
+ *	Routine:	ipc_hash_local_free
+ *	Purpose:
+ *		Frees a local hash allocated by ipc_hash_local_alloc.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+void
+ipc_hash_local_free(
+	mach_port_index_t	*hash,
+	ipc_entry_num_t		hsize)
+{
+	ipc_table_free(hsize * sizeof(mach_port_index_t),
+		       (vm_offset_t) hash);
+}
 
 /*
  *	Routine:	ipc_hash_local_lookup
@@ -348,37 +701,26 @@ ipc_hash_local_lookup(
 	ipc_entry_t	*entryp)
 {
 	ipc_entry_t table;
-	ipc_entry_num_t size;
 	mach_port_index_t hindex, index;
 
 	assert(space != IS_NULL);
 	assert(obj != IO_NULL);
 
 	table = space->is_table;
-	size = space->is_table_size;
-	hindex = IH_LOCAL_HASH(obj, size);
-
-	/*
-	 *	Ideally, table[hindex].ie_index is the name we want.
-	 *	However, must check ie_object to verify this,
-	 *	because collisions can happen.  In case of a collision,
-	 *	search farther along in the clump.
-	 */
-
-	while ((index = table[hindex].ie_index) != 0) {
-		ipc_entry_t entry = &table[index];
-
-		if (entry->ie_object == obj) {
-			*namep = MACH_PORT_MAKEB(index, entry->ie_bits);
-			*entryp = entry;
-			return TRUE;
-		}
-
-		if (++hindex == size)
-			hindex = 0;
-	}
-
-	return FALSE;
+	index = ipc_hash_local_probe(space->is_hash_table,
+				     space->is_hash_size,
+				     table, obj, &hindex);
+	if ((index == 0) &&
+	    (space->is_hash_migrate < space->is_hash_old_size))
+		index = ipc_hash_local_probe(space->is_hash_old,
+					     space->is_hash_old_size,
+					     table, obj, &hindex);
+	if (index == 0)
+		return FALSE;
+
+	*namep = MACH_PORT_MAKEB(index, table[index].ie_bits);
+	*entryp = &table[index];
+	return TRUE;
 }
 
 /*
@@ -396,33 +738,14 @@ ipc_hash_local_insert(
 	mach_port_index_t	index,
 	ipc_entry_t		entry)
 {
-	ipc_entry_t table;
-	ipc_entry_num_t size;
-	mach_port_index_t hindex;
-
 	assert(index != 0);
 	assert(space != IS_NULL);
 	assert(obj != IO_NULL);
-
-	table = space->is_table;
-	size = space->is_table_size;
-	hindex = IH_LOCAL_HASH(obj, size);
-
-	assert(entry == &table[index]);
+	assert(entry == &space->is_table[index]);
 	assert(entry->ie_object == obj);
 
-	/*
-	 *	We want to insert at hindex, but there may be collisions.
-	 *	If a collision occurs, search for the end of the clump
-	 *	and insert there.
-	 */
-
-	while (table[hindex].ie_index != 0) {
-		if (++hindex == size)
-			hindex = 0;
-	}
-
-	table[hindex].ie_index = index;
+	ipc_hash_local_migrate(space, IH_LOCAL_MIGRATE);
+	ipc_hash_local_enter(space, obj, index);
 }
 
 /*
@@ -441,6 +764,7 @@ ipc_hash_local_delete(
 	ipc_entry_t		entry)
 {
 	ipc_entry_t table;
+	mach_port_index_t *hash;
 	ipc_entry_num_t size;
 	mach_port_index_t hindex, dindex;
 
@@ -449,20 +773,29 @@ ipc_hash_local_delete(
 	assert(obj != IO_NULL);
 
 	table = space->is_table;
-	size = space->is_table_size;
-	hindex = IH_LOCAL_HASH(obj, size);
-
 	assert(entry == &table[index]);
 	assert(entry->ie_object == obj);
 
+	ipc_hash_local_migrate(space, IH_LOCAL_MIGRATE);
+
 	/*
 	 *	First check we have the right hindex for this index.
 	 *	In case of collision, we have to search farther
-	 *	along in this clump.
+	 *	along in this clump.  An entry still in the old
+	 *	hash is just replaced by a tombstone.
 	 */
 
-	while (table[hindex].ie_index != index) {
-		if (table[hindex].ie_index == 0)
+	hash = space->is_hash_table;
+	size = space->is_hash_size;
+	if (ipc_hash_local_probe(hash, size, table, obj, &hindex) != index) {
+		if ((space->is_hash_migrate < space->is_hash_old_size) &&
+		    (ipc_hash_local_probe(space->is_hash_old,
+					  space->is_hash_old_size,
+					  table, obj, &hindex) == index)) {
+			space->is_hash_old[hindex] = IH_LOCAL_TOMBSTONE;
+			return;
+		}
+
 		{
 			static int gak = 0;
 			if (gak == 0)
@@ -472,12 +805,10 @@ ipc_hash_local_delete(
 			}
 			return;
 		}
-		if (++hindex == size)
-			hindex = 0;
 	}
 
 	/*
-	 *	Now we want to set table[hindex].ie_index = 0.
+	 *	Now we want to set hash[hindex] = 0.
 	 *	But if we aren't the last index in a clump,
 	 *	this might cause problems for lookups of objects
 	 *	farther along in the clump that are displaced
@@ -500,13 +831,12 @@ ipc_hash_local_delete(
 			mach_port_index_t tindex;
 			ipc_object_t tobj;
 
-			if (++dindex == size)
-				dindex = 0;
+			dindex = (dindex + 1) & (size - 1);
 			assert(dindex != hindex);
 
 			/* are we at the end of the clump? */
 
-			index = table[dindex].ie_index;
+			index = hash[dindex];
 			if (index == 0)
 				break;
 
@@ -522,61 +852,7 @@ ipc_hash_local_delete(
 				break;
 		}
 
-		table[hindex].ie_index = index;
-	}
-}
-
-/*
- *	Routine:	ipc_hash_init
- *	Purpose:
- *		Initialize the reverse hash table implementation.
- */
-
-void
-ipc_hash_init(void)
-{
-	ipc_hash_index_t i;
-
-	/* if not configured, initialize ipc_hash_global_size */
-
-	if (ipc_hash_global_size == 0) {
-		ipc_hash_global_size = ipc_tree_entry_max >> 8;
-		if (ipc_hash_global_size < 32)
-			ipc_hash_global_size = 32;
-	}
-
-	/* make sure it is a power of two */
-
-	ipc_hash_global_mask = ipc_hash_global_size - 1;
-	if ((ipc_hash_global_size & ipc_hash_global_mask) != 0) {
-		natural_t bit;
-
-		/* round up to closest power of two */
-
-		for (bit = 1;; bit <<= 1) {
-			ipc_hash_global_mask |= bit;
-			ipc_hash_global_size = ipc_hash_global_mask + 1;
-
-			if ((ipc_hash_global_size & ipc_hash_global_mask) == 0)
-				break;
-		}
-	}
-
-	/* allocate ipc_hash_global_table */
-
-	ipc_hash_global_table = (ipc_hash_global_bucket_t)
-		kalloc((vm_size_t) (ipc_hash_global_size *
-				    sizeof(struct ipc_hash_global_bucket)));
-	assert(ipc_hash_global_table != IHGB_NULL);
-
-	/* and initialize it */
-
-	for (i = 0; i < ipc_hash_global_size; i++) {
-		ipc_hash_global_bucket_t bucket;
-
-		bucket = &ipc_hash_global_table[i];
-		ihgb_lock_init(bucket);
-		bucket->ihgb_head = ITE_NULL;
+		hash[hindex] = index;
 	}
 }
 
@@ -585,7 +861,11 @@ ipc_hash_init(void)
 /*
  *	Routine:	ipc_hash_info
  *	Purpose:
- *		Return information about the global reverse hash table.
+ *		Return information about the reverse hash tables
+ *		for splay tree entries.  Each space has its own,
+ *		so this returns the distribution of chain lengths
+ *		over all of them: entry i counts the buckets holding
+ *		i entries, and the last entry also counts longer chains.
  *		Fills the buffer with as much information as possible
  *		and returns the desired size of the buffer.
  *	Conditions:
@@ -593,34 +873,48 @@ ipc_hash_init(void)
  *		possibly-pageable memory.
  */
 
-
-ipc_hash_index_t
+unsigned int
 ipc_hash_info(
 	hash_info_bucket_t	*info,
 	mach_msg_type_number_t count)
 {
-	ipc_hash_index_t i;
-
-	if (ipc_hash_global_size < count)
-		count = ipc_hash_global_size;
-
-	for (i = 0; i < count; i++) {
-		ipc_hash_global_bucket_t bucket = &ipc_hash_global_table[i];
-		unsigned int bucket_count = 0;
-		ipc_tree_entry_t entry;
+	hash_info_histogram_t histogram;
+	processor_set_t pset;
+	task_t task;
+	unsigned int i;
+
+	for (i = 0; i < HASH_INFO_HISTOGRAM_SIZE; i++)
+		histogram[i] = 0;
+
+	simple_lock(&all_psets_lock);
+	queue_iterate(&all_psets, pset, processor_set_t, all_psets) {
+		pset_lock(pset);
+		queue_iterate(&pset->tasks, task, task_t, pset_tasks) {
+			ipc_space_t space;
+
+			itk_lock(task);
+			space = task->itk_space;
+			if (space != IS_NULL) {
+				is_read_lock(space);
+				if (space->is_active)
+					ipc_hash_tree_histogram(space,
+								histogram);
+				is_read_unlock(space);
+			}
+			itk_unlock(task);
+		}
+		pset_unlock(pset);
+	}
+	simple_unlock(&all_psets_lock);
 
-		ihgb_lock(bucket);
-		for (entry = bucket->ihgb_head;
-		     entry != ITE_NULL;
-		     entry = entry->ite_next)
-			bucket_count++;
-		ihgb_unlock(bucket);
+	/* don't touch pageable memory while holding locks */
 
-		/* don't touch pageable memory while holding locks */
-		info[i].hib_count = bucket_count;
-	}
+	if (count > HASH_INFO_HISTOGRAM_SIZE)
+		count = HASH_INFO_HISTOGRAM_SIZE;
+	for (i = 0; i < count; i++)
+		info[i].hib_count = histogram[i];
 
-	return ipc_hash_global_size;
+	return HASH_INFO_HISTOGRAM_SIZE;
 }
 
 #endif	/* MACH_IPC_DEBUG */
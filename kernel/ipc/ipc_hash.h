@@ -39,9 +39,6 @@
 #include <mach/boolean.h>
 #include <mach/kern_return.h>
 
-extern void
-ipc_hash_init();
-
 #if	MACH_IPC_DEBUG
 
 extern unsigned int
@@ -63,21 +60,30 @@ ipc_hash_delete(/* ipc_space_t space, ipc_object_t obj,
 
 /*
  *	For use by functions that know what they're doing:
- *	the global primitives, for splay tree entries,
+ *	the tree primitives, for splay tree entries,
  *	and the local primitives, for table entries.
  */
 
+extern kern_return_t
+ipc_hash_tree_init(/* ipc_space_t space */);
+
+extern void
+ipc_hash_tree_destroy(/* ipc_space_t space */);
+
+extern void
+ipc_hash_tree_reserve(/* ipc_space_t space, ipc_entry_num_t count */);
+
 extern boolean_t
-ipc_hash_global_lookup(/* ipc_space_t space, ipc_object_t obj,
-			  mach_port_t *namep, ipc_tree_entry_t *entryp */);
+ipc_hash_tree_lookup(/* ipc_space_t space, ipc_object_t obj,
+			mach_port_t *namep, ipc_tree_entry_t *entryp */);
 
 extern void
-ipc_hash_global_insert(/* ipc_space_t space, ipc_object_t obj,
-			  mach_port_t name, ipc_tree_entry_t entry */);
+ipc_hash_tree_insert(/* ipc_space_t space, ipc_object_t obj,
+			mach_port_t name, ipc_tree_entry_t entry */);
 
 extern void
-ipc_hash_global_delete(/* ipc_space_t space, ipc_object_t obj,
-			  mach_port_t name, ipc_tree_entry_t entry */);
+ipc_hash_tree_delete(/* ipc_space_t space, ipc_object_t obj,
+			mach_port_t name, ipc_tree_entry_t entry */);
 
 extern boolean_t
 ipc_hash_local_lookup(/* ipc_space_t space, ipc_object_t obj,
@@ -91,4 +97,19 @@ extern void
 ipc_hash_local_delete(/* ipc_space_t space, ipc_object_t obj,
 			 mach_port_index_t index, ipc_entry_t entry */);
 
+/*
+ *	Number of old local hash slots drained per operation.
+ */
+
+#define	IH_LOCAL_MIGRATE	16
+
+extern void
+ipc_hash_local_migrate(/* ipc_space_t space, ipc_entry_num_t count */);
+
+extern mach_port_index_t *
+ipc_hash_local_alloc(/* ipc_entry_num_t size, ipc_entry_num_t *hsizep */);
+
+extern void
+ipc_hash_local_free(/* mach_port_index_t *hash, ipc_entry_num_t hsize */);
+
 #endif	_IPC_IPC_HASH_H_
@@ -37,6 +37,7 @@
 #include <mach/kern_return.h>
 #include <kern/mach_param.h>
 #include <kern/ipc_host.h>
+#include <kern/ipc_kobject.h>
 #include <vm/vm_map.h>
 #include <vm/vm_kern.h>
 #include <ipc/ipc_entry.h>
@@ -117,7 +118,6 @@ ipc_bootstrap(void)
 
 	ipc_table_init();
 	ipc_notify_init();
-	ipc_hash_init();
 	ipc_marequest_init();
 }
 
@@ -136,4 +136,5 @@ ipc_init()
 				       ipc_kernel_map_size, TRUE);
 
 	ipc_host_init();
+	ipc_kobject_init();
 }
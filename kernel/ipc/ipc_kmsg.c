@@ -70,6 +70,7 @@ void ipc_msg_print(); /* forward */
 	( ( ((vm_offset_t)(x)) + (sizeof(vm_offset_t)-1) ) & ~(sizeof(vm_offset_t)-1) )
 
 ipc_kmsg_t ipc_kmsg_cache[NCPUS];
+struct ipc_kmsg_reply_pool ipc_kmsg_reply_pool[NCPUS];
 
 /*
  *	Routine:	ipc_kmsg_enqueue
@@ -480,12 +481,50 @@ ipc_kmsg_free(kmsg)
 		net_kmsg_put(kmsg);
 		break;
 
+	    case IKM_REPLY_KMSG_SIZE: {
+		register struct ipc_kmsg_reply_pool *pool = ikm_reply_pool();
+
+		if (pool->irp_count < IKM_REPLY_POOL) {
+			pool->irp_kmsgs[pool->irp_count++] = kmsg;
+			break;
+		}
+	    }
+		/* fall through */
+
 	    default:
 		kfree((vm_offset_t) kmsg, size);
 		break;
 	}
 }
 
+/*
+ *	Routine:	ipc_kmsg_reply_alloc
+ *	Purpose:
+ *		Allocate a buffer for the reply to a kernel call,
+ *		preferably from this processor's reply pool.
+ *		The kmsg is initialized with IKM_REPLY_MSG_SIZE.
+ *	Conditions:
+ *		Nothing locked.  Not called at interrupt level.
+ */
+
+ipc_kmsg_t
+ipc_kmsg_reply_alloc()
+{
+	register struct ipc_kmsg_reply_pool *pool = ikm_reply_pool();
+	ipc_kmsg_t kmsg;
+
+	if (pool->irp_count > 0)
+		kmsg = pool->irp_kmsgs[--pool->irp_count];
+	else {
+		kmsg = ikm_alloc(IKM_REPLY_MSG_SIZE);
+		if (kmsg == IKM_NULL)
+			return IKM_NULL;
+	}
+
+	ikm_init(kmsg, IKM_REPLY_MSG_SIZE);
+	return kmsg;
+}
+
 /*
  *	Routine:	ipc_kmsg_get
  *	Purpose:
@@ -1544,29 +1583,26 @@ ipc_kmsg_copyin_body(kmsg, space, map)
 			else
 				((mach_msg_type_t*)type)->msgt_name = newname;
 
-			for (i = 0; i < number; i++) {
-				mach_port_t port = (mach_port_t) objects[i];
-				ipc_object_t object;
+			kr = ipc_object_copyin_array(space, objects, number,
+						     name, &i);
+			if (kr != KERN_SUCCESS) {
+				ipc_kmsg_clean_partial(kmsg, taddr, TRUE, i);
+				return MACH_SEND_INVALID_RIGHT;
+			}
 
-				if (!MACH_PORT_VALID(port))
-					continue;
+			/* receive rights can't carry their destination */
 
-				kr = ipc_object_copyin(space, port,
-						       name, &object);
-				if (kr != KERN_SUCCESS) {
-					ipc_kmsg_clean_partial(kmsg, taddr,
-							       TRUE, i);
-					return MACH_SEND_INVALID_RIGHT;
-				}
+			if (newname == MACH_MSG_TYPE_PORT_RECEIVE) {
+				for (i = 0; i < number; i++) {
+					ipc_object_t object = objects[i];
 
-				if ((newname == MACH_MSG_TYPE_PORT_RECEIVE) &&
-				    ipc_port_check_circularity(
+					if (IO_VALID(object) &&
+					    ipc_port_check_circularity(
 							(ipc_port_t) object,
 							(ipc_port_t) dest))
-					kmsg->ikm_header.msgh_bits |=
-						MACH_MSGH_BITS_CIRCULAR;
-
-				objects[i] = object;
+						kmsg->ikm_header.msgh_bits |=
+						    MACH_MSGH_BITS_CIRCULAR;
+				}
 			}
 
 			complex = TRUE;
@@ -2391,6 +2427,108 @@ ipc_kmsg_copyout_object(space, object, msgt_name, namep)
     }
 }
 
+/*
+ *	Routine:	ipc_kmsg_copyout_objects
+ *	Purpose:
+ *		Copy-out an array of port rights, replacing each
+ *		object with its name.  This is ipc_kmsg_copyout_object
+ *		for each right, except that send rights for ports the
+ *		space already names are handled under one acquisition
+ *		of the space lock, and a run of rights for the same
+ *		port takes the port lock and updates counts once.
+ *	Conditions:
+ *		Nothing locked.
+ *	Returns:
+ *		The union of the ipc_kmsg_copyout_object returns.
+ */
+
+mach_msg_return_t
+ipc_kmsg_copyout_objects(space, objects, number, msgt_name)
+	ipc_space_t space;
+	mach_port_t *objects;
+	mach_msg_type_number_t number;
+	mach_msg_type_name_t msgt_name;
+{
+	mach_msg_return_t mr = MACH_MSG_SUCCESS;
+	mach_msg_type_number_t i, j;
+	boolean_t locked = FALSE;
+
+	for (i = 0; i < number; i = j) {
+#ifndef MIGRATING_THREADS
+		ipc_port_t port = (ipc_port_t) objects[i];
+		ipc_entry_t entry;
+		ipc_entry_bits_t bits;
+		mach_port_urefs_t urefs;
+		mach_port_t name;
+
+		if ((msgt_name != MACH_MSG_TYPE_PORT_SEND) ||
+		    !IP_VALID(port))
+			goto slow_copyout;
+
+		for (j = i + 1; j < number; j++)
+			if (objects[j] != (mach_port_t) port)
+				break;
+
+		if (!locked) {
+			is_write_lock(space);
+			if (!space->is_active) {
+				is_write_unlock(space);
+				goto slow_copyout;
+			}
+			locked = TRUE;
+		}
+
+		ip_lock(port);
+		if (!ip_active(port) ||
+		    !ipc_hash_local_lookup(space, (ipc_object_t) port,
+					   &name, &entry)) {
+			ip_unlock(port);
+			is_write_unlock(space);
+			locked = FALSE;
+			goto slow_copyout;
+		}
+
+		/*
+		 *	Copyout the send rights, adding to urefs
+		 *	up to the limit, and consume the rights.
+		 *	The space's own send right keeps the port.
+		 */
+
+		assert(port->ip_srights > j - i);
+		port->ip_srights -= j - i;
+		assert(port->ip_references > j - i);
+		port->ip_references -= j - i;
+		ip_unlock(port);
+
+		bits = entry->ie_bits;
+		assert(bits & MACH_PORT_TYPE_SEND);
+		urefs = IE_BITS_UREFS(bits) + (j - i);
+		if (urefs >= MACH_PORT_UREFS_MAX)
+			urefs = MACH_PORT_UREFS_MAX - 1;
+		entry->ie_bits = (bits &~ IE_BITS_UREFS_MASK) | urefs;
+
+		for (; i < j; i++)
+			objects[i] = name;
+		continue;
+
+	    slow_copyout:
+#endif	/* MIGRATING_THREADS */
+		if (locked) {
+			is_write_unlock(space);
+			locked = FALSE;
+		}
+
+		j = i + 1;
+		mr |= ipc_kmsg_copyout_object(space,
+					      (ipc_object_t) objects[i],
+					      msgt_name, &objects[i]);
+	}
+
+	if (locked)
+		is_write_unlock(space);
+	return mr;
+}
+
 /*
  *	Routine:	ipc_kmsg_copyout_body
  *	Purpose:
@@ -2479,13 +2617,8 @@ ipc_kmsg_copyout_body(saddr, eaddr, space, map)
 
 			/* copyout port rights carried in the message */
 
-			for (i = 0; i < number; i++) {
-				ipc_object_t object =
-					(ipc_object_t) objects[i];
-
-				mr |= ipc_kmsg_copyout_object(space, object,
-							name, &objects[i]);
-			}
+			mr |= ipc_kmsg_copyout_objects(space, objects,
+						       number, name);
 		}
 
 		if (is_inline) {
@@ -50,6 +50,15 @@
 #include <vm/vm_map.h>
 #endif	NORMA_IPC
 
+/*
+ *	On multiprocessors, a message queue can take messages from a
+ *	single sender without the port lock (see ipc/ipc_mqueue.h).
+ *	ikm_ringed marks such messages until they are received
+ *	or destroyed.
+ */
+
+#define	IMQ_RING	((NCPUS > 1) && !NORMA_IPC)
+
 /*
  *	This structure is only the header for a kmsg buffer;
  *	the actual buffer is normally larger.  The rest of the buffer
@@ -66,6 +75,9 @@ typedef struct ipc_kmsg {
 	struct ipc_kmsg *ikm_next, *ikm_prev;
 	vm_size_t ikm_size;
 	ipc_marequest_t ikm_marequest;
+#if	IMQ_RING
+	boolean_t ikm_ringed;
+#endif	IMQ_RING
 #if	NORMA_IPC
 	vm_page_t ikm_page;
 	vm_map_copy_t ikm_copy;
@@ -107,6 +119,27 @@ extern ipc_kmsg_t	ipc_kmsg_cache[NCPUS];
 #define	IKM_SAVED_KMSG_SIZE	((vm_size_t) 256)
 #define	IKM_SAVED_MSG_SIZE	ikm_less_overhead(IKM_SAVED_KMSG_SIZE)
 
+/*
+ *	Kernel calls build their replies in IKM_REPLY_KMSG_SIZE buffers.
+ *	Each processor also keeps a few of these, so that a kernel call
+ *	doesn't have to kalloc and kfree a reply every time.  Like the
+ *	kmsg cache, the pool is only used at thread level and needs no
+ *	locking.  ikm_free returns buffers of this size to the pool.
+ */
+
+#define	IKM_REPLY_KMSG_SIZE	((vm_size_t) 8192)
+#define	IKM_REPLY_MSG_SIZE	ikm_less_overhead(IKM_REPLY_KMSG_SIZE)
+#define	IKM_REPLY_POOL		4
+
+struct ipc_kmsg_reply_pool {
+	int		irp_count;
+	ipc_kmsg_t	irp_kmsgs[IKM_REPLY_POOL];
+};
+
+extern struct ipc_kmsg_reply_pool	ipc_kmsg_reply_pool[NCPUS];
+
+#define	ikm_reply_pool()	(&ipc_kmsg_reply_pool[cpu_number()])
+
 #define	ikm_alloc(size)							\
 		((ipc_kmsg_t) kalloc(ikm_plus_overhead(size)))
 
@@ -119,8 +152,15 @@ MACRO_END
 MACRO_BEGIN								\
 	(kmsg)->ikm_size = (size);					\
 	(kmsg)->ikm_marequest = IMAR_NULL;				\
+	ikm_ringed_clear(kmsg);						\
 MACRO_END
 
+#if	IMQ_RING
+#define	ikm_ringed_clear(kmsg)	((kmsg)->ikm_ringed = FALSE)
+#else	IMQ_RING
+#define	ikm_ringed_clear(kmsg)
+#endif	IMQ_RING
+
 #define	ikm_check_initialized(kmsg, size)				\
 MACRO_BEGIN								\
 	assert((kmsg)->ikm_size == (size));				\
@@ -133,7 +173,8 @@ MACRO_END
  *	requires some special handling to free.
  *
  *	ipc_kmsg_free is the non-macro form of ikm_free.
- *	It frees kmsgs of all varieties.
+ *	It frees kmsgs of all varieties, and refills the
+ *	reply pool.
  */
 
 #define	IKM_SIZE_NORMA		0
@@ -143,7 +184,8 @@ MACRO_END
 MACRO_BEGIN								\
 	register vm_size_t _size = (kmsg)->ikm_size;			\
 									\
-	if ((integer_t)_size > 0)					\
+	if (((integer_t)_size > 0) &&					\
+	    (_size != IKM_REPLY_KMSG_SIZE))				\
 		kfree((vm_offset_t) (kmsg), _size);			\
 	else								\
 		ipc_kmsg_free(kmsg);					\
@@ -238,6 +280,9 @@ ipc_kmsg_clean(/* ipc_kmsg_t */);
 extern void
 ipc_kmsg_free(/* ipc_kmsg_t */);
 
+extern ipc_kmsg_t
+ipc_kmsg_reply_alloc();
+
 extern mach_msg_return_t
 ipc_kmsg_get(/* mach_msg_header_t *, mach_msg_size_t, ipc_kmsg_t * */);
 
@@ -267,6 +312,10 @@ extern mach_msg_return_t
 ipc_kmsg_copyout_object(/* ipc_space_t, ipc_object_t,
 			   mach_msg_type_name_t, mach_port_t * */);
 
+extern mach_msg_return_t
+ipc_kmsg_copyout_objects(/* ipc_space_t, mach_port_t *,
+			    mach_msg_type_number_t, mach_msg_type_name_t */);
+
 extern mach_msg_return_t
 ipc_kmsg_copyout_body(/* vm_offset_t, vm_offset_t, ipc_space_t, vm_map_t */);
 
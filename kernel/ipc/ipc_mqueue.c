@@ -74,70 +74,264 @@ ipc_mqueue_init(
 	imq_lock_init(mqueue);
 	ipc_kmsg_queue_init(&mqueue->imq_messages);
 	ipc_thread_queue_init(&mqueue->imq_threads);
+	queue_init(&mqueue->imq_ready);
+#if	IMQ_RING
+	simple_lock_init(&mqueue->imq_ring_lock);
+	mqueue->imq_ring_head = 0;
+	mqueue->imq_ring_tail = 0;
+	mqueue->imq_ring_count = 0;
+#endif	IMQ_RING
 }
 
+#if	IMQ_RING
 /*
- *	Routine:	ipc_mqueue_move
+ *	Routine:	ipc_mqueue_deliver
  *	Purpose:
- *		Move messages from one queue (source) to another (dest).
- *		Only moves messages sent to the specified port.
+ *		Give a message to a waiting receiver, or queue it.
+ *		This is the delivery loop of ipc_mqueue_send,
+ *		for messages taken from the ring.
  *	Conditions:
- *		Both queues must be locked.
- *		(This is sufficient to manipulate port->ip_seqno.)
+ *		The message queue is locked.
+ */
+
+static void
+ipc_mqueue_deliver(
+	ipc_mqueue_t	mqueue,
+	ipc_kmsg_t	kmsg)
+{
+	ipc_port_t port = (ipc_port_t) kmsg->ikm_header.msgh_remote_port;
+	ipc_thread_queue_t receivers = &mqueue->imq_threads;
+	ipc_thread_t receiver;
+
+	for (;;) {
+		receiver = ipc_thread_queue_first(receivers);
+		if (receiver == ITH_NULL) {
+			ipc_kmsg_enqueue_macro(&mqueue->imq_messages, kmsg);
+			return;
+		}
+
+		ipc_thread_rmqueue_first_macro(receivers, receiver);
+		assert(ipc_mqueue_empty(mqueue));
+
+		if (kmsg->ikm_header.msgh_size <= receiver->ith_msize) {
+			receiver->ith_state = MACH_MSG_SUCCESS;
+			receiver->ith_kmsg = kmsg;
+			receiver->ith_seqno = port->ip_seqno++;
+			thread_go(receiver);
+			return;
+		}
+
+		receiver->ith_state = MACH_RCV_TOO_LARGE;
+		receiver->ith_msize = kmsg->ikm_header.msgh_size;
+		thread_go(receiver);
+	}
+}
+
+/*
+ *	Routine:	ipc_mqueue_ring_drain
+ *	Purpose:
+ *		Move messages posted to the ring onto the
+ *		message queue, in order, or hand them to
+ *		waiting receivers.  Called by imq_lock.
+ *	Conditions:
+ *		The message queue is locked.
  */
 
 void
-ipc_mqueue_move(
-	ipc_mqueue_t	dest,
-	ipc_mqueue_t	source,
-	ipc_port_t	port)
+ipc_mqueue_ring_drain(
+	ipc_mqueue_t	mqueue)
 {
-	ipc_kmsg_queue_t oldq, newq;
-	ipc_thread_queue_t blockedq;
-	ipc_kmsg_t kmsg, next;
-	ipc_thread_t th;
+	natural_t head = mqueue->imq_ring_head;
+	ipc_kmsg_t kmsg;
 
-	oldq = &source->imq_messages;
-	newq = &dest->imq_messages;
-	blockedq = &dest->imq_threads;
+	while (head != mqueue->imq_ring_tail) {
+		kmsg = mqueue->imq_ring[head & (IMQ_RING_SIZE - 1)];
 
-	for (kmsg = ipc_kmsg_queue_first(oldq);
-	     kmsg != IKM_NULL; kmsg = next) {
-		next = ipc_kmsg_queue_next(oldq, kmsg);
+		/* the slot may be reused once head moves past it */
 
-		/* only move messages sent to port */
+		mqueue->imq_ring_head = ++head;
+		ipc_mqueue_deliver(mqueue, kmsg);
+	}
+}
 
-		if (kmsg->ikm_header.msgh_remote_port != (mach_port_t) port)
-			continue;
+/*
+ *	Routine:	ipc_mqueue_ring_kick
+ *	Purpose:
+ *		Called by imq_unlock when messages are in the ring
+ *		and receivers are waiting.  Relocking drains the ring.
+ *	Conditions:
+ *		Nothing locked.  The caller holds a reference
+ *		for the message queue's port or set.
+ */
 
-		ipc_kmsg_rmqueue(oldq, kmsg);
+void
+ipc_mqueue_ring_kick(
+	ipc_mqueue_t	mqueue)
+{
+	counter(c_ipc_mqueue_ring_kick++);
 
-		/* before adding kmsg to newq, check for a blocked receiver */
+	do {
+		imq_lock(mqueue);
+		simple_unlock(&mqueue->imq_lock_data);
+	} while (imq_ring_pending(mqueue) &&
+		 !ipc_thread_queue_empty(&mqueue->imq_threads));
+}
 
-		while ((th = ipc_thread_dequeue(blockedq)) != ITH_NULL) {
-			assert(ipc_kmsg_queue_empty(newq));
+/*
+ *	Routine:	ipc_mqueue_ring_close
+ *	Purpose:
+ *		Wait for a sender that may be posting to the ring.
+ *		Called after a port is put in a set or deactivated;
+ *		later senders see the change and take the slow path,
+ *		and the next imq_lock drains whatever was posted.
+ *	Conditions:
+ *		The message queue is not locked.
+ */
 
-			thread_go(th);
+void
+ipc_mqueue_ring_close(
+	ipc_mqueue_t	mqueue)
+{
+	simple_lock(&mqueue->imq_ring_lock);
+	simple_unlock(&mqueue->imq_ring_lock);
+}
 
-			/* check if the receiver can handle the message */
+/*
+ *	Routine:	ipc_mqueue_ring_send
+ *	Purpose:
+ *		Try to post a message to its port's ring, without
+ *		taking the port lock.  Fails if another sender is
+ *		posting, or if the message needs the slow path:
+ *		the port is in a set, dead, owned by the kernel,
+ *		over its queue limit, or has receivers waiting.
+ *	Conditions:
+ *		Nothing locked.
+ *	Returns:
+ *		TRUE if the message was posted.
+ */
+
+static boolean_t
+ipc_mqueue_ring_send(
+	ipc_kmsg_t	kmsg)
+{
+	ipc_port_t port;
+	ipc_mqueue_t mqueue;
+	natural_t tail;
 
-			if (kmsg->ikm_header.msgh_size <= th->ith_msize) {
-				th->ith_state = MACH_MSG_SUCCESS;
-				th->ith_kmsg = kmsg;
-				th->ith_seqno = port->ip_seqno++;
+	if (kmsg->ikm_header.msgh_bits & MACH_MSGH_BITS_CIRCULAR)
+		return FALSE;
 
-				goto next_kmsg;
-			}
+	port = (ipc_port_t) kmsg->ikm_header.msgh_remote_port;
+	mqueue = &port->ip_messages;
+
+	if (!simple_lock_try(&mqueue->imq_ring_lock)) {
+		counter(c_ipc_mqueue_ring_busy++);
+		return FALSE;
+	}
+
+	/*
+	 *	These reads are racy, but ipc_mqueue_ring_close
+	 *	makes ip_active and ip_pset stable while we hold
+	 *	the ring lock, and the others are only hints.
+	 */
 
+	tail = mqueue->imq_ring_tail;
+	if (!ip_active(port) ||
+	    (port->ip_pset != IPS_NULL) ||
+	    (port->ip_receiver == ipc_space_kernel) ||
+	    (port->ip_msgcount + mqueue->imq_ring_count >=
+						port->ip_qlimit) ||
+	    !ipc_thread_queue_empty(&mqueue->imq_threads) ||
+	    (tail - mqueue->imq_ring_head == IMQ_RING_SIZE)) {
+		simple_unlock(&mqueue->imq_ring_lock);
+		return FALSE;
+	}
+
+	kmsg->ikm_ringed = TRUE;
+	mqueue->imq_ring_count++;
+	mqueue->imq_ring[tail & (IMQ_RING_SIZE - 1)] = kmsg;
+	mqueue->imq_ring_tail = tail + 1;
+
+	/*
+	 *	A receiver may have queued itself since we looked.
+	 *	If we get the lock, imq_lock_try drains the ring.
+	 *	Otherwise the holder sees the message when it unlocks.
+	 */
+
+	if (imq_lock_try(mqueue))
+		imq_unlock(mqueue);
+
+	simple_unlock(&mqueue->imq_ring_lock);
+	counter(c_ipc_mqueue_ring_send++);
+	return TRUE;
+}
+#endif	IMQ_RING
+
+/*
+ *	Routine:	ipc_mqueue_join
+ *	Purpose:
+ *		Put a port's message queue (member) into a port set's
+ *		message queue (set).  The port's messages stay on its
+ *		own queue.  Receivers waiting on the set take what
+ *		they can; if messages remain, the member goes on the
+ *		set's ready list.
+ *	Conditions:
+ *		Both queues must be locked.
+ *		(This is sufficient to manipulate port->ip_seqno.)
+ */
+
+void
+ipc_mqueue_join(
+	ipc_mqueue_t	set,
+	ipc_mqueue_t	member,
+	ipc_port_t	port)
+{
+	ipc_kmsg_queue_t kmsgs = &member->imq_messages;
+	ipc_kmsg_t kmsg;
+	ipc_thread_t th;
+
+	while (((kmsg = ipc_kmsg_queue_first(kmsgs)) != IKM_NULL) &&
+	       ((th = ipc_thread_dequeue(&set->imq_threads)) != ITH_NULL)) {
+		assert(ipc_mqueue_empty(set));
+
+		thread_go(th);
+
+		/* check if the receiver can handle the message */
+
+		if (kmsg->ikm_header.msgh_size <= th->ith_msize) {
+			ipc_kmsg_rmqueue_first_macro(kmsgs, kmsg);
+			th->ith_state = MACH_MSG_SUCCESS;
+			th->ith_kmsg = kmsg;
+			th->ith_seqno = port->ip_seqno++;
+		} else {
 			th->ith_state = MACH_RCV_TOO_LARGE;
 			th->ith_msize = kmsg->ikm_header.msgh_size;
 		}
+	}
 
-		/* didn't find a receiver to handle the message */
+	if (kmsg != IKM_NULL)
+		queue_enter(&set->imq_ready, member,
+			    ipc_mqueue_t, imq_ready_chain);
+}
 
-		ipc_kmsg_enqueue(newq, kmsg);
-	    next_kmsg:;
-	}
+/*
+ *	Routine:	ipc_mqueue_leave
+ *	Purpose:
+ *		Take a port's message queue (member) out of a port
+ *		set's message queue (set).  The port's messages are
+ *		already on its own queue.
+ *	Conditions:
+ *		Both queues must be locked.
+ */
+
+void
+ipc_mqueue_leave(
+	ipc_mqueue_t	set,
+	ipc_mqueue_t	member)
+{
+	if (!ipc_kmsg_queue_empty(&member->imq_messages))
+		queue_remove(&set->imq_ready, member,
+			     ipc_mqueue_t, imq_ready_chain);
 }
 
 /*
@@ -190,6 +384,11 @@ ipc_mqueue_send(kmsg, option, time_out)
 	port = (ipc_port_t) kmsg->ikm_header.msgh_remote_port;
 	assert(IP_VALID(port));
 
+#if	IMQ_RING
+	if (ipc_mqueue_ring_send(kmsg))
+		return MACH_MSG_SUCCESS;
+#endif	IMQ_RING
+
 	ip_lock(port);
 
 	if (port->ip_receiver == ipc_space_kernel) {
@@ -257,6 +456,7 @@ ipc_mqueue_send(kmsg, option, time_out)
 		 *	3) Message is sent to a send-once right.
 		 */
 
+		ip_msgcount_fold(port);
 		if ((port->ip_msgcount < port->ip_qlimit) ||
 		    (option & MACH_SEND_ALWAYS) ||
 		    (MACH_MSGH_BITS_REMOTE(kmsg->ikm_header.msgh_bits) ==
@@ -363,7 +563,7 @@ ipc_mqueue_send(kmsg, option, time_out)
 	 *	a set (dead or alive), then we're OK because the port
 	 *	is still a member of the set and the set won't go away
 	 *	until the port is taken out, which tries to lock the
-	 *	set's msg queue to remove the port's msgs.
+	 *	set's msg queue to take the port off its ready list.
 	 */
 
 	ip_unlock(port);
@@ -385,13 +585,14 @@ ipc_mqueue_send(kmsg, option, time_out)
 		if (receiver == ITH_NULL) {
 			/* no receivers; queue kmsg */
 
-			ipc_kmsg_enqueue_macro(&mqueue->imq_messages, kmsg);
+			ipc_mqueue_enqueue_macro(mqueue, &port->ip_messages,
+						 kmsg);
 			imq_unlock(mqueue);
 			break;
 		}
 
 		ipc_thread_rmqueue_first_macro(receivers, receiver);
-		assert(ipc_kmsg_queue_empty(&mqueue->imq_messages));
+		assert(ipc_mqueue_empty(mqueue));
 
 		if (kmsg->ikm_header.msgh_size <= receiver->ith_msize) {
 			/* got a successful receiver */
@@ -564,13 +765,14 @@ ipc_mqueue_receive(
 	mach_port_seqno_t seqno;
 
     {
-	ipc_kmsg_queue_t kmsgs = &mqueue->imq_messages;
+	ipc_kmsg_queue_t kmsgs;
 	ipc_thread_t self = current_thread();
 
 	if (resume)
 		goto after_thread_block;
 
 	for (;;) {
+		kmsgs = ipc_mqueue_next(mqueue);
 		kmsg = ipc_kmsg_queue_first(kmsgs);
 #if	NORMA_IPC
 		/*
@@ -609,6 +811,19 @@ ipc_mqueue_receive(
 			ipc_kmsg_rmqueue_first_macro(kmsgs, kmsg);
 			port = (ipc_port_t) kmsg->ikm_header.msgh_remote_port;
 			seqno = port->ip_seqno++;
+
+			if (kmsgs != &mqueue->imq_messages) {
+				ipc_mqueue_t member = &port->ip_messages;
+
+				/* send the member to the back of the line */
+
+				queue_remove(&mqueue->imq_ready, member,
+					     ipc_mqueue_t, imq_ready_chain);
+				if (!ipc_kmsg_queue_empty(kmsgs))
+					queue_enter(&mqueue->imq_ready, member,
+						    ipc_mqueue_t,
+						    imq_ready_chain);
+			}
 			break;
 		}
 
@@ -722,12 +937,16 @@ ipc_mqueue_receive(
 	assert((kmsg->ikm_header.msgh_bits & MACH_MSGH_BITS_CIRCULAR) == 0);
 
 	assert(port == (ipc_port_t) kmsg->ikm_header.msgh_remote_port);
+
+	ikm_ringed_clear(kmsg);
+
 	ip_lock(port);
 
 	if (ip_active(port)) {
 		ipc_thread_queue_t senders;
 		ipc_thread_t sender;
 
+		ip_msgcount_fold(port);
 		assert(port->ip_msgcount > 0);
 		port->ip_msgcount--;
 
@@ -38,27 +38,148 @@
 #include <kern/assert.h>
 #include <kern/lock.h>
 #include <kern/macro_help.h>
+#include <kern/queue.h>
 #include <ipc/ipc_kmsg.h>
 #include <ipc/ipc_thread.h>
 
+/*
+ *	On multiprocessors, a port's message queue also has a small
+ *	ring through which one sender at a time can post messages
+ *	without taking the port lock or the message queue lock.
+ *	The sender owns imq_ring_tail, under imq_ring_lock, which
+ *	only senders take; whoever holds the message queue lock
+ *	owns imq_ring_head.  Taking the message queue lock drains
+ *	the ring into imq_messages (or to waiting receivers), so
+ *	code holding the lock never sees the ring.
+ *
+ *	The ring is only used for an active port which is not in a
+ *	port set and has no waiting receivers.  Code that changes
+ *	the first two conditions calls ipc_mqueue_ring_close after
+ *	doing so, to wait out a sender that looked before the change.
+ *	A sender counts what it posts in imq_ring_count, which is
+ *	folded into the port's ip_msgcount (see ip_msgcount_fold),
+ *	so ringed messages count against the queue limit like any
+ *	others until they are received.
+ */
+
+#define	IMQ_RING_SIZE		8	/* must be a power of two */
+
+/*
+ *	A port in a port set keeps its messages on its own queue,
+ *	which is then protected by the set's message queue lock.
+ *	The set's queue keeps a ready list of the member queues
+ *	that have messages, linked through imq_ready_chain.
+ *	Receiving a message from the set moves its member to the
+ *	end of the ready list, so members are served round-robin,
+ *	and adding or removing a member only links or unlinks it.
+ */
+
 typedef struct ipc_mqueue {
 	decl_simple_lock_data(, imq_lock_data)
 	struct ipc_kmsg_queue imq_messages;
 	struct ipc_thread_queue imq_threads;
+	queue_head_t imq_ready;		/* set: members with messages */
+	queue_chain_t imq_ready_chain;	/* member: link in set's imq_ready */
+#if	IMQ_RING
+	decl_simple_lock_data(, imq_ring_lock)
+	volatile natural_t imq_ring_head;
+	volatile natural_t imq_ring_tail;
+	volatile natural_t imq_ring_count; /* posted, not in ip_msgcount */
+	struct ipc_kmsg * volatile imq_ring[IMQ_RING_SIZE];
+#endif	IMQ_RING
 } *ipc_mqueue_t;
 
 #define	IMQ_NULL		((ipc_mqueue_t) 0)
 
+/*
+ *	ipc_mqueue_next returns the kmsg queue holding the next
+ *	message to receive from a locked message queue.
+ */
+
+#define	ipc_mqueue_next(mq)						\
+	(queue_empty(&(mq)->imq_ready) ? &(mq)->imq_messages :		\
+	 &((ipc_mqueue_t) queue_first(&(mq)->imq_ready))->imq_messages)
+
+#define	ipc_mqueue_empty(mq)						\
+	(ipc_kmsg_queue_empty(&(mq)->imq_messages) &&			\
+	 queue_empty(&(mq)->imq_ready))
+
+/*
+ *	Queue a kmsg on a member's queue (which is the same as
+ *	the locked queue mq unless the port is in a set).
+ */
+
+#define	ipc_mqueue_enqueue_macro(mq, member, kmsg)			\
+MACRO_BEGIN								\
+	if (((member) != (mq)) &&					\
+	    ipc_kmsg_queue_empty(&(member)->imq_messages))		\
+		queue_enter(&(mq)->imq_ready, (member),			\
+			    ipc_mqueue_t, imq_ready_chain);		\
+	ipc_kmsg_enqueue_macro(&(member)->imq_messages, (kmsg));	\
+MACRO_END
+
 #define	imq_lock_init(mq)	simple_lock_init(&(mq)->imq_lock_data)
+
+#if	IMQ_RING
+
+#define	imq_ring_pending(mq)						\
+		((mq)->imq_ring_head != (mq)->imq_ring_tail)
+
+#define	imq_lock(mq)							\
+MACRO_BEGIN								\
+	simple_lock(&(mq)->imq_lock_data);				\
+	if (imq_ring_pending(mq))					\
+		ipc_mqueue_ring_drain(mq);				\
+MACRO_END
+
+#define	imq_lock_try(mq)						\
+	(simple_lock_try(&(mq)->imq_lock_data) &&			\
+	 (imq_ring_pending(mq) ?					\
+	  (ipc_mqueue_ring_drain(mq), TRUE) : TRUE))
+
+/*
+ *	After unlocking, look at the ring again.  A receiver that
+ *	queued itself just as a sender posted to the ring would
+ *	otherwise sleep with a message waiting; the sender checks
+ *	imq_threads after posting, and the unlock here orders our
+ *	check of the ring after the receiver was queued.
+ */
+
+#define	imq_unlock(mq)							\
+MACRO_BEGIN								\
+	simple_unlock(&(mq)->imq_lock_data);				\
+	if (imq_ring_pending(mq) &&					\
+	    !ipc_thread_queue_empty(&(mq)->imq_threads))		\
+		ipc_mqueue_ring_kick(mq);				\
+MACRO_END
+
+extern void
+ipc_mqueue_ring_drain(/* ipc_mqueue_t */);
+
+extern void
+ipc_mqueue_ring_kick(/* ipc_mqueue_t */);
+
+extern void
+ipc_mqueue_ring_close(/* ipc_mqueue_t */);
+
+#else	IMQ_RING
+
 #define	imq_lock(mq)		simple_lock(&(mq)->imq_lock_data)
 #define	imq_lock_try(mq)	simple_lock_try(&(mq)->imq_lock_data)
 #define	imq_unlock(mq)		simple_unlock(&(mq)->imq_lock_data)
 
+#define	ipc_mqueue_ring_close(mq)
+
+#endif	IMQ_RING
+
 extern void
 ipc_mqueue_init(/* ipc_mqueue_t */);
 
 extern void
-ipc_mqueue_move(/* ipc_mqueue_t, ipc_mqueue_t, ipc_port_t */);
+ipc_mqueue_join(/* ipc_mqueue_t, ipc_mqueue_t, ipc_port_t */);
+
+extern void
+ipc_mqueue_leave(/* ipc_mqueue_t, ipc_mqueue_t */);
 
 extern void
 ipc_mqueue_changed(/* ipc_mqueue_t, mach_msg_return_t */);
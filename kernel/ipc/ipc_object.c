@@ -435,6 +435,79 @@ ipc_object_copyin(
 	return kr;
 }
 
+/*
+ *	Routine:	ipc_object_copyin_array
+ *	Purpose:
+ *		Copyin an array of capabilities from a space,
+ *		replacing each valid name with its object.
+ *		This is ipc_object_copyin for each name, except
+ *		that the space is locked once for the whole array.
+ *	Conditions:
+ *		Nothing locked.
+ *	Returns:
+ *		As for ipc_object_copyin.  *countp is the number of
+ *		names handled; on failure, it is the index of the
+ *		name that failed, and the names before it have
+ *		been copied in.
+ */
+
+kern_return_t
+ipc_object_copyin_array(
+	ipc_space_t		space,
+	ipc_object_t		*objects,
+	mach_msg_type_number_t	number,
+	mach_msg_type_name_t	msgt_name,
+	mach_msg_type_number_t	*countp)
+{
+	mach_msg_type_number_t i;
+	kern_return_t kr = KERN_SUCCESS;
+
+	is_write_lock(space);
+
+	for (i = 0; i < number; i++) {
+		mach_port_t name = (mach_port_t) objects[i];
+		ipc_entry_t entry;
+		ipc_object_t object;
+		ipc_port_t soright;
+
+		if (!MACH_PORT_VALID(name))
+			continue;
+
+		if (!space->is_active) {
+			kr = KERN_INVALID_TASK;
+			break;
+		}
+
+		entry = ipc_entry_lookup(space, name);
+		if (entry == IE_NULL) {
+			kr = KERN_INVALID_NAME;
+			break;
+		}
+
+		kr = ipc_right_copyin(space, name, entry,
+				      msgt_name, TRUE,
+				      &object, &soright);
+		if (IE_BITS_TYPE(entry->ie_bits) == MACH_PORT_TYPE_NONE)
+			ipc_entry_dealloc(space, name, entry);
+		if (kr != KERN_SUCCESS)
+			break;
+
+		objects[i] = object;
+
+		if (soright != IP_NULL) {
+			/* can't send the notification with the space locked */
+
+			is_write_unlock(space);
+			ipc_notify_port_deleted(soright, name);
+			is_write_lock(space);
+		}
+	}
+
+	is_write_unlock(space);
+	*countp = i;
+	return kr;
+}
+
 /*
  *	Routine:	ipc_object_copyin_from_kernel
  *	Purpose:
@@ -1321,6 +1394,8 @@ char *ikot_print_array[IKOT_MAX_TYPE] = {
 	"(LOCK_SET)         ",
 	"(CLOCK)            ",
 	"(CLOCK_CTRL)       ",	/* 26 */
+	"(CHANNEL)          ",
+	"(IO_CQ)            ",
 				/* << new entries here	*/
 	"(UNKNOWN)     "	/* magic catchall	*/
 };	/* Please keep in sync with kern/ipc_kobject.h	*/
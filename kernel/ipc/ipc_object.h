@@ -141,6 +141,11 @@ extern kern_return_t
 ipc_object_copyin(/* ipc_space_t, mach_port_t,
 		     mach_msg_type_name_t, ipc_object_t * */);
 
+extern kern_return_t
+ipc_object_copyin_array(/* ipc_space_t, ipc_object_t *,
+			   mach_msg_type_number_t, mach_msg_type_name_t,
+			   mach_msg_type_number_t * */);
+
 extern void
 ipc_object_copyin_from_kernel(/* ipc_object_t, mach_msg_type_name_t */);
 
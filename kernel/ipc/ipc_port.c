@@ -78,6 +78,29 @@ ipc_port_timestamp(void)
 	return timestamp;
 }
 
+/*
+ *	Routine:	ipc_port_request_lookup
+ *	Purpose:
+ *		Find a dead-name request slot from its index.
+ *	Conditions:
+ *		The port holding the table is locked.
+ */
+
+ipc_port_request_t
+ipc_port_request_lookup(
+	ipc_port_request_table_t	table,
+	ipc_port_request_index_t	index)
+{
+	ipc_port_request_index_t n = index + IPR_CHUNK_BASE;
+	unsigned int k;
+
+	for (k = 0; (n >> k) >= 2 * IPR_CHUNK_BASE; k++)
+		continue;
+
+	assert(k < table->iprt_chunks);
+	return &table->iprt_chunk[k][n - iprt_chunk_size(k)];
+}
+
 /*
  *	Routine:	ipc_port_dnrequest
  *	Purpose:
@@ -98,7 +121,8 @@ ipc_port_dnrequest(port, name, soright, indexp)
 	ipc_port_t soright;
 	ipc_port_request_index_t *indexp;
 {
-	ipc_port_request_t ipr, table;
+	ipc_port_request_table_t table;
+	ipc_port_request_t ipr;
 	ipc_port_request_index_t index;
 
 	assert(ip_active(port));
@@ -106,17 +130,17 @@ ipc_port_dnrequest(port, name, soright, indexp)
 	assert(soright != IP_NULL);
 
 	table = port->ip_dnrequests;
-	if (table == IPR_NULL)
+	if (table == IPRT_NULL)
 		return KERN_NO_SPACE;
 
-	index = table->ipr_next;
+	index = table->iprt_free;
 	if (index == 0)
 		return KERN_NO_SPACE;
 
-	ipr = &table[index];
+	ipr = ipc_port_request_lookup(table, index);
 	assert(ipr->ipr_name == MACH_PORT_NULL);
 
-	table->ipr_next = ipr->ipr_next;
+	table->iprt_free = ipr->ipr_next;
 	ipr->ipr_name = name;
 	ipr->ipr_soright = soright;
 
@@ -127,7 +151,8 @@ ipc_port_dnrequest(port, name, soright, indexp)
 /*
  *	Routine:	ipc_port_dngrow
  *	Purpose:
- *		Grow a port's table of dead-name requests.
+ *		Grow a port's table of dead-name requests
+ *		by adding a chunk.  Existing requests stay put.
  *	Conditions:
  *		The port must be locked and active.
  *		Nothing else locked; will allocate memory.
@@ -136,33 +161,47 @@ ipc_port_dnrequest(port, name, soright, indexp)
  *		KERN_SUCCESS		Grew the table.
  *		KERN_SUCCESS		Somebody else grew the table.
  *		KERN_SUCCESS		The port died.
- *		KERN_RESOURCE_SHORTAGE	Couldn't allocate new table.
+ *		KERN_RESOURCE_SHORTAGE	Couldn't allocate new chunk.
  */
 
 kern_return_t
 ipc_port_dngrow(port)
 	ipc_port_t port;
 {
-	ipc_table_size_t its;
-	ipc_port_request_t otable, ntable;
+	ipc_port_request_table_t otable, ntable;
+	ipc_port_request_t chunk;
+	unsigned int k;
+	vm_size_t size;
 
 	assert(ip_active(port));
 
 	otable = port->ip_dnrequests;
-	if (otable == IPR_NULL)
-		its = &ipc_table_dnrequests[0];
-	else
-		its = otable->ipr_size + 1;
+	k = (otable == IPRT_NULL) ? 0 : otable->iprt_chunks;
+	if (k == IPR_CHUNK_MAX) {
+		ip_unlock(port);
+		return KERN_RESOURCE_SHORTAGE;
+	}
 
 	ip_reference(port);
 	ip_unlock(port);
 
-	if ((its->its_size == 0) ||
-	    ((ntable = it_dnrequests_alloc(its)) == IPR_NULL)) {
+	size = iprt_chunk_size(k) * sizeof(struct ipc_port_request);
+	chunk = (ipc_port_request_t) ipc_table_alloc(size);
+	if (chunk == IPR_NULL) {
 		ipc_port_release(port);
 		return KERN_RESOURCE_SHORTAGE;
 	}
 
+	ntable = IPRT_NULL;
+	if (otable == IPRT_NULL) {
+		ntable = (ipc_port_request_table_t) kalloc(sizeof *ntable);
+		if (ntable == IPRT_NULL) {
+			ipc_table_free(size, (vm_offset_t) chunk);
+			ipc_port_release(port);
+			return KERN_RESOURCE_SHORTAGE;
+		}
+	}
+
 	ip_lock(port);
 	ip_release(port);
 
@@ -170,57 +209,74 @@ ipc_port_dngrow(port)
 	 *	Check that port is still active and that nobody else
 	 *	has slipped in and grown the table on us.  Note that
 	 *	just checking port->ip_dnrequests == otable isn't
-	 *	sufficient; must check ipr_size.
+	 *	sufficient; must check iprt_chunks.
 	 */
 
 	if (ip_active(port) &&
 	    (port->ip_dnrequests == otable) &&
-	    ((otable == IPR_NULL) || (otable->ipr_size+1 == its))) {
-		ipc_table_size_t oits = 0; /* '=0' to shut up lint */
-		ipc_table_elems_t osize, nsize;
-		ipc_port_request_index_t free, i;
-
-		/* copy old table to new table */
-
-		if (otable != IPR_NULL) {
-			oits = otable->ipr_size;
-			osize = oits->its_size;
-			free = otable->ipr_next;
-
-			bcopy((char *)(otable + 1), (char *)(ntable + 1),
-			      (osize - 1) * sizeof(struct ipc_port_request));
-		} else {
-			osize = 1;
-			free = 0;
+	    ((otable == IPRT_NULL) || (otable->iprt_chunks == k))) {
+		ipc_port_request_table_t table = otable;
+		ipc_port_request_index_t free, index, base;
+
+		if (table == IPRT_NULL) {
+			table = ntable;
+			table->iprt_free = 0;
+			table->iprt_chunks = 0;
+			ntable = IPRT_NULL;
 		}
 
-		nsize = its->its_size;
-		assert(nsize > osize);
+		/* add the new chunk's elements to the free list */
 
-		/* add new elements to the new table's free list */
+		base = iprt_size(k);
+		free = table->iprt_free;
 
-		for (i = osize; i < nsize; i++) {
-			ipc_port_request_t ipr = &ntable[i];
+		for (index = iprt_size(k + 1); index-- > base;) {
+			ipc_port_request_t ipr = &chunk[index - base];
 
 			ipr->ipr_name = MACH_PORT_NULL;
+			if (index == 0)
+				break;	/* slot 0 is never used */
 			ipr->ipr_next = free;
-			free = i;
+			free = index;
 		}
 
-		ntable->ipr_next = free;
-		ntable->ipr_size = its;
-		port->ip_dnrequests = ntable;
+		table->iprt_chunk[k] = chunk;
+		table->iprt_chunks = k + 1;
+		table->iprt_free = free;
+		port->ip_dnrequests = table;
 		ip_unlock(port);
-
-		if (otable != IPR_NULL)
-			it_dnrequests_free(oits, otable);
 	} else {
 		ip_check_unlock(port);
-		it_dnrequests_free(its, ntable);
+		ipc_table_free(size, (vm_offset_t) chunk);
 	}
 
+	if (ntable != IPRT_NULL)
+		kfree((vm_offset_t) ntable, sizeof *ntable);
+
 	return KERN_SUCCESS;
 }
+
+/*
+ *	Routine:	ipc_port_dntable_free
+ *	Purpose:
+ *		Free a table of dead-name requests.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+static void
+ipc_port_dntable_free(
+	ipc_port_request_table_t	table)
+{
+	unsigned int k;
+
+	for (k = 0; k < table->iprt_chunks; k++)
+		ipc_table_free(iprt_chunk_size(k) *
+			       sizeof(struct ipc_port_request),
+			       (vm_offset_t) table->iprt_chunk[k]);
+
+	kfree((vm_offset_t) table, sizeof *table);
+}
  
 /*
  *	Routine:	ipc_port_dncancel
@@ -236,7 +292,8 @@ ipc_port_dncancel(
 	mach_port_t			name,
 	ipc_port_request_index_t	index)
 {
-	ipc_port_request_t ipr, table;
+	ipc_port_request_table_t table;
+	ipc_port_request_t ipr;
 	ipc_port_t dnrequest;
 
 	assert(ip_active(port));
@@ -244,17 +301,17 @@ ipc_port_dncancel(
 	assert(index != 0);
 
 	table = port->ip_dnrequests;
-	assert(table != IPR_NULL);
+	assert(table != IPRT_NULL);
 
-	ipr = &table[index];
+	ipr = ipc_port_request_lookup(table, index);
 	dnrequest = ipr->ipr_soright;
 	assert(ipr->ipr_name == name);
 
 	/* return ipr to the free list inside the table */
 
 	ipr->ipr_name = MACH_PORT_NULL;
-	ipr->ipr_next = table->ipr_next;
-	table->ipr_next = index;
+	ipr->ipr_next = table->iprt_free;
+	table->iprt_free = index;
 
 	return dnrequest;
 }
@@ -484,7 +541,7 @@ ipc_port_init(
 
 	port->ip_nsrequest = IP_NULL;
 	port->ip_pdrequest = IP_NULL;
-	port->ip_dnrequests = IPR_NULL;
+	port->ip_dnrequests = IPRT_NULL;
 
 	port->ip_pset = IPS_NULL;
 	port->ip_cur_target = &port->ip_target;
@@ -661,7 +718,7 @@ ipc_port_destroy(
 	ipc_kmsg_queue_t kmqueue;
 	ipc_kmsg_t kmsg;
 	ipc_thread_t sender;
-	ipc_port_request_t dnrequests;
+	ipc_port_request_table_t dnrequests;
 
 	assert(ip_active(port));
 	/* port->ip_receiver_name is garbage */
@@ -760,6 +817,7 @@ ipc_port_destroy(
 	/* destroy any queued messages */
 
 	mqueue = &port->ip_messages;
+	ipc_mqueue_ring_close(mqueue);
 	imq_lock(mqueue);
 	assert(ipc_thread_queue_empty(&mqueue->imq_threads));
 	kmqueue = &mqueue->imq_messages;
@@ -772,6 +830,7 @@ ipc_port_destroy(
 
 		ipc_port_release(port);
 		kmsg->ikm_header.msgh_remote_port = MACH_PORT_NULL;
+		ikm_ringed_clear(kmsg);
 		ipc_kmsg_destroy(kmsg);
 
 		imq_lock(mqueue);
@@ -782,34 +841,40 @@ ipc_port_destroy(
 	/* generate dead-name notifications */
 
 	dnrequests = port->ip_dnrequests;
-	if (dnrequests != IPR_NULL) {
-		ipc_table_size_t its = dnrequests->ipr_size;
-		ipc_table_elems_t size = its->its_size;
-		ipc_port_request_index_t index;
+	if (dnrequests != IPRT_NULL) {
+		unsigned int k;
+
+		/* the port is dead and unlocked; walk it a chunk at a time */
 
-		for (index = 1; index < size; index++) {
-			ipc_port_request_t ipr = &dnrequests[index];
-			mach_port_t name = ipr->ipr_name;
-			ipc_port_t soright;
+		for (k = 0; k < dnrequests->iprt_chunks; k++) {
+			ipc_port_request_t chunk = dnrequests->iprt_chunk[k];
+			ipc_table_elems_t size = iprt_chunk_size(k);
+			ipc_table_elems_t i;
 
-			if (name == MACH_PORT_NULL)
-				continue;
+			for (i = (k == 0) ? 1 : 0; i < size; i++) {
+				ipc_port_request_t ipr = &chunk[i];
+				mach_port_t name = ipr->ipr_name;
+				ipc_port_t soright;
 
-			soright = ipr->ipr_soright;
-			assert(soright != IP_NULL);
+				if (name == MACH_PORT_NULL)
+					continue;
+
+				soright = ipr->ipr_soright;
+				assert(soright != IP_NULL);
 
 #if	MACH_IPC_COMPAT
-			if (ipr_spacep(soright)) {
-				ipc_port_delete_compat(port,
+				if (ipr_spacep(soright)) {
+					ipc_port_delete_compat(port,
 						ipr_space(soright), name);
-				continue;
-			}
+					continue;
+				}
 #endif	MACH_IPC_COMPAT
 
-			ipc_notify_dead_name(soright, name);
+				ipc_notify_dead_name(soright, name);
+			}
 		}
 
-		it_dnrequests_free(its, dnrequests);
+		ipc_port_dntable_free(dnrequests);
 	}
 
 	if (ip_kotype(port) != IKOT_NONE)
@@ -1343,27 +1408,35 @@ ipc_port_alloc_compat(space, namep, portp)
 	ipc_port_t port;
 	ipc_entry_t entry;
 	mach_port_t name;
-	ipc_table_size_t its;
-	ipc_port_request_t table;
-	ipc_table_elems_t size;
+	ipc_port_request_table_t table;
+	ipc_port_request_t chunk;
 	ipc_port_request_index_t free, i;
+	vm_size_t size;
 	kern_return_t kr;
 
 	port = ip_alloc();
 	if (port == IP_NULL)
 		return KERN_RESOURCE_SHORTAGE;
 
-	its = &ipc_table_dnrequests[0];
-	table = it_dnrequests_alloc(its);
-	if (table == IPR_NULL) {
+	size = iprt_chunk_size(0) * sizeof(struct ipc_port_request);
+	table = (ipc_port_request_table_t) kalloc(sizeof *table);
+	chunk = (ipc_port_request_t) ipc_table_alloc(size);
+	if ((table == IPRT_NULL) || (chunk == IPR_NULL)) {
+		if (table != IPRT_NULL)
+			kfree((vm_offset_t) table, sizeof *table);
+		if (chunk != IPR_NULL)
+			ipc_table_free(size, (vm_offset_t) chunk);
 		ip_free(port);
 		return KERN_RESOURCE_SHORTAGE;
 	}
 
+	table->iprt_chunk[0] = chunk;
+	table->iprt_chunks = 1;
+
 	kr = ipc_entry_alloc(space, &name, &entry);
 	if (kr != KERN_SUCCESS) {
 		ip_free(port);
-		it_dnrequests_free(its, table);
+		ipc_port_dntable_free(table);
 		return kr;
 	}
 	/* space is write-locked */
@@ -1381,24 +1454,22 @@ ipc_port_alloc_compat(space, namep, portp)
 
 	ipc_port_init(port, space, name);
 
-	size = its->its_size;
-	assert(size > 1);
 	free = 0;
+	chunk[0].ipr_name = MACH_PORT_NULL;	/* never used */
 
-	for (i = 2; i < size; i++) {
-		ipc_port_request_t ipr = &table[i];
+	for (i = iprt_chunk_size(0) - 1; i > 1; i--) {
+		ipc_port_request_t ipr = &chunk[i];
 
 		ipr->ipr_name = MACH_PORT_NULL;
 		ipr->ipr_next = free;
 		free = i;
 	}
 
-	table->ipr_next = free;
-	table->ipr_size = its;
+	table->iprt_free = free;
 	port->ip_dnrequests = table;
 
-	table[1].ipr_name = name;
-	table[1].ipr_soright = ipr_spacem(space);
+	chunk[1].ipr_name = name;
+	chunk[1].ipr_soright = ipr_spacem(space);
 	is_reference(space);
 
 	*namep = name;
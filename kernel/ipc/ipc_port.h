@@ -92,7 +92,7 @@ struct ipc_port {
 
 	struct ipc_port *ip_nsrequest;
 	struct ipc_port *ip_pdrequest;
-	struct ipc_port_request *ip_dnrequests;
+	struct ipc_port_request_table *ip_dnrequests;
 
 	struct ipc_pset *ip_pset;
 	mach_port_seqno_t ip_seqno;		/* locked by message queue */
@@ -147,6 +147,28 @@ struct ipc_port {
 
 #define	ip_kotype(port)		io_kotype(&(port)->ip_object)
 
+/*
+ *	Messages posted through the message queue's ring are
+ *	counted in imq_ring_count, under the ring lock, until
+ *	someone holding the port lock folds them into ip_msgcount.
+ *	Code that tests or changes ip_msgcount folds first.
+ *	The port must be locked.
+ */
+
+#if	IMQ_RING
+#define	ip_msgcount_fold(port)						\
+MACRO_BEGIN								\
+	if ((port)->ip_messages.imq_ring_count != 0) {			\
+		simple_lock(&(port)->ip_messages.imq_ring_lock);	\
+		(port)->ip_msgcount += (port)->ip_messages.imq_ring_count; \
+		(port)->ip_messages.imq_ring_count = 0;			\
+		simple_unlock(&(port)->ip_messages.imq_ring_lock);	\
+	}								\
+MACRO_END
+#else	IMQ_RING
+#define	ip_msgcount_fold(port)
+#endif	IMQ_RING
+
 typedef ipc_table_index_t ipc_port_request_index_t;
 
 typedef struct ipc_port_request {
@@ -155,20 +177,44 @@ typedef struct ipc_port_request {
 		ipc_port_request_index_t index;
 	} notify;
 
-	union {
-		mach_port_t name;
-		struct ipc_table_size *size;
-	} name;
+	mach_port_t ipr_name;
 } *ipc_port_request_t;
 
 #define	ipr_next		notify.index
-#define	ipr_size		name.size
-
 #define	ipr_soright		notify.port
-#define	ipr_name		name.name
 
 #define	IPR_NULL		((ipc_port_request_t) 0)
 
+/*
+ *	A port's dead-name requests are kept in chunks which double
+ *	in size: chunk k holds IPR_CHUNK_BASE << k requests, so
+ *	request index i lives in the chunk where i + IPR_CHUNK_BASE
+ *	has its high bit.  Growing the table adds a chunk; requests
+ *	never move, so the indices held in ie_request stay valid
+ *	and nothing is copied.  Index 0 is never used.
+ *	Free requests are linked through ipr_next.
+ */
+
+#define	IPR_CHUNK_BASE		4
+#define	IPR_CHUNK_MAX		16
+
+typedef struct ipc_port_request_table {
+	ipc_port_request_index_t iprt_free;	/* free list */
+	unsigned int iprt_chunks;		/* chunks allocated */
+	ipc_port_request_t iprt_chunk[IPR_CHUNK_MAX];
+} *ipc_port_request_table_t;
+
+#define	IPRT_NULL		((ipc_port_request_table_t) 0)
+
+#define	iprt_chunk_size(k)	(IPR_CHUNK_BASE << (k))
+
+/* number of request indices covered by the first k chunks */
+#define	iprt_size(k)		(IPR_CHUNK_BASE * ((1 << (k)) - 1))
+
+extern ipc_port_request_t
+ipc_port_request_lookup(/* ipc_port_request_table_t,
+			   ipc_port_request_index_t */);
+
 #if	MACH_IPC_COMPAT
 /*
  *	For backwards compatibility, the ip_pdrequest field can hold a
@@ -262,14 +308,12 @@ ipc_port_dncancel(/* ipc_port_t, mach_port_t, ipc_port_request_index_t */);
 
 #define	ipc_port_dnrename(port, index, oname, nname)			\
 MACRO_BEGIN								\
-	ipc_port_request_t ipr, table;					\
+	ipc_port_request_t ipr;						\
 									\
 	assert(ip_active(port));					\
+	assert(port->ip_dnrequests != IPRT_NULL);			\
 									\
-	table = port->ip_dnrequests;					\
-	assert(table != IPR_NULL);					\
-									\
-	ipr = &table[index];						\
+	ipr = ipc_port_request_lookup(port->ip_dnrequests, index);	\
 	assert(ipr->ipr_name == oname);					\
 									\
 	ipr->ipr_name = nname;						\
@@ -145,14 +145,17 @@ ipc_pset_add(
 	port->ip_cur_target = &pset->ips_target;
 	ips_reference(pset);
 
+	/* senders posting to the port's ring must see ip_pset first */
+
+	ipc_mqueue_ring_close(&port->ip_messages);
+
 	imq_lock(&port->ip_messages);
 	imq_lock(&pset->ips_messages);
 
-	/* move messages from port's queue to the port set's queue */
+	/* the port's messages become visible through the set */
 
-	ipc_mqueue_move(&pset->ips_messages, &port->ip_messages, port);
+	ipc_mqueue_join(&pset->ips_messages, &port->ip_messages, port);
 	imq_unlock(&pset->ips_messages);
-	assert(ipc_kmsg_queue_empty(&port->ip_messages.imq_messages));
 
 	/* wake up threads waiting to receive from the port */
 
@@ -186,9 +189,9 @@ ipc_pset_remove(
 	imq_lock(&port->ip_messages);
 	imq_lock(&pset->ips_messages);
 
-	/* move messages from port set's queue to the port's queue */
+	/* the port's messages are already on its own queue */
 
-	ipc_mqueue_move(&port->ip_messages, &pset->ips_messages, port);
+	ipc_mqueue_leave(&pset->ips_messages, &port->ip_messages);
 
 	imq_unlock(&pset->ips_messages);
 	imq_unlock(&port->ip_messages);
@@ -290,7 +293,7 @@ ipc_pset_move(
  *
  *		Doesn't remove members from the port set;
  *		that happens lazily.  As members are removed,
- *		their messages are removed from the queue.
+ *		they are taken off the set's ready list.
  *	Conditions:
  *		The port_set is locked and alive.
  *		The caller has a reference, which is consumed.
@@ -340,7 +343,7 @@ ipc_pset_print(
 
 	ipc_object_print(&pset->ips_object);
 	iprintf("local_name = 0x%x\n", pset->ips_local_name);
-	iprintf("kmsgs = 0x%x", pset->ips_messages.imq_messages.ikmq_base);
+	iprintf("ready = 0x%x", queue_first(&pset->ips_messages.imq_ready));
 	printf(",rcvrs = 0x%x\n", pset->ips_messages.imq_threads.ithq_base);
 
 	indent -=2;
@@ -109,6 +109,8 @@ ipc_space_create(
 	ipc_entry_t table;
 	ipc_entry_num_t new_size;
 	mach_port_index_t index;
+	mach_port_index_t *hash;
+	ipc_entry_num_t hash_size;
 
 	space = is_alloc();
 	if (space == IS_NULL)
@@ -121,6 +123,21 @@ ipc_space_create(
 	}
 
 	new_size = initial->its_size;
+
+	hash = ipc_hash_local_alloc(new_size, &hash_size);
+	if (hash == (mach_port_index_t *) 0) {
+		it_entries_free(initial, table);
+		is_free(space);
+		return KERN_RESOURCE_SHORTAGE;
+	}
+
+	if (ipc_hash_tree_init(space) != KERN_SUCCESS) {
+		ipc_hash_local_free(hash, hash_size);
+		it_entries_free(initial, table);
+		is_free(space);
+		return KERN_RESOURCE_SHORTAGE;
+	}
+
 	memset((void *) table, 0, new_size * sizeof(struct ipc_entry));
 
 	/*
@@ -147,6 +164,11 @@ ipc_space_create(
 	space->is_table = table;
 	space->is_table_size = new_size;
 	space->is_table_next = initial+1;
+	space->is_hash_table = hash;
+	space->is_hash_size = hash_size;
+	space->is_hash_old = (mach_port_index_t *) 0;
+	space->is_hash_old_size = 0;
+	space->is_hash_migrate = 0;
 
 	ipc_splay_tree_init(&space->is_tree);
 	space->is_tree_total = 0;
@@ -283,6 +305,10 @@ ipc_space_destroy(
 	}
 
 	it_entries_free(space->is_table_next-1, table);
+	ipc_hash_local_free(space->is_hash_table, space->is_hash_size);
+	if (space->is_hash_old != (mach_port_index_t *) 0)
+		ipc_hash_local_free(space->is_hash_old,
+				    space->is_hash_old_size);
 
 	for (tentry = ipc_splay_traverse_start(&space->is_tree);
 	     tentry != ITE_NULL;
@@ -295,12 +321,13 @@ ipc_space_destroy(
 		/* use object before ipc_right_clean releases ref */
 
 		if (type == MACH_PORT_TYPE_SEND)
-			ipc_hash_global_delete(space, tentry->ite_object,
-					       name, tentry);
+			ipc_hash_tree_delete(space, tentry->ite_object,
+					     name, tentry);
 
 		ipc_right_clean(space, name, &tentry->ite_entry);
 	}
 	ipc_splay_traverse_finish(&space->is_tree);
+	ipc_hash_tree_destroy(space);
 
 #if	MACH_IPC_COMPAT
 	if (IP_VALID(space->is_notify))
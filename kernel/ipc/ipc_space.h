@@ -39,6 +39,7 @@
 #ifndef	_IPC_IPC_SPACE_H_
 #define _IPC_IPC_SPACE_H_
 
+#include <cpus.h>
 #include <mach_ipc_compat.h>
 #include <norma_ipc.h>
 
@@ -61,6 +62,10 @@
  *	is_growing marks when the table is in the process of growing.
  *	When the table is growing, it can't be freed or grown by another
  *	thread, because of krealloc/kmem_realloc's requirements.
+ *	The new part of the table and a larger reverse hash are
+ *	prepared while the space is unlocked; the old reverse hash
+ *	is then drained into the new one by later operations
+ *	(see ipc/ipc_hash.c), so growth doesn't touch the old entries.
  */
 
 typedef unsigned int ipc_space_refs_t;
@@ -69,16 +74,27 @@ struct ipc_space {
 	decl_simple_lock_data(,is_ref_lock_data)
 	ipc_space_refs_t is_references;
 
+#if	NCPUS > 1
+	lock_data_t is_lock_data;	/* read/write lock */
+#else	/* NCPUS > 1 */
 	decl_simple_lock_data(,is_lock_data)
+#endif	/* NCPUS > 1 */
 	boolean_t is_active;		/* is the space alive? */
 	boolean_t is_growing;		/* is the space growing? */
 	ipc_entry_t is_table;		/* an array of entries */
 	ipc_entry_num_t is_table_size;	/* current size of table */
 	struct ipc_table_size *is_table_next; /* info for larger table */
-	struct ipc_splay_tree is_tree;	/* a splay tree of entries */
+	mach_port_index_t *is_hash_table; /* reverse hash of table entries */
+	ipc_entry_num_t is_hash_size;	/* slots in is_hash_table */
+	mach_port_index_t *is_hash_old;	/* reverse hash being drained */
+	ipc_entry_num_t is_hash_old_size; /* slots in is_hash_old */
+	ipc_entry_num_t is_hash_migrate; /* next is_hash_old slot to drain */
+	struct ipc_splay_tree is_tree;	/* a tree of entries */
 	ipc_entry_num_t is_tree_total;	/* number of entries in the tree */
 	ipc_entry_num_t is_tree_small;	/* # of small entries in the tree */
 	ipc_entry_num_t is_tree_hash;	/* # of hashed entries in the tree */
+	struct ipc_tree_entry **is_tree_hash_table; /* their reverse hash */
+	ipc_entry_num_t is_tree_hash_size; /* buckets in is_tree_hash_table */
 
 #if	MACH_IPC_COMPAT
 	struct ipc_port *is_notify;	/* notification port */
@@ -121,6 +137,25 @@ MACRO_BEGIN								\
 		is_free(is);						\
 MACRO_END
 
+/*
+ *	On multiprocessors the space lock is a read/write lock,
+ *	so name translation (which doesn't restructure the tree)
+ *	proceeds in parallel.  It never sleeps; holders of the
+ *	space lock can't block anyway.
+ */
+
+#if	NCPUS > 1
+#define	is_lock_init(is)	lock_init(&(is)->is_lock_data, FALSE)
+
+#define	is_read_lock(is)	lock_read(&(is)->is_lock_data)
+#define is_read_unlock(is)	lock_done(&(is)->is_lock_data)
+
+#define	is_write_lock(is)	lock_write(&(is)->is_lock_data)
+#define	is_write_lock_try(is)	lock_try_write(&(is)->is_lock_data)
+#define is_write_unlock(is)	lock_done(&(is)->is_lock_data)
+
+#define	is_write_to_read_lock(is) lock_write_to_read(&(is)->is_lock_data)
+#else	/* NCPUS > 1 */
 #define	is_lock_init(is)	simple_lock_init(&(is)->is_lock_data)
 
 #define	is_read_lock(is)	simple_lock(&(is)->is_lock_data)
@@ -131,6 +166,7 @@ MACRO_END
 #define is_write_unlock(is)	simple_unlock(&(is)->is_lock_data)
 
 #define	is_write_to_read_lock(is)
+#endif	/* NCPUS > 1 */
 
 extern void ipc_space_reference(struct ipc_space *space);
 extern void ipc_space_release(struct ipc_space *space);
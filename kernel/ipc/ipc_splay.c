@@ -40,215 +40,134 @@
 #include <ipc/ipc_splay.h>
 
 /*
- *	Splay trees are self-adjusting binary search trees.
- *	They have the following attractive properties:
+ *	The "splay" tree holds those entries that don't fit into
+ *	the lookup table.  It used to be a self-adjusting splay tree
+ *	(Sleator and Tarjan, JACM v. 32, no. 3, pp. 652-686), but
+ *	splaying restructures the tree on every lookup, so even
+ *	translations needed an exclusive lock on the space.
+ *
+ *	The tree is now a treap: a binary search tree on the name
+ *	that is also heap-ordered on a priority.  The priority is
+ *	a fixed multiplicative hash of the name, so it costs no space
+ *	and the shape of the tree depends only on the set of names
+ *	it holds.  The expected depth is O(log n) whatever the
+ *	insertion order.  The operations keep the old properties:
  *		1) Space efficient; only two pointers per entry.
- *		2) Robust performance; amortized O(log n) per operation.
+ *		2) Robust performance; expected O(log n) per operation.
  *		3) Recursion not needed.
- *	This makes them a good fall-back data structure for those
- *	entries that don't fit into the lookup table.
- *
- *	The paper by Sleator and Tarjan, JACM v. 32, no. 3, pp. 652-686,
- *	describes the splaying operation.  ipc_splay_prim_lookup
- *	and ipc_splay_prim_assemble implement the top-down splay
- *	described on p. 669.
- *
- *	The tree is stored in an unassembled form.  If ist_root is null,
- *	then the tree has no entries.  Otherwise, ist_name records
- *	the value used for the last lookup.  ist_root points to the
- *	middle tree obtained from the top-down splay.  ist_ltree and
- *	ist_rtree point to left and right subtrees, whose entries
- *	are all smaller (larger) than those in the middle tree.
- *	ist_ltreep and ist_rtreep are pointers to fields in the
- *	left and right subtrees.  ist_ltreep points to the rchild field
- *	of the largest entry in ltree, and ist_rtreep points to the
- *	lchild field of the smallest entry in rtree.  The pointed-to
- *	fields aren't initialized.  If the left (right) subtree is null,
- *	then ist_ltreep (ist_rtreep) points to the ist_ltree (ist_rtree)
- *	field in the splay structure itself.
- *
- *	The primary advantage of the unassembled form is that repeated
- *	unsuccessful lookups are efficient.  In particular, an unsuccessful
- *	lookup followed by an insert only requires one splaying operation.
- *
- *	The traversal algorithm works via pointer inversion.
- *	When descending down the tree, child pointers are reversed
- *	to point back to the parent entry.  When ascending,
- *	the pointers are restored to their original value.
- *
- *	The biggest potential problem with the splay tree implementation
- *	is that the operations, even lookup, require an exclusive lock.
- *	If IPC spaces are protected with exclusive locks, then
- *	the splay tree doesn't require its own lock, and ist_lock/ist_unlock
- *	needn't do anything.  If IPC spaces are protected with read/write
- *	locks then ist_lock/ist_unlock should provide exclusive access.
  *
- *	If it becomes important to let lookups run in parallel,
- *	or if the restructuring makes lookups too expensive, then
- *	there is hope.  Use a read/write lock on the splay tree.
- *	Keep track of the number of entries in the tree.  When doing
- *	a lookup, first try a non-restructuring lookup with a read lock held,
- *	with a bound (based on log of size of the tree) on the number of
- *	entries to traverse.  If the lookup runs up against the bound,
- *	then take a write lock and do a reorganizing lookup.
- *	This way, if lookups only access roughly balanced parts
- *	of the tree, then lookups run in parallel and do no restructuring.
- *
- *	The traversal algorithm currently requires an exclusive lock.
- *	If that is a problem, the tree could be changed from an lchild/rchild
- *	representation to a leftmost child/right sibling representation.
- *	In conjunction with non-restructing lookups, this would let
- *	lookups and traversals all run in parallel.  But this representation
- *	is more complicated and would slow down the operations.
+ *	ipc_splay_tree_lookup, ipc_splay_tree_bounds and
+ *	ipc_splay_tree_pick don't modify the tree at all, so they
+ *	may run in parallel with each other under a read lock.
+ *	Insert, delete, split, join and traversals need exclusive
+ *	access; the traversal keeps its position in ist_name and
+ *	finds each successor with a fresh descent from the root.
  */
 
 /*
- *	Boundary values to hand to ipc_splay_prim_lookup:
+ *	Boundary values returned by ipc_splay_tree_bounds:
  */
 
 #define	MACH_PORT_SMALLEST	((mach_port_t) 0)
 #define MACH_PORT_LARGEST	((mach_port_t) ~0)
 
 /*
- *	Routine:	ipc_splay_prim_lookup
+ *	The priority of an entry.  Multiplication by an odd constant
+ *	is a bijection on 32 bits, so no two names tie.
+ */
+
+#define	ITE_PRIORITY(name)	((natural_t) (name) * 0x9e3779b1)
+#define	ite_priority(entry)	ITE_PRIORITY((entry)->ite_name)
+
+/*
+ *	Routine:	ipc_splay_prim_split
  *	Purpose:
- *		Searches for the node labeled name in the splay tree.
- *		Returns three nodes (treep, ltreep, rtreep) and
- *		two pointers to nodes (ltreepp, rtreepp).
- *
- *		ipc_splay_prim_lookup splits the supplied tree into
- *		three subtrees, left, middle, and right, returned
- *		in ltreep, treep, and rtreep.
- *
- *		If name is present in the tree, then it is at
- *		the root of the middle tree.  Otherwise, the root
- *		of the middle tree is the last node traversed.
- *
- *		ipc_splay_prim_lookup returns a pointer into
- *		the left subtree, to the rchild field of its
- *		largest node, in ltreepp.  It returns a pointer
- *		into the right subtree, to the lchild field of its
- *		smallest node, in rtreepp.
+ *		Splits the tree rooted at "tree" into two trees,
+ *		returned in ltreep and rtreep.  Entries smaller
+ *		than name go left; the rest go right.
  */
 
 static void
-ipc_splay_prim_lookup(
-	mach_port_t		name,
+ipc_splay_prim_split(
 	ipc_tree_entry_t	tree,
-	ipc_tree_entry_t	*treep,
+	mach_port_t		name,
 	ipc_tree_entry_t	*ltreep,
-	ipc_tree_entry_t	**ltreepp,
-	ipc_tree_entry_t	*rtreep,
-	ipc_tree_entry_t	**rtreepp)
+	ipc_tree_entry_t	*rtreep)
 {
-	mach_port_t tname;			/* temp name */
-	ipc_tree_entry_t lchild, rchild;	/* temp child pointers */
+	while (tree != ITE_NULL) {
+		if (tree->ite_name < name) {
+			*ltreep = tree;
+			ltreep = &tree->ite_rchild;
+			tree = tree->ite_rchild;
+		} else {
+			*rtreep = tree;
+			rtreep = &tree->ite_lchild;
+			tree = tree->ite_lchild;
+		}
+	}
 
-	assert(tree != ITE_NULL);
+	*ltreep = ITE_NULL;
+	*rtreep = ITE_NULL;
+}
+
+/*
+ *	Routine:	ipc_splay_prim_join
+ *	Purpose:
+ *		Joins two trees, returning the root of the result.
+ *		All entries in ltree must be smaller than
+ *		all entries in rtree.
+ */
 
-#define	link_left					\
-MACRO_BEGIN						\
-	*ltreep = tree;					\
-	ltreep = &tree->ite_rchild;			\
-	tree = *ltreep;					\
-MACRO_END
-
-#define	link_right					\
-MACRO_BEGIN						\
-	*rtreep = tree;					\
-	rtreep = &tree->ite_lchild;			\
-	tree = *rtreep;					\
-MACRO_END
-
-#define rotate_left					\
-MACRO_BEGIN						\
-	ipc_tree_entry_t temp = tree;			\
-							\
-	tree = temp->ite_rchild;			\
-	temp->ite_rchild = tree->ite_lchild;		\
-	tree->ite_lchild = temp;			\
-MACRO_END
-
-#define rotate_right					\
-MACRO_BEGIN						\
-	ipc_tree_entry_t temp = tree;			\
-							\
-	tree = temp->ite_lchild;			\
-	temp->ite_lchild = tree->ite_rchild;		\
-	tree->ite_rchild = temp;			\
-MACRO_END
-
-	while (name != (tname = tree->ite_name)) {
-		if (name < tname) {
-			/* descend to left */
-
-			lchild = tree->ite_lchild;
-			if (lchild == ITE_NULL)
-				break;
-			tname = lchild->ite_name;
-
-			if ((name < tname) &&
-			    (lchild->ite_lchild != ITE_NULL))
-				rotate_right;
-			link_right;
-			if ((name > tname) &&
-			    (lchild->ite_rchild != ITE_NULL))
-				link_left;
+static ipc_tree_entry_t
+ipc_splay_prim_join(
+	ipc_tree_entry_t	ltree,
+	ipc_tree_entry_t	rtree)
+{
+	ipc_tree_entry_t root;
+	ipc_tree_entry_t *rootp = &root;
+
+	while ((ltree != ITE_NULL) && (rtree != ITE_NULL)) {
+		if (ite_priority(ltree) > ite_priority(rtree)) {
+			*rootp = ltree;
+			rootp = &ltree->ite_rchild;
+			ltree = ltree->ite_rchild;
 		} else {
-			/* descend to right */
-
-			rchild = tree->ite_rchild;
-			if (rchild == ITE_NULL)
-				break;
-			tname = rchild->ite_name;
-
-			if ((name > tname) &&
-			    (rchild->ite_rchild != ITE_NULL))
-				rotate_left;
-			link_left;
-			if ((name < tname) &&
-			    (rchild->ite_lchild != ITE_NULL))
-				link_right;
+			*rootp = rtree;
+			rootp = &rtree->ite_lchild;
+			rtree = rtree->ite_lchild;
 		}
-
-		assert(tree != ITE_NULL);
 	}
 
-	*treep = tree;
-	*ltreepp = ltreep;
-	*rtreepp = rtreep;
-
-#undef	link_left
-#undef	link_right
-#undef	rotate_left
-#undef	rotate_right
+	*rootp = (ltree != ITE_NULL) ? ltree : rtree;
+	return root;
 }
 
 /*
- *	Routine:	ipc_splay_prim_assemble
+ *	Routine:	ipc_splay_prim_find
  *	Purpose:
- *		Assembles the results of ipc_splay_prim_lookup
- *		into a splay tree with the found node at the root.
- *
- *		ltree and rtree are by-reference so storing
- *		through ltreep and rtreep can change them.
+ *		Returns a pointer to the link that points
+ *		to the entry labeled name, or to the null link
+ *		where it would be.
  */
 
-static void
-ipc_splay_prim_assemble(
-	ipc_tree_entry_t	tree,
-	ipc_tree_entry_t	*ltree,
-	ipc_tree_entry_t	*ltreep,
-	ipc_tree_entry_t	*rtree,
-	ipc_tree_entry_t	*rtreep)
+static ipc_tree_entry_t *
+ipc_splay_prim_find(
+	ipc_splay_tree_t	splay,
+	mach_port_t		name)
 {
-	assert(tree != ITE_NULL);
-
-	*ltreep = tree->ite_lchild;
-	*rtreep = tree->ite_rchild;
+	ipc_tree_entry_t *linkp = &splay->ist_root;
+	ipc_tree_entry_t entry;
+
+	while ((entry = *linkp) != ITE_NULL) {
+		if (name < entry->ite_name)
+			linkp = &entry->ite_lchild;
+		else if (name > entry->ite_name)
+			linkp = &entry->ite_rchild;
+		else
+			break;
+	}
 
-	tree->ite_lchild = *ltree;
-	tree->ite_rchild = *rtree;
+	return linkp;
 }
 
 /*
@@ -279,16 +198,12 @@ ipc_splay_tree_pick(
 {
 	ipc_tree_entry_t root;
 
-	ist_lock(splay);
-
 	root = splay->ist_root;
 	if (root != ITE_NULL) {
 		*namep = root->ite_name;
 		*entryp = root;
 	}
 
-	ist_unlock(splay);
-
 	return root != ITE_NULL;
 }
 
@@ -297,6 +212,8 @@ ipc_splay_tree_pick(
  *	Purpose:
  *		Finds an entry in a splay tree.
  *		Returns ITE_NULL if not found.
+ *
+ *		The tree isn't modified, so a read lock suffices.
  */
 
 ipc_tree_entry_t
@@ -304,30 +221,19 @@ ipc_splay_tree_lookup(
 	ipc_splay_tree_t	splay,
 	mach_port_t		name)
 {
-	ipc_tree_entry_t root;
-
-	ist_lock(splay);
-
-	root = splay->ist_root;
-	if (root != ITE_NULL) {
-		if (splay->ist_name != name) {
-			ipc_splay_prim_assemble(root,
-				&splay->ist_ltree, splay->ist_ltreep,
-				&splay->ist_rtree, splay->ist_rtreep);
-			ipc_splay_prim_lookup(name, root, &root,
-				&splay->ist_ltree, &splay->ist_ltreep,
-				&splay->ist_rtree, &splay->ist_rtreep);
-			splay->ist_name = name;
-			splay->ist_root = root;
-		}
-
-		if (name != root->ite_name)
-			root = ITE_NULL;
+	ipc_tree_entry_t entry;
+
+	entry = splay->ist_root;
+	while (entry != ITE_NULL) {
+		if (name < entry->ite_name)
+			entry = entry->ite_lchild;
+		else if (name > entry->ite_name)
+			entry = entry->ite_rchild;
+		else
+			break;
 	}
 
-	ist_unlock(splay);
-
-	return root;
+	return entry;
 }
 
 /*
@@ -344,51 +250,30 @@ ipc_splay_tree_insert(
 	mach_port_t		name,
 	ipc_tree_entry_t	entry)
 {
-	ipc_tree_entry_t root;
-
-	assert(entry != ITE_NULL);
-
-	ist_lock(splay);
-
-	root = splay->ist_root;
-	if (root == ITE_NULL) {
-		entry->ite_lchild = ITE_NULL;
-		entry->ite_rchild = ITE_NULL;
-	} else {
-		if (splay->ist_name != name) {
-			ipc_splay_prim_assemble(root,
-				&splay->ist_ltree, splay->ist_ltreep,
-				&splay->ist_rtree, splay->ist_rtreep);
-			ipc_splay_prim_lookup(name, root, &root,
-				&splay->ist_ltree, &splay->ist_ltreep,
-				&splay->ist_rtree, &splay->ist_rtreep);
-		}
-
-		assert(root->ite_name != name);
+	ipc_tree_entry_t *linkp = &splay->ist_root;
+	ipc_tree_entry_t tree;
+	natural_t priority = ITE_PRIORITY(name);
 
-		if (name < root->ite_name) {
-			assert(root->ite_lchild == ITE_NULL);
+	assert(entry->ite_name == name);
 
-			*splay->ist_ltreep = ITE_NULL;
-			*splay->ist_rtreep = root;
-		} else {
-			assert(root->ite_rchild == ITE_NULL);
-
-			*splay->ist_ltreep = root;
-			*splay->ist_rtreep = ITE_NULL;
-		}
+	/*
+	 *	Descend until we reach an entry with lower priority;
+	 *	the new entry takes its place, and the subtree
+	 *	below is split around the new name.
+	 */
 
-		entry->ite_lchild = splay->ist_ltree;
-		entry->ite_rchild = splay->ist_rtree;
+	while (((tree = *linkp) != ITE_NULL) &&
+	       (ite_priority(tree) > priority)) {
+		assert(tree->ite_name != name);
+		if (name < tree->ite_name)
+			linkp = &tree->ite_lchild;
+		else
+			linkp = &tree->ite_rchild;
 	}
 
-	entry->ite_name = name;
-	splay->ist_root = entry;
-	splay->ist_name = name;
-	splay->ist_ltreep = &splay->ist_ltree;
-	splay->ist_rtreep = &splay->ist_rtree;
-
-	ist_unlock(splay);
+	ipc_splay_prim_split(tree, name,
+			     &entry->ite_lchild, &entry->ite_rchild);
+	*linkp = entry;
 }
 
 /*
@@ -408,59 +293,16 @@ ipc_splay_tree_delete(
 	mach_port_t		name,
 	ipc_tree_entry_t	entry)
 {
-	ipc_tree_entry_t root, saved;
+	ipc_tree_entry_t *linkp;
+	ipc_tree_entry_t tree;
 
-	ist_lock(splay);
-
-	root = splay->ist_root;
-	assert(root != ITE_NULL);
-
-	if (splay->ist_name != name) {
-		ipc_splay_prim_assemble(root,
-			&splay->ist_ltree, splay->ist_ltreep,
-			&splay->ist_rtree, splay->ist_rtreep);
-		ipc_splay_prim_lookup(name, root, &root,
-			&splay->ist_ltree, &splay->ist_ltreep,
-			&splay->ist_rtree, &splay->ist_rtreep);
-	}
-
-	assert(root->ite_name == name);
-	assert(root == entry);
-
-	*splay->ist_ltreep = root->ite_lchild;
-	*splay->ist_rtreep = root->ite_rchild;
-	ite_free(root);
-
-	root = splay->ist_ltree;
-	saved = splay->ist_rtree;
-
-	if (root == ITE_NULL)
-		root = saved;
-	else if (saved != ITE_NULL) {
-		/*
-		 *	Find the largest node in the left subtree, and splay it
-		 *	to the root.  Then add the saved right subtree.
-		 */
-
-		ipc_splay_prim_lookup(MACH_PORT_LARGEST, root, &root,
-			&splay->ist_ltree, &splay->ist_ltreep,
-			&splay->ist_rtree, &splay->ist_rtreep);
-		ipc_splay_prim_assemble(root,
-			&splay->ist_ltree, splay->ist_ltreep,
-			&splay->ist_rtree, splay->ist_rtreep);
-
-		assert(root->ite_rchild == ITE_NULL);
-		root->ite_rchild = saved;
-	}
-
-	splay->ist_root = root;
-	if (root != ITE_NULL) {
-		splay->ist_name = root->ite_name;
-		splay->ist_ltreep = &splay->ist_ltree;
-		splay->ist_rtreep = &splay->ist_rtree;
-	}
+	linkp = ipc_splay_prim_find(splay, name);
+	tree = *linkp;
+	assert(tree != ITE_NULL);
+	assert(tree == entry);
 
-	ist_unlock(splay);
+	*linkp = ipc_splay_prim_join(tree->ite_lchild, tree->ite_rchild);
+	ite_free(tree);
 }
 
 /*
@@ -479,70 +321,8 @@ ipc_splay_tree_split(
 	mach_port_t		name,
 	ipc_splay_tree_t	small)
 {
-	ipc_tree_entry_t root;
-
-	ipc_splay_tree_init(small);
-
-	ist_lock(splay);
-
-	root = splay->ist_root;
-	if (root != ITE_NULL) {
-		/* lookup name, to get it (or last traversed) to the top */
-
-		if (splay->ist_name != name) {
-			ipc_splay_prim_assemble(root,
-				&splay->ist_ltree, splay->ist_ltreep,
-				&splay->ist_rtree, splay->ist_rtreep);
-			ipc_splay_prim_lookup(name, root, &root,
-				&splay->ist_ltree, &splay->ist_ltreep,
-				&splay->ist_rtree, &splay->ist_rtreep);
-		}
-
-		if (root->ite_name < name) {
-			/* root goes into small */
-
-			*splay->ist_ltreep = root->ite_lchild;
-			*splay->ist_rtreep = ITE_NULL;
-			root->ite_lchild = splay->ist_ltree;
-			assert(root->ite_rchild == ITE_NULL);
-
-			small->ist_root = root;
-			small->ist_name = root->ite_name;
-			small->ist_ltreep = &small->ist_ltree;
-			small->ist_rtreep = &small->ist_rtree;
-
-			/* rtree goes into splay */
-
-			root = splay->ist_rtree;
-			splay->ist_root = root;
-			if (root != ITE_NULL) {
-				splay->ist_name = root->ite_name;
-				splay->ist_ltreep = &splay->ist_ltree;
-				splay->ist_rtreep = &splay->ist_rtree;
-			}
-		} else {
-			/* root stays in splay */
-
-			*splay->ist_ltreep = root->ite_lchild;
-			root->ite_lchild = ITE_NULL;
-
-			splay->ist_root = root;
-			splay->ist_name = name;
-			splay->ist_ltreep = &splay->ist_ltree;
-
-			/* ltree goes into small */
-
-			root = splay->ist_ltree;
-			small->ist_root = root;
-			if (root != ITE_NULL) {
-				small->ist_name = root->ite_name;
-				small->ist_ltreep = &small->ist_ltree;
-				small->ist_rtreep = &small->ist_rtree;
-			}
-		}		
-	}
-
-	ist_unlock(splay);
+	ipc_splay_prim_split(splay->ist_root, name,
+			     &small->ist_root, &splay->ist_root);
 }
 
 /*
@@ -558,61 +338,9 @@ ipc_splay_tree_join(
 	ipc_splay_tree_t	splay,
 	ipc_splay_tree_t	small)
 {
-	ipc_tree_entry_t sroot;
-
-	/* pull entries out of small */
-
-	ist_lock(small);
-
-	sroot = small->ist_root;
-	if (sroot != ITE_NULL) {
-		ipc_splay_prim_assemble(sroot,
-			&small->ist_ltree, small->ist_ltreep,
-			&small->ist_rtree, small->ist_rtreep);
-		small->ist_root = ITE_NULL;
-	}
-
-	ist_unlock(small);
-
-	/* put entries, if any, into splay */
-
-	if (sroot != ITE_NULL) {
-		ipc_tree_entry_t root;
-
-		ist_lock(splay);
-
-		root = splay->ist_root;
-		if (root == ITE_NULL) {
-			root = sroot;
-		} else {
-			/* get smallest entry in splay tree to top */
-
-			if (splay->ist_name != MACH_PORT_SMALLEST) {
-				ipc_splay_prim_assemble(root,
-					&splay->ist_ltree, splay->ist_ltreep,
-					&splay->ist_rtree, splay->ist_rtreep);
-				ipc_splay_prim_lookup(MACH_PORT_SMALLEST,
-					root, &root,
-					&splay->ist_ltree, &splay->ist_ltreep,
-					&splay->ist_rtree, &splay->ist_rtreep);
-			}
-
-			ipc_splay_prim_assemble(root,
-				&splay->ist_ltree, splay->ist_ltreep,
-				&splay->ist_rtree, splay->ist_rtreep);
-
-			assert(root->ite_lchild == ITE_NULL);
-			assert(sroot->ite_name < root->ite_name);
-			root->ite_lchild = sroot;
-		}
-
-		splay->ist_root = root;
-		splay->ist_name = root->ite_name;
-		splay->ist_ltreep = &splay->ist_ltree;
-		splay->ist_rtreep = &splay->ist_rtree;
-
-		ist_unlock(splay);
-	}
+	splay->ist_root = ipc_splay_prim_join(small->ist_root,
+					      splay->ist_root);
+	small->ist_root = ITE_NULL;
 }
 
 /*
@@ -637,6 +365,8 @@ ipc_splay_tree_join(
  *				and they are tight bounds on name
  *
  *		(Note MACH_PORT_SMALLEST = 0 and MACH_PORT_LARGEST = ~0.)
+ *
+ *		The tree isn't modified, so a read lock suffices.
  */
 
 void
@@ -646,66 +376,28 @@ ipc_splay_tree_bounds(
 	mach_port_t		*lowerp, 
 	mach_port_t		*upperp)
 {
-	ipc_tree_entry_t root;
-
-	ist_lock(splay);
-
-	root = splay->ist_root;
-	if (root == ITE_NULL) {
-		*lowerp = MACH_PORT_LARGEST;
-		*upperp = MACH_PORT_SMALLEST;
-	} else {
-		mach_port_t rname;
-
-		if (splay->ist_name != name) {
-			ipc_splay_prim_assemble(root,
-				&splay->ist_ltree, splay->ist_ltreep,
-				&splay->ist_rtree, splay->ist_rtreep);
-			ipc_splay_prim_lookup(name, root, &root,
-				&splay->ist_ltree, &splay->ist_ltreep,
-				&splay->ist_rtree, &splay->ist_rtreep);
-			splay->ist_name = name;
-			splay->ist_root = root;
-		}
-
-		rname = root->ite_name;
-
-		/*
-		 *	OK, it's a hack.  We convert the ltreep and rtreep
-		 *	pointers back into real entry pointers,
-		 *	so we can pick the names out of the entries.
-		 */
-
-		if (rname <= name)
-			*lowerp = rname;
-		else if (splay->ist_ltreep == &splay->ist_ltree)
-			*lowerp = MACH_PORT_LARGEST;
-		else {
-			ipc_tree_entry_t entry;
-
-			entry = (ipc_tree_entry_t)
-				((char *)splay->ist_ltreep -
-				 ((char *)&root->ite_rchild -
-				  (char *)root));
-			*lowerp = entry->ite_name;
-		}
-
-		if (rname >= name)
-			*upperp = rname;
-		else if (splay->ist_rtreep == &splay->ist_rtree)
-			*upperp = MACH_PORT_SMALLEST;
-		else {
-			ipc_tree_entry_t entry;
-
-			entry = (ipc_tree_entry_t)
-				((char *)splay->ist_rtreep -
-				 ((char *)&root->ite_lchild -
-				  (char *)root));
-			*upperp = entry->ite_name;
+	ipc_tree_entry_t entry;
+	mach_port_t lower = MACH_PORT_LARGEST;
+	mach_port_t upper = MACH_PORT_SMALLEST;
+
+	entry = splay->ist_root;
+	while (entry != ITE_NULL) {
+		mach_port_t ename = entry->ite_name;
+
+		if (name < ename) {
+			upper = ename;
+			entry = entry->ite_lchild;
+		} else if (name > ename) {
+			lower = ename;
+			entry = entry->ite_rchild;
+		} else {
+			lower = upper = ename;
+			break;
 		}
 	}
 
-	ist_unlock(splay);
+	*lowerp = lower;
+	*upperp = upper;
 }
 
 /*
@@ -725,36 +417,25 @@ ipc_splay_tree_bounds(
  *		If "delete" is TRUE, then the current entry
  *		is removed from the tree and deallocated.
  *
- *		During the traversal, the splay tree is locked.
+ *		The tree isn't restructured by the traversal itself,
+ *		but the position is kept in the tree, so the caller
+ *		needs exclusive access.
  */
 
 ipc_tree_entry_t
 ipc_splay_traverse_start(
 	ipc_splay_tree_t	splay)
 {
-	ipc_tree_entry_t current, parent;
+	ipc_tree_entry_t current;
 
 	ist_lock(splay);
 
 	current = splay->ist_root;
 	if (current != ITE_NULL) {
-		ipc_splay_prim_assemble(current,
-			&splay->ist_ltree, splay->ist_ltreep,
-			&splay->ist_rtree, splay->ist_rtreep);
-
-		parent = ITE_NULL;
-
-		while (current->ite_lchild != ITE_NULL) {
-			ipc_tree_entry_t next;
-
-			next = current->ite_lchild;
-			current->ite_lchild = parent;
-			parent = current;
-			current = next;
-		}
+		while (current->ite_lchild != ITE_NULL)
+			current = current->ite_lchild;
 
-		splay->ist_ltree = current;
-		splay->ist_rtree = parent;
+		splay->ist_name = current->ite_name;
 	}
 
 	return current;
@@ -765,156 +446,42 @@ ipc_splay_traverse_next(
 	ipc_splay_tree_t	splay,
 	boolean_t		delete)
 {
-	ipc_tree_entry_t current, parent;
-
-	/* pick up where traverse_entry left off */
+	ipc_tree_entry_t entry, next;
+	mach_port_t name = splay->ist_name;
 
-	current = splay->ist_ltree;
-	parent = splay->ist_rtree;
-	assert(current != ITE_NULL);
+	if (delete) {
+		ipc_tree_entry_t *linkp;
 
-	if (!delete)
-		goto traverse_right;
-
-	/* we must delete current and patch the tree */
-
-	if (current->ite_lchild == ITE_NULL) {
-		if (current->ite_rchild == ITE_NULL) {
-			/* like traverse_back, but with deletion */
-
-			if (parent == ITE_NULL) {
-				ite_free(current);
-
-				splay->ist_root = ITE_NULL;
-				return ITE_NULL;
-			}
-
-			if (current->ite_name < parent->ite_name) {
-				ite_free(current);
-
-				current = parent;
-				parent = current->ite_lchild;
-				current->ite_lchild = ITE_NULL;
-				goto traverse_entry;
-			} else {
-				ite_free(current);
-
-				current = parent;
-				parent = current->ite_rchild;
-				current->ite_rchild = ITE_NULL;
-				goto traverse_back;
-			}
-		} else {
-			ipc_tree_entry_t prev;
-
-			prev = current;
-			current = current->ite_rchild;
-			ite_free(prev);
-			goto traverse_left;
-		}
-	} else {
-		if (current->ite_rchild == ITE_NULL) {
-			ipc_tree_entry_t prev;
+		linkp = ipc_splay_prim_find(splay, name);
+		entry = *linkp;
+		assert(entry != ITE_NULL);
 
-			prev = current;
-			current = current->ite_lchild;
-			ite_free(prev);
-			goto traverse_back;
-		} else {
-			ipc_tree_entry_t prev;
-			ipc_tree_entry_t ltree, rtree;
-			ipc_tree_entry_t *ltreep, *rtreep;
-
-			/* replace current with largest of left children */
-
-			prev = current;
-			ipc_splay_prim_lookup(MACH_PORT_LARGEST,
-				current->ite_lchild, &current,
-				&ltree, &ltreep, &rtree, &rtreep);
-			ipc_splay_prim_assemble(current,
-				&ltree, ltreep, &rtree, rtreep);
-
-			assert(current->ite_rchild == ITE_NULL);
-			current->ite_rchild = prev->ite_rchild;
-			ite_free(prev);
-			goto traverse_right;
-		}
-	}
-	/*NOTREACHED*/
-
-	/*
-	 *	A state machine:  for each entry, we
-	 *		1) traverse left subtree
-	 *		2) traverse the entry
-	 *		3) traverse right subtree
-	 *		4) traverse back to parent
-	 */
-
-    traverse_left:
-	if (current->ite_lchild != ITE_NULL) {
-		ipc_tree_entry_t next;
-
-		next = current->ite_lchild;
-		current->ite_lchild = parent;
-		parent = current;
-		current = next;
-		goto traverse_left;
+		*linkp = ipc_splay_prim_join(entry->ite_lchild,
+					     entry->ite_rchild);
+		ite_free(entry);
 	}
 
-    traverse_entry:
-	splay->ist_ltree = current;
-	splay->ist_rtree = parent;
-	return current;
-
-    traverse_right:
-	if (current->ite_rchild != ITE_NULL) {
-		ipc_tree_entry_t next;
+	/* find the smallest entry larger than the current name */
 
-		next = current->ite_rchild;
-		current->ite_rchild = parent;
-		parent = current;
-		current = next;
-		goto traverse_left;
+	next = ITE_NULL;
+	entry = splay->ist_root;
+	while (entry != ITE_NULL) {
+		if (name < entry->ite_name) {
+			next = entry;
+			entry = entry->ite_lchild;
+		} else
+			entry = entry->ite_rchild;
 	}
 
-    traverse_back:
-	if (parent == ITE_NULL) {
-		splay->ist_root = current;
-		return ITE_NULL;
-	}
+	if (next != ITE_NULL)
+		splay->ist_name = next->ite_name;
 
-	if (current->ite_name < parent->ite_name) {
-		ipc_tree_entry_t prev;
-
-		prev = current;
-		current = parent;
-		parent = current->ite_lchild;
-		current->ite_lchild = prev;
-		goto traverse_entry;
-	} else {
-		ipc_tree_entry_t prev;
-
-		prev = current;
-		current = parent;
-		parent = current->ite_rchild;
-		current->ite_rchild = prev;
-		goto traverse_back;
-	}
+	return next;
 }
 
 void
 ipc_splay_traverse_finish(
 	ipc_splay_tree_t	splay)
 {
-	ipc_tree_entry_t root;
-
-	root = splay->ist_root;
-	if (root != ITE_NULL) {
-		splay->ist_name = root->ite_name;
-		splay->ist_ltreep = &splay->ist_ltree;
-		splay->ist_rtreep = &splay->ist_rtree;
-	}
-
 	ist_unlock(splay);
 }
-
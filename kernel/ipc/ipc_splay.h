@@ -41,13 +41,14 @@
 #include <kern/macro_help.h>
 #include <ipc/ipc_entry.h>
 
+/*
+ *	Despite the name, the tree is a treap; lookups and bounds
+ *	don't restructure it.  See ipc/ipc_splay.c.
+ */
+
 typedef struct ipc_splay_tree {
-	mach_port_t ist_name;		/* name used in last lookup */
-	ipc_tree_entry_t ist_root;	/* root of middle tree */
-	ipc_tree_entry_t ist_ltree;	/* root of left tree */
-	ipc_tree_entry_t *ist_ltreep;	/* pointer into left tree */
-	ipc_tree_entry_t ist_rtree;	/* root of right tree */
-	ipc_tree_entry_t *ist_rtreep;	/* pointer into right tree */
+	ipc_tree_entry_t ist_root;	/* root of the tree */
+	mach_port_t ist_name;		/* position of current traversal */
 } *ipc_splay_tree_t;
 
 #define	ist_lock(splay)		/* no locking */
@@ -55,17 +55,8 @@
  *		2) MACH_PORT_MAKE(index+1, 0) and MAKE_PORT_MAKE(size, 0)
  *		won't ever overflow.
  *
- *
- *	The ipr_size field of the first element in a table of
- *	dead-name requests (ipc_port_request_t) points to the
- *	ipc_table_size structure.  The structures must be elements
- *	of ipc_table_dnrequests.  ipc_table_dnrequests must end
- *	with an element with zero its_size, and except for this last
- *	element, the its_size values must be strictly increasing.
- *
  *	The is_table_next field points to the ipc_table_size structure
  *	for the next larger size of table, not the one currently in use.
- *	The ipr_size field points to the currently used ipc_table_size.
  */
 
 typedef unsigned int ipc_table_index_t;	/* index into tables */
@@ -78,7 +69,6 @@ typedef struct ipc_table_size {
 #define	ITS_NULL	((ipc_table_size_t) 0)
 
 extern ipc_table_size_t ipc_table_entries;
-extern ipc_table_size_t ipc_table_dnrequests;
 
 extern void
 ipc_table_init();
@@ -125,14 +115,4 @@ extern void ipc_table_free(
 	ipc_table_free((its)->its_size * sizeof(struct ipc_entry),	\
 		       (vm_offset_t)(table))
 
-#define	it_dnrequests_alloc(its)					\
-	((ipc_port_request_t)						\
-	 ipc_table_alloc((its)->its_size *				\
-			 sizeof(struct ipc_port_request)))
-
-#define	it_dnrequests_free(its, table)					\
-	ipc_table_free((its)->its_size *				\
-		       sizeof(struct ipc_port_request),			\
-		       (vm_offset_t)(table))
-
 #endif	/* _IPC_IPC_TABLE_H_ */
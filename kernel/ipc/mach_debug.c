@@ -96,7 +96,8 @@ mach_port_get_srights(
 /*
  *	Routine:	host_ipc_hash_info
  *	Purpose:
- *		Return information about the global reverse hash table.
+ *		Return the distribution of chain lengths in the
+ *		per-space reverse hash tables for tree entries.
  *	Conditions:
  *		Nothing locked.  Obeys CountInOut protocol.
  *	Returns:
@@ -299,9 +300,10 @@ mach_port_space_info(
 	tree_potential = *treeCntp;
 
 	for (;;) {
-		is_read_lock(space);
+		/* the tree traversal below needs exclusive access */
+		is_write_lock(space);
 		if (!space->is_active) {
-			is_read_unlock(space);
+			is_write_unlock(space);
 			if (table_info != *tablep)
 				kmem_free(ipc_kernel_map,
 					  table_addr, table_size);
@@ -318,7 +320,7 @@ mach_port_space_info(
 		    (tree_actual <= tree_potential))
 			break;
 
-		is_read_unlock(space);
+		is_write_unlock(space);
 
 		if (table_actual > table_potential) {
 			if (table_info != *tablep)
@@ -391,7 +393,8 @@ mach_port_space_info(
 		iin->iin_urefs = IE_BITS_UREFS(bits);
 		iin->iin_object = (vm_offset_t) entry->ie_object;
 		iin->iin_next = entry->ie_next;
-		iin->iin_hash = entry->ie_index;
+		iin->iin_hash = (index < space->is_hash_size) ?
+				space->is_hash_table[index] : 0;
 	}
 
 	for (tentry = ipc_splay_traverse_start(&space->is_tree), index = 0;
@@ -430,7 +433,7 @@ mach_port_space_info(
 
 	}
 	ipc_splay_traverse_finish(&space->is_tree);
-	is_read_unlock(space);
+	is_write_unlock(space);
 
 	if (table_info == *tablep) {
 		/* data fit in-line; nothing to deallocate */
@@ -539,21 +542,21 @@ mach_port_dnrequest_info(
 		return kr;
 	/* port is locked and active */
 
-	if (port->ip_dnrequests == IPR_NULL) {
+	if (port->ip_dnrequests == IPRT_NULL) {
 		total = 0;
 		used = 0;
 	} else {
-		ipc_port_request_t dnrequests = port->ip_dnrequests;
-		ipc_port_request_index_t index;
+		ipc_port_request_table_t dnrequests = port->ip_dnrequests;
+		unsigned int k, i;
 
-		total = dnrequests->ipr_size->its_size;
+		total = iprt_size(dnrequests->iprt_chunks);
 
-		for (index = 1, used = 0;
-		     index < total; index++) {
-			ipc_port_request_t ipr = &dnrequests[index];
+		for (k = 0, used = 0; k < dnrequests->iprt_chunks; k++) {
+			ipc_port_request_t chunk = dnrequests->iprt_chunk[k];
 
-			if (ipr->ipr_name != MACH_PORT_NULL)
-				used++;
+			for (i = 0; i < iprt_chunk_size(k); i++)
+				if (chunk[i].ipr_name != MACH_PORT_NULL)
+					used++;
 		}
 	}
 	ip_unlock(port);
@@ -643,6 +643,7 @@ mach_msg_trap(msg, option, send_size, rcv_size, rcv_name, time_out, notify)
 		        }
 #endif	NORMA_IPC
 
+			ip_msgcount_fold(dest_port);
 			if (dest_port->ip_msgcount >= dest_port->ip_qlimit)
 				goto abort_request_send_receive;
 
@@ -892,8 +893,7 @@ mach_msg_trap(msg, option, send_size, rcv_size, rcv_name, time_out, notify)
 
 		receiver = ipc_thread_queue_first(&dest_mqueue->imq_threads);
 		if ((receiver == ITH_NULL) ||
-		    (ipc_kmsg_queue_first(&rcv_mqueue->imq_messages)
-								!= IKM_NULL)) {
+		    !ipc_mqueue_empty(rcv_mqueue)) {
 			imq_unlock(dest_mqueue);
 			goto abort_send_receive;
 		}
@@ -1340,6 +1340,7 @@ mach_msg_trap(msg, option, send_size, rcv_size, rcv_name, time_out, notify)
 			goto kernel_send;
 		}
 
+		ip_msgcount_fold(dest_port);
 		if (ip_active(dest_port) &&
 #if	NORMA_IPC
 		    (! IP_NORMA_IS_PROXY(dest_port)) &&
@@ -187,9 +187,10 @@ mach_port_names(
 		ipc_entry_num_t bound;
 		vm_size_t size_needed;
 
-		is_read_lock(space);
+		/* the tree traversal below needs exclusive access */
+		is_write_lock(space);
 		if (!space->is_active) {
-			is_read_unlock(space);
+			is_write_unlock(space);
 			if (size != 0) {
 				kmem_free(ipc_kernel_map, addr1, size);
 				kmem_free(ipc_kernel_map, addr2, size);
@@ -205,7 +206,7 @@ mach_port_names(
 		if (size_needed <= size)
 			break;
 
-		is_read_unlock(space);
+		is_write_unlock(space);
 
 		if (size != 0) {
 			kmem_free(ipc_kernel_map, addr1, size);
@@ -268,7 +269,7 @@ mach_port_names(
 				       names, types, &actual);
 	}
 	ipc_splay_traverse_finish(&space->is_tree);
-	is_read_unlock(space);
+	is_write_unlock(space);
 
 	if (actual == 0) {
 		memory1 = VM_MAP_COPY_NULL;
@@ -1409,6 +1410,7 @@ mach_port_get_receive_status(space, name, statusp)
 
 	statusp->mps_mscount = port->ip_mscount;
 	statusp->mps_qlimit = port->ip_qlimit;
+	ip_msgcount_fold(port);
 	statusp->mps_msgcount = port->ip_msgcount;
 	statusp->mps_sorights = port->ip_sorights;
 	statusp->mps_srights = port->ip_srights > 0;
@@ -2068,6 +2070,7 @@ port_status(space, name, enabledp, num_msgs, backlog,
 			enabled = MACH_PORT_NULL;
 
 		qlimit = port->ip_qlimit;
+		ip_msgcount_fold(port);
 		msgcount = port->ip_msgcount;
 		ip_unlock(port);
 
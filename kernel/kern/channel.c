@@ -0,0 +1,441 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	File:	kern/channel.c
+ *
+ *	Shared-memory RPC channels between two user tasks.
+ */
+
+#include <mach/boolean.h>
+#include <mach/kern_return.h>
+#include <mach/message.h>
+#include <mach/notify.h>
+#include <mach/vm_prot.h>
+#include <mach/vm_inherit.h>
+#include <mach/vm_param.h>
+#include <kern/assert.h>
+#include <kern/channel.h>
+#include <kern/ipc_kobject.h>
+#include <kern/thread.h>
+#include <kern/zalloc.h>
+#include <ipc/ipc_port.h>
+#include <ipc/ipc_space.h>
+#include <vm/vm_kern.h>
+#include <vm/vm_map.h>
+
+/*
+ *	Each channel uses two of the eventcounts in the global table,
+ *	so there can be no more channels than half of those.
+ */
+#define	CHANNEL_MAX		32
+#define	CHANNEL_MAX_SIZE	(64 * PAGE_SIZE)
+
+/*
+ *	Channels come from a zone, so their memory stays type-stable:
+ *	evc_wait translates an id to an evc without a lock, and may
+ *	still touch the evc of a channel that is being terminated.
+ */
+zone_t		channel_zone;
+
+/*
+ *	channel_signal_lock protects the translation from an evc back
+ *	to its channel, and the membership fields (ch_active, ch_client,
+ *	ch_server) that channel_signal checks.  ch_lock only protects
+ *	the reference count.
+ */
+decl_simple_lock_data(,	channel_signal_lock)
+
+void
+channel_init()
+{
+	channel_zone = zinit(sizeof(struct channel),
+			     CHANNEL_MAX * sizeof(struct channel),
+			     sizeof(struct channel), ZONE_EXHAUSTIBLE,
+			     "channels");
+	simple_lock_init(&channel_signal_lock);
+}
+
+void
+channel_reference(ch)
+	channel_t ch;
+{
+	channel_lock(ch);
+	ch->ch_ref_count++;
+	channel_unlock(ch);
+}
+
+void
+channel_deallocate(ch)
+	channel_t ch;
+{
+	int refs;
+
+	if (ch == CHANNEL_NULL)
+		return;
+
+	channel_lock(ch);
+	refs = --ch->ch_ref_count;
+	channel_unlock(ch);
+
+	if (refs == 0)
+		zfree(channel_zone, (vm_offset_t) ch);
+}
+
+/*
+ *	Routine:	channel_member
+ *	Purpose:
+ *		Is the task one of the two ends of the channel?
+ *	Conditions:
+ *		channel_signal_lock held, or a stale answer is harmless.
+ */
+
+boolean_t
+channel_member(ch, task)
+	channel_t ch;
+	task_t task;
+{
+	return ch->ch_active &&
+	       (task == ch->ch_client || task == ch->ch_server);
+}
+
+/*
+ *	Routine:	convert_port_to_channel
+ *	Purpose:
+ *		Convert from a port to a channel.
+ *		Doesn't consume the port ref; produces a channel ref,
+ *		which may be null.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+channel_t
+convert_port_to_channel(port)
+	ipc_port_t port;
+{
+	channel_t ch = CHANNEL_NULL;
+
+	if (IP_VALID(port)) {
+		ip_lock(port);
+		if (ip_active(port) &&
+		    (ip_kotype(port) == IKOT_CHANNEL)) {
+			ch = (channel_t) port->ip_kobject;
+			channel_reference(ch);
+		}
+		ip_unlock(port);
+	}
+
+	return ch;
+}
+
+/*
+ *	Routine:	convert_channel_to_port
+ *	Purpose:
+ *		Convert from a channel to a port.
+ *		Consumes a channel ref; produces a naked send right
+ *		which may be invalid.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+ipc_port_t
+convert_channel_to_port(ch)
+	channel_t ch;
+{
+	ipc_port_t port = IP_NULL;
+
+	if (ch == CHANNEL_NULL)
+		return IP_NULL;
+
+	simple_lock(&channel_signal_lock);
+	if (ch->ch_active)
+		port = ipc_port_make_send(ch->ch_self);
+	simple_unlock(&channel_signal_lock);
+
+	channel_deallocate(ch);
+	return port;
+}
+
+/*
+ *	Routine:	channel_create [kernel call]
+ *	Purpose:
+ *		Create a channel whose client is the given task.
+ *		A zero-filled buffer of the given size is mapped
+ *		into the task, and the ids of the request and reply
+ *		eventcounts are returned for evc_wait and
+ *		channel_signal.
+ *	Conditions:
+ *		Nothing locked.
+ *	Returns:
+ *		KERN_SUCCESS		The channel was created.
+ *		KERN_INVALID_ARGUMENT	Bad task or size.
+ *		KERN_RESOURCE_SHORTAGE	Out of channels or eventcounts.
+ */
+
+kern_return_t
+channel_create(task, size, chp, addressp, request_idp, reply_idp)
+	task_t task;
+	vm_size_t size;
+	channel_t *chp;
+	vm_offset_t *addressp;
+	natural_t *request_idp;
+	natural_t *reply_idp;
+{
+	channel_t ch;
+	ipc_port_t port, notify;
+	kern_return_t kr;
+
+	if (task == TASK_NULL || size == 0 || size > CHANNEL_MAX_SIZE)
+		return KERN_INVALID_ARGUMENT;
+
+	ch = (channel_t) zalloc(channel_zone);
+	if (ch == CHANNEL_NULL)
+		return KERN_RESOURCE_SHORTAGE;
+
+	simple_lock_init(&ch->ch_lock);
+	ch->ch_ref_count = 1;
+	ch->ch_active = FALSE;
+	ch->ch_server = TASK_NULL;
+	ch->ch_size = round_page(size);
+
+	evc_init(&ch->ch_request);
+	evc_init(&ch->ch_reply);
+	if (ch->ch_request.sanity != &ch->ch_request ||
+	    ch->ch_reply.sanity != &ch->ch_reply) {
+		kr = KERN_RESOURCE_SHORTAGE;
+		goto fail_evc;
+	}
+
+	kr = projected_buffer_allocate(task->map, ch->ch_size, FALSE,
+				       &ch->ch_kaddr, addressp,
+				       VM_PROT_READ | VM_PROT_WRITE,
+				       VM_INHERIT_NONE);
+	if (kr != KERN_SUCCESS)
+		goto fail_evc;
+
+	/*
+	 *	Keep the kernel mapping alive until the server has
+	 *	had a chance to attach, even if the client unmaps.
+	 */
+	(void) projected_buffer_hold(ch->ch_kaddr);
+
+	port = ipc_port_alloc_kernel();
+	if (port == IP_NULL) {
+		(void) projected_buffer_deallocate(task->map, *addressp,
+						   *addressp + ch->ch_size);
+		projected_buffer_release(ch->ch_kaddr);
+		kr = KERN_RESOURCE_SHORTAGE;
+		goto fail_evc;
+	}
+	ch->ch_self = port;
+	ipc_kobject_set(port, (ipc_kobject_t) ch, IKOT_CHANNEL);
+
+	notify = ipc_port_make_sonce(port);
+	ip_lock(port);
+	ipc_port_nsrequest(port, 1, notify, &notify);
+	assert(notify == IP_NULL);
+
+	task_reference(task);
+	ch->ch_client = task;
+
+	simple_lock(&channel_signal_lock);
+	ch->ch_request.ev_channel = ch;
+	ch->ch_reply.ev_channel = ch;
+	ch->ch_active = TRUE;
+	simple_unlock(&channel_signal_lock);
+
+	*request_idp = ch->ch_request.ev_id;
+	*reply_idp = ch->ch_reply.ev_id;
+
+	/* one reference for the port, one for the caller */
+	ch->ch_ref_count++;
+	*chp = ch;
+	return KERN_SUCCESS;
+
+    fail_evc:
+	evc_destroy(&ch->ch_request);
+	evc_destroy(&ch->ch_reply);
+	zfree(channel_zone, (vm_offset_t) ch);
+	return kr;
+}
+
+/*
+ *	Routine:	channel_attach [kernel call]
+ *	Purpose:
+ *		Map an existing channel into its server task.
+ *		A channel has exactly one server.  The size of
+ *		the mapping is returned so that the server need
+ *		not believe the client's header about it.
+ *	Conditions:
+ *		Nothing locked.
+ *	Returns:
+ *		KERN_SUCCESS		The channel is mapped.
+ *		KERN_INVALID_ARGUMENT	Bad channel or task.
+ *		KERN_NO_SPACE		Already has a server.
+ */
+
+kern_return_t
+channel_attach(ch, task, addressp, sizep, request_idp, reply_idp)
+	channel_t ch;
+	task_t task;
+	vm_offset_t *addressp;
+	vm_size_t *sizep;
+	natural_t *request_idp;
+	natural_t *reply_idp;
+{
+	kern_return_t kr;
+
+	if (ch == CHANNEL_NULL || task == TASK_NULL)
+		return KERN_INVALID_ARGUMENT;
+
+	simple_lock(&channel_signal_lock);
+	if (!ch->ch_active) {
+		simple_unlock(&channel_signal_lock);
+		return KERN_INVALID_ARGUMENT;
+	}
+	if (ch->ch_server != TASK_NULL) {
+		simple_unlock(&channel_signal_lock);
+		return KERN_NO_SPACE;
+	}
+	task_reference(task);
+	ch->ch_server = task;
+	simple_unlock(&channel_signal_lock);
+
+	/*
+	 *	The buffer cannot go away under us: it is held
+	 *	until channel_terminate.
+	 */
+	kr = projected_buffer_map(task->map, ch->ch_kaddr, ch->ch_size,
+				  addressp, VM_PROT_READ | VM_PROT_WRITE,
+				  VM_INHERIT_NONE);
+	if (kr != KERN_SUCCESS) {
+		simple_lock(&channel_signal_lock);
+		ch->ch_server = TASK_NULL;
+		simple_unlock(&channel_signal_lock);
+		task_deallocate(task);
+		return kr;
+	}
+
+	*sizep = ch->ch_size;
+	*request_idp = ch->ch_request.ev_id;
+	*reply_idp = ch->ch_reply.ev_id;
+	return KERN_SUCCESS;
+}
+
+/*
+ *	Routine:	channel_terminate
+ *	Purpose:
+ *		Shut a channel down once nobody can name it.
+ *		Threads blocked in evc_wait on it are woken;
+ *		the buffer stays mapped in the tasks until they
+ *		deallocate it or die.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+void
+channel_terminate(ch)
+	channel_t ch;
+{
+	task_t client, server;
+	ipc_port_t port;
+
+	simple_lock(&channel_signal_lock);
+	if (!ch->ch_active) {
+		simple_unlock(&channel_signal_lock);
+		return;
+	}
+	ch->ch_active = FALSE;
+	ch->ch_request.ev_channel = CHANNEL_NULL;
+	ch->ch_reply.ev_channel = CHANNEL_NULL;
+	evc_destroy(&ch->ch_request);
+	evc_destroy(&ch->ch_reply);
+	client = ch->ch_client;
+	server = ch->ch_server;
+	ch->ch_client = TASK_NULL;
+	ch->ch_server = TASK_NULL;
+	port = ch->ch_self;
+	ch->ch_self = IP_NULL;
+	simple_unlock(&channel_signal_lock);
+
+	projected_buffer_release(ch->ch_kaddr);
+	task_deallocate(client);
+	if (server != TASK_NULL)
+		task_deallocate(server);
+
+	ipc_kobject_set(port, IKO_NULL, IKOT_NONE);
+	ipc_port_dealloc_kernel(port);
+
+	/* the port's reference */
+	channel_deallocate(ch);
+}
+
+/*
+ *	Routine:	channel_notify
+ *	Purpose:
+ *		Handle notifications sent to a channel port.
+ *		The only one requested is no-senders.
+ */
+
+boolean_t
+channel_notify(msg)
+	mach_msg_header_t *msg;
+{
+	channel_t ch;
+
+	if (msg->msgh_id != MACH_NOTIFY_NO_SENDERS)
+		return FALSE;
+
+	ch = convert_port_to_channel((ipc_port_t) msg->msgh_remote_port);
+	if (ch == CHANNEL_NULL)
+		return TRUE;
+
+	channel_terminate(ch);
+	channel_deallocate(ch);
+	return TRUE;
+}
+
+/*
+ *	Routine:	channel_signal [trap]
+ *	Purpose:
+ *		Signal one of the eventcounts of a channel from user
+ *		mode.  Only the client and the server may do so.
+ *		A signal raised before the other side waits is
+ *		counted, not lost.
+ *	Conditions:
+ *		Nothing locked.
+ */
+
+kern_return_t
+channel_signal(ev_id)
+	natural_t ev_id;
+{
+	evc_t ev;
+
+	simple_lock(&channel_signal_lock);
+	ev = evc_lookup(ev_id);
+	if (ev == EVC_NULL || ev->ev_channel == CHANNEL_NULL ||
+	    !channel_member(ev->ev_channel, current_task())) {
+		simple_unlock(&channel_signal_lock);
+		return KERN_INVALID_ARGUMENT;
+	}
+	evc_signal(ev);
+	simple_unlock(&channel_signal_lock);
+	return KERN_SUCCESS;
+}
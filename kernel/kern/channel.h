@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	File:	kern/channel.h
+ *
+ *	Shared-memory RPC channels between two user tasks.
+ *
+ *	A channel is a projected buffer mapped into a client and a
+ *	server task, plus two eventcounts: the client signals the
+ *	request eventcount after filling a slot, the server signals
+ *	the reply eventcount after answering it.  The kernel never
+ *	looks inside the buffer; the slot layout is private to the
+ *	two tasks (see <mach/channel.h>).  Port rights and out-of-line
+ *	memory still travel through ordinary Mach messages.
+ */
+
+#ifndef	_KERN_CHANNEL_H_
+#define _KERN_CHANNEL_H_
+
+#include <mach/port.h>
+#include <kern/lock.h>
+#include <kern/task.h>
+#include <kern/eventcount.h>
+#include <ipc/ipc_port.h>
+
+typedef struct channel {
+	decl_simple_lock_data(,	ch_lock)
+	int		ch_ref_count;
+	boolean_t	ch_active;	/* not yet terminated */
+	struct ipc_port	*ch_self;	/* kernel port naming the channel */
+	vm_offset_t	ch_kaddr;	/* kernel address of shared buffer */
+	vm_size_t	ch_size;
+	task_t		ch_client;	/* referenced; task that created it */
+	task_t		ch_server;	/* referenced; task that attached */
+	struct evc	ch_request;	/* signalled by the client */
+	struct evc	ch_reply;	/* signalled by the server */
+} *channel_t;
+
+#define	CHANNEL_NULL	((channel_t) 0)
+
+#define	channel_lock(ch)	simple_lock(&(ch)->ch_lock)
+#define	channel_unlock(ch)	simple_unlock(&(ch)->ch_lock)
+
+extern void		channel_init();
+extern channel_t	convert_port_to_channel(/* ipc_port_t */);
+extern ipc_port_t	convert_channel_to_port(/* channel_t */);
+extern void		channel_deallocate(/* channel_t */);
+extern boolean_t	channel_member(/* channel_t, task_t */);
+extern boolean_t	channel_notify(/* mach_msg_header_t * */);
+
+/* user-visible trap */
+
+extern kern_return_t	channel_signal(natural_t ev_id);
+
+#endif	/* _KERN_CHANNEL_H_ */
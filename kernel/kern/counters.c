@@ -53,6 +53,9 @@ mach_counter_t c_clock_ticks = 0;
 mach_counter_t c_ipc_mqueue_send_block = 0;
 mach_counter_t c_ipc_mqueue_receive_block_user = 0;
 mach_counter_t c_ipc_mqueue_receive_block_kernel = 0;
+mach_counter_t c_ipc_mqueue_ring_send = 0;
+mach_counter_t c_ipc_mqueue_ring_busy = 0;
+mach_counter_t c_ipc_mqueue_ring_kick = 0;
 mach_counter_t c_mach_msg_trap_block_fast = 0;
 mach_counter_t c_mach_msg_trap_block_slow = 0;
 mach_counter_t c_mach_msg_trap_block_exc = 0;
@@ -71,6 +74,7 @@ mach_counter_t c_vm_page_wait_block_user = 0;
 mach_counter_t c_vm_page_wait_block_kernel = 0;
 mach_counter_t c_vm_pageout_block = 0;
 mach_counter_t c_vm_pageout_scan_block = 0;
+mach_counter_t c_vm_page_zero_thread_block = 0;
 mach_counter_t c_idle_thread_block = 0;
 mach_counter_t c_idle_thread_handoff = 0;
 mach_counter_t c_sched_thread_block = 0;
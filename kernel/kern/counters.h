@@ -76,6 +76,9 @@ extern mach_counter_t c_clock_ticks;
 extern mach_counter_t c_ipc_mqueue_send_block;
 extern mach_counter_t c_ipc_mqueue_receive_block_user;
 extern mach_counter_t c_ipc_mqueue_receive_block_kernel;
+extern mach_counter_t c_ipc_mqueue_ring_send;
+extern mach_counter_t c_ipc_mqueue_ring_busy;
+extern mach_counter_t c_ipc_mqueue_ring_kick;
 extern mach_counter_t c_mach_msg_trap_block_fast;
 extern mach_counter_t c_mach_msg_trap_block_slow;
 extern mach_counter_t c_mach_msg_trap_block_exc;
@@ -94,6 +97,7 @@ extern mach_counter_t c_vm_page_wait_block_user;
 extern mach_counter_t c_vm_page_wait_block_kernel;
 extern mach_counter_t c_vm_pageout_block;
 extern mach_counter_t c_vm_pageout_scan_block;
+extern mach_counter_t c_vm_page_zero_thread_block;
 extern mach_counter_t c_idle_thread_block;
 extern mach_counter_t c_idle_thread_handoff;
 extern mach_counter_t c_sched_thread_block;
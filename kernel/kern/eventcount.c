@@ -51,6 +51,7 @@
 #include <machine/machspl.h>	/* For def'n of splsched() */
 
 #include <kern/eventcount.h>
+#include <kern/channel.h>
 
 
 #if  NCPUS <= 1
@@ -59,7 +60,7 @@ void simpler_thread_setrun(
 	boolean_t	may_preempt); /* forward */
 #endif
 
-#define	MAX_EVCS	10		/* xxx for now */
+#define	MAX_EVCS	64		/* xxx for now */
 evc_t	all_eventcounters[MAX_EVCS];
 
 /*
@@ -100,6 +101,21 @@ evc_destroy(evc_t	ev)
 	ev->ev_id = -1;
 }
 
+/*
+ * Translate an id handed out to user mode.
+ */
+evc_t
+evc_lookup(natural_t	ev_id)
+{
+	evc_t	ev;
+
+	if ((ev_id >= MAX_EVCS) ||
+	    ((ev = all_eventcounters[ev_id]) == 0) ||
+	    (ev->ev_id != ev_id) || (ev->sanity != ev))
+		return EVC_NULL;
+	return ev;
+}
+
 /*
  * Thread termination.
  * HORRIBLE. This stuff needs to be fixed.
@@ -149,9 +165,9 @@ kern_return_t evc_wait(natural_t ev_id)
 	kern_return_t	ret;
 	evc_t		ev;
 
-	if ((ev_id >= MAX_EVCS) ||
-	    ((ev = all_eventcounters[ev_id]) == 0) ||
-	    (ev->ev_id != ev_id) || (ev->sanity != ev))
+	if ((ev = evc_lookup(ev_id)) == EVC_NULL ||
+	    ((ev->ev_channel != 0) &&
+	     !channel_member(ev->ev_channel, current_task())))
 		return KERN_INVALID_ARGUMENT;
 
 	s = splsched();
@@ -196,9 +212,9 @@ kern_return_t evc_wait_clear(natural_t ev_id)
 	kern_return_t	ret;
 	evc_t		ev;
 
-	if ((ev_id >= MAX_EVCS) ||
-	    ((ev = all_eventcounters[ev_id]) == 0) ||
-	    (ev->ev_id != ev_id) || (ev->sanity != ev))
+	if ((ev = evc_lookup(ev_id)) == EVC_NULL ||
+	    ((ev->ev_channel != 0) &&
+	     !channel_member(ev->ev_channel, current_task())))
 		return KERN_INVALID_ARGUMENT;
 
 	s = splsched();
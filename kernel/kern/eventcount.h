@@ -42,9 +42,14 @@ typedef struct evc {
 	thread_t	waiting_thread;
 	natural_t	ev_id;
 	struct evc	*sanity;
+	struct channel	*ev_channel;	/* channel signalled from user mode */
 	decl_simple_lock_data(,	lock)
 } *evc_t;
 
+#define	EVC_NULL	((evc_t) 0)
+
+extern	evc_t	evc_lookup(natural_t ev_id);
+
 extern	void	evc_init(evc_t ev),
 		evc_destroy(evc_t ev),
 		evc_signal(evc_t ev),
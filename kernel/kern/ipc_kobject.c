@@ -45,6 +45,12 @@
 #include <mach/mig_errors.h>
 #include <mach/notify.h>
 #include <kern/ipc_kobject.h>
+#include <kern/channel.h>
+#include <device/io_cq.h>
+#include <kern/cpu_number.h>
+#include <kern/host.h>
+#include <kern/kalloc.h>
+#include <kern/time_stamp.h>
 #include <ipc/ipc_object.h>
 #include <ipc/ipc_kmsg.h>
 #include <ipc/ipc_port.h>
@@ -54,6 +60,203 @@
 #include <machine/machine_routines.h>
 #endif
 
+#if	MACH_DEBUG
+#include <mach_debug/rpc_info.h>
+#include <vm/vm_kern.h>
+#include <vm/vm_map.h>
+#endif	MACH_DEBUG
+
+
+extern mig_routine_t	mach_server_routine(),
+			mach_port_server_routine(),
+			mach_host_server_routine(),
+			device_server_routine(),
+			device_pager_server_routine(),
+			mach4_server_routine();
+#if	MACH_DEBUG
+extern mig_routine_t	mach_debug_server_routine();
+#endif
+#if	NORMA_TASK
+extern mig_routine_t	mach_norma_server_routine();
+extern mig_routine_t	norma_internal_server_routine();
+#endif
+#if	NORMA_VM
+extern mig_routine_t	proxy_server_routine();
+#endif
+
+#if	MACH_MACHINE_ROUTINES
+extern mig_routine_t	MACHINE_SERVER_ROUTINE();
+#endif
+
+/*
+ *	The demultiplexers of the kernel's MIG subsystems,
+ *	in the order they are tried.
+ */
+static mig_routine_t (*ipc_kobject_demux[])() = {
+	mach_server_routine,
+	mach_port_server_routine,
+	mach_host_server_routine,
+	device_server_routine,
+	device_pager_server_routine,
+#if	MACH_DEBUG
+	mach_debug_server_routine,
+#endif	MACH_DEBUG
+#if	NORMA_TASK
+	mach_norma_server_routine,
+	norma_internal_server_routine,
+#endif	NORMA_TASK
+#if	NORMA_VM
+	proxy_server_routine,
+#endif	NORMA_VM
+	mach4_server_routine,
+#if	MACH_MACHINE_ROUTINES
+	MACHINE_SERVER_ROUTINE,
+#endif	MACH_MACHINE_ROUTINES
+	0
+};
+
+/*
+ *	All the standard kernel subsystems have msgh_ids in
+ *	[IKO_ID_MIN, IKO_ID_MAX).  ipc_kobject_init asks the
+ *	demultiplexers about each of those ids once, so that a
+ *	kernel call finds its routine with a single index.
+ *	Ids outside the range (NORMA) still go through the
+ *	demultiplexers one by one.
+ */
+#define	IKO_ID_MIN	2000
+#define	IKO_ID_MAX	4100
+
+mig_routine_t	ipc_kobject_routines[IKO_ID_MAX - IKO_ID_MIN];
+
+#if	MACH_DEBUG
+/*
+ *	Kernel call statistics.  Each routine in the dispatch table
+ *	gets a slot in ipc_kobject_stat_ids; each processor counts
+ *	the calls it serves and keeps a log2 histogram of their
+ *	service time in cycles.  The per-processor arrays are only
+ *	touched by their own processor, at thread level, without
+ *	locking.  host_kernel_rpc_info adds them up.
+ */
+struct ipc_kobject_stat {
+	natural_t	iks_count;
+	natural_t	iks_histogram[KERNEL_RPC_HISTOGRAM_SIZE];
+};
+
+unsigned short	ipc_kobject_stat_index[IKO_ID_MAX - IKO_ID_MIN];
+mach_msg_id_t	*ipc_kobject_stat_ids;		/* slot -> msgh_id */
+int		ipc_kobject_stat_count;		/* slots in use */
+struct ipc_kobject_stat	*ipc_kobject_stats[NCPUS];
+
+/*
+ *	Routine:	ipc_kobject_stat_init
+ *	Purpose:
+ *		Assign statistics slots to the routines
+ *		in the dispatch table.  Slot 0 is unused.
+ */
+
+void
+ipc_kobject_stat_init()
+{
+	vm_size_t size;
+	int i, n;
+
+	n = 1;
+	for (i = 0; i < IKO_ID_MAX - IKO_ID_MIN; i++)
+		if (ipc_kobject_routines[i] != 0)
+			ipc_kobject_stat_index[i] = n++;
+
+	ipc_kobject_stat_ids = (mach_msg_id_t *)
+		kalloc(n * sizeof(mach_msg_id_t));
+	for (i = 0; i < IKO_ID_MAX - IKO_ID_MIN; i++)
+		if (ipc_kobject_stat_index[i] != 0)
+			ipc_kobject_stat_ids[ipc_kobject_stat_index[i]] =
+				i + IKO_ID_MIN;
+
+	size = n * sizeof(struct ipc_kobject_stat);
+	for (i = 0; i < NCPUS; i++) {
+		ipc_kobject_stats[i] = (struct ipc_kobject_stat *) kalloc(size);
+		bzero((char *) ipc_kobject_stats[i], size);
+	}
+	ipc_kobject_stat_count = n;
+}
+
+/*
+ *	Routine:	ipc_kobject_stat
+ *	Purpose:
+ *		Account for one call of a kernel routine.
+ */
+
+static void
+ipc_kobject_stat(id, cycles)
+	mach_msg_id_t id;
+	unsigned cycles;
+{
+	register struct ipc_kobject_stat *iks;
+	register int bucket;
+	int slot;
+
+	if ((id < IKO_ID_MIN) || (id >= IKO_ID_MAX) ||
+	    ((slot = ipc_kobject_stat_index[id - IKO_ID_MIN]) == 0))
+		return;
+
+	for (bucket = 0; (cycles >>= 1) != 0; bucket++)
+		continue;
+
+	iks = &ipc_kobject_stats[cpu_number()][slot];
+	iks->iks_count++;
+	iks->iks_histogram[bucket]++;
+}
+#endif	MACH_DEBUG
+
+/*
+ *	Routine:	ipc_kobject_init
+ *	Purpose:
+ *		Build the kernel server dispatch table.
+ */
+
+void
+ipc_kobject_init()
+{
+	mach_msg_header_t header;
+	mig_routine_t routine;
+	int i, id;
+
+	for (id = IKO_ID_MIN; id < IKO_ID_MAX; id++) {
+		header.msgh_id = id;
+		routine = 0;
+		for (i = 0; ipc_kobject_demux[i] != 0; i++)
+			if ((routine = (*ipc_kobject_demux[i])(&header)) != 0)
+				break;
+		ipc_kobject_routines[id - IKO_ID_MIN] = routine;
+	}
+
+#if	MACH_DEBUG
+	ipc_kobject_stat_init();
+#endif	MACH_DEBUG
+}
+
+/*
+ *	Routine:	ipc_kobject_routine
+ *	Purpose:
+ *		Find the server routine for a kernel call.
+ */
+
+static mig_routine_t
+ipc_kobject_routine(header)
+	mach_msg_header_t *header;
+{
+	mig_routine_t routine;
+	mach_msg_id_t id = header->msgh_id;
+	int i;
+
+	if ((id >= IKO_ID_MIN) && (id < IKO_ID_MAX))
+		return ipc_kobject_routines[id - IKO_ID_MIN];
+
+	for (i = 0; ipc_kobject_demux[i] != 0; i++)
+		if ((routine = (*ipc_kobject_demux[i])(header)) != 0)
+			return routine;
+	return 0;
+}
 
 /*
  *	Routine:	ipc_kobject_server
@@ -68,19 +271,17 @@ ipc_kmsg_t
 ipc_kobject_server(request)
 	ipc_kmsg_t request;
 {
-	mach_msg_size_t reply_size = ikm_less_overhead(8192);
 	ipc_kmsg_t reply;
 	kern_return_t kr;
 	mig_routine_t routine;
 	ipc_port_t *destp;
 
-	reply = ikm_alloc(reply_size);
+	reply = ipc_kmsg_reply_alloc();
 	if (reply == IKM_NULL) {
 		printf("ipc_kobject_server: dropping request\n");
 		ipc_kmsg_destroy(request);
 		return IKM_NULL;
 	}
-	ikm_init(reply, reply_size);
 
 	/*
 	 * Initialize reply message.
@@ -104,38 +305,6 @@ ipc_kobject_server(request)
 	    OutP->Head.msgh_local_port  = MACH_PORT_NULL;
 	    OutP->Head.msgh_seqno = 0;
 	    OutP->Head.msgh_id = InP->msgh_id + 100;
-#if 0
-	    if (InP->msgh_id) {
-		    static long _calls;
-		    static struct { long id, count; } _counts[512];
-		    int i, id;
-
-		    id = InP->msgh_id;
-		    for (i = 0; i < 511; i++) {
-			    if (_counts[i].id == 0) {
-				    _counts[i].id = id;
-				    _counts[i].count++;
-				    break;
-			    }
-			    if (_counts[i].id == id) {
-				    _counts[i].count++;
-				    break;
-			    }
-		    }
-		    if (i == 511) {
-			    _counts[i].id = id;
-			    _counts[i].count++;
-		    }
-		    if ((++_calls & 0x7fff) == 0)
-			    for (i = 0; i < 512; i++) {
-				    if (_counts[i].id == 0)
-					    break;
-				    printf("%d: %d\n",
-					   _counts[i].id, _counts[i].count);
-			    }
-	    }
-#endif
-
 	    OutP->RetCodeType = RetCodeType;
 
 #undef	InP
@@ -146,50 +315,17 @@ ipc_kobject_server(request)
 	 * Find the server routine to call, and call it
 	 * to perform the kernel function
 	 */
-    {
-	extern mig_routine_t	mach_server_routine(),
-				mach_port_server_routine(),
-				mach_host_server_routine(),
-				device_server_routine(),
-				device_pager_server_routine(),
-				mach4_server_routine();
-#if	MACH_DEBUG
-	extern mig_routine_t	mach_debug_server_routine();
-#endif
-#if	NORMA_TASK
-	extern mig_routine_t	mach_norma_server_routine();
-	extern mig_routine_t	norma_internal_server_routine();
-#endif
-#if	NORMA_VM
-	extern mig_routine_t	proxy_server_routine();
-#endif
-
-#if	MACH_MACHINE_ROUTINES
-	extern mig_routine_t	MACHINE_SERVER_ROUTINE();
-#endif
-
 	check_simple_locks();
-	if ((routine = mach_server_routine(&request->ikm_header)) != 0
-	 || (routine = mach_port_server_routine(&request->ikm_header)) != 0
-	 || (routine = mach_host_server_routine(&request->ikm_header)) != 0
-	 || (routine = device_server_routine(&request->ikm_header)) != 0
-	 || (routine = device_pager_server_routine(&request->ikm_header)) != 0
+	if ((routine = ipc_kobject_routine(&request->ikm_header)) != 0) {
 #if	MACH_DEBUG
-	 || (routine = mach_debug_server_routine(&request->ikm_header)) != 0
-#endif	MACH_DEBUG
-#if	NORMA_TASK
-	 || (routine = mach_norma_server_routine(&request->ikm_header)) != 0
-	 || (routine = norma_internal_server_routine(&request->ikm_header)) != 0
-#endif	NORMA_TASK
-#if	NORMA_VM
-	 || (routine = proxy_server_routine(&request->ikm_header)) != 0
-#endif	NORMA_VM
-	 || (routine = mach4_server_routine(&request->ikm_header)) != 0
-#if	MACH_MACHINE_ROUTINES
-	 || (routine = MACHINE_SERVER_ROUTINE(&request->ikm_header)) != 0
-#endif	MACH_MACHINE_ROUTINES
-	) {
+	    mach_msg_id_t id = request->ikm_header.msgh_id;
+	    unsigned start = cycle_count();
+
+	    (*routine)(&request->ikm_header, &reply->ikm_header);
+	    ipc_kobject_stat(id, cycle_count() - start);
+#else	MACH_DEBUG
 	    (*routine)(&request->ikm_header, &reply->ikm_header);
+#endif	MACH_DEBUG
 	}
 	else if (!ipc_kobject_notify(&request->ikm_header,&reply->ikm_header)){
 		((mig_reply_header_t *) &reply->ikm_header)->RetCode
@@ -199,7 +335,6 @@ ipc_kobject_server(request)
 		       request->ikm_header.msgh_id);
 #endif	MACH_IPC_TEST
 	}
-    }
 	check_simple_locks();
 
 	/*
@@ -385,7 +520,125 @@ ipc_kobject_notify(request_header, reply_header)
 		case IKOT_DEVICE:
 		return ds_notify(request_header);
 
+		case IKOT_CHANNEL:
+		return channel_notify(request_header);
+
+		case IKOT_IO_CQ:
+		return io_cq_notify(request_header);
+
 		default:
 		return FALSE;
 	}
 }
+
+#if	MACH_DEBUG
+/*
+ *	Routine:	host_kernel_rpc_info [kernel call]
+ *	Purpose:
+ *		Return call counts and service time histograms
+ *		for every kernel routine that has been called.
+ *	Conditions:
+ *		Nothing locked.  Obeys CountInOut protocol.
+ *	Returns:
+ *		KERN_SUCCESS		Returned information.
+ *		KERN_INVALID_HOST	The host is null.
+ *		KERN_RESOURCE_SHORTAGE	Couldn't allocate memory.
+ */
+
+kern_return_t
+host_kernel_rpc_info(host, infop, infoCntp)
+	host_t			host;
+	kernel_rpc_info_array_t	*infop;
+	natural_t		*infoCntp;
+{
+	kernel_rpc_info_t *info;
+	vm_offset_t addr;
+	vm_size_t size = 0; /*'=0' to quiet gcc warnings */
+	natural_t count, max;
+	int slot, cpu, i;
+	kern_return_t kr;
+
+	if (host == HOST_NULL)
+		return KERN_INVALID_HOST;
+
+	max = ipc_kobject_stat_count;
+	if (max <= *infoCntp) {
+		/* use in-line memory */
+
+		info = *infop;
+	} else {
+		size = round_page(max * sizeof *info);
+		kr = kmem_alloc_pageable(ipc_kernel_map, &addr, size);
+		if (kr != KERN_SUCCESS)
+			return KERN_RESOURCE_SHORTAGE;
+
+		info = (kernel_rpc_info_t *) addr;
+	}
+
+	/*
+	 *	The counters are read without stopping the other
+	 *	processors, so a snapshot may be slightly torn.
+	 */
+
+	count = 0;
+	for (slot = 1; slot < ipc_kobject_stat_count; slot++) {
+		kernel_rpc_info_t *kri = &info[count];
+
+		kri->kri_count = 0;
+		for (i = 0; i < KERNEL_RPC_HISTOGRAM_SIZE; i++)
+			kri->kri_histogram[i] = 0;
+
+		for (cpu = 0; cpu < NCPUS; cpu++) {
+			struct ipc_kobject_stat *iks =
+				&ipc_kobject_stats[cpu][slot];
+
+			kri->kri_count += iks->iks_count;
+			for (i = 0; i < KERNEL_RPC_HISTOGRAM_SIZE; i++)
+				kri->kri_histogram[i] +=
+					iks->iks_histogram[i];
+		}
+
+		if (kri->kri_count != 0) {
+			kri->kri_id = ipc_kobject_stat_ids[slot];
+			count++;
+		}
+	}
+
+	if (info != *infop) {
+		vm_map_copy_t copy;
+		vm_size_t size_used, rsize_used;
+
+		size_used = count * sizeof *info;
+		rsize_used = round_page(size_used);
+
+		if (size_used == 0) {
+			kmem_free(ipc_kernel_map, addr, size);
+			*infop = 0;
+		} else {
+			/*
+			 *	Send only the pages in use, so the
+			 *	caller can deallocate what it got
+			 *	knowing just the count.
+			 */
+
+			if (rsize_used != size)
+				kmem_free(ipc_kernel_map,
+					  addr + rsize_used,
+					  size - rsize_used);
+
+			if (size_used != rsize_used)
+				bzero((char *) (addr + size_used),
+				      rsize_used - size_used);
+
+			kr = vm_map_copyin(ipc_kernel_map, addr, rsize_used,
+					   TRUE, &copy);
+			assert(kr == KERN_SUCCESS);
+
+			*infop = (kernel_rpc_info_t *) copy;
+		}
+	}
+	*infoCntp = count;
+
+	return KERN_SUCCESS;
+}
+#endif	MACH_DEBUG
@@ -77,9 +77,11 @@ typedef unsigned int ipc_kobject_type_t;
 #define IKOT_LOCK_SET		24
 #define IKOT_CLOCK		25
 #define IKOT_CLOCK_CTRL		26
+#define IKOT_CHANNEL		27
+#define IKOT_IO_CQ		28
 					/* << new entries here	*/
-#define	IKOT_UNKNOWN		27	/* magic catchall	*/
-#define	IKOT_MAX_TYPE		28	/* # of IKOT_ types	*/
+#define	IKOT_UNKNOWN		29	/* magic catchall	*/
+#define	IKOT_MAX_TYPE		30	/* # of IKOT_ types	*/
  /* Please keep ipc/ipc_object.c:ikot_print_array up to date	*/
 
 #define is_ipc_kobject(ikot)	(ikot != IKOT_NONE)
@@ -95,9 +97,7 @@ typedef unsigned int ipc_kobject_type_t;
 #define ipc_kobject_vm_page_steal(ikot)	(ikot == IKOT_PAGING_REQUEST)
 
 /* Initialize kernel server dispatch table */
-/* XXX
-extern void mig_init(void);
-*/
+extern void ipc_kobject_init(void);
 
 /* Dispatch a kernel server function */
 extern ipc_kmsg_t ipc_kobject_server(
@@ -62,6 +62,7 @@ extern void	vm_mem_init();
 extern void	vm_mem_bootstrap();
 extern void	init_timeout();
 extern void	machine_init();
+extern void	channel_init();
 
 extern void	idle_thread();
 extern void	vm_pageout();
@@ -133,6 +134,7 @@ void setup_main()
 	task_init();
 	thread_init();
 	swapper_init();
+	channel_init();
 #if	MACH_HOST
 	pset_sys_init();
 #endif	MACH_HOST
@@ -207,6 +209,8 @@ void start_kernel_threads()
 	(void) kernel_thread(kernel_task, reaper_thread, (char *) 0);
 	(void) kernel_thread(kernel_task, swapin_thread, (char *) 0);
 	(void) kernel_thread(kernel_task, sched_thread, (char *) 0);
+	(void) kernel_thread(kernel_task, vm_page_zero_thread, (char *) 0);
+	(void) kernel_thread(kernel_task, vm_object_collapse_thread, (char *) 0);
 
 #if	NCPUS > 1
 	/*
@@ -89,6 +89,7 @@ extern	kern_return_t	syscall_mach_port_allocate_name();
 extern	kern_return_t	syscall_thread_depress_abort();
 extern	kern_return_t	evc_wait();
 extern	kern_return_t	evc_wait_clear();
+extern	kern_return_t	channel_signal();
 
 extern	kern_return_t	syscall_device_write_request();
 extern	kern_return_t	syscall_device_writev_request();
@@ -126,7 +127,7 @@ mach_trap_t	mach_trap_table[] = {
 	MACH_TRAP(kern_invalid, 0),		/* 16 */
 	MACH_TRAP_STACK(evc_wait, 1),		/* 17 */
 	MACH_TRAP_STACK(evc_wait_clear, 1),	/* 18 */
-	MACH_TRAP(kern_invalid, 0),		/* 19 */
+	MACH_TRAP(channel_signal, 1),		/* 19 */
 
 #if	MACH_IPC_COMPAT
 	MACH_TRAP(msg_send_trap, 4),		/* 20 */	/* obsolete */
@@ -56,6 +56,14 @@ unsigned	ts_tick_count;
 #endif	KERNEL
 #endif	TS_FORMAT
 
+/*
+ *	Machines without a cycle counter can't time short intervals.
+ */
+
+#ifndef	cycle_count
+#define	cycle_count()	0
+#endif	cycle_count
+
 /*
  *	List of all format definitions for convert_ts_to_tv.
  */
@@ -225,6 +225,20 @@ extern void		pmap_copy();		/* Copy range of
 						 * mappings, if desired.
 						 */
 #endif	pmap_copy
+#ifndef	pmap_superpage_size
+#define	pmap_superpage_size()	((vm_size_t) 0)	/* Size of the large
+						 * pages that pmap_enter
+						 * may promote aligned,
+						 * physically contiguous
+						 * runs to, or zero.
+						 */
+#endif	pmap_superpage_size
+#ifndef	pmap_zero_page_nocache
+extern void		pmap_zero_page_nocache(); /* Zero a page
+						 * without displacing
+						 * cached data.
+						 */
+#endif	pmap_zero_page_nocache
 #ifndef pmap_attribute
 extern kern_return_t	pmap_attribute();	/* Get/Set special
 						 * memory attributes
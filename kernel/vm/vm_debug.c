@@ -497,3 +497,26 @@ host_virtual_physical_table_info(host, infop, countp)
 
 	return KERN_SUCCESS;
 }
+
+/*
+ *	Routine:	host_virtual_physical_table_histogram
+ *	Purpose:
+ *		Return the chain-length distribution of the VP table.
+ *	Conditions:
+ *		Nothing locked.
+ *	Returns:
+ *		KERN_SUCCESS		Returned information.
+ *		KERN_INVALID_HOST	The host is null.
+ */
+
+kern_return_t
+host_virtual_physical_table_histogram(host, histogram)
+	host_t host;
+	hash_info_histogram_t histogram;
+{
+	if (host == HOST_NULL)
+		return KERN_INVALID_HOST;
+
+	vm_page_info_histogram(histogram);
+	return KERN_SUCCESS;
+}
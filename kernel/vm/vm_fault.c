@@ -56,6 +56,7 @@
 #include <kern/mach_param.h>
 #include <kern/macro_help.h>
 #include <kern/zalloc.h>
+#include <kern/kalloc.h>
 
 #if	MACH_PCSAMPLE
 #include <kern/pc_sample.h>
@@ -98,6 +99,21 @@ boolean_t	vm_fault_interruptible = TRUE;
 
 boolean_t	software_reference_bits = TRUE;
 
+/*
+ *	Superpage reservations: the first zero-fill fault in an
+ *	aligned, untouched chunk of a private anonymous object
+ *	fills the whole chunk from one aligned physical run, so
+ *	that the pmap can map it with a single large page.
+ *	After a failure to find a run, the next few attempts
+ *	are skipped.
+ */
+boolean_t	vm_fault_superpages = TRUE;
+int		vm_fault_superpage_backoff = 0;
+#define	VM_FAULT_SUPERPAGE_BACKOFF	64
+
+unsigned int	vm_fault_superpage_fills = 0;		/* debugging */
+unsigned int	vm_fault_superpage_failures = 0;	/* debugging */
+
 #if	MACH_KDB
 extern struct db_watchpoint *db_watchpoint_list;
 #endif	MACH_KDB
@@ -115,6 +131,135 @@ void vm_fault_init()
 				    0, "vm fault state");
 }
 
+/*
+ *	Routine:	vm_fault_superpage_check
+ *	Purpose:
+ *		Decide whether a zero-fill fault at the given
+ *		offset should fill the whole superpage-sized chunk
+ *		around it.  The object must be the only one in its
+ *		chain, have no pager or copy, and have no other
+ *		resident page in the chunk.
+ *
+ *	In/out conditions:
+ *		"object" must be locked.
+ */
+static boolean_t
+vm_fault_superpage_check(object, offset)
+	register vm_object_t	object;
+	vm_offset_t		offset;
+{
+	register vm_size_t	size = pmap_superpage_size();
+	register vm_offset_t	start, off;
+
+	if (size == 0 || !vm_fault_superpages)
+		return FALSE;
+	if (vm_fault_superpage_backoff > 0) {
+		vm_fault_superpage_backoff--;
+		return FALSE;
+	}
+
+	if (object == kernel_object || !object->internal ||
+	    object->pager_created || object->shadow != VM_OBJECT_NULL ||
+	    object->copy != VM_OBJECT_NULL)
+		return FALSE;
+
+	start = offset & ~(size - 1);
+	if (start + size > object->size)
+		return FALSE;
+
+	if (vm_page_free_count < vm_page_free_target + atop(size))
+		return FALSE;
+
+	for (off = start; off < start + size; off += PAGE_SIZE)
+		if (off != offset &&
+		    vm_page_lookup(object, off) != VM_PAGE_NULL)
+			return FALSE;
+
+	return TRUE;
+}
+
+/*
+ *	Routine:	vm_fault_superpage_fill
+ *	Purpose:
+ *		Zero-fill the busy page "m" at "offset", and every
+ *		other missing page of its superpage-sized chunk,
+ *		from one aligned physical run.  "m" keeps its
+ *		descriptor but takes the run's frame for its offset.
+ *		The other pages are entered in the object unbusied
+ *		and active.
+ *	Results:
+ *		FALSE if no run could be found; "m" is untouched.
+ *
+ *	In/out conditions:
+ *		"object" must be unlocked, with a paging reference.
+ */
+static boolean_t
+vm_fault_superpage_fill(object, offset, m)
+	register vm_object_t	object;
+	vm_offset_t		offset;
+	vm_page_t		m;
+{
+	vm_size_t		size = pmap_superpage_size();
+	int			npages = atop(size);
+	vm_size_t		run_size = npages * sizeof(vm_page_t);
+	vm_page_t		*run;
+	register vm_page_t	p;
+	vm_offset_t		start, pa;
+	register int		i, k;
+
+	run = (vm_page_t *) kalloc(run_size);
+	if (vm_page_grab_contiguous_pages(npages, run, (natural_t *) 0,
+					  npages) != KERN_SUCCESS) {
+		kfree((vm_offset_t) run, run_size);
+		vm_fault_superpage_failures++;
+		vm_fault_superpage_backoff = VM_FAULT_SUPERPAGE_BACKOFF;
+		return FALSE;
+	}
+
+	for (i = 0; i < npages; i++) {
+		pmap_zero_page_nocache(run[i]->phys_addr);
+		pmap_clear_modify(run[i]->phys_addr);
+	}
+
+	/*
+	 *	Give "m" the frame for its offset, and return
+	 *	its old frame to the free list.
+	 */
+	start = offset & ~(size - 1);
+	k = atop(offset - start);
+	pa = m->phys_addr;
+	m->phys_addr = run[k]->phys_addr;
+	run[k]->phys_addr = pa;
+	vm_page_release(run[k]);
+
+	vm_object_lock(object);
+	vm_page_lock_queues();
+	for (i = 0; i < npages; i++) {
+		if (i == k)
+			continue;
+		p = run[i];
+
+		/*
+		 *	Someone may have filled this offset
+		 *	while the object was unlocked.
+		 */
+		if (vm_page_lookup(object, start + ptoa(i)) != VM_PAGE_NULL) {
+			vm_page_release(p);
+			continue;
+		}
+
+		vm_page_insert(p, object, start + ptoa(i));
+		vm_page_activate(p);
+		PAGE_WAKEUP_DONE(p);
+	}
+	vm_page_unlock_queues();
+	vm_object_unlock(object);
+
+	kfree((vm_offset_t) run, run_size);
+	vm_fault_superpage_fills++;
+	return TRUE;
+}
+
 /*
  *	Routine:	vm_fault_cleanup
  *	Purpose:
@@ -241,6 +386,7 @@ vm_fault_return_t vm_fault_page(first_object, first_offset,
 	vm_object_t	next_object;
 	vm_object_t	copy_object;
 	boolean_t	look_for_page;
+	boolean_t	superpage;
 	vm_prot_t	access_required;
 
 #ifdef CONTINUATIONS
@@ -478,7 +624,7 @@ vm_fault_return_t vm_fault_page(first_object, first_offset,
 					 */
 					vm_object_unlock(object);
 
-					vm_page_zero_fill(m);
+					vm_page_zero_fill_unmapped(m);
 
 					vm_stat_sample(SAMPLED_PC_VM_ZFILL_FAULTS);
 					
@@ -748,8 +894,11 @@ vm_fault_return_t vm_fault_page(first_object, first_offset,
 				return(VM_FAULT_MEMORY_SHORTAGE);
 			}
 
+			superpage = vm_fault_superpage_check(object, offset);
 			vm_object_unlock(object);
-			vm_page_zero_fill(m);
+			if (!superpage ||
+			    !vm_fault_superpage_fill(object, offset, m))
+				vm_page_zero_fill_unmapped(m);
 			vm_stat_sample(SAMPLED_PC_VM_ZFILL_FAULTS);
 			vm_stat.zero_fill_count++;
 			vm_object_lock(object);
@@ -316,6 +316,65 @@ projected_buffer_collect(map)
 }
 
 
+/*
+ *	projected_buffer_hold
+ *
+ *	Take a kernel reference to a non-persistent projected buffer,
+ *      so that user deallocation cannot remove its kernel mapping
+ *      while the kernel may still hand it to projected_buffer_map.
+ *      The reference is dropped with projected_buffer_release.
+ */
+
+kern_return_t
+projected_buffer_hold(kernel_addr)
+	vm_offset_t kernel_addr;
+{
+	vm_map_entry_t k_entry;
+
+	vm_map_lock(kernel_map);
+	if (!vm_map_lookup_entry(kernel_map, kernel_addr, &k_entry) ||
+	    k_entry->projected_on != (vm_map_entry_t) -1) {
+	  vm_map_unlock(kernel_map);
+	  return(KERN_INVALID_ARGUMENT);
+	}
+	vm_object_reference(k_entry->object.vm_object);
+	vm_map_unlock(kernel_map);
+	return(KERN_SUCCESS);
+}
+
+
+/*
+ *	projected_buffer_release
+ *
+ *	Drop a reference taken with projected_buffer_hold.  If no
+ *      user task maps the buffer any longer, the kernel mapping is
+ *      deleted here, as projected_buffer_deallocate would have done.
+ */
+
+void
+projected_buffer_release(kernel_addr)
+	vm_offset_t kernel_addr;
+{
+	vm_map_entry_t k_entry;
+	vm_object_t object;
+
+	vm_map_lock(kernel_map);
+	if (!vm_map_lookup_entry(kernel_map, kernel_addr, &k_entry))
+	  panic("projected_buffer_release");
+	object = k_entry->object.vm_object;
+	if (k_entry->projected_on == (vm_map_entry_t) -1 &&
+	    object->ref_count == 2) {
+	  /*Only the kernel mapping and our reference remain*/
+	  if (kernel_map->first_free == k_entry)
+	    kernel_map->first_free = k_entry->vme_prev;
+	  k_entry->projected_on = 0;    /*Allow unwire fault*/
+	  vm_map_entry_delete(kernel_map, k_entry);
+	}
+	vm_map_unlock(kernel_map);
+	vm_object_deallocate(object);
+}
+
+
 /*
  *	projected_buffer_in_range
  *
@@ -41,6 +41,8 @@ extern kern_return_t    projected_buffer_allocate();
 extern kern_return_t    projected_buffer_deallocate();
 extern kern_return_t    projected_buffer_map();
 extern kern_return_t    projected_buffer_collect();
+extern kern_return_t    projected_buffer_hold();
+extern void             projected_buffer_release();
 
 extern void		kmem_init();
 
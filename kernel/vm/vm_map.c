@@ -4258,16 +4258,33 @@ vm_map_t vm_map_fork(old_map)
 					 */
 
 					if (src_needs_copy && !old_entry->needs_copy) {
-						vm_object_pmap_protect(
+						/*
+						 *	If only this map can have
+						 *	the pages mapped, protect
+						 *	the range rather than each
+						 *	resident page: pmaps may
+						 *	defer the work per page
+						 *	table until the next write
+						 *	there, so the cost of
+						 *	forking does not grow with
+						 *	the parent's resident size.
+						 */
+						if (old_entry->is_shared)
+						    vm_object_pmap_protect(
 							old_entry->object.vm_object,
 							old_entry->offset,
 							entry_size,
-							(old_entry->is_shared ?
-								PMAP_NULL :
-								old_map->pmap),
+							PMAP_NULL,
 							old_entry->vme_start,
 							old_entry->protection &
 							    ~VM_PROT_WRITE);
+						else
+						    pmap_protect(
+							old_map->pmap,
+							old_entry->vme_start,
+							old_entry->vme_end,
+							old_entry->protection &
+							    ~VM_PROT_WRITE);
 
 						old_entry->needs_copy = TRUE;
 					}
@@ -48,7 +48,10 @@
 #include <ipc/ipc_space.h>
 #include <kern/assert.h>
 #include <kern/lock.h>
+#include <kern/processor.h>
 #include <kern/queue.h>
+#include <kern/sched.h>
+#include <kern/sched_prim.h>
 #include <kern/xpr.h>
 #include <kern/zalloc.h>
 #include <vm/memory_object.h>
@@ -193,6 +196,25 @@ decl_simple_lock_data(,vm_object_cached_lock_data)
 #define vm_object_cache_unlock()	\
 		simple_unlock(&vm_object_cached_lock_data)
 
+/*
+ *	Objects whose shadow chains have grown deeper than
+ *	vm_object_shadow_depth_max are queued for the background
+ *	collapser, which retries vm_object_collapse on them
+ *	whenever a backing object may have become private.
+ *	The queue holds no references; vm_object_terminate
+ *	removes dying objects from it.
+ */
+queue_head_t	vm_object_collapse_queue;
+int		vm_object_collapse_count;
+int		vm_object_shadow_depth_max = 4;	/* may be patched */
+
+decl_simple_lock_data(,vm_object_collapse_lock_data)
+
+#define vm_object_collapse_queue_lock()		\
+		simple_lock(&vm_object_collapse_lock_data)
+#define vm_object_collapse_queue_unlock()	\
+		simple_unlock(&vm_object_collapse_lock_data)
+
 /*
  *	Virtual memory objects are initialized from
  *	a template (see vm_object_allocate).
@@ -257,6 +279,9 @@ void vm_object_bootstrap(void)
 	queue_init(&vm_object_cached_list);
 	simple_lock_init(&vm_object_cached_lock_data);
 
+	queue_init(&vm_object_collapse_queue);
+	simple_lock_init(&vm_object_collapse_lock_data);
+
 	/*
 	 *	Fill in a template object, for quick initialization
 	 */
@@ -270,6 +295,7 @@ void vm_object_bootstrap(void)
 	vm_object_template->copy = VM_OBJECT_NULL;
 	vm_object_template->shadow = VM_OBJECT_NULL;
 	vm_object_template->shadow_offset = (vm_offset_t) 0;
+	vm_object_template->shadow_depth = 0;
 
 	vm_object_template->pager = IP_NULL;
 	vm_object_template->paging_offset = 0;
@@ -285,6 +311,7 @@ void vm_object_bootstrap(void)
 		 * permanent object becomes ready */
 	vm_object_template->use_shared_copy = FALSE;
 	vm_object_template->shadowed = FALSE;
+	vm_object_template->collapse_queued = FALSE;
 
 	vm_object_template->absent_count = 0;
 	vm_object_template->all_wanted = 0; /* all bits FALSE */
@@ -389,8 +416,13 @@ void vm_object_deallocate(
 
 			/*
 			 *	If there are still references, then
-			 *	we are done.
+			 *	we are done.  If only one is left, the
+			 *	object may now be collapsible into the
+			 *	object that shadows it.
 			 */
+			if (object->ref_count == 1 && object->internal &&
+			    vm_object_collapse_count > 0)
+				thread_wakeup((event_t) &vm_object_collapse_queue);
 			vm_object_unlock(object);
 			vm_object_cache_unlock();
 			return;
@@ -548,6 +580,19 @@ void vm_object_terminate(
 	assert(object->alive);
 	object->alive = FALSE;
 
+	/*
+	 *	Take the object off the collapser's queue.
+	 */
+
+	if (object->collapse_queued) {
+		vm_object_collapse_queue_lock();
+		queue_remove(&vm_object_collapse_queue, object,
+			     vm_object_t, collapse_list);
+		vm_object_collapse_count--;
+		object->collapse_queued = FALSE;
+		vm_object_collapse_queue_unlock();
+	}
+
 	/*
 	 *	Make sure no one can look us up now.
 	 */
@@ -1430,6 +1475,7 @@ kern_return_t vm_object_copy_call(
 	new_object = vm_object_enter(new_memory_object, size, FALSE);
 	new_object->shadow = src_object;
 	new_object->shadow_offset = src_offset;
+	vm_object_set_shadow_depth(new_object);
 
 	/*
 	 *	Drop the reference for new_memory_object taken above.
@@ -1578,6 +1624,7 @@ vm_object_t vm_object_copy_delayed(
 		src_object->ref_count--;	/* remove ref. from old_copy */
 		assert(src_object->ref_count > 0);
 		old_copy->shadow = new_copy;
+		vm_object_set_shadow_depth(old_copy);
 		assert(new_copy->ref_count > 0);
 		new_copy->ref_count++;
 		vm_object_unlock(old_copy);	/* done with old_copy */
@@ -1589,6 +1636,7 @@ vm_object_t vm_object_copy_delayed(
 
 	new_copy->shadow = src_object;
 	new_copy->shadow_offset = 0;
+	vm_object_set_shadow_depth(new_copy);
 	new_copy->shadowed = TRUE;	/* caller must set needs_copy */
 	assert(src_object->ref_count > 0);
 	src_object->ref_count++;
@@ -1762,6 +1810,18 @@ void vm_object_shadow(
 
 	result->shadow_offset = *offset;
 
+	/*
+	 *	Let the collapser shorten chains that repeated
+	 *	copy-on-write has made too long.
+	 */
+
+	vm_object_set_shadow_depth(result);
+	if (result->shadow_depth > vm_object_shadow_depth_max) {
+		vm_object_lock(result);
+		vm_object_collapse_enqueue(result);
+		vm_object_unlock(result);
+	}
+
 	/*
 	 *	Return the new things
 	 */
@@ -2653,6 +2713,7 @@ void vm_object_collapse(
 
 			object->shadow = backing_object->shadow;
 			object->shadow_offset += backing_object->shadow_offset;
+			object->shadow_depth = backing_object->shadow_depth;
 			if (object->shadow != VM_OBJECT_NULL &&
 			    object->shadow->copy != VM_OBJECT_NULL) {
 				panic("vm_object_collapse: we collapsed a copy-object!");
@@ -2751,6 +2812,7 @@ void vm_object_collapse(
 
 			vm_object_reference(object->shadow = backing_object->shadow);
 			object->shadow_offset += backing_object->shadow_offset;
+			object->shadow_depth = backing_object->shadow_depth;
 
 			/*
 			 *	Backing object might have had a copy pointer
@@ -2779,6 +2841,139 @@ void vm_object_collapse(
 	}
 }
 
+/*
+ *	Routine:	vm_object_collapse_enqueue
+ *	Purpose:
+ *		Ask the background collapser to shorten the
+ *		object's shadow chain.
+ *
+ *	In/out conditions:
+ *		The object must be locked.
+ */
+void vm_object_collapse_enqueue(
+	register vm_object_t	object)
+{
+	vm_object_collapse_queue_lock();
+	if (!object->collapse_queued) {
+		queue_enter(&vm_object_collapse_queue, object,
+			    vm_object_t, collapse_list);
+		object->collapse_queued = TRUE;
+		if (vm_object_collapse_count++ == 0)
+			thread_wakeup((event_t) &vm_object_collapse_queue);
+	}
+	vm_object_collapse_queue_unlock();
+}
+
+/*
+ *	Routine:	vm_object_shadow_depth_count
+ *	Purpose:
+ *		Recount the objects behind the given one,
+ *		locking down the chain as the fault path does.
+ *
+ *	In/out conditions:
+ *		The object must be locked, and is left locked.
+ */
+unsigned short vm_object_shadow_depth_count(
+	vm_object_t	object)
+{
+	register vm_object_t	cur, next;
+	register unsigned short	depth;
+
+	depth = 0;
+	cur = object;
+	while ((next = cur->shadow) != VM_OBJECT_NULL) {
+		vm_object_lock(next);
+		if (cur != object)
+			vm_object_unlock(cur);
+		cur = next;
+		depth++;
+	}
+	if (cur != object)
+		vm_object_unlock(cur);
+
+	return depth;
+}
+
+/*
+ *	Routine:	vm_object_collapse_thread
+ *	Purpose:
+ *		Background thread that shortens deep shadow
+ *		chains, so that faults on long-lived forking
+ *		tasks need not walk them.  Each pass looks at
+ *		every queued object once; objects whose chains
+ *		are still too deep (because a backing object is
+ *		still shared) stay queued until the next wakeup.
+ */
+long	vm_object_collapse_passes = 0;		/* debugging */
+long	vm_object_collapse_shortened = 0;	/* debugging */
+
+void vm_object_collapse_continue(void)
+{
+	register vm_object_t	object;
+	register int		count;
+	unsigned short		depth;
+
+	vm_object_collapse_queue_lock();
+	vm_object_collapse_passes++;
+
+	for (count = vm_object_collapse_count; count > 0; count--) {
+		if (queue_empty(&vm_object_collapse_queue))
+			break;
+		object = (vm_object_t) queue_first(&vm_object_collapse_queue);
+		queue_remove(&vm_object_collapse_queue, object,
+			     vm_object_t, collapse_list);
+
+		/*
+		 *	Lock order is object, then queue: only try.
+		 */
+		if (!vm_object_lock_try(object)) {
+			queue_enter(&vm_object_collapse_queue, object,
+				    vm_object_t, collapse_list);
+			continue;
+		}
+		object->collapse_queued = FALSE;
+		vm_object_collapse_count--;
+
+		if (object->ref_count == 0) {
+			/*
+			 *	Cached; leave it alone.
+			 */
+			vm_object_unlock(object);
+			continue;
+		}
+		object->ref_count++;
+		vm_object_collapse_queue_unlock();
+
+		depth = object->shadow_depth;
+		vm_object_collapse(object);
+		object->shadow_depth = vm_object_shadow_depth_count(object);
+		if (object->shadow_depth < depth)
+			vm_object_collapse_shortened++;
+		if (object->shadow_depth > vm_object_shadow_depth_max)
+			vm_object_collapse_enqueue(object);
+		vm_object_unlock(object);
+		vm_object_deallocate(object);
+
+		if (csw_needed(current_thread(), current_processor()))
+			thread_block((void (*)(void)) 0);
+
+		vm_object_collapse_queue_lock();
+	}
+
+	assert_wait((event_t) &vm_object_collapse_queue, FALSE);
+	vm_object_collapse_queue_unlock();
+	thread_block(vm_object_collapse_continue);
+	/*NOTREACHED*/
+}
+
+void vm_object_collapse_thread(void)
+{
+	thread_set_own_priority(BASEPRI_USER);
+
+	vm_object_collapse_continue();
+	/*NOTREACHED*/
+}
+
 /*
  *	Routine:	vm_object_page_remove: [internal]
  *	Purpose:
@@ -3063,8 +3258,9 @@ void vm_object_print(
 		object->internal ? "internal" : "external",
 	 	object->can_persist ? " cacheable" : "");
 	 printf("copy_strategy=%d\n", (vm_offset_t)object->copy_strategy);
-	iprintf("shadow=0x%X (offset=0x%X),",
-		(vm_offset_t) object->shadow, (vm_offset_t) object->shadow_offset);
+	iprintf("shadow=0x%X (offset=0x%X, depth=%d),",
+		(vm_offset_t) object->shadow, (vm_offset_t) object->shadow_offset,
+		object->shadow_depth);
 	 printf("copy=0x%X\n", (vm_offset_t) object->copy);
 
 	indent += 2;
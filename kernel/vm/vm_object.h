@@ -88,6 +88,10 @@ struct vm_object {
 						 */
 	struct vm_object	*shadow;	/* My shadow */
 	vm_offset_t		shadow_offset;	/* Offset into shadow */
+	unsigned short		shadow_depth;	/* Objects behind me in the
+						 * shadow chain, when it was
+						 * last set (an upper bound)
+						 */
 
 	struct ipc_port		*pager;		/* Where to get data */
 	vm_offset_t		paging_offset;	/* Offset into memory object */
@@ -156,13 +160,21 @@ struct vm_object {
 						 */
 	/* boolean_t */		use_shared_copy : 1,/* Use shared (i.e.,
 						 * delayed) copy on write */
-	/* boolean_t */		shadowed: 1;	/* Shadow may exist */
+	/* boolean_t */		shadowed: 1,	/* Shadow may exist */
+	/* boolean_t */		collapse_queued: 1;
+						/* On the background
+						 * collapser's queue
+						 */
 
 	queue_chain_t		cached_list;	/* Attachment point for the list
 						 * of objects cached as a result
 						 * of their can_persist value
 						 */
 	vm_offset_t		last_alloc;	/* last allocation offset */
+	queue_chain_t		collapse_list;	/* Attachment point for the
+						 * collapser's queue of
+						 * objects with deep chains
+						 */
 #if	MACH_PAGEMAP
 	vm_external_t		existence_info;
 #endif	/* MACH_PAGEMAP */
@@ -204,6 +216,8 @@ extern void		vm_object_shadow(
 	vm_offset_t	*offset,	/* in/out */
 	vm_size_t	length);
 extern void		vm_object_collapse(vm_object_t);
+extern void		vm_object_collapse_enqueue(vm_object_t);
+extern void		vm_object_collapse_thread(void);
 extern vm_object_t	vm_object_lookup(struct ipc_port *);
 extern vm_object_t	vm_object_lookup_name(struct ipc_port *);
 extern struct ipc_port	*vm_object_name(vm_object_t);
@@ -248,6 +262,15 @@ extern void		vm_object_print(vm_object_t);
 
 extern vm_object_t	vm_object_request_object(struct ipc_port *);
 
+/*
+ *	Recompute the depth of an object's shadow chain after
+ *	its shadow has changed.  The shadow's depth is read
+ *	unlocked; it is only a hint.
+ */
+#define	vm_object_set_shadow_depth(object)				\
+	((object)->shadow_depth = ((object)->shadow == VM_OBJECT_NULL) ?	\
+		0 : (object)->shadow->shadow_depth + 1)
+
 /*
  *	Event waiting handling
  */
@@ -235,6 +235,9 @@ extern void		vm_page_remove(
 	vm_page_t	mem);
 
 extern void		vm_page_zero_fill(vm_page_t);
+extern void		vm_page_zero_fill_unmapped(vm_page_t);
+extern void		vm_page_zero_thread(void);
+extern void		vm_page_zeroed_drain(void);
 extern void		vm_page_copy(vm_page_t src_m, vm_page_t dest_m);
 
 extern void		vm_page_wire(vm_page_t);
@@ -242,10 +245,21 @@ extern void		vm_page_unwire(vm_page_t);
 
 extern void		vm_set_page_size(void);
 
+extern void		vm_page_hash_resize(unsigned int count);
+extern void		vm_page_hash_check(void);
+
+extern kern_return_t	vm_page_grab_contiguous_pages(
+	int		npages,
+	vm_page_t	pages[],
+	natural_t	*bits,
+	int		align);
+
 #if	MACH_VM_DEBUG
 extern unsigned int	vm_page_info(
 	hash_info_bucket_t	*info,
 	unsigned int		count);
+extern void		vm_page_info_histogram(
+	hash_info_histogram_t	histogram);
 #endif
 
 /*
@@ -146,6 +146,7 @@
 
 extern void vm_pageout_continue();
 extern void vm_pageout_scan_continue();
+extern void blk_cache_collect();
 
 unsigned int vm_pageout_reserved_internal = 0;
 unsigned int vm_pageout_reserved_really = 0;
@@ -543,6 +544,7 @@ void vm_pageout_scan()
     Restart:
 	stack_collect();
 	net_kmsg_collect();
+	blk_cache_collect();
 	consider_task_collect();
 	consider_thread_collect();
 	consider_zone_gc();
@@ -36,6 +36,8 @@
 
 #include <mach/vm_prot.h>
 #include <kern/counters.h>
+#include <kern/processor.h>
+#include <kern/sched.h>
 #include <kern/sched_prim.h>
 #include <kern/task.h>
 #include <kern/thread.h>
@@ -81,15 +83,32 @@ vm_offset_t virtual_space_end;
  *	routines install and remove associations in the table.
  *	[This table is often called the virtual-to-physical,
  *	or VP, table.]
+ *
+ *	The buckets are protected by a fixed array of striped
+ *	locks.  A bucket's stripe is selected by the low bits
+ *	of the full hash value, which don't depend on the size
+ *	of the table, so the table can be resized by taking
+ *	every stripe.  The bucket array, count and mask may
+ *	only be examined while holding a stripe.
  */
 typedef struct {
-	decl_simple_lock_data(,lock)
 	vm_page_t pages;
 } vm_page_bucket_t;
 
 vm_page_bucket_t *vm_page_buckets;		/* Array of buckets */
 unsigned int	vm_page_bucket_count = 0;	/* How big is array? */
 unsigned int	vm_page_hash_mask;		/* Mask for hash function */
+boolean_t	vm_page_buckets_stolen;		/* Array from pmap_steal_memory? */
+unsigned int	vm_page_hash_pages = 0;		/* Page frames created so far */
+
+#define	VM_PAGE_BUCKET_LOCKS	64		/* Must be a power of two */
+
+decl_simple_lock_data(,vm_page_bucket_locks[VM_PAGE_BUCKET_LOCKS])
+
+#define	vm_page_bucket_lock(hash)	\
+	simple_lock(&vm_page_bucket_locks[(hash) & (VM_PAGE_BUCKET_LOCKS - 1)])
+#define	vm_page_bucket_unlock(hash)	\
+	simple_unlock(&vm_page_bucket_locks[(hash) & (VM_PAGE_BUCKET_LOCKS - 1)])
 
 /*
  *	Resident page structures are initialized from
@@ -108,12 +127,42 @@ struct vm_page	vm_page_template;
 vm_page_t	vm_page_queue_free;
 vm_page_t	vm_page_queue_fictitious;
 decl_simple_lock_data(,vm_page_queue_free_lock)
+
+/*
+ *	Biggest phys page number for the pages we handle in VM,
+ *	and the work space vm_page_grab_contiguous_pages uses
+ *	(under the free list lock) when the caller has none.
+ */
+vm_size_t	vm_page_big_pagenum = 0;
+natural_t	*vm_page_contiguous_bits;
+vm_size_t	vm_page_contiguous_bits_size;	/* in bytes */
+
+#ifndef	NBBY
+#define	NBBY	8	/* size in bits of sizeof()`s unity */
+#endif
+
 unsigned int	vm_page_free_wanted;
 int		vm_page_free_count;
 int		vm_page_fictitious_count;
 
 unsigned int	vm_page_free_count_minimum;	/* debugging */
 
+/*
+ *	Free pages that the idle-time zeroing thread has already
+ *	cleared are kept on a list of their own, so that zero-fill
+ *	faults can take one instead of zeroing a page synchronously.
+ *	The list is protected by vm_page_queue_free_lock, and the
+ *	pages on it are included in vm_page_free_count.
+ */
+vm_page_t	vm_page_queue_zeroed;
+int		vm_page_zeroed_count;
+int		vm_page_zeroed_target = 0;	/* size of pool to maintain */
+boolean_t	vm_page_zero_idle = TRUE;	/* enables the zeroing thread */
+
+#ifndef	VM_PAGE_ZEROED_TARGET
+#define	VM_PAGE_ZEROED_TARGET(free)	((free) / 16)
+#endif	VM_PAGE_ZEROED_TARGET
+
 /*
  *	Occasionally, the virtual memory system uses
  *	resident page structures that do not refer to
@@ -227,6 +276,7 @@ void vm_page_bootstrap(
 
 	vm_page_queue_free = VM_PAGE_NULL;
 	vm_page_queue_fictitious = VM_PAGE_NULL;
+	vm_page_queue_zeroed = VM_PAGE_NULL;
 	queue_init(&vm_page_queue_active);
 	queue_init(&vm_page_queue_inactive);
 
@@ -259,6 +309,15 @@ void vm_page_bootstrap(
 			vm_page_bucket_count <<= 1;
 	}
 
+	/*
+	 *	The stripe of a bucket must not change when
+	 *	the table is resized, so there can't be fewer
+	 *	buckets than stripes.
+	 */
+
+	if (vm_page_bucket_count < VM_PAGE_BUCKET_LOCKS)
+		vm_page_bucket_count = VM_PAGE_BUCKET_LOCKS;
+
 	vm_page_hash_mask = vm_page_bucket_count - 1;
 
 	if (vm_page_hash_mask & vm_page_bucket_count)
@@ -267,13 +326,13 @@ void vm_page_bootstrap(
 	vm_page_buckets = (vm_page_bucket_t *)
 		pmap_steal_memory(vm_page_bucket_count *
 				  sizeof(vm_page_bucket_t));
+	vm_page_buckets_stolen = TRUE;
 
-	for (i = 0; i < vm_page_bucket_count; i++) {
-		register vm_page_bucket_t *bucket = &vm_page_buckets[i];
+	for (i = 0; i < vm_page_bucket_count; i++)
+		vm_page_buckets[i].pages = VM_PAGE_NULL;
 
-		bucket->pages = VM_PAGE_NULL;
-		simple_lock_init(&bucket->lock);
-	}
+	for (i = 0; i < VM_PAGE_BUCKET_LOCKS; i++)
+		simple_lock_init(&vm_page_bucket_locks[i]);
 
 	/*
 	 *	Machine-dependent code allocates the resident page table.
@@ -386,6 +445,9 @@ void pmap_startup(
 
 		vm_page_init(&pages[i], paddr);
 		pages_initialized++;
+		vm_page_hash_pages++;
+		if (atop(paddr) >= vm_page_big_pagenum)
+			vm_page_big_pagenum = atop(paddr) + 1;
 	}
 
 	/*
@@ -423,6 +485,24 @@ void		vm_page_module_init(void)
 			     VM_MAX_KERNEL_ADDRESS - VM_MIN_KERNEL_ADDRESS,
 			     PAGE_SIZE,
 			     0, "vm pages");
+
+	/*
+	 *	Set aside the work space for contiguous allocations,
+	 *	so that callers in the fault path need not allocate.
+	 */
+	vm_page_contiguous_bits_size =
+		round_page((vm_page_big_pagenum + NBBY - 1) / NBBY);
+	if (kmem_alloc_wired(kernel_map,
+			     (vm_offset_t *) &vm_page_contiguous_bits,
+			     vm_page_contiguous_bits_size) != KERN_SUCCESS)
+		vm_page_contiguous_bits_size = 0;
+
+	/*
+	 *	The boot-time table was sized from an estimate;
+	 *	now that kernel memory can be allocated, grow it
+	 *	if more pages turned up than it was sized for.
+	 */
+	vm_page_hash_check();
 }
 
 /*
@@ -450,6 +530,32 @@ void vm_page_create(
 
 		vm_page_init(m, paddr);
 		vm_page_release(m);
+		vm_page_hash_pages++;
+		if (atop(paddr) >= vm_page_big_pagenum)
+			vm_page_big_pagenum = atop(paddr) + 1;
+	}
+
+	vm_page_hash_check();
+}
+
+/*
+ *	vm_page_hash_check:
+ *
+ *	Keep the average chain short if there are a lot more
+ *	pages than the VP table was sized for.  Called when
+ *	vm_page_hash_pages has grown.
+ *
+ *	Nothing locked; may block.
+ */
+void vm_page_hash_check(void)
+{
+	unsigned int count;
+
+	if (vm_page_hash_pages > 2 * vm_page_bucket_count) {
+		count = vm_page_bucket_count;
+		while (count < vm_page_hash_pages)
+			count <<= 1;
+		vm_page_hash_resize(count);
 	}
 }
 
@@ -457,13 +563,98 @@ void vm_page_create(
  *	vm_page_hash:
  *
  *	Distributes the object/offset key pair among hash buckets.
+ *	Returns the full hash value; callers mask it with
+ *	vm_page_hash_mask to get a bucket and with the stripe
+ *	mask to get a lock.  Object addresses have their low
+ *	bits in common and offsets of one object are usually
+ *	consecutive, so both are mixed into all the bits.
  *
  *	NOTE:	To get a good hash function, the bucket count should
  *		be a power of two.
  */
-#define vm_page_hash(object, offset) \
-	(((unsigned int)(vm_offset_t)object + (unsigned int)atop(offset)) \
-		& vm_page_hash_mask)
+static __inline unsigned int vm_page_hash(
+	vm_object_t	object,
+	vm_offset_t	offset)
+{
+	register unsigned int h;
+
+	h = ((unsigned int)(vm_offset_t)object >> 4) * 0x9e3779b1;
+	h += (unsigned int)atop(offset);
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	return h;
+}
+
+/*
+ *	vm_page_hash_resize:
+ *
+ *	Rehash the VP table into count buckets, which must
+ *	be a power of two.  Lookups are held off by taking
+ *	every stripe while the chains are moved.
+ *
+ *	Nothing locked; may block.
+ */
+void vm_page_hash_resize(
+	unsigned int	count)
+{
+	vm_page_bucket_t	*buckets, *old_buckets;
+	unsigned int		old_count, i;
+	boolean_t		old_stolen;
+	register vm_page_t	mem, next;
+
+	assert((count & (count - 1)) == 0);
+	if (count < VM_PAGE_BUCKET_LOCKS)
+		count = VM_PAGE_BUCKET_LOCKS;
+
+	if (kmem_alloc_wired(kernel_map, (vm_offset_t *) &buckets,
+			     round_page(count * sizeof(vm_page_bucket_t)))
+						!= KERN_SUCCESS) {
+		printf("vm_page_hash_resize: no memory for %d buckets\n",
+		       count);
+		return;
+	}
+	for (i = 0; i < count; i++)
+		buckets[i].pages = VM_PAGE_NULL;
+
+	for (i = 0; i < VM_PAGE_BUCKET_LOCKS; i++)
+		simple_lock(&vm_page_bucket_locks[i]);
+
+	old_buckets = vm_page_buckets;
+	old_count = vm_page_bucket_count;
+	old_stolen = vm_page_buckets_stolen;
+
+	for (i = 0; i < old_count; i++) {
+		for (mem = old_buckets[i].pages; mem != VM_PAGE_NULL;
+		     mem = next) {
+			register vm_page_bucket_t *bucket;
+
+			next = mem->next;
+			bucket = &buckets[vm_page_hash(mem->object,
+						       mem->offset)
+					  & (count - 1)];
+			mem->next = bucket->pages;
+			bucket->pages = mem;
+		}
+	}
+
+	vm_page_buckets = buckets;
+	vm_page_bucket_count = count;
+	vm_page_hash_mask = count - 1;
+	vm_page_buckets_stolen = FALSE;
+
+	for (i = VM_PAGE_BUCKET_LOCKS; i > 0; i--)
+		simple_unlock(&vm_page_bucket_locks[i - 1]);
+
+	/*
+	 *	The boot-time table came from pmap_steal_memory
+	 *	and can't be given back.
+	 */
+
+	if (!old_stolen)
+		kmem_free(kernel_map, (vm_offset_t) old_buckets,
+			  round_page(old_count * sizeof(vm_page_bucket_t)));
+}
 
 /*
  *	vm_page_insert:		[ internal use only ]
@@ -480,6 +671,7 @@ void vm_page_insert(
 	register vm_offset_t	offset)
 {
 	register vm_page_bucket_t *bucket;
+	register unsigned int	hash;
 
 	VM_PAGE_CHECK(mem);
 
@@ -497,11 +689,12 @@ void vm_page_insert(
 	 *	Insert it into the object_object/offset hash table
 	 */
 
-	bucket = &vm_page_buckets[vm_page_hash(object, offset)];
-	simple_lock(&bucket->lock);
+	hash = vm_page_hash(object, offset);
+	vm_page_bucket_lock(hash);
+	bucket = &vm_page_buckets[hash & vm_page_hash_mask];
 	mem->next = bucket->pages;
 	bucket->pages = mem;
-	simple_unlock(&bucket->lock);
+	vm_page_bucket_unlock(hash);
 
 	/*
 	 *	Now link into the object's list of backed pages.
@@ -548,6 +741,7 @@ void vm_page_replace(
 	register vm_offset_t	offset)
 {
 	register vm_page_bucket_t *bucket;
+	register unsigned int	hash;
 
 	VM_PAGE_CHECK(mem);
 
@@ -566,8 +760,9 @@ void vm_page_replace(
 	 *	replacing any page that might have been there.
 	 */
 
-	bucket = &vm_page_buckets[vm_page_hash(object, offset)];
-	simple_lock(&bucket->lock);
+	hash = vm_page_hash(object, offset);
+	vm_page_bucket_lock(hash);
+	bucket = &vm_page_buckets[hash & vm_page_hash_mask];
 	if (bucket->pages) {
 		vm_page_t *mp = &bucket->pages;
 		register vm_page_t m = *mp;
@@ -586,7 +781,7 @@ void vm_page_replace(
 				/*
 				 * Return page to the free list.
 				 * Note the page is not tabled now, so this
-				 * won't self-deadlock on the bucket lock.
+				 * won't self-deadlock on the bucket stripe.
 				 */
 
 				vm_page_free(m);
@@ -599,7 +794,7 @@ void vm_page_replace(
 		mem->next = VM_PAGE_NULL;
 	}
 	bucket->pages = mem;
-	simple_unlock(&bucket->lock);
+	vm_page_bucket_unlock(hash);
 
 	/*
 	 *	Now link into the object's list of backed pages.
@@ -630,6 +825,7 @@ void vm_page_remove(
 {
 	register vm_page_bucket_t	*bucket;
 	register vm_page_t	this;
+	register unsigned int	hash;
 
 	assert(mem->tabled);
 	VM_PAGE_CHECK(mem);
@@ -638,8 +834,9 @@ void vm_page_remove(
 	 *	Remove from the object_object/offset hash table
 	 */
 
-	bucket = &vm_page_buckets[vm_page_hash(mem->object, mem->offset)];
-	simple_lock(&bucket->lock);
+	hash = vm_page_hash(mem->object, mem->offset);
+	vm_page_bucket_lock(hash);
+	bucket = &vm_page_buckets[hash & vm_page_hash_mask];
 	if ((this = bucket->pages) == mem) {
 		/* optimize for common case */
 
@@ -653,7 +850,7 @@ void vm_page_remove(
 			continue;
 		*prev = this->next;
 	}
-	simple_unlock(&bucket->lock);
+	vm_page_bucket_unlock(hash);
 
 	/*
 	 *	Now remove from the object's list of backed pages.
@@ -686,20 +883,21 @@ vm_page_t vm_page_lookup(
 {
 	register vm_page_t	mem;
 	register vm_page_bucket_t *bucket;
+	register unsigned int	hash;
 
 	/*
 	 *	Search the hash table for this object/offset pair
 	 */
 
-	bucket = &vm_page_buckets[vm_page_hash(object, offset)];
-
-	simple_lock(&bucket->lock);
+	hash = vm_page_hash(object, offset);
+	vm_page_bucket_lock(hash);
+	bucket = &vm_page_buckets[hash & vm_page_hash_mask];
 	for (mem = bucket->pages; mem != VM_PAGE_NULL; mem = mem->next) {
 		VM_PAGE_CHECK(mem);
 		if ((mem->object == object) && (mem->offset == offset))
 			break;
 	}
-	simple_unlock(&bucket->lock);
+	vm_page_bucket_unlock(hash);
 	return mem;
 }
 
@@ -858,13 +1056,21 @@ vm_page_t vm_page_grab(void)
 		return VM_PAGE_NULL;
 	}
 
-	if (vm_page_queue_free == VM_PAGE_NULL)
+	/*
+	 *	Leave pre-zeroed pages for zero-fill faults,
+	 *	unless there is nothing else left.
+	 */
+
+	if ((mem = vm_page_queue_free) != VM_PAGE_NULL)
+		vm_page_queue_free = (vm_page_t) mem->pageq.next;
+	else if ((mem = vm_page_queue_zeroed) != VM_PAGE_NULL) {
+		vm_page_queue_zeroed = (vm_page_t) mem->pageq.next;
+		vm_page_zeroed_count--;
+	} else
 		panic("vm_page_grab");
 
 	if (--vm_page_free_count < vm_page_free_count_minimum)
 		vm_page_free_count_minimum = vm_page_free_count;
-	mem = vm_page_queue_free;
-	vm_page_queue_free = (vm_page_t) mem->pageq.next;
 	mem->free = FALSE;
 	simple_unlock(&vm_page_queue_free_lock);
 
@@ -887,6 +1093,27 @@ vm_page_t vm_page_grab(void)
 	return mem;
 }
 
+/*
+ *	vm_page_zeroed_drain:
+ *
+ *	Give the pre-zeroed pages back to the ordinary free
+ *	list, for allocators that search vm_page_queue_free
+ *	by hand.  The zeroing thread will replace them later.
+ *	Called with vm_page_queue_free_lock held.
+ */
+
+void vm_page_zeroed_drain(void)
+{
+	register vm_page_t	mem;
+
+	while ((mem = vm_page_queue_zeroed) != VM_PAGE_NULL) {
+		vm_page_queue_zeroed = (vm_page_t) mem->pageq.next;
+		mem->pageq.next = (queue_entry_t) vm_page_queue_free;
+		vm_page_queue_free = mem;
+	}
+	vm_page_zeroed_count = 0;
+}
+
 vm_offset_t vm_page_grab_phys_addr(void)
 {
 	vm_page_t p = vm_page_grab();
@@ -900,31 +1127,27 @@ vm_offset_t vm_page_grab_phys_addr(void)
  *	vm_page_grab_contiguous_pages:
  *
  *	Take N pages off the free list, the pages should
- *	cover a contiguous range of physical addresses.
- *	[Used by device drivers to cope with DMA limitations]
+ *	cover a contiguous range of physical addresses,
+ *	starting at a multiple of ALIGN pages.
+ *	[Used by device drivers to cope with DMA limitations,
+ *	 and to back superpages]
  *
  *	Returns the page descriptors in ascending order, or
  *	Returns KERN_RESOURCE_SHORTAGE if it could not.
  */
 
-/* Biggest phys page number for the pages we handle in VM */
-
-vm_size_t	vm_page_big_pagenum = 0;	/* Set this before call! */
-
 kern_return_t
 vm_page_grab_contiguous_pages(
 	int		npages,
 	vm_page_t	pages[],
-	natural_t	*bits)
+	natural_t	*bits,
+	int		align)
 {
 	register int	first_set;
 	int		size, alloc_size;
 	kern_return_t	ret;
 	vm_page_t       mem, prevmem;
-
-#ifndef	NBBY
-#define	NBBY	8	/* size in bits of sizeof()`s unity */
-#endif
+	vm_page_t	*queue;
 
 #define	NBPEL	(sizeof(natural_t)*NBBY)
 
@@ -933,114 +1156,85 @@ vm_page_grab_contiguous_pages(
 
 	size = size / NBBY;				/* in bytes */
 
+	if (align <= 0)
+		align = 1;
+
 	/*
 	 * If we are called before the VM system is fully functional
 	 * the invoker must provide us with the work space. [one bit
 	 * per page starting at phys 0 and up to vm_page_big_pagenum]
+	 * Otherwise, use the shared work space, under the free
+	 * list lock.
 	 */
-	if (bits == 0) {
+	alloc_size = 0;
+	if (bits == 0 && size > vm_page_contiguous_bits_size) {
 		alloc_size = round_page(size);
 		if (kmem_alloc_wired(kernel_map,
 				     (vm_offset_t *)&bits,
 				     alloc_size)
 			!= KERN_SUCCESS)
 		    return KERN_RESOURCE_SHORTAGE;
-	} else
-		alloc_size = 0;
-
-	bzero(bits, size);
+	}
 
 	/*
 	 * A very large granularity call, its rare so that is ok
 	 */
 	simple_lock(&vm_page_queue_free_lock);
 
+	if (bits == 0)
+		bits = vm_page_contiguous_bits;
+	bzero(bits, size);
+
 	/*
 	 *	Do not dip into the reserved pool.
 	 */
 
 	if (vm_page_free_count < vm_page_free_reserved) {
 		simple_unlock(&vm_page_queue_free_lock);
-		return KERN_RESOURCE_SHORTAGE;
+		ret = KERN_RESOURCE_SHORTAGE;
+		goto out;
 	}
 
 	/*
 	 *	First pass through, build a big bit-array of
-	 *	the pages that are free.  It is not going to
-	 *	be too large anyways, in 4k we can fit info
-	 *	for 32k pages.
+	 *	the pages that are free, pre-zeroed or not.
+	 *	It is not going to be too large anyways, in
+	 *	4k we can fit info for 32k pages.
 	 */
-	mem = vm_page_queue_free;
-	while (mem) {
-		register int word_index, bit_index;
-
-		bit_index = (mem->phys_addr >> PAGE_SHIFT);
-		word_index = bit_index / NBPEL;
-		bit_index = bit_index - (word_index * NBPEL);
-		bits[word_index] |= 1 << bit_index;
-
-		mem = (vm_page_t) mem->pageq.next;
+	for (queue = &vm_page_queue_free; ;
+	     queue = &vm_page_queue_zeroed) {
+		for (mem = *queue; mem; mem = (vm_page_t) mem->pageq.next) {
+			register int word_index, bit_index;
+
+			bit_index = (mem->phys_addr >> PAGE_SHIFT);
+			word_index = bit_index / NBPEL;
+			bit_index = bit_index - (word_index * NBPEL);
+			bits[word_index] |= 1 << bit_index;
+		}
+		if (queue == &vm_page_queue_zeroed)
+			break;
 	}
 
 	/*
 	 *	Second loop. Scan the bit array for NPAGES
-	 *	contiguous bits.  That gives us, if any,
-	 *	the range of pages we will be grabbing off
-	 *	the free list.
+	 *	contiguous bits, starting on an ALIGN boundary.
+	 *	That gives us, if any, the range of pages we
+	 *	will be grabbing off the free list.  On a miss,
+	 *	skip to the next boundary past the hole.
 	 */
 	{
-	    register int	bits_so_far = 0, i;
+	    register int	i, last;
 
+		last = size * NBBY;
 		first_set = 0;
 
-		for (i = 0; i < size; i += sizeof(natural_t)) {
-
-		    register natural_t	v = bits[i / sizeof(natural_t)];
-		    register int	bitpos;
-
-		    /*
-		     * Bitscan this one word
-		     */
-		    if (v) {
-			/*
-			 * keep counting them beans ?
-			 */
-			bitpos = 0;
-
-			if (bits_so_far) {
-count_ones:
-			    while (v & 1) {
-				bitpos++;
-				/*
-				 * got enough beans ?
-				 */
-				if (++bits_so_far == npages)
-				    goto found_em;
-				v >>= 1;
-			    }
-			    /* if we are being lucky, roll again */
-			    if (bitpos == NBPEL)
-			    	continue;
-			}
-
-			/*
-			 * search for beans here
-			 */
-			bits_so_far = 0;
-count_zeroes:
-			while ((bitpos < NBPEL) && ((v & 1) == 0)) {
-			    bitpos++;
-			    v >>= 1;
-			}
-			if (v & 1) {
-			    first_set = (i * NBBY) + bitpos;
-			    goto count_ones;
-			}
-		    }
-		    /*
-		     * No luck
-		     */
-		    bits_so_far = 0;
+		while (first_set + npages <= last) {
+		    for (i = first_set; i < first_set + npages; i++)
+			if ((bits[i / NBPEL] & (1 << (i % NBPEL))) == 0)
+			    break;
+		    if (i == first_set + npages)
+			goto found_em;
+		    first_set = ((i + align) / align) * align;
 		}
 	}
 
@@ -1071,20 +1265,33 @@ found_em:
 	    first_phys = first_set << PAGE_SHIFT;
 	    last_phys = first_phys + (npages << PAGE_SHIFT);/* not included */
 
-	    /* running pointers */
-	    mem = vm_page_queue_free;
+	    /* running pointers, over both lists */
+	    queue = &vm_page_queue_free;
+	    mem = *queue;
 	    prevmem = VM_PAGE_NULL;
 
-	    while (mem) {
+	    for (;;) {
 
 		register vm_offset_t	addr;
 
+		if (mem == VM_PAGE_NULL) {
+		    assert(queue == &vm_page_queue_free);
+		    queue = &vm_page_queue_zeroed;
+		    mem = *queue;
+		    prevmem = VM_PAGE_NULL;
+		    continue;
+		}
+
 		addr = mem->phys_addr;
 
 		if ((addr >= first_phys) &&
 		    (addr <  last_phys)) {
 		    if (prevmem)
 			prevmem->pageq.next = mem->pageq.next;
+		    else
+			*queue = (vm_page_t) mem->pageq.next;
+		    if (queue == &vm_page_queue_zeroed)
+			vm_page_zeroed_count--;
 		    pages[(addr - first_phys) >> PAGE_SHIFT] = mem;
 		    mem->free = FALSE;
 		    /*
@@ -1406,6 +1613,130 @@ void vm_page_zero_fill(
 	pmap_zero_page(m->phys_addr);
 }
 
+/*
+ *	vm_page_zero_fill_unmapped:
+ *
+ *	Like vm_page_zero_fill, but for a page that is
+ *	busy and not entered in any physical map, such as
+ *	a newly allocated page in a zero-fill fault.
+ *	If a pre-zeroed page is available, we exchange
+ *	physical frames with it instead of zeroing.
+ */
+void vm_page_zero_fill_unmapped(
+	vm_page_t	m)
+{
+	register vm_page_t	z;
+	vm_offset_t		phys_addr;
+
+	VM_PAGE_CHECK(m);
+	assert(m->busy);
+
+	if (!m->fictitious && !m->private) {
+		simple_lock(&vm_page_queue_free_lock);
+		if ((z = vm_page_queue_zeroed) != VM_PAGE_NULL) {
+			vm_page_queue_zeroed = (vm_page_t) z->pageq.next;
+			vm_page_zeroed_count--;
+
+			/*
+			 *	The free page takes over our old frame
+			 *	and goes back on the ordinary free list,
+			 *	so the free count doesn't change.
+			 */
+
+			phys_addr = z->phys_addr;
+			z->phys_addr = m->phys_addr;
+			m->phys_addr = phys_addr;
+
+			z->pageq.next = (queue_entry_t) vm_page_queue_free;
+			vm_page_queue_free = z;
+
+			if (vm_page_zeroed_count < vm_page_zeroed_target / 2)
+				thread_wakeup((event_t) &vm_page_queue_zeroed);
+			simple_unlock(&vm_page_queue_free_lock);
+			return;
+		}
+		simple_unlock(&vm_page_queue_free_lock);
+	}
+
+	if (vm_page_zeroed_count < vm_page_zeroed_target / 2)
+		thread_wakeup((event_t) &vm_page_queue_zeroed);
+	pmap_zero_page(m->phys_addr);
+}
+
+/*
+ *	vm_page_zero_thread:
+ *
+ *	Runs at the lowest priority, keeping a pool of
+ *	pre-zeroed free pages for vm_page_zero_fill_unmapped.
+ *	Pages are only zeroed while free memory is plentiful,
+ *	and the thread yields whenever anything else can run.
+ */
+
+void vm_page_zero_thread_continue(void)
+{
+	register vm_page_t	m;
+
+	for (;;) {
+		simple_lock(&vm_page_queue_free_lock);
+		if (!vm_page_zero_idle ||
+		    vm_page_zeroed_count >= vm_page_zeroed_target ||
+		    vm_page_free_count <= vm_page_free_target ||
+		    vm_page_queue_free == VM_PAGE_NULL)
+			break;
+
+		/*
+		 *	Take the page off the free list and out of the
+		 *	free count while we zero it, so that vm_page_grab
+		 *	never finds the count and the lists out of step.
+		 */
+
+		m = vm_page_queue_free;
+		vm_page_queue_free = (vm_page_t) m->pageq.next;
+		vm_page_free_count--;
+		simple_unlock(&vm_page_queue_free_lock);
+
+		pmap_zero_page_nocache(m->phys_addr);
+
+		simple_lock(&vm_page_queue_free_lock);
+		m->pageq.next = (queue_entry_t) vm_page_queue_zeroed;
+		vm_page_queue_zeroed = m;
+		vm_page_zeroed_count++;
+		vm_page_free_count++;
+
+		/*
+		 *	See vm_page_release.
+		 */
+
+		if ((vm_page_free_wanted > 0) &&
+		    (vm_page_free_count >= vm_page_free_reserved)) {
+			vm_page_free_wanted--;
+			thread_wakeup_one((event_t) &vm_page_free_count);
+		}
+		simple_unlock(&vm_page_queue_free_lock);
+
+		if (csw_needed(current_thread(), current_processor()))
+			thread_block((void (*)(void)) 0);
+	}
+
+	assert_wait((event_t) &vm_page_queue_zeroed, FALSE);
+	simple_unlock(&vm_page_queue_free_lock);
+	counter(c_vm_page_zero_thread_block++);
+	thread_block(vm_page_zero_thread_continue);
+	/*NOTREACHED*/
+}
+
+void vm_page_zero_thread(void)
+{
+	thread_set_own_priority(NRQS - 1);
+
+	if (vm_page_zeroed_target == 0)
+		vm_page_zeroed_target =
+			VM_PAGE_ZEROED_TARGET(vm_page_free_count);
+
+	vm_page_zero_thread_continue();
+	/*NOTREACHED*/
+}
+
 /*
  *	vm_page_copy:
  *
@@ -1445,14 +1776,21 @@ vm_page_info(
 		count = vm_page_bucket_count;
 
 	for (i = 0; i < count; i++) {
-		vm_page_bucket_t *bucket = &vm_page_buckets[i];
 		unsigned int bucket_count = 0;
 		vm_page_t m;
 
-		simple_lock(&bucket->lock);
-		for (m = bucket->pages; m != VM_PAGE_NULL; m = m->next)
-			bucket_count++;
-		simple_unlock(&bucket->lock);
+		/*
+		 *	The bucket's stripe is the same as that of
+		 *	any hash value that selects it.
+		 */
+
+		vm_page_bucket_lock(i);
+		if (i < vm_page_bucket_count)
+			for (m = vm_page_buckets[i].pages;
+			     m != VM_PAGE_NULL;
+			     m = m->next)
+				bucket_count++;
+		vm_page_bucket_unlock(i);
 
 		/* don't touch pageable memory while holding locks */
 		info[i].hib_count = bucket_count;
@@ -1460,6 +1798,42 @@ vm_page_info(
 
 	return vm_page_bucket_count;
 }
+
+/*
+ *	Routine:	vm_page_info_histogram
+ *	Purpose:
+ *		Return the distribution of chain lengths in
+ *		the VP table.  Entry i counts the buckets with
+ *		i pages; the last entry also counts longer chains.
+ *	Conditions:
+ *		Nothing locked.  The histogram must be wired.
+ */
+
+void
+vm_page_info_histogram(
+	hash_info_histogram_t	histogram)
+{
+	unsigned int i, length;
+	vm_page_t m;
+
+	for (i = 0; i < HASH_INFO_HISTOGRAM_SIZE; i++)
+		histogram[i] = 0;
+
+	for (i = 0; i < vm_page_bucket_count; i++) {
+		length = 0;
+		vm_page_bucket_lock(i);
+		if (i < vm_page_bucket_count)
+			for (m = vm_page_buckets[i].pages;
+			     m != VM_PAGE_NULL;
+			     m = m->next)
+				length++;
+		vm_page_bucket_unlock(i);
+
+		if (length >= HASH_INFO_HISTOGRAM_SIZE)
+			length = HASH_INFO_HISTOGRAM_SIZE - 1;
+		histogram[length]++;
+	}
+}
 #endif	/* MACH_VM_DEBUG */
 
 #include <mach_kdb.h>
@@ -60,6 +60,7 @@ kern_return_t vm_allocate(map, addr, size, anywhere)
 	boolean_t		anywhere;
 {
 	kern_return_t	result;
+	vm_offset_t	mask;
 
 	if (map == VM_MAP_NULL)
 		return(KERN_INVALID_ARGUMENT);
@@ -74,11 +75,20 @@ kern_return_t vm_allocate(map, addr, size, anywhere)
 		*addr = trunc_page(*addr);
 	size = round_page(size);
 
+	/*
+	 *	Align large regions so that the pmap
+	 *	can map them with superpages.
+	 */
+	mask = 0;
+	if (anywhere && pmap_superpage_size() != 0 &&
+	    size >= pmap_superpage_size())
+		mask = pmap_superpage_size() - 1;
+
 	result = vm_map_enter(
 			map,
 			addr,
 			size,
-			(vm_offset_t)0,
+			mask,
 			anywhere,
 			VM_OBJECT_NULL,
 			(vm_offset_t)0,
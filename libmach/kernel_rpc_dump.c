@@ -0,0 +1,136 @@
+/* 
+ * Copyright (c) 1995 The University of Utah and
+ * the Computer Systems Laboratory at the University of Utah (CSL).
+ * All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	Print the most frequently called kernel routines,
+ *	from the statistics kept by a MACH_DEBUG kernel.
+ */
+
+#include <stdio.h>
+#include <mach.h>
+#include <mach_debug/mach_debug.h>
+#include <mach_debug/rpc_info.h>
+
+/*
+ *	The kernel's MIG subsystems, by msgh_id base.
+ */
+static struct {
+	int	base;
+	char	*name;
+} kernel_subsystems[] = {
+	{ 2000, "mach" },
+	{ 2200, "memory_object" },
+	{ 2600, "mach_host" },
+	{ 2800, "device" },
+	{ 3000, "mach_debug" },
+	{ 3200, "mach_port" },
+	{ 3800, "machine" },
+	{ 4000, "mach4" },
+	{ 0, 0 }
+};
+
+static char *
+kernel_subsystem_name(id)
+	int id;
+{
+	int i;
+
+	for (i = 0; kernel_subsystems[i].name != 0; i++)
+		if ((id >= kernel_subsystems[i].base) &&
+		    (id < kernel_subsystems[i].base + 100))
+			return kernel_subsystems[i].name;
+	return "?";
+}
+
+/*
+ *	The smallest bucket below which the given fraction
+ *	(in percent) of the calls fall.
+ */
+static int
+kernel_rpc_percentile(kri, percent)
+	kernel_rpc_info_t *kri;
+	int percent;
+{
+	natural_t want, seen;
+	int i;
+
+	want = (kri->kri_count / 100) * percent +
+		((kri->kri_count % 100) * percent + 99) / 100;
+	seen = 0;
+	for (i = 0; i < KERNEL_RPC_HISTOGRAM_SIZE - 1; i++) {
+		seen += kri->kri_histogram[i];
+		if (seen >= want)
+			break;
+	}
+	return i;
+}
+
+/*
+ *	Routine:	kernel_rpc_dump
+ *	Purpose:
+ *		Print the top kernel routines by number of calls,
+ *		with the median and 99th percentile service time
+ *		(as powers of two of machine cycles).
+ */
+
+kern_return_t
+kernel_rpc_dump(host, top)
+	mach_port_t host;
+	int top;
+{
+	kernel_rpc_info_array_t info;
+	natural_t count;
+	kern_return_t kr;
+	int i, j, best;
+
+	count = 0;
+	kr = host_kernel_rpc_info(host, &info, &count);
+	if (kr != KERN_SUCCESS)
+		return kr;
+
+	printf("%6s %-14s %10s %8s %8s\n",
+	       "id", "subsystem", "calls", "median", "p99");
+
+	for (i = 0; (i < top) && (i < count); i++) {
+		kernel_rpc_info_t tmp;
+
+		/* selection sort, only as far as needed */
+		best = i;
+		for (j = i + 1; j < count; j++)
+			if (info[j].kri_count > info[best].kri_count)
+				best = j;
+		tmp = info[i];
+		info[i] = info[best];
+		info[best] = tmp;
+
+		printf("%6d %-14s %10u   2^%-4d   2^%-4d\n",
+		       info[i].kri_id,
+		       kernel_subsystem_name(info[i].kri_id),
+		       info[i].kri_count,
+		       kernel_rpc_percentile(&info[i], 50),
+		       kernel_rpc_percentile(&info[i], 99));
+	}
+
+	/* the kernel sends whole pages */
+	if (count != 0)
+		(void) vm_deallocate(mach_task_self(), (vm_offset_t) info,
+				     round_page(count * sizeof *info));
+	return KERN_SUCCESS;
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	Library side of shared-memory RPC channels.
+ *	See <mach/channel.h> for the slot protocol.
+ */
+
+#include <mach.h>
+#include <mach/mach4_interface.h>
+#include <mach/channel.h>
+
+extern void *memcpy(void *, const void *, unsigned int);
+
+/*
+ *	Poll a slot this many times before blocking in evc_wait;
+ *	when the other side runs on another processor the answer
+ *	often arrives sooner than a trip through the scheduler.
+ */
+#define	CHANNEL_SPIN	64
+
+#define	slot_stride(slot_size)	(sizeof(struct channel_slot) + (slot_size))
+
+/*
+ *	Slot addresses come from the geometry saved in mc,
+ *	never from the shared header.
+ */
+static struct channel_slot *
+channel_slot(mc, i)
+	mach_channel_t mc;
+	natural_t i;
+{
+	return (struct channel_slot *)
+		((char *) (mc->mc_header + 1) +
+		 i * slot_stride(mc->mc_slot_size));
+}
+
+/*
+ *	Routine:	mach_channel_create
+ *	Purpose:
+ *		Create a channel with nslots slots of slot_size
+ *		bytes, with the calling task as the client.
+ *		mc->mc_port can then be sent to the server.
+ */
+
+kern_return_t
+mach_channel_create(mc, slot_size, nslots)
+	mach_channel_t mc;
+	vm_size_t slot_size;
+	natural_t nslots;
+{
+	vm_address_t address;
+	kern_return_t kr;
+
+	if (nslots == 0)
+		return KERN_INVALID_ARGUMENT;
+
+	slot_size = (slot_size + sizeof(natural_t) - 1) &
+			~(sizeof(natural_t) - 1);
+	mc->mc_size = sizeof(struct channel_header) +
+		nslots * (sizeof(struct channel_slot) + slot_size);
+
+	kr = channel_create(mach_task_self(), mc->mc_size, &mc->mc_port,
+			    &address, &mc->mc_request, &mc->mc_reply);
+	if (kr != KERN_SUCCESS)
+		return kr;
+
+	mc->mc_header = (struct channel_header *) address;
+	mc->mc_header->chh_nslots = nslots;
+	mc->mc_header->chh_slot_size = slot_size;
+	mc->mc_header->chh_magic = CHANNEL_MAGIC;
+	mc->mc_nslots = nslots;
+	mc->mc_slot_size = slot_size;
+	mc->mc_next = 0;
+	return KERN_SUCCESS;
+}
+
+/*
+ *	Routine:	mach_channel_attach
+ *	Purpose:
+ *		Become the server of a channel, given a send
+ *		right for it (usually received in a message).
+ *		The header is read once and checked against the
+ *		real size of the buffer; after that only the copy
+ *		in mc is used.
+ */
+
+kern_return_t
+mach_channel_attach(mc, channel)
+	mach_channel_t mc;
+	mach_port_t channel;
+{
+	register struct channel_header *h;
+	vm_address_t address;
+	vm_size_t size;
+	natural_t nslots, slot_size;
+	kern_return_t kr;
+
+	kr = channel_attach(channel, mach_task_self(), &address, &size,
+			    &mc->mc_request, &mc->mc_reply);
+	if (kr != KERN_SUCCESS)
+		return kr;
+
+	h = (struct channel_header *) address;
+	if (size < sizeof *h || h->chh_magic != CHANNEL_MAGIC)
+		return KERN_INVALID_ARGUMENT;
+	nslots = h->chh_nslots;
+	slot_size = h->chh_slot_size;
+	if (nslots == 0 ||
+	    (slot_size & (sizeof(natural_t) - 1)) != 0 ||
+	    slot_size > size ||
+	    nslots > (size - sizeof *h) / slot_stride(slot_size))
+		return KERN_INVALID_ARGUMENT;
+
+	mc->mc_port = channel;
+	mc->mc_header = h;
+	mc->mc_size = size;
+	mc->mc_nslots = nslots;
+	mc->mc_slot_size = slot_size;
+	mc->mc_next = 0;
+	return KERN_SUCCESS;
+}
+
+/*
+ *	Routine:	mach_channel_call
+ *	Purpose:
+ *		Send a request through a free slot and wait for
+ *		its reply.  On entry *reply_size is the size of the
+ *		reply buffer; on return, the size of the reply.
+ *		Calls on one channel must be serialized by the caller.
+ */
+
+kern_return_t
+mach_channel_call(mc, id, request, request_size, reply, reply_size)
+	mach_channel_t mc;
+	natural_t id;
+	const void *request;
+	vm_size_t request_size;
+	void *reply;
+	vm_size_t *reply_size;
+{
+	register struct channel_slot *slot;
+	register int spin;
+	vm_size_t size;
+	natural_t i;
+	kern_return_t kr;
+
+	if (request_size > mc->mc_slot_size)
+		return KERN_INVALID_ARGUMENT;
+
+	for (i = 0; i < mc->mc_nslots; i++) {
+		slot = channel_slot(mc, mc->mc_next);
+		mc->mc_next = (mc->mc_next + 1) % mc->mc_nslots;
+		if (slot->cs_state == CHANNEL_SLOT_FREE)
+			break;
+	}
+	if (i == mc->mc_nslots)
+		return KERN_NO_SPACE;
+
+	memcpy(channel_slot_data(slot), request, request_size);
+	slot->cs_id = id;
+	slot->cs_size = request_size;
+	slot->cs_state = CHANNEL_SLOT_REQUEST;
+
+	kr = channel_signal(mc->mc_request);
+	if (kr != KERN_SUCCESS)
+		return kr;
+
+	for (spin = CHANNEL_SPIN; slot->cs_state != CHANNEL_SLOT_REPLY; ) {
+		if (spin > 0) {
+			spin--;
+			continue;
+		}
+		kr = evc_wait(mc->mc_reply);
+		if (kr != KERN_SUCCESS)
+			return kr;
+	}
+
+	/* cs_size is the server's word; read it once and bound it */
+	size = slot->cs_size;
+	if (size > mc->mc_slot_size)
+		size = mc->mc_slot_size;
+	if (size < *reply_size)
+		*reply_size = size;
+	memcpy(reply, channel_slot_data(slot), *reply_size);
+	slot->cs_state = CHANNEL_SLOT_FREE;
+	return KERN_SUCCESS;
+}
+
+/*
+ *	Routine:	mach_channel_receive
+ *	Purpose:
+ *		Wait for the next request.  The slot returned is
+ *		owned by the server until mach_channel_reply.
+ */
+
+kern_return_t
+mach_channel_receive(mc, slotp)
+	mach_channel_t mc;
+	struct channel_slot **slotp;
+{
+	register struct channel_slot *slot;
+	register int spin = CHANNEL_SPIN;
+	natural_t i;
+	kern_return_t kr;
+
+	for (;;) {
+		for (i = 0; i < mc->mc_nslots; i++) {
+			slot = channel_slot(mc, mc->mc_next);
+			mc->mc_next = (mc->mc_next + 1) % mc->mc_nslots;
+			if (slot->cs_state == CHANNEL_SLOT_REQUEST) {
+				slot->cs_state = CHANNEL_SLOT_BUSY;
+				*slotp = slot;
+				return KERN_SUCCESS;
+			}
+		}
+		if (spin > 0) {
+			spin--;
+			continue;
+		}
+		kr = evc_wait(mc->mc_request);
+		if (kr != KERN_SUCCESS)
+			return kr;
+	}
+}
+
+/*
+ *	Routine:	mach_channel_reply
+ *	Purpose:
+ *		Hand a slot back to the client with reply_size
+ *		bytes of reply in its data area.
+ */
+
+kern_return_t
+mach_channel_reply(mc, slot, reply_size)
+	mach_channel_t mc;
+	struct channel_slot *slot;
+	vm_size_t reply_size;
+{
+	if (slot->cs_state != CHANNEL_SLOT_BUSY ||
+	    reply_size > mc->mc_slot_size)
+		return KERN_INVALID_ARGUMENT;
+
+	slot->cs_size = reply_size;
+	slot->cs_state = CHANNEL_SLOT_REPLY;
+	return channel_signal(mc->mc_reply);
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 1994 The University of Utah and
+ * the Computer Systems Laboratory (CSL).  All rights reserved.
+ *
+ * Permission to use, copy, modify and distribute this software is hereby
+ * granted provided that (1) source code retains these copyright, permission,
+ * and disclaimer notices, and (2) redistributions including binaries
+ * reproduce the notices in supporting documentation, and (3) all advertising
+ * materials mentioning features or use of this software display the following
+ * acknowledgement: ``This product includes software developed by the
+ * Computer Systems Laboratory at the University of Utah.''
+ *
+ * THE UNIVERSITY OF UTAH AND CSL ALLOW FREE USE OF THIS SOFTWARE IN ITS "AS
+ * IS" CONDITION.  THE UNIVERSITY OF UTAH AND CSL DISCLAIM ANY LIABILITY OF
+ * ANY KIND FOR ANY DAMAGES WHATSOEVER RESULTING FROM THE USE OF THIS SOFTWARE.
+ *
+ * CSL requests users of this software to return to csl-dist@cs.utah.edu any
+ * improvements that they make and grant CSL redistribution rights.
+ */
+/*
+ *	Walk the frames of a batched network receive message.
+ */
+
+#include <mach.h>
+#include <device/net_status.h>
+
+/*
+ *	Routine:	net_rcv_batch_next
+ *	Purpose:
+ *		Return the frame after frame in msg, or the first
+ *		frame if frame is null.  Returns null after the
+ *		last frame, or if the message is malformed.
+ */
+
+struct net_rcv_frame *
+net_rcv_batch_next(msg, frame)
+	net_rcv_batch_msg_t msg;
+	struct net_rcv_frame *frame;
+{
+	char *end = msg->frames + msg->frames_type.msgtl_number;
+	char *next;
+
+	if (frame == 0)
+		next = msg->frames;
+	else
+		next = (char *) frame + frame->nf_size;
+
+	if (next + sizeof(struct net_rcv_frame) > end)
+		return 0;
+	frame = (struct net_rcv_frame *) next;
+	if (frame->nf_size < sizeof(struct net_rcv_frame) +
+			     frame->nf_header_size + frame->nf_packet_size ||
+	    next + frame->nf_size > end)
+		return 0;
+	return frame;
+}